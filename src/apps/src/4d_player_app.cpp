@@ -6,54 +6,122 @@
 #include <4d/player.hpp>
 #include <4d/depth_filter.hpp>
 #include <4d/dataset_reader.hpp>
+#include <4d/parallel_mesher.hpp>
+#include <4d/mesh_cache_reader.hpp>
+#include <4d/mesh_cache_writer.hpp>
 
 
 int main(int argc, char *argv[])
 {
     const int minNumArgs = 2;
     if (argc < minNumArgs)
-        TLOG(FATAL) << "Expected at least" << minNumArgs << " arguments, got " << argc;
+        TLOG(FATAL) << "Usage: " << argv[0] << " [--preview] <dataset.4dv>";
 
+    // --preview: point sprites straight from the depth filter, no triangulation, for the minimum latency
+    bool preview = false;
     int arg = 1;
+    for (; arg < argc - 1; ++arg)
+    {
+        const std::string option(argv[arg]);
+        if (option == "--preview")
+            preview = true;
+        else
+            TLOG(FATAL) << "Unknown option " << option;
+    }
+
     const std::string datasetPath(argv[arg++]);
 
     CancellationToken cancellationToken;
-    FrameQueue frameQueue(100), filteredDepthQueue(100);
-    MeshFrameQueue playerQueue(10);
+    FrameQueue frameQueue(100), filteredQueue(2);
+    MeshFrameQueue playerQueue(10), cacheQueue(100);
 
-    std::thread readerThread([&]
-    {
-        DatasetReader reader(datasetPath, true, cancellationToken);
-        reader.addQueue(&frameQueue);
-        reader.init();
-        reader.runLoop();
-    });
+    // replay the pre-meshed sequence if we have one, otherwise run the full pipeline and save the results
+    const bool useMeshCache = !preview && MeshCacheReader::isValid(datasetPath);
+    std::vector<std::thread> threads;
+    MeshFrameCache frameCache;
 
-    std::thread filterThread([&]
+    if (preview)
     {
-        FrameProducer filteredDepthProducer(cancellationToken);
-        filteredDepthProducer.addQueue(&filteredDepthQueue);
+        threads.emplace_back([&]
+        {
+            DatasetReader reader(datasetPath, true, cancellationToken);
+            reader.addQueue(&frameQueue);
+            reader.enableRealTimePacing();
+            reader.init();
+            reader.runLoop();
+        });
 
-        DepthFilter filter(frameQueue, filteredDepthProducer, cancellationToken);
-        filter.init();
-        filter.run();
-    });
+        threads.emplace_back([&]
+        {
+            FrameProducer filteredProducer(cancellationToken);
+            filteredProducer.addQueue(&filteredQueue);
+            DepthFilter filter(frameQueue, filteredProducer, cancellationToken);
+            filter.init();
+            filter.run();
+        });
 
-    std::thread mesherThread([&]
+        threads.emplace_back([&]
+        {
+            MeshFrameProducer pointsProducer(cancellationToken);
+            pointsProducer.addQueue(&playerQueue);
+            Mesher mesher(filteredQueue, pointsProducer, cancellationToken);
+            mesher.enablePointsOnly();
+            mesher.init();
+            mesher.run();
+        });
+    }
+    else if (useMeshCache)
     {
-        MeshFrameProducer meshFrameProducer(cancellationToken);
-        meshFrameProducer.addQueue(&playerQueue);
-        Mesher mesher(filteredDepthQueue, meshFrameProducer, cancellationToken);
-        mesher.init();
-        mesher.run();
-    });
+        threads.emplace_back([&]
+        {
+            MeshCacheReader reader(datasetPath, true, cancellationToken);
+            reader.addQueue(&playerQueue);
+            reader.init();
+            reader.runLoop();
+        });
+    }
+    else
+    {
+        threads.emplace_back([&]
+        {
+            // paced like in the preview, otherwise the reader runs far ahead of the player and the reported latency
+            // is mostly the wait in the frame queue; the player shows frames at their timestamps anyway
+            DatasetReader reader(datasetPath, true, cancellationToken);
+            reader.addQueue(&frameQueue);
+            reader.enableRealTimePacing();
+            reader.init();
+            reader.runLoop();
+        });
+
+        threads.emplace_back([&]
+        {
+            // the dataset is played in a loop, after the first pass the frames come from the memory cache
+            MeshFrameProducer meshFrameProducer(cancellationToken);
+            meshFrameProducer.addQueue(&playerQueue);
+            meshFrameProducer.addQueue(&cacheQueue);
+            ParallelMesher mesher(frameQueue, meshFrameProducer, cancellationToken, 1);
+            mesher.setCache(frameCache, datasetPath);
+            mesher.init();
+            mesher.run();
+        });
+
+        threads.emplace_back([&]
+        {
+            MeshCacheWriter cacheWriter(datasetPath, cacheQueue, cancellationToken);
+            cacheWriter.init();
+            cacheWriter.run();
+        });
+    }
 
     Player player(playerQueue, cancellationToken);
+    if (preview)
+        player.setJitterBufferSize(1);
     player.init();
     player.run();
 
     cancellationToken.trigger();
-    readerThread.join(), filterThread.join(), mesherThread.join();
+    for (auto &t : threads)
+        t.join();
 
     return EXIT_SUCCESS;
 }
@@ -1,12 +1,18 @@
 #include <thread>
 
 #include <util/tiny_logger.hpp>
+#include <util/filesystem_utils.hpp>
 
 #include <4d/mesher.hpp>
 #include <4d/player.hpp>
+#include <4d/params.hpp>
 #include <4d/depth_filter.hpp>
+#include <4d/mesh_decimator.hpp>
 #include <4d/dataset_reader.hpp>
+#include <4d/mesh_cache_reader.hpp>
+#include <4d/mesh_cache_writer.hpp>
 #include <4d/animation_writer.hpp>
+#include <4d/mesh_sequence_writer.hpp>
 
 
 int main(int argc, char *argv[])
@@ -18,43 +24,124 @@ int main(int argc, char *argv[])
     int arg = 1;
     const std::string datasetPath(argv[arg++]), outputPath(argv[arg++]);
 
+    // optional: --sequence to write a single compressed .4ds container instead of PLY files and texture atlases,
+    // --dedupe to skip frames that did not change, --decimate N to simplify the written meshes to N triangles
+    // (e.g. 20000 for the web viewers)
+    bool writeSequence = false, dedupe = false;
+    int writerTriangleBudget = decimationParams().writerTriangleBudget;
+    for (; arg < argc; ++arg)
+    {
+        const std::string option(argv[arg]);
+        if (option == "--sequence")
+            writeSequence = true;
+        else if (option == "--dedupe")
+            dedupe = true;
+        else if (option == "--decimate" && arg + 1 < argc)
+            writerTriangleBudget = std::stoi(argv[++arg]);
+        else
+            TLOG(FATAL) << "Unknown option " << option;
+    }
+
     CancellationToken cancellationToken;
     FrameQueue frameQueue(100), filteredDepthQueue(100);
-    MeshFrameQueue playerQueue(10), writerQueue(200);
+    MeshFrameQueue playerQueue(10), writerQueue(200), cacheQueue(100);
+    MeshFrameQueue playerDecimationQueue(10), writerDecimationQueue(100);
 
-    std::thread readerThread([&]
-    {
-        DatasetReader reader(datasetPath, true, cancellationToken);
-        reader.addQueue(&frameQueue);
-        reader.init();
-        reader.run();
-    });
+    // replay the pre-meshed sequence if we have one, otherwise run the full pipeline and save the results
+    const bool useMeshCache = MeshCacheReader::isValid(datasetPath);
+    std::vector<std::thread> threads;
 
-    std::thread filterThread([&]
+    // each output gets meshes simplified to its own triangle budget, if any
+    const auto addDecimation = [&](int triangleBudget, MeshFrameQueue &decimationQueue, MeshFrameQueue &outputQueue) -> MeshFrameQueue &
     {
-        FrameProducer filteredDepthProducer(cancellationToken);
-        filteredDepthProducer.addQueue(&filteredDepthQueue);
-        DepthFilter filter(frameQueue, filteredDepthProducer, cancellationToken);
-        filter.init();
-        filter.run();
-    });
+        if (triangleBudget <= 0)
+            return outputQueue;
+
+        SimplificationSettings settings;
+        settings.targetTriangles = size_t(triangleBudget);
+        settings.maxError = decimationParams().maxError;
+        MeshFrameQueue *input = &decimationQueue, *output = &outputQueue;
+        threads.emplace_back([&cancellationToken, input, output, settings]
+        {
+            MeshFrameProducer producer(cancellationToken);
+            producer.addQueue(output);
+            MeshDecimator decimator(*input, producer, cancellationToken, settings);
+            decimator.init();
+            decimator.run();
+        });
+        return decimationQueue;
+    };
 
-    std::thread mesherThread([&]
+    MeshFrameQueue &playerInput = addDecimation(decimationParams().playerTriangleBudget, playerDecimationQueue, playerQueue);
+    MeshFrameQueue &writerInput = addDecimation(writerTriangleBudget, writerDecimationQueue, writerQueue);
+
+    if (useMeshCache)
+    {
+        threads.emplace_back([&]
+        {
+            MeshCacheReader reader(datasetPath, true, cancellationToken);
+            reader.addQueue(&playerInput);
+            reader.addQueue(&writerInput);
+            reader.init();
+            reader.run();
+        });
+    }
+    else
     {
-        MeshFrameProducer meshFrameProducer(cancellationToken);
-        meshFrameProducer.addQueue(&playerQueue);
-        meshFrameProducer.addQueue(&writerQueue);
+        threads.emplace_back([&]
+        {
+            DatasetReader reader(datasetPath, true, cancellationToken);
+            reader.addQueue(&frameQueue);
+            reader.init();
+            reader.run();
+        });
 
-        Mesher mesher(filteredDepthQueue, meshFrameProducer, cancellationToken);
-        mesher.init();
-        mesher.run();
-    });
+        threads.emplace_back([&]
+        {
+            FrameProducer filteredDepthProducer(cancellationToken);
+            filteredDepthProducer.addQueue(&filteredDepthQueue);
+            DepthFilter filter(frameQueue, filteredDepthProducer, cancellationToken);
+            filter.init();
+            filter.run();
+        });
+
+        threads.emplace_back([&]
+        {
+            MeshFrameProducer meshFrameProducer(cancellationToken);
+            meshFrameProducer.addQueue(&playerInput);
+            meshFrameProducer.addQueue(&writerInput);
+            meshFrameProducer.addQueue(&cacheQueue);
+
+            Mesher mesher(filteredDepthQueue, meshFrameProducer, cancellationToken);
+            mesher.init();
+            mesher.run();
+        });
+
+        threads.emplace_back([&]
+        {
+            MeshCacheWriter cacheWriter(datasetPath, cacheQueue, cancellationToken);
+            cacheWriter.init();
+            cacheWriter.run();
+        });
+    }
 
     std::thread writerThread([&]
     {
-        AnimationWriter writer(outputPath, writerQueue, cancellationToken);
-        writer.init();
-        writer.run();
+        if (writeSequence)
+        {
+            MeshSequenceWriter writer(pathJoin(outputPath, "sequence.4ds"), writerQueue, cancellationToken);
+            writer.enablePlyComparison();
+            writer.init();
+            writer.run();
+        }
+        else
+        {
+            AnimationWriter writer(outputPath, writerQueue, cancellationToken);
+            if (dedupe)
+                writer.enableDeduplication();
+            writer.init();
+            writer.run();
+        }
     });
 
     Player player(playerQueue, cancellationToken);
@@ -63,9 +150,8 @@ int main(int argc, char *argv[])
 
     cancellationToken.trigger();
 
-    readerThread.join();
-    filterThread.join();
-    mesherThread.join();
+    for (auto &t : threads)
+        t.join();
     writerThread.join();
 
     return EXIT_SUCCESS;
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <thread>
+
+#include <util/tiny_logger.hpp>
+#include <util/string_utils.hpp>
+#include <util/filesystem_utils.hpp>
+
+#include <4d/app_state.hpp>
+#include <4d/dataset_reader.hpp>
+#include <4d/parallel_mesher.hpp>
+#include <4d/mesh_cache_reader.hpp>
+#include <4d/mesh_cache_writer.hpp>
+#include <4d/animation_writer.hpp>
+
+
+namespace
+{
+
+/// "path/to/take.4dv" -> "take"
+std::string datasetName(const std::string &path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    const std::string filename = slash == std::string::npos ? path : path.substr(slash + 1);
+    return filename.substr(0, filename.find_last_of('.'));
+}
+
+/// Full pipeline for a single dataset without the player: each stage is stopped after the previous one finished,
+/// so every frame goes through all the stages. Returns the number of exported frames.
+int processDataset(const std::string &datasetPath, const std::string &outputPath, int numWorkers)
+{
+    appState().reset();
+
+    // producers use the token of the last stage, so no frames are dropped while the stages drain their queues
+    CancellationToken meshingCancel, writingCancel;
+    FrameQueue frameQueue(100);
+    MeshFrameQueue writerQueue(100), cacheQueue(100);
+
+    int numFrames = 0;
+    std::thread writerThread([&]
+    {
+        AnimationWriter writer(outputPath, writerQueue, writingCancel);
+        writer.init();
+        writer.run();
+    });
+
+    if (MeshCacheReader::isValid(datasetPath))
+    {
+        // meshing was already done before, just replay the cache
+        MeshCacheReader reader(datasetPath, true, writingCancel);
+        reader.addQueue(&writerQueue);
+        reader.init();
+        reader.run();
+        numFrames = reader.numFramesRead();
+    }
+    else
+    {
+        std::thread cacheWriterThread([&]
+        {
+            MeshCacheWriter cacheWriter(datasetPath, cacheQueue, writingCancel);
+            cacheWriter.init();
+            cacheWriter.run();
+        });
+
+        MeshFrameProducer meshFrameProducer(writingCancel);
+        meshFrameProducer.addQueue(&writerQueue);
+        meshFrameProducer.addQueue(&cacheQueue);
+        ParallelMesher mesher(frameQueue, meshFrameProducer, meshingCancel, numWorkers);
+        std::thread mesherThread([&]
+        {
+            mesher.init();
+            mesher.run();
+        });
+
+        DatasetReader reader(datasetPath, true, writingCancel);
+        reader.addQueue(&frameQueue);
+        reader.init();
+        reader.run();
+
+        meshingCancel.trigger();
+        mesherThread.join();
+        numFrames = mesher.numProcessedFrames();
+
+        writingCancel.trigger();
+        cacheWriterThread.join();
+    }
+
+    writingCancel.trigger();
+    writerThread.join();
+    return numFrames;
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    const int minNumArgs = 3;
+    if (argc < minNumArgs)
+        TLOG(FATAL) << "Usage: " << argv[0] << " [--workers N] <output dir> <dataset.4dv> [<dataset.4dv> ...]";
+
+    int arg = 1;
+    int numWorkers = 0;  // default: ParallelMesher picks the number of workers for the hardware
+    if (std::string(argv[arg]) == "--workers")
+    {
+        bool ok = false;
+        if (arg + 1 < argc)
+            numWorkers = stringTo<int>(argv[arg + 1], ok);
+        arg += 2;
+        if (!ok || numWorkers < 1 || argc - arg < 2)
+            TLOG(FATAL) << "Usage: " << argv[0] << " [--workers N] <output dir> <dataset.4dv> [<dataset.4dv> ...], N >= 1";
+    }
+
+    const std::string outputRoot(argv[arg++]);
+    if (!createDirectory(outputRoot))
+        TLOG(FATAL) << "Could not create output directory " << outputRoot;
+
+    // datasets one after another: sensor parameters are global, and frame-level parallelism already loads all cores
+    for (; arg < argc; ++arg)
+    {
+        const std::string datasetPath(argv[arg]);
+        const std::string outputPath = pathJoin(outputRoot, datasetName(datasetPath));
+        if (!createDirectory(outputPath))
+        {
+            TLOG(ERROR) << "Could not create output directory " << outputPath << ", skip " << datasetPath;
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const int numFrames = processDataset(datasetPath, outputPath, numWorkers);
+        const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+        TLOG(INFO) << datasetPath << ": " << numFrames << " frames in " << seconds << " s, " << numFrames / seconds << " fps";
+    }
+
+    return EXIT_SUCCESS;
+}
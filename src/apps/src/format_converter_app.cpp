@@ -27,19 +27,26 @@ float extrTranslation[3];
 
 int main(int argc, char *argv[])
 {
-    const int numArgs = 3;
-    if (argc != numArgs)
-        TLOG(FATAL) << "Expected " << numArgs << " arguments, got " << argc;
+    const int minNumArgs = 3;
+    if (argc < minNumArgs)
+        TLOG(FATAL) << "Expected at least " << minNumArgs << " arguments, got " << argc;
 
     int arg = 1;
     const std::string datasetPath(argv[arg++]), outputPath(argv[arg++]);
 
+    // optional: --quantize (16-bit cloud) or --quantize-morton (16-bit cloud, Morton order + delta coding)
+    const std::string quantization(arg < argc ? argv[arg++] : "");
+
     CancellationToken cancellationToken;
     FrameQueue frameQueue;
 
     std::thread writerThread([&]
     {
         DatasetWriter writer(outputPath, frameQueue, cancellationToken);
+        if (quantization == "--quantize")
+            writer.enableCloudQuantization(CloudEncoding::RAW);
+        else if (quantization == "--quantize-morton")
+            writer.enableCloudQuantization(CloudEncoding::MORTON_DELTA);
         writer.init();
         writer.run();
     });
@@ -0,0 +1,99 @@
+#include <thread>
+
+#include <util/tiny_logger.hpp>
+#include <util/string_utils.hpp>
+#include <util/filesystem_utils.hpp>
+
+#include <4d/dataset_reader.hpp>
+#include <4d/parallel_mesher.hpp>
+#include <4d/mesh_cache_reader.hpp>
+#include <4d/offscreen_renderer.hpp>
+
+
+int main(int argc, char *argv[])
+{
+    const int minNumArgs = 3;
+    if (argc < minNumArgs)
+        TLOG(FATAL) << "Usage: " << argv[0] << " [--width N] [--raw] [--yaw degrees per frame] [--pitch degrees] [--distance scale] <dataset.4dv> <output dir>";
+
+    // the last two arguments are the dataset and the output, options can't take them as values
+    OffscreenRenderer::Settings settings;
+    int arg = 1;
+    for (; arg < argc - 2; ++arg)
+    {
+        const std::string option(argv[arg]);
+        const bool hasValue = arg + 1 < argc - 2;
+        bool ok = true;
+        if (option == "--raw")
+            settings.rawOutput = true;
+        else if (option == "--width" && hasValue)
+        {
+            settings.width = stringTo<int>(argv[++arg], ok);
+            ok = ok && settings.width > 0;
+        }
+        else if (option == "--yaw" && hasValue)
+            settings.yawDegreesPerFrame = stringTo<float>(argv[++arg], ok);
+        else if (option == "--pitch" && hasValue)
+            settings.pitchDegrees = stringTo<float>(argv[++arg], ok);
+        else if (option == "--distance" && hasValue)
+        {
+            settings.distanceScale = stringTo<float>(argv[++arg], ok);
+            ok = ok && settings.distanceScale > 0;
+        }
+        else
+            ok = false;
+
+        if (!ok)
+            TLOG(FATAL) << "Usage: " << argv[0] << " [--width N] [--raw] [--yaw degrees per frame] [--pitch degrees] [--distance scale] <dataset.4dv> <output dir>, "
+                        << "width and distance scale positive";
+    }
+
+    const std::string datasetPath(argv[arg++]);
+    const std::string outputPath(argv[arg++]);
+    if (!createDirectory(outputPath))
+        TLOG(FATAL) << "Could not create output directory " << outputPath;
+
+    // every frame is rendered: producers use the token of the renderer, which is stopped after all the other stages
+    CancellationToken meshingCancel, renderingCancel;
+    FrameQueue frameQueue(100);
+    MeshFrameQueue rendererQueue(100);
+
+    std::thread rendererThread([&]
+    {
+        OffscreenRenderer renderer(outputPath, settings, rendererQueue, renderingCancel);
+        renderer.init();
+        renderer.run();
+    });
+
+    if (MeshCacheReader::isValid(datasetPath))
+    {
+        MeshCacheReader reader(datasetPath, true, renderingCancel);
+        reader.addQueue(&rendererQueue);
+        reader.init();
+        reader.run();
+    }
+    else
+    {
+        MeshFrameProducer meshFrameProducer(renderingCancel);
+        meshFrameProducer.addQueue(&rendererQueue);
+        ParallelMesher mesher(frameQueue, meshFrameProducer, meshingCancel);
+        std::thread mesherThread([&]
+        {
+            mesher.init();
+            mesher.run();
+        });
+
+        DatasetReader reader(datasetPath, true, renderingCancel);
+        reader.addQueue(&frameQueue);
+        reader.init();
+        reader.run();
+
+        meshingCancel.trigger();
+        mesherThread.join();
+    }
+
+    renderingCancel.trigger();
+    rendererThread.join();
+
+    return EXIT_SUCCESS;
+}
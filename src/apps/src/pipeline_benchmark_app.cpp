@@ -0,0 +1,394 @@
+#include <array>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <util/tiny_logger.hpp>
+#include <util/cpu_features.hpp>
+#include <util/string_utils.hpp>
+
+#include <4d/mesher.hpp>
+#include <4d/app_state.hpp>
+#include <4d/depth_filter.hpp>
+#include <4d/synthetic_sensor.hpp>
+
+
+namespace
+{
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+/// Points where the frames are stamped: creation by the sensor, then the input and the output of every stage.
+/// From the output of a stage to the input of the next one the frame waits in the queue.
+enum Stamp
+{
+    CREATED,
+    FILTER_STARTED,
+    FILTERED,
+    MESHER_STARTED,
+    MESHED,
+    RECEIVED,
+    NUM_STAMPS,
+};
+
+/// Per-frame stamps, written by the stage threads.
+class FrameStamps
+{
+public:
+    explicit FrameStamps(int numFrames)
+        : stamps(numFrames)
+        , stamped(numFrames)
+    {
+    }
+
+    void record(const Frame &frame, Stamp stamp)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (frame.frameNumber < 0 || frame.frameNumber >= int(stamps.size()))
+            return;
+        stamps[frame.frameNumber][CREATED] = frame.creationTime;
+        stamps[frame.frameNumber][stamp] = now;
+        stamped[frame.frameNumber][stamp] = true;
+    }
+
+    /// Milliseconds between two stamps of every frame that has both.
+    std::vector<double> intervalsMs(Stamp from, Stamp to) const
+    {
+        std::vector<double> intervals;
+        for (size_t i = 0; i < stamps.size(); ++i)
+            if ((from == CREATED || stamped[i][from]) && stamped[i][to])
+                intervals.push_back(std::chrono::duration<double, std::milli>(stamps[i][to] - stamps[i][from]).count());
+        return intervals;
+    }
+
+    /// Frames per second at the output, from the first to the last received frame.
+    double outputFps() const
+    {
+        std::vector<TimePoint> received;
+        for (size_t i = 0; i < stamps.size(); ++i)
+            if (stamped[i][RECEIVED])
+                received.push_back(stamps[i][RECEIVED]);
+        if (received.size() < 2)
+            return 0;
+
+        const auto minmax = std::minmax_element(received.begin(), received.end());
+        const double seconds = std::chrono::duration<double>(*minmax.second - *minmax.first).count();
+        return seconds > 0 ? (received.size() - 1) / seconds : 0;
+    }
+
+private:
+    std::vector<std::array<TimePoint, NUM_STAMPS>> stamps;
+    std::vector<std::array<bool, NUM_STAMPS>> stamped;
+    std::mutex mutex;
+};
+
+/// Depth filter that stamps the frames taken from its queue.
+class StampingDepthFilter : public DepthFilter
+{
+public:
+    StampingDepthFilter(FrameQueue &q, FrameProducer &output, FrameStamps &stamps, CancellationToken &cancellationToken)
+        : DepthFilter(q, output, cancellationToken)
+        , stamps(stamps)
+    {
+    }
+
+protected:
+    void process(std::shared_ptr<Frame> &frame) override
+    {
+        stamps.record(*frame, FILTER_STARTED);
+        DepthFilter::process(frame);
+    }
+
+private:
+    FrameStamps &stamps;
+};
+
+/// Mesher that stamps the frames taken from its queue.
+class StampingMesher : public Mesher
+{
+public:
+    StampingMesher(FrameQueue &q, MeshFrameProducer &output, FrameStamps &stamps, CancellationToken &cancellationToken)
+        : Mesher(q, output, cancellationToken)
+        , stamps(stamps)
+    {
+    }
+
+protected:
+    void process(std::shared_ptr<Frame> &frame) override
+    {
+        stamps.record(*frame, MESHER_STARTED);
+        Mesher::process(frame);
+    }
+
+private:
+    FrameStamps &stamps;
+};
+
+/// Output of the depth filter.
+class StampingFrameProducer : public FrameProducer
+{
+public:
+    StampingFrameProducer(FrameStamps &stamps, const CancellationToken &cancellationToken)
+        : FrameProducer(cancellationToken)
+        , stamps(stamps)
+    {
+    }
+
+    void produce(std::shared_ptr<Frame> frame) override
+    {
+        stamps.record(*frame, FILTERED);
+        FrameProducer::produce(frame);
+    }
+
+private:
+    FrameStamps &stamps;
+};
+
+/// Output of the mesher.
+class StampingMeshFrameProducer : public MeshFrameProducer
+{
+public:
+    StampingMeshFrameProducer(FrameStamps &stamps, const CancellationToken &cancellationToken)
+        : MeshFrameProducer(cancellationToken)
+        , stamps(stamps)
+    {
+    }
+
+    void produce(std::shared_ptr<MeshFrame> frame) override
+    {
+        stamps.record(*frame->frame2D, MESHED);
+        MeshFrameProducer::produce(frame);
+    }
+
+private:
+    FrameStamps &stamps;
+};
+
+/// End of the pipeline instead of the player: only counts the frames.
+class NullSink : public MeshFrameConsumer
+{
+public:
+    NullSink(MeshFrameQueue &q, FrameStamps &stamps, CancellationToken &cancellationToken)
+        : MeshFrameConsumer(q, cancellationToken)
+        , stamps(stamps)
+    {
+    }
+
+    int numFrames = 0;
+    size_t numPoints = 0, numTriangles = 0;
+
+protected:
+    void process(std::shared_ptr<MeshFrame> &frame) override
+    {
+        stamps.record(*frame->frame2D, RECEIVED);
+        ++numFrames;
+        numPoints += frame->isCompact() ? frame->compactVertices.size() : frame->cloud.size();
+        numTriangles += frame->triangles.size();
+    }
+
+private:
+    FrameStamps &stamps;
+};
+
+struct LatencySummary
+{
+    double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+LatencySummary summarize(std::vector<double> values)
+{
+    LatencySummary s;
+    if (values.empty())
+        return s;
+
+    std::sort(values.begin(), values.end());
+    const auto percentile = [&](double p) { return values[std::min(values.size() - 1, size_t(p * values.size()))]; };
+    for (double v : values)
+        s.mean += v;
+    s.mean /= values.size();
+    s.p50 = percentile(0.5), s.p90 = percentile(0.9), s.p99 = percentile(0.99), s.max = values.back();
+    return s;
+}
+
+std::ostream & operator<<(std::ostream &out, const LatencySummary &s)
+{
+    return out << "mean " << s.mean << " p50 " << s.p50 << " p90 " << s.p90 << " p99 " << s.p99 << " max " << s.max;
+}
+
+std::string toJson(const LatencySummary &s)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{ \"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90 << ", \"p99\": " << s.p99
+        << ", \"max\": " << s.max << " }";
+    return out.str();
+}
+
+/// Value of the command line option, false if it is not a number or not positive.
+template <typename T>
+bool parsePositive(const std::string &s, T &value)
+{
+    bool ok = false;
+    const T parsed = stringTo<T>(s, ok);
+    if (!ok || !(parsed > 0))
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    SyntheticSensorSettings settings;
+    bool pointsOnly = false;
+    std::string jsonPath;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        const std::string option(argv[arg]);
+        const bool hasValue = arg + 1 < argc;
+        bool ok = true;
+        if (option == "--width" && hasValue)
+            ok = parsePositive(argv[++arg], settings.width);
+        else if (option == "--height" && hasValue)
+            ok = parsePositive(argv[++arg], settings.height);
+        else if (option == "--fps" && hasValue)
+            ok = parsePositive(argv[++arg], settings.fps);
+        else if (option == "--frames" && hasValue)
+            ok = parsePositive(argv[++arg], settings.numFrames);
+        else if (option == "--noise" && hasValue)
+        {
+            // zero is fine, exact depth
+            settings.noiseMm = stringTo<float>(argv[++arg], ok);
+            ok = ok && settings.noiseMm >= 0;
+        }
+        else if (option == "--unpaced")
+            settings.realTime = false;
+        else if (option == "--points-only")
+            pointsOnly = true;
+        else if (option == "--json" && hasValue)
+            jsonPath = argv[++arg];
+        else
+            ok = false;
+
+        if (!ok)
+            TLOG(FATAL) << "Usage: " << argv[0] << " [--width N] [--height N] [--fps N] [--frames N] [--noise mm at 1 m] "
+                        << "[--unpaced] [--points-only] [--json <output.json or - for stdout>], all numbers positive";
+    }
+
+    appState().reset();
+
+    // the live pipeline: sensor -> depth filter -> mesher -> sink instead of the player,
+    // every stage is stopped after the previous one finished, producers use the token of the last stage
+    CancellationToken filterCancel, mesherCancel, sinkCancel;
+    FrameQueue frameQueue(2), filteredQueue(2);
+    MeshFrameQueue sinkQueue(10);
+    FrameStamps stamps(settings.numFrames);
+
+    SyntheticSensor sensor(settings, sinkCancel);
+    sensor.addQueue(&frameQueue);
+    sensor.init();
+
+    StampingFrameProducer filteredProducer(stamps, sinkCancel);
+    filteredProducer.addQueue(&filteredQueue);
+    std::thread filterThread([&]
+    {
+        StampingDepthFilter filter(frameQueue, filteredProducer, stamps, filterCancel);
+        filter.init();
+        filter.run();
+    });
+
+    StampingMeshFrameProducer meshFrameProducer(stamps, sinkCancel);
+    meshFrameProducer.addQueue(&sinkQueue);
+    std::thread mesherThread([&]
+    {
+        StampingMesher mesher(filteredQueue, meshFrameProducer, stamps, mesherCancel);
+        if (pointsOnly)
+            mesher.enablePointsOnly();
+        mesher.init();
+        mesher.run();
+    });
+
+    NullSink sink(sinkQueue, stamps, sinkCancel);
+    std::thread sinkThread([&]
+    {
+        sink.init();
+        sink.run();
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    sensor.run();
+
+    filterCancel.trigger();
+    filterThread.join();
+    mesherCancel.trigger();
+    mesherThread.join();
+    sinkCancel.trigger();
+    sinkThread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the queue wait dominates when the sensor is not paced, processing is the time spent in the stage itself
+    const LatencySummary filterWait = summarize(stamps.intervalsMs(CREATED, FILTER_STARTED));
+    const LatencySummary filter = summarize(stamps.intervalsMs(FILTER_STARTED, FILTERED));
+    const LatencySummary mesherWait = summarize(stamps.intervalsMs(FILTERED, MESHER_STARTED));
+    const LatencySummary mesher = summarize(stamps.intervalsMs(MESHER_STARTED, MESHED));
+    const LatencySummary outputWait = summarize(stamps.intervalsMs(MESHED, RECEIVED));
+    const LatencySummary endToEnd = summarize(stamps.intervalsMs(CREATED, RECEIVED));
+    const double fps = stamps.outputFps();
+    const int numFrames = std::max(sink.numFrames, 1);
+
+    TLOG(INFO) << sink.numFrames << " of " << sensor.numFramesProduced() << " frames in " << seconds << " s, " << fps << " fps, "
+               << sink.numPoints / numFrames << " points and " << sink.numTriangles / numFrames << " triangles per frame";
+    TLOG(INFO) << "Processing ms";
+    TLOG(INFO) << "  filter: " << filter;
+    TLOG(INFO) << "  mesher: " << mesher;
+    TLOG(INFO) << "Wait in the input queue ms";
+    TLOG(INFO) << "  filter: " << filterWait;
+    TLOG(INFO) << "  mesher: " << mesherWait;
+    TLOG(INFO) << "  output: " << outputWait;
+    TLOG(INFO) << "End to end latency ms: " << endToEnd;
+
+    if (!jsonPath.empty())
+    {
+        std::ofstream file;
+        if (jsonPath != "-")
+        {
+            file.open(jsonPath);
+            if (!file)
+                TLOG(FATAL) << "Could not open " << jsonPath;
+        }
+        std::ostream &out = jsonPath == "-" ? std::cout : file;
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\n";
+        out << "  \"width\": " << settings.width << ", \"height\": " << settings.height << ", \"targetFps\": " << settings.fps
+            << ", \"realTime\": " << (settings.realTime ? "true" : "false") << ", \"pointsOnly\": " << (pointsOnly ? "true" : "false")
+            << ", \"cpuLevel\": \"" << cpuLevelName(cpuLevel()) << "\",\n";
+        out << "  \"framesProduced\": " << sensor.numFramesProduced() << ", \"framesReceived\": " << sink.numFrames
+            << ", \"seconds\": " << seconds << ", \"fps\": " << fps << ",\n";
+        out << "  \"pointsPerFrame\": " << sink.numPoints / numFrames << ", \"trianglesPerFrame\": " << sink.numTriangles / numFrames << ",\n";
+        out << "  \"processingMs\": {\n";
+        out << "    \"filter\": " << toJson(filter) << ",\n";
+        out << "    \"mesher\": " << toJson(mesher) << "\n";
+        out << "  },\n";
+        out << "  \"queueWaitMs\": {\n";
+        out << "    \"filter\": " << toJson(filterWait) << ",\n";
+        out << "    \"mesher\": " << toJson(mesherWait) << ",\n";
+        out << "    \"output\": " << toJson(outputWait) << "\n";
+        out << "  },\n";
+        out << "  \"latencyMs\": {\n";
+        out << "    \"endToEnd\": " << toJson(endToEnd) << "\n";
+        out << "  }\n";
+        out << "}\n";
+    }
+
+    return sink.numFrames == sensor.numFramesProduced() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,13 @@
+# Try to find liburing (Linux io_uring helper library).
+# Once done this will define
+#
+# LIBURING_FOUND
+# LIBURING_INCLUDE_DIR
+# LIBURING_LIBRARY
+#
+
+include(FindPackageHandleStandardArgs)
+
+find_path(LIBURING_INCLUDE_DIR NAMES liburing.h)
+find_library(LIBURING_LIBRARY NAMES uring)
+find_package_handle_standard_args(LibUring REQUIRED_VARS LIBURING_LIBRARY LIBURING_INCLUDE_DIR)
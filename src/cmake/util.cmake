@@ -39,14 +39,19 @@ macro(find_modules)
 
   find_package(GLEW REQUIRED)
 
-  find_package(OpenGL REQUIRED)
-  message(STATUS "OpenGL found: ${OPENGL_FOUND}, libraries: ${OPENGL_LIBRARIES}")
+  find_package(OpenGL REQUIRED OPTIONAL_COMPONENTS EGL)
+  message(STATUS "OpenGL found: ${OPENGL_FOUND}, libraries: ${OPENGL_LIBRARIES}, EGL: ${OpenGL_EGL_FOUND}")
 
   set(GLM_INCLUDES "${CURRENT_DIR}/../3rdparty/glm" CACHE INTERNAL "glm includes")
   message(STATUS "GLM include dir: ${GLM_INCLUDES}")
 
   find_package(RSSDK)
   message(STATUS "RSSDK found: ${RSSDK_FOUND}, libraries: ${RSSDK_LIBS}")
+
+  if(UNIX AND NOT APPLE)
+    find_package(LibUring)
+    message(STATUS "liburing found: ${LIBURING_FOUND}, library: ${LIBURING_LIBRARY}")
+  endif()
 endmacro()
 
 macro(common_settings)
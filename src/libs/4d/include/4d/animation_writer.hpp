@@ -1,5 +1,9 @@
 #pragma once
 
+#include <future>
+
+#include <util/async_file_writer.hpp>
+
 #include <4d/mesh_frame.hpp>
 
 
@@ -9,11 +13,16 @@ public:
     AnimationWriter(const std::string &outputPath, MeshFrameQueue &q, CancellationToken &cancellationToken);
     virtual ~AnimationWriter();
 
+    /// Frames that match the previous written frame (see AnimationParams::dedupe*) are not written,
+    /// instead the previous mesh stays on screen longer in the timeframe listing.
+    void enableDeduplication();
+
 protected:
     void process(std::shared_ptr<MeshFrame> &item) override;
 
 private:
     void processFrameBatch();
+    void waitForAtlas();
 
 private:
     bool finished = false;
@@ -28,8 +37,21 @@ private:
     int64_t lastFrameTimestamp = -1;
     std::string lastMeshFilename;
 
-    float totalDelta = 0;
     int numFrames = 0;
 
+    /// All frames received, also the skipped duplicates, for the duration of the last written one.
+    int64_t firstInputTimestamp = -1, lastInputTimestamp = -1;
+    int numInputFrames = 0;
+
+    bool deduplicate = false;
+    uint64_t lastStructureHash = 0;
+    std::shared_ptr<MeshFrame> lastKeptFrame;
+    cv::Mat lastKeptThumbnail;
+    int numDuplicates = 0;
+
     std::vector<std::shared_ptr<MeshFrame>> batch;
+    std::future<bool> pendingAtlas;
+
+    /// Meshes and atlases are written in the background while the next frames are processed.
+    AsyncFileWriter fileWriter;
 };
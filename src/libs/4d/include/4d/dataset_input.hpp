@@ -6,6 +6,7 @@
 
 #include <util/enum.hpp>
 #include <util/camera.hpp>
+#include <util/quantization.hpp>
 
 #include <4d/frame.hpp>
 #include <4d/format.hpp>
@@ -13,7 +14,7 @@
 
 struct DatasetMetadata
 {
-    uint32_t formatVersion;
+    uint32_t formatVersion = 0;
     CameraParams color, depth;
     ColorDataFormat colorFormat;
     DepthDataFormat depthFormat;
@@ -61,4 +62,6 @@ private:
     std::map<ColorDataFormat, FrameFieldParser> colorReaders;
 
     DatasetMetadata meta;
+
+    QuantizedCloud quantizedCloud;
 };
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <fstream>
-
 #include <util/enum.hpp>
+#include <util/quantization.hpp>
+#include <util/async_file_writer.hpp>
 
 #include <4d/frame.hpp>
 #include <4d/format.hpp>
@@ -13,22 +13,34 @@ class DatasetOutput
 {
 public:
     DatasetOutput(const std::string &path);
+    ~DatasetOutput();
 
     Status writeHeader(const SensorManager &sensorManager);
     Status writeFrame(const Frame &frame);
 
+    /// Store point clouds as 16-bit fixed-point coordinates instead of 32-bit floats.
+    void enableCloudQuantization(CloudEncoding encoding, float step = defaultQuantizationStep);
+
 private:
+    /// Header and frames are serialized into the buffer, and the whole section is written in the background.
+    void write(const char *data, size_t size)
+    {
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    void submitBuffer();
+
     template<typename T>
     void binWrite(T val)
     {
-        out.write((const char *)&val, sizeof(val));
+        write((const char *)&val, sizeof(val));
     }
 
     // specialization for cv::Mat
     template<>
     void binWrite(cv::Mat m)
     {
-        out.write((const char *)m.data, m.total() * m.elemSize());
+        write((const char *)m.data, m.total() * m.elemSize());
     }
 
     template<typename T, typename... Args>
@@ -47,9 +59,16 @@ private:
     void writeField(Field field, const char *data, size_t size)
     {
         binWrite(field);
-        out.write(data, size);
+        write(data, size);
     }
 
 private:
-    std::ofstream out;
+    AsyncFileWriter fileWriter;
+    AsyncFileWriter::FileHandle file;
+    std::vector<char> buffer;
+
+    bool quantizeClouds = false;
+    CloudEncoding cloudEncoding = CloudEncoding::RAW;
+    float quantizationStep = defaultQuantizationStep;
+    QuantizedCloud quantizedCloud;
 };
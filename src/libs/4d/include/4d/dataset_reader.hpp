@@ -12,6 +12,10 @@ public:
 
     void init();
 
+    /// Release frames at the rate of their timestamps, like a live sensor, instead of reading ahead.
+    /// Frame creation time is taken at the release, so the end-to-end latency does not include the read-ahead.
+    void enableRealTimePacing();
+
     virtual void run();
 
     /// Read dataset in a loop
@@ -20,6 +24,7 @@ public:
 private:
     bool withColor;
     bool initialized = false;
+    bool realTime = false;
     std::string path;
     std::shared_ptr<DatasetInput> dataset;
 };
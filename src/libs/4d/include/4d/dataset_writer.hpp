@@ -12,6 +12,9 @@ public:
 
     virtual void init() override;
 
+    /// See DatasetOutput::enableCloudQuantization.
+    void enableCloudQuantization(CloudEncoding encoding);
+
 protected:
     virtual void process(std::shared_ptr<Frame> &frame) override;
 
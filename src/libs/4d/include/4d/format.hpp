@@ -29,9 +29,26 @@ enum class Field : uint16_t
     DEPTH_TIMESTAMP = 0x0f21,
     CLOUD = 0x0f30,
     CLOUD_NUM_POINTS = 0x0f31,
+    CLOUD_QUANTIZED = 0x0f32,  // 16-bit fixed-point cloud, see util/quantization.hpp
+
+    // mesh cache (.4dm) data, frame number and timestamps are shared with the fields above
+    CACHE_KEY = 0x1000,
+    TRIANGLES = 0x1010,
+    NORMALS = 0x1011,
+    UV = 0x1012,
+    LODS = 0x1013,  // number of levels of detail, each follows as cloud, triangles, normals and uv
+    END_OF_SEQUENCE = 0x10ff,
+
+    // compressed mesh sequence (.4ds), see mesh_sequence.hpp
+    MESH_INTRA = 0x1100,
+    MESH_DELTA = 0x1101,
+    TEXTURE_JPEG = 0x1110,
+    SEEK_TABLE = 0x11f0,
 };
 
-constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint32_t FORMAT_VERSION = 2;  // 2: quantized clouds
+constexpr uint32_t MESH_CACHE_FORMAT_VERSION = 3;  // 2: uv with the full depth to color extrinsics, 3: levels of detail
+constexpr uint32_t MESH_SEQUENCE_FORMAT_VERSION = 1;
 
 enum class ColorDataFormat : uint8_t
 {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 
 #include <opencv2/core.hpp>
@@ -15,6 +16,12 @@ struct Frame
     cv::Mat color, depth;
     std::vector<cv::Point3f> cloud;
     int64_t cTimestamp = 0, dTimestamp = 0;
+
+    /// Last frame of the dataset (or of the current pass, when the dataset is played in a loop).
+    bool lastFrame = false;
+
+    /// When the frame entered the pipeline (grabbed or read), to measure the end-to-end latency.
+    std::chrono::steady_clock::time_point creationTime = std::chrono::steady_clock::now();
 };
 
 typedef ConcurrentQueue<std::shared_ptr<Frame>> FrameQueue;
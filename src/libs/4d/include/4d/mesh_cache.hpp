@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+
+/// Pre-meshed sequence (.4dm) is stored next to the source dataset, e.g. dataset.4dv -> dataset.4dv.4dm
+std::string meshCachePath(const std::string &datasetPath);
+
+/// Key changes whenever the source dataset, meshing parameters or the cache format change.
+/// Only the size and the head and tail of the dataset are hashed, so it is cheap to compute even for huge files.
+uint64_t meshCacheKey(const std::string &datasetPath);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <fstream>
+
+#include <4d/format.hpp>
+#include <4d/mesh_frame.hpp>
+#include <4d/dataset_input.hpp>
+
+
+/// Replays the .4dm cache written by MeshCacheWriter, bypassing DepthFilter and Mesher.
+/// Color frames are not duplicated in the cache, they are read from the source dataset in lockstep.
+class MeshCacheReader : public MeshFrameProducer
+{
+public:
+    MeshCacheReader(const std::string &datasetPath, bool readColor, const CancellationToken &cancellationToken);
+    virtual ~MeshCacheReader();
+
+    /// True if the cache exists and was created from the same dataset with the same params.
+    static bool isValid(const std::string &datasetPath);
+
+    void init();
+
+    virtual void run();
+
+    /// Read cache in a loop
+    virtual void runLoop();
+
+    /// Number of frames read by the last run().
+    int numFramesRead() const { return numFrames; }
+
+private:
+    template<typename T>
+    bool binRead(T &value)
+    {
+        return bool(in.read((char *)&value, sizeof(value)));
+    }
+
+    template<typename T>
+    bool readField(Field expected, T &value)
+    {
+        Field field;
+        return binRead(field) && field == expected && binRead(value);
+    }
+
+    template<typename T>
+    bool readArray(Field expected, std::vector<T> &v)
+    {
+        uint32_t size;
+        if (!readField(expected, size))
+            return false;
+
+        v.resize(size);
+        return bool(in.read((char *)v.data(), size * sizeof(T)));
+    }
+
+    bool readHeader();
+    bool readFrame(MeshFrame &frame);
+    bool readMesh(MeshFrame &mesh);
+    void readColor(Frame &frame);
+
+private:
+    bool withColor;
+    bool initialized = false;
+    bool finished = false;
+    int numFrames = 0;
+    std::string datasetPath;
+    std::ifstream in;
+    std::shared_ptr<DatasetInput> source;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <fstream>
+
+#include <4d/format.hpp>
+#include <4d/mesh_frame.hpp>
+
+
+/// Stores the output of the meshing pipeline in the .4dm cache, see mesh_cache.hpp.
+/// Cache is written to a temporary file and becomes visible only after the last frame of the dataset is received,
+/// so interrupted runs never leave incomplete caches behind.
+class MeshCacheWriter : public MeshFrameConsumer
+{
+public:
+    MeshCacheWriter(const std::string &datasetPath, MeshFrameQueue &q, CancellationToken &cancellationToken);
+    virtual ~MeshCacheWriter() override;
+
+    virtual void init() override;
+
+protected:
+    virtual void process(std::shared_ptr<MeshFrame> &frame) override;
+
+private:
+    template<typename T>
+    void binWrite(T val)
+    {
+        out.write((const char *)&val, sizeof(val));
+    }
+
+    template<typename T, typename... Args>
+    void binWrite(T val, Args&&... args)
+    {
+        binWrite(val), binWrite(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void writeArray(Field field, const std::vector<T> &v)
+    {
+        binWrite(field, uint32_t(v.size()));
+        out.write((const char *)v.data(), v.size() * sizeof(T));
+    }
+
+    void writeMesh(const MeshFrame &mesh);
+    void finalize();
+
+private:
+    bool finished = false;
+    int numFrames = 0;
+
+    std::string datasetPath, cachePath, tmpPath;
+    std::ofstream out;
+};
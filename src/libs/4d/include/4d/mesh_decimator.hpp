@@ -0,0 +1,47 @@
+#pragma once
+
+#include <deque>
+#include <future>
+
+#include <util/mesh_simplification.hpp>
+
+#include <4d/mesh_frame.hpp>
+
+
+/// Optional pipeline stage between the mesher and a consumer that needs lighter meshes (e.g. the exporters):
+/// every frame is simplified to the triangle budget with quadric error metrics, see simplifyMesh.
+/// Frames are simplified in parallel on the thread pool and passed on in the original order.
+/// Input frames are shared with the other consumers and are never modified. Frames within the budget are passed on
+/// as they are (or their level of detail), so the results may be shared too and must not be modified either.
+class MeshDecimator : public MeshFrameConsumer
+{
+public:
+    MeshDecimator(MeshFrameQueue &q, MeshFrameProducer &output, CancellationToken &cancellationToken, const SimplificationSettings &settings);
+
+    /// Returns when cancelled and all frames received so far are simplified and passed to the output.
+    void run() override;
+
+    /// Simplified copy of the frame without levels of detail, or the frame itself if it is within the budget already.
+    /// If the frame has levels of detail, the one within the budget is returned, or the coarsest one is simplified.
+    /// The result may be the input or one of its levels, don't modify it.
+    static std::shared_ptr<MeshFrame> decimate(const std::shared_ptr<MeshFrame> &frame, const SimplificationSettings &settings);
+
+    /// Build the chain of numLods - 1 lower levels of detail, every level is simplified from the previous one
+    /// to half of its triangles. The chain stops early if the error bound does not allow to simplify a level enough.
+    static void addLods(const std::shared_ptr<MeshFrame> &frame, int numLods, float maxError);
+
+protected:
+    void process(std::shared_ptr<MeshFrame> &frame) override;
+
+private:
+    /// Pass on the simplified frames from the front of the queue, wait until at most maxPending are left.
+    void produceReady(size_t maxPending);
+
+private:
+    MeshFrameProducer &output;
+    SimplificationSettings settings;
+
+    std::deque<std::future<std::shared_ptr<MeshFrame>>> pending;
+    int numFrames = 0;
+    size_t numInputTriangles = 0, numOutputTriangles = 0;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <util/quantization.hpp>
+
 #include <tri/triangulation.hpp>
 
 #include <4d/frame.hpp>
@@ -28,17 +30,46 @@ struct MeshFrame
 
     bool indexedMode = false;
 
+    /// Preview without triangulation: only the cloud and uv, drawn as point sprites.
+    bool pointsOnly = false;
+
     // indexed mode
     std::vector<Triangle> triangles;
     std::vector<cv::Point3f> normals;
     std::vector<cv::Point2f> uv;
 
+    // indexed mode with compact vertices: cloud, normals and uv are empty, p = compactOrigin + compactStep * position
+    std::vector<CompactVertex> compactVertices;
+    cv::Point3f compactOrigin;
+    float compactStep = 0;
+
     // array mode
     std::vector<Triangle3D> triangles3D, trianglesNormals;
     std::vector<TriangleUV> trianglesUv;
     int num3DTriangles;
+
+    /// Lower levels of detail, each with about half of the triangles of the previous one (MesherParams::numLods).
+    /// Levels share frame2D with this frame and have no levels of their own.
+    std::vector<std::shared_ptr<MeshFrame>> lods;
+
+    bool isCompact() const { return !compactVertices.empty(); }
 };
 
+/// The most detailed level of the frame with at most maxTriangles triangles, the coarsest level if none fits.
+std::shared_ptr<MeshFrame> selectLod(const std::shared_ptr<MeshFrame> &frame, size_t maxTriangles);
+
+/// Vertex cache optimization of the indexed mode frame: triangles are reordered for the post-transform cache,
+/// vertices in the order of the first use, vertices not used by any triangle are removed.
+void optimizeVertexOrder(MeshFrame &frame);
+
+/// Replace the float vertex arrays of the indexed mode frame with 12-byte compact vertices.
+/// Normals are kept only for frames without color, textured meshes are not shaded.
+void compactVertices(MeshFrame &frame);
+
+/// For the consumers that need float arrays (exporters): returns the frame itself if it is not compact, otherwise
+/// a copy with the decoded cloud, normals and uv. Frames are shared between the stages and are never decoded in place.
+std::shared_ptr<MeshFrame> withFloatVertices(const std::shared_ptr<MeshFrame> &frame);
+
 typedef ConcurrentQueue<std::shared_ptr<MeshFrame>> MeshFrameQueue;
 typedef Producer<MeshFrameQueue> MeshFrameProducer;
 typedef Consumer<MeshFrameQueue> MeshFrameConsumer;
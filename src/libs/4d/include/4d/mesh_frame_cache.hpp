@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include <4d/mesh_frame.hpp>
+
+
+/// In-memory cache of meshed frames, keyed by dataset and frame number. When a dataset is played in a loop
+/// the frames of the next passes don't have to be filtered and meshed again, the same goes for seeking back.
+/// Memory is bounded, least recently used frames are evicted first. Cached frames are shared, they must not
+/// be modified by the consumers. Thread-safe.
+class MeshFrameCache
+{
+public:
+    struct Stats
+    {
+        uint64_t numHits = 0, numMisses = 0, numEvicted = 0;
+        int numFrames = 0;
+        size_t numBytes = 0;
+
+        float hitRate() const { return numHits + numMisses ? float(numHits) / (numHits + numMisses) : 0.0f; }
+    };
+
+public:
+    explicit MeshFrameCache(size_t maxBytes = size_t(1) << 30);
+
+    /// Nullptr if the frame is not in the cache.
+    std::shared_ptr<MeshFrame> get(const std::string &dataset, int frameNumber);
+
+    /// Frames larger than the whole cache are not stored.
+    void put(const std::string &dataset, int frameNumber, const std::shared_ptr<MeshFrame> &frame);
+
+    Stats getStats() const;
+
+    /// Approximate memory footprint of the frame including the images.
+    static size_t frameBytes(const MeshFrame &frame);
+
+private:
+    MeshFrameCache(const MeshFrameCache &) = delete;
+    void operator=(const MeshFrameCache &) = delete;
+
+private:
+    typedef std::pair<std::string, int> Key;
+
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<MeshFrame> frame;
+        size_t bytes;
+    };
+
+    size_t maxBytes;
+
+    /// Most recently used frames first.
+    std::list<Entry> lru;
+    std::map<Key, std::list<Entry>::iterator> index;
+
+    Stats stats;
+    mutable std::mutex mutex;
+};
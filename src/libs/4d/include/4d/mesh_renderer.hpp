@@ -0,0 +1,30 @@
+#pragma once
+
+#include <4d/mesh_frame.hpp>
+
+
+/// OpenGL drawing of mesh frames, shared by the interactive player and the offscreen renderer.
+/// All methods require a current OpenGL 3.3 core context; the renderer must be destroyed while the context is alive.
+class MeshRenderer
+{
+    /// Private implementation to hide some OpenGL headers.
+    struct MeshRendererImpl;
+
+public:
+    /// Compiles shaders and creates buffers in the current context.
+    MeshRenderer();
+    ~MeshRenderer();
+
+    /// Upload the mesh and the texture of the frame, drawn until the next frame is set.
+    void setFrame(const MeshFrame &frame);
+
+    /// Draw the last frame, mvp is the column-major 4x4 transform matrix.
+    void draw(const float *mvp);
+
+private:
+    MeshRenderer(const MeshRenderer &) = delete;
+    void operator=(const MeshRenderer &) = delete;
+
+private:
+    std::unique_ptr<MeshRendererImpl> data;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+#include <util/geometry.hpp>
+#include <util/quantization.hpp>
+
+
+/// Compressed mesh sequence (.4ds), the whole animation in one file:
+///
+///   MAGIC METADATA_SECTION VERSION <u32>
+///   { FRAME_SECTION FRAME_NUMBER <i32> DEPTH_TIMESTAMP <i64> (MESH_INTRA | MESH_DELTA) <u32 size> <payload> [TEXTURE_JPEG <u32 size> <jpeg>] }
+///   SEEK_TABLE <u32 n> { <i32 frame number> <u64 offset of FRAME_SECTION> } <u64 offset of SEEK_TABLE>
+///
+/// Intra frames are self-contained and listed in the seek table. Positions are quantized to 16 bits within
+/// the frame bounding box (extended by a margin for the following delta frames), uv to 16 bits over [0, 1], every value is stored as a zigzag varint delta to the same
+/// component of the previous vertex (vertices are sorted by the triangulation, so neighbours are close),
+/// indices as deltas to the previous index.
+/// Delta frames are used when the topology did not change since the previous frame: only differences of the
+/// quantized positions and uv are stored, in the quantization grid of the previous frame.
+enum class MeshFrameType : uint8_t
+{
+    INTRA,
+    DELTA,
+};
+
+class MeshSequenceEncoder
+{
+public:
+    /// Intra frame is forced at least every keyframeInterval frames, so that seeking stays cheap.
+    explicit MeshSequenceEncoder(int keyframeInterval = 30, float step = defaultQuantizationStep);
+
+    MeshFrameType encode(const std::vector<cv::Point3f> &cloud, const std::vector<Triangle> &triangles, const std::vector<cv::Point2f> &uv,
+                         std::vector<uint8_t> &out);
+
+private:
+    bool canEncodeDelta(const std::vector<cv::Point3f> &cloud, const std::vector<Triangle> &triangles, bool hasUv);
+
+private:
+    int keyframeInterval;
+    float step;
+    int framesSinceIntra = 0;
+
+    // state of the previous frame
+    cv::Point3f origin;
+    float prevStep = 0;
+    bool prevHasUv = false;
+    std::vector<Triangle> prevTriangles;
+    std::vector<uint16_t> prevPositions, prevUv;
+    std::vector<uint16_t> positions, uvs;  // current frame
+};
+
+class MeshSequenceDecoder
+{
+public:
+    /// Returns false if the payload is malformed or a delta frame does not match the previous frame.
+    bool decode(MeshFrameType type, const uint8_t *data, size_t size,
+                std::vector<cv::Point3f> &cloud, std::vector<Triangle> &triangles, std::vector<cv::Point2f> &uv);
+
+    /// Forget the previous frame, e.g. after seeking.
+    void reset();
+
+private:
+    bool hasPrevious = false;
+    cv::Point3f origin;
+    float step = 0;
+    bool hasUv = false;
+    std::vector<Triangle> prevTriangles;
+    std::vector<uint16_t> positions, uvs;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <fstream>
+
+#include <util/enum.hpp>
+
+#include <4d/format.hpp>
+#include <4d/mesh_frame.hpp>
+#include <4d/mesh_sequence.hpp>
+
+
+/// Reader of the .4ds container written by MeshSequenceWriter.
+class MeshSequenceInput
+{
+public:
+    MeshSequenceInput(const std::string &path, bool readColor);
+
+    /// Read header and the seek table.
+    Status open();
+
+    /// Frame numbers of the intra frames and their offsets in the file.
+    const std::vector<std::pair<int32_t, uint64_t>> & getSeekTable() const { return seekTable; }
+
+    /// Next readFrame returns the first frame with number >= frameNumber. Decodes from the nearest intra frame.
+    Status seek(int frameNumber);
+
+    Status readFrame(MeshFrame &frame);
+
+    bool finished() const;
+
+private:
+    template<typename T>
+    bool binRead(T &value)
+    {
+        return bool(in.read((char *)&value, sizeof(value)));
+    }
+
+    template<typename T, typename... Args>
+    bool binRead(T &value, Args&&... args)
+    {
+        return binRead(value) && binRead(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    bool readField(Field expected, T &value)
+    {
+        Field field;
+        return binRead(field) && field == expected && binRead(value);
+    }
+
+    bool readBlock(std::vector<uint8_t> &block);
+    Status decodeNextFrame(MeshFrame &frame);
+
+private:
+    bool withColor;
+    bool isFinished = false;
+    std::ifstream in;
+    uint64_t seekTableOffset = 0;
+    std::vector<std::pair<int32_t, uint64_t>> seekTable;
+
+    MeshSequenceDecoder decoder;
+    std::vector<uint8_t> payload, jpeg;
+
+    /// Frame decoded during seek, returned by the next readFrame.
+    std::shared_ptr<MeshFrame> pendingFrame;
+};
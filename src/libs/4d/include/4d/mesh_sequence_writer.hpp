@@ -0,0 +1,63 @@
+#pragma once
+
+#include <fstream>
+
+#include <4d/format.hpp>
+#include <4d/mesh_frame.hpp>
+#include <4d/mesh_sequence.hpp>
+
+
+/// Alternative to AnimationWriter: the whole animation goes into one compressed .4ds container (see mesh_sequence.hpp),
+/// with a JPEG texture per frame.
+class MeshSequenceWriter : public MeshFrameConsumer
+{
+public:
+    MeshSequenceWriter(const std::string &path, MeshFrameQueue &q, CancellationToken &cancellationToken);
+    virtual ~MeshSequenceWriter() override;
+
+    /// Also serialize every mesh to PLY in memory, to report the size and time of the PLY export for comparison.
+    void enablePlyComparison();
+
+protected:
+    virtual void process(std::shared_ptr<MeshFrame> &frame) override;
+
+private:
+    template<typename T>
+    void binWrite(T val)
+    {
+        out.write((const char *)&val, sizeof(val));
+    }
+
+    template<typename T, typename... Args>
+    void binWrite(T val, Args&&... args)
+    {
+        binWrite(val), binWrite(std::forward<Args>(args)...);
+    }
+
+    void writeBlock(Field field, const uint8_t *data, size_t size)
+    {
+        binWrite(field, uint32_t(size));
+        out.write((const char *)data, size);
+    }
+
+    void finalize();
+
+private:
+    bool finished = false;
+    int lastWrittenFrame = -1;
+
+    std::string path;
+    std::ofstream out;
+
+    MeshSequenceEncoder encoder;
+    std::vector<uint8_t> payload, jpeg;
+    std::vector<std::pair<int32_t, uint64_t>> seekTable;
+
+    bool comparePly = false;
+    std::vector<char> plyBuffer;
+
+    // statistics
+    int numFrames = 0, numIntraFrames = 0;
+    uint64_t meshBytes = 0, textureBytes = 0, plyBytes = 0;
+    double meshEncodeSeconds = 0, textureEncodeSeconds = 0, plySeconds = 0;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <util/point_cloud.hpp>
+
 #include <tri/triangulation.hpp>
 
 #include <4d/mesh_frame.hpp>
@@ -15,15 +17,20 @@ public:
 
     void init() override;
 
+    /// Preview mode for the minimum latency: triangulation is skipped, frames contain only the cloud and uv.
+    void enablePointsOnly();
+
 protected:
     void process(std::shared_ptr<Frame> &frame) override;
 
 private:
-    void fillPoints(const cv::Mat &depth, std::vector<PointIJ> &points, std::vector<cv::Point3f> &cloud) const;
-    void fillPoints(const std::vector<cv::Point3f> &frameCloud, std::vector<PointIJ> &points, std::vector<cv::Point3f> &cloud) const;
+    void fillPoints(const cv::Mat &depth);
+    void fillPoints(const std::vector<cv::Point3f> &frameCloud);
+
+    void fillUv(std::vector<cv::Point2f> &uv) const;
 
-    void fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &points);
-    void fillDataIndexedMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &points);
+    void fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &pixels);
+    void fillDataIndexedMode(MeshFrame &frame, Triangle *triangles, int numTriangles);
 
 private:
     constexpr static bool skipFiltering = false;
@@ -34,5 +41,17 @@ private:
 
     CameraParams colorCam, depthCam;
     Calibration calibration;
+    UvProjection colorProjection;
     float scale;
+
+    /// Per-frame buffers, reused to avoid allocations. Points are kept as structure of arrays for the kernels
+    /// and converted to the frame cloud once they are in the triangulation order.
+    PointCloudSoA points;
+    std::vector<float> cols;
+    std::vector<int> iImg, jImg;
+    std::vector<uint8_t> valid, keep;
+    std::vector<short> indexMap;
+
+    int numProcessedFrames = 0;
+    bool pointsOnly = false;
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <4d/mesh_frame.hpp>
+
+
+/// Renders mesh frames without a window, into a framebuffer of the surfaceless EGL context, so it runs on servers
+/// without display (also with Mesa software rendering). Every frame is saved as frame_%08d.png
+/// (see misc/ffmpeg_cmd.txt) or appended to a single raw BGRA file.
+/// Pixels are read back asynchronously through pixel buffers and encoded on the thread pool, frames are rendered
+/// as fast as they arrive, the timestamps are ignored.
+class OffscreenRenderer : public MeshFrameConsumer
+{
+    /// Private implementation to hide some OpenGL headers.
+    struct OffscreenRendererImpl;
+
+public:
+    struct Settings
+    {
+        /// Image width, height follows the aspect ratio of the depth camera.
+        int width = 1280;
+
+        /// Write all frames to frames.bgra instead of separate PNG files, encoding is free then.
+        bool rawOutput = false;
+
+        /// Camera path: starts at the depth camera position and rotates around the vertical axis through
+        /// the model center by this angle every frame, 0 is the static view of the player.
+        float yawDegreesPerFrame = 0;
+
+        /// Camera tilt and distance to the model center (as a multiple of the sensor distance).
+        float pitchDegrees = 0;
+        float distanceScale = 1;
+    };
+
+public:
+    OffscreenRenderer(const std::string &outputPath, const Settings &settings, MeshFrameQueue &q, CancellationToken &cancellationToken);
+    virtual ~OffscreenRenderer();
+
+    virtual void init();
+    virtual void run();
+
+    int numRenderedFrames() const;
+
+protected:
+    void process(std::shared_ptr<MeshFrame> &item) override;
+
+private:
+    std::unique_ptr<OffscreenRendererImpl> data;
+};
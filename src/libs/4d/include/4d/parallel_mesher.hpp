@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include <4d/mesh_frame.hpp>
+#include <4d/mesh_frame_cache.hpp>
+
+
+/// Filtering and meshing of consecutive frames on multiple workers, every worker is a DepthFilter + Mesher pair.
+/// Frames are distributed round-robin and collected in the same order, so the output is identical to
+/// the single-threaded pipeline, just faster. Intended for offline processing where latency does not matter.
+class ParallelMesher : public FrameConsumer
+{
+private:
+    struct Worker;
+
+public:
+    /// By default use half of the hardware threads, every worker keeps two threads busy.
+    ParallelMesher(FrameQueue &inputQueue, MeshFrameProducer &output, CancellationToken &cancellationToken, int numWorkers = 0);
+    virtual ~ParallelMesher();
+
+    void init() override;
+
+    /// Returns when cancelled and all frames received so far are processed and passed to the output.
+    void run() override;
+
+    int numProcessedFrames() const { return int(numCollected); }
+
+    /// Frames found in the cache skip filtering and meshing, the others are added after meshing. Call before init().
+    void setCache(MeshFrameCache &frameCache, const std::string &dataset);
+
+protected:
+    void process(std::shared_ptr<Frame> &frame) override;
+
+private:
+    void collect();
+
+private:
+    MeshFrameProducer &output;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::thread collector;
+    CancellationToken collectorCancel;
+
+    MeshFrameCache *cache = nullptr;
+    std::string cacheDataset;
+
+    /// Output order: cached frames, or nullptr for the next frame meshed by the workers (round-robin).
+    std::deque<std::shared_ptr<MeshFrame>> dispatchOrder;
+    std::mutex dispatchMutex;
+
+    std::atomic<int> numDispatched, numCollected;
+    int numMeshDispatched = 0;
+};
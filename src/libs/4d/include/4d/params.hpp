@@ -17,6 +17,18 @@ public:
 
         /// Max difference between minimum and maximum Z-coordinate of any 3D triangle. In meters.
         float zThreshold;
+
+        /// Reorder triangles for the post-transform vertex cache and vertices in the order of use (indexed mode).
+        bool optimizeVertexOrder;
+
+        /// Number of levels of detail in the output frames including the full one, 1 to disable.
+        /// Lower levels are simplified from the previous ones, see MeshDecimator::addLods.
+        int numLods;
+        float lodMaxError;
+
+        /// Output indexed mode frames with 12-byte quantized vertices instead of float cloud, normals and uv
+        /// (32 bytes per vertex), less memory in the queues and caches and less bandwidth for GPU uploads.
+        bool compactVertices;
     };
 
     struct FilterParams
@@ -44,6 +56,41 @@ public:
 
         /// Animation frames are written in batches, one texture atlas is created per frame batch.
         int batchSize;
+
+        /// Deduplication of unchanged frames: no vertex moved further than this distance (meters)...
+        float dedupeMaxDistance;
+
+        /// ...and no pixel of the downscaled texture changed more than this in any channel.
+        int dedupeMaxColorDifference;
+    };
+
+    struct PlayerParams
+    {
+        /// Stream color frames through pixel buffers into the texture storage allocated once,
+        /// otherwise the texture is respecified with glTexImage2D every frame.
+        bool streamTextures;
+
+        /// Update only the part of the texture referenced by the mesh uv (streaming only).
+        bool uploadUvBoundedRect;
+
+        /// Regenerate mipmaps every N-th frame, 0 to disable mipmaps (streaming only).
+        int mipmapInterval;
+
+        /// Draw the most detailed level of detail within this number of triangles, 0 to always draw the full mesh.
+        int maxTriangles;
+
+        /// Size of the point sprites in the preview mode, pixels.
+        int pointSize;
+    };
+
+    struct DecimationParams
+    {
+        /// Triangle budget per frame for the player and for the exporters, 0 disables the decimation of that output.
+        int playerTriangleBudget;
+        int writerTriangleBudget;
+
+        /// Max geometric error of the decimation in meters, frames stay above the budget rather than exceed it.
+        float maxError;
     };
 
 public:
@@ -52,6 +99,11 @@ public:
     const MesherParams & getMesherParams() const { return mesherP; }
     const FilterParams & getFilterParams() const { return filterP; }
     const AnimationParams & getAnimationParams() const { return animP; }
+    const PlayerParams & getPlayerParams() const { return playerP; }
+    const DecimationParams & getDecimationParams() const { return decimationP; }
+
+    /// Hash of all parameters that affect the results of filtering and meshing, used to invalidate caches.
+    uint64_t meshingParamsHash() const;
 
 private:
     Params();
@@ -64,9 +116,13 @@ private:
     MesherParams mesherP;
     FilterParams filterP;
     AnimationParams animP;
+    PlayerParams playerP;
+    DecimationParams decimationP;
 };
 
 inline const Params & algoParams() { return Params::instance(); }
 inline const Params::MesherParams & mesherParams() { return algoParams().getMesherParams(); }
 inline const Params::FilterParams & filterParams() { return algoParams().getFilterParams(); }
 inline const Params::AnimationParams & animationParams() { return algoParams().getAnimationParams(); }
+inline const Params::PlayerParams & playerParams() { return algoParams().getPlayerParams(); }
+inline const Params::DecimationParams & decimationParams() { return algoParams().getDecimationParams(); }
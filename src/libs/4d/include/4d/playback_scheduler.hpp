@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <chrono>
+
+#include <4d/mesh_frame.hpp>
+
+
+/// Presentation timing of the player. Frames wait in a small jitter buffer, the playback clock starts when the buffer
+/// is filled and then runs on the monotonic clock, independent of when the frames arrive: a frame is presented when
+/// the clock reaches its timestamp. If several frames are due at once (render loop or pipeline stalled), only
+/// the newest one is presented and the rest are dropped, so the playback never drifts behind the timestamps.
+/// When the dataset starts over (frame numbers go back) the clock is restarted.
+class PlaybackScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stats
+    {
+        int numPresented = 0, numDropped = 0;
+
+        /// Wall time between presented frames.
+        float meanIntervalMs = 0, maxIntervalMs = 0;
+
+        /// Average number of frames waiting in the jitter buffer at presentation.
+        float meanBufferedFrames = 0;
+    };
+
+    static constexpr double minSpeed = 0.25, maxSpeed = 8;
+
+public:
+    explicit PlaybackScheduler(int jitterBufferSize = 4);
+
+    /// Frames should be pushed only when there is room, otherwise the pipeline is blocked by the queue as usual.
+    bool canPush() const;
+    bool empty() const;
+    void push(const std::shared_ptr<MeshFrame> &frame, Clock::time_point now);
+
+    /// Frame that should be on the screen at the moment, nullptr if the previous one stays.
+    std::shared_ptr<MeshFrame> frameToPresent(Clock::time_point now);
+
+    /// Speed is clamped to [minSpeed, maxSpeed], the current position in the timeline is preserved.
+    void setSpeed(double newSpeed, Clock::time_point now);
+    double getSpeed() const;
+
+    /// Statistics since the last reset.
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<MeshFrame> frame;
+
+        /// First frame of the next pass through the dataset.
+        bool restart;
+    };
+
+private:
+    int64_t playbackTimeUs(Clock::time_point now) const;
+    void startClock(int64_t timestampUs, Clock::time_point now);
+
+private:
+    int jitterBufferSize;
+    std::deque<Entry> buffer;
+
+    /// Playback clock: timeline position anchorTimestampUs at anchorTime, advancing with the speed.
+    bool clockStarted = false;
+    Clock::time_point anchorTime;
+    int64_t anchorTimestampUs = 0;
+    double speed = 1;
+
+    /// Don't wait forever for the jitter buffer to fill, e.g. very short datasets.
+    static constexpr int maxPrebufferMs = 500;
+    Clock::time_point firstPushTime;
+
+    int lastPushedFrameNumber = -1;
+    bool presentedAny = false;
+    Clock::time_point lastPresentTime;
+
+    Stats stats;
+    double sumIntervalsMs = 0, sumBufferedFrames = 0;
+};
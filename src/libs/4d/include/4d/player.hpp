@@ -19,6 +19,9 @@ public:
     virtual void init();
     virtual void run();
 
+    /// Frames buffered before presentation to absorb the pipeline jitter (default 4), 1 for the minimum latency.
+    void setJitterBufferSize(int numFrames);
+
 private:
     std::unique_ptr<PlayerImpl> data;
 };
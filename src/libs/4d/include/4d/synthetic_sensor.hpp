@@ -0,0 +1,65 @@
+#pragma once
+
+#include <random>
+
+#include <util/camera.hpp>
+
+#include <4d/frame.hpp>
+
+
+struct SyntheticSensorSettings
+{
+    int width = 640, height = 480;
+    float fps = 30;
+    int numFrames = 300;
+
+    /// Depth noise standard deviation at 1 meter, grows with the square of the depth like on the real sensors.
+    float noiseMm = 1.5f;
+
+    /// Fraction of pixels without depth.
+    float holeFraction = 0.01f;
+
+    bool withColor = true;
+
+    /// Release frames at the frame rate like a live sensor, otherwise as fast as the pipeline takes them.
+    bool realTime = true;
+
+    uint32_t seed = 1;
+};
+
+/// Depth and color source without hardware for load tests of the live pipeline. Renders a scene with known geometry:
+/// a slightly tilted wall at about 2.2 m, a sphere moving along a circle in front of it and a box sliding sideways.
+/// The color and depth cameras are the same (identity calibration), color is a checkerboard on the wall
+/// and shaded solid colors on the moving objects.
+class SyntheticSensor : public FrameProducer
+{
+public:
+    SyntheticSensor(const SyntheticSensorSettings &settings, const CancellationToken &cancellationToken);
+
+    /// Publishes the camera parameters to the sensor manager.
+    void init();
+
+    /// Produces settings.numFrames frames, or until cancelled.
+    void run();
+
+    const CameraParams & camera() const { return cam; }
+
+    /// Exact depth of the frame in millimeters, without noise and holes.
+    cv::Mat groundTruthDepth(int frameNumber) const;
+
+    /// Frame with noisy depth and color as it is passed to the pipeline, except for the creation time.
+    std::shared_ptr<Frame> renderFrame(int frameNumber);
+
+    int numFramesProduced() const { return numProduced; }
+
+private:
+    /// Depth in meters along the pixel ray and the object hit: 0 wall, 1 sphere, 2 box, -1 nothing.
+    float castRay(int frameNumber, int i, int j, int &object) const;
+
+private:
+    SyntheticSensorSettings settings;
+    CameraParams cam;
+
+    std::mt19937 rng;
+    int numProduced = 0;
+};
@@ -3,8 +3,12 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 
+#include <util/hash.hpp>
 #include <util/io_3d.hpp>
+#include <util/geometry.hpp>
 #include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
+#include <util/rect_packing.hpp>
 #include <util/filesystem_utils.hpp>
 
 #include <4d/params.hpp>
@@ -21,6 +25,66 @@ std::string frameFilename(int frameNumber, const std::string &ext)
     return filenamePrefix.str() + ext;
 }
 
+/// Hash of the frame structure: vertex and triangle counts and the triangles themselves. Frames with different
+/// structure are never duplicates, so most of the changed frames are rejected without comparing the vertices.
+uint64_t frameStructureHash(const MeshFrame &frame)
+{
+    Hasher h;
+    h.add(uint32_t(frame.cloud.size())).add(uint32_t(frame.uv.size())).add(uint32_t(frame.triangles.size()));
+
+    // Triangle is three uint16_t, no padding
+    h.add(frame.triangles.data(), frame.triangles.size() * sizeof(Triangle));
+    return h.value();
+}
+
+/// Small thumbnail of the color frame is enough to detect changes of lighting or texture.
+cv::Mat colorThumbnail(const MeshFrame &frame)
+{
+    cv::Mat thumbnail;
+    const cv::Mat &color = frame.frame2D->color;
+    if (!color.empty())
+        cv::resize(color, thumbnail, cv::Size(32, 24), 0, 0, cv::INTER_AREA);
+    return thumbnail;
+}
+
+/// Frames with the same structure: no vertex moved further than maxDistance and the uv stayed within a fraction
+/// of a texel.
+bool sameGeometry(const MeshFrame &a, const MeshFrame &b, float maxDistance)
+{
+    constexpr float maxUvDifference = 1.0f / 1024;
+
+    const float maxDistance2 = maxDistance * maxDistance;
+    for (size_t i = 0; i < a.cloud.size(); ++i)
+    {
+        const cv::Point3f d = a.cloud[i] - b.cloud[i];
+        if (d.dot(d) > maxDistance2)
+            return false;
+    }
+
+    for (size_t i = 0; i < a.uv.size(); ++i)
+        if (std::abs(a.uv[i].x - b.uv[i].x) > maxUvDifference || std::abs(a.uv[i].y - b.uv[i].y) > maxUvDifference)
+            return false;
+
+    return true;
+}
+
+/// No channel of any thumbnail pixel differs by more than maxDifference.
+bool sameColor(const cv::Mat &a, const cv::Mat &b, int maxDifference)
+{
+    if (a.empty() || b.empty())
+        return a.empty() == b.empty();
+
+    for (int i = 0; i < a.rows; ++i)
+    {
+        const uchar *rowA = a.ptr(i), *rowB = b.ptr(i);
+        for (int j = 0; j < a.cols * a.channels(); ++j)
+            if (std::abs(int(rowA[j]) - int(rowB[j])) > maxDifference)
+                return false;
+    }
+
+    return true;
+}
+
 }
 
 
@@ -33,14 +97,27 @@ AnimationWriter::AnimationWriter(const std::string &outputPath, MeshFrameQueue &
 
 AnimationWriter::~AnimationWriter()
 {
-    TLOG(INFO);
+    TLOG(INFO) << "Skipped " << numDuplicates << " duplicate frames";
 
     processFrameBatch();
+    waitForAtlas();
+    TLOG_IF(ERROR, !fileWriter.flush()) << "Could not write some of the animation files";
 
-    timeframe << totalDelta / numFrames << " " << lastMeshFilename << '\n';
+    // the last mesh stays on screen for one frame interval, plus the duplicates skipped after it
+    if (numFrames > 0)
+    {
+        const float frameInterval = numInputFrames > 1 ? float(lastInputTimestamp - firstInputTimestamp) / 1000000 / (numInputFrames - 1) : 0;
+        const float skippedSeconds = float(lastInputTimestamp - lastFrameTimestamp) / 1000000;
+        timeframe << frameInterval + skippedSeconds << " " << lastMeshFilename << '\n';
+    }
     timeframe.close();
 }
 
+void AnimationWriter::enableDeduplication()
+{
+    deduplicate = true;
+}
+
 void AnimationWriter::process(std::shared_ptr<MeshFrame> &frame)
 {
     if (finished)
@@ -53,9 +130,38 @@ void AnimationWriter::process(std::shared_ptr<MeshFrame> &frame)
         return;
     }
 
+    // the rest of the writer works with the float arrays, frames in the batch hold the decoded copies
+    frame = withFloatVertices(frame);
+
     if (!meanPointCalculated)
         modelCenter = meanPoint(frame->cloud), meanPointCalculated = true;
 
+    if (firstInputTimestamp < 0)
+        firstInputTimestamp = frame->frame2D->dTimestamp;
+    lastInputTimestamp = frame->frame2D->dTimestamp;
+    ++numInputFrames;
+
+    if (deduplicate)
+    {
+        // compare with the last frame that was actually written, so that slow changes still accumulate;
+        // the hash only rejects the frames that can't be duplicates, the candidates are compared vertex by vertex
+        const auto &p = animationParams();
+        const uint64_t structureHash = frameStructureHash(*frame);
+        cv::Mat thumbnail = colorThumbnail(*frame);
+        if (lastKeptFrame && structureHash == lastStructureHash
+            && sameGeometry(*frame, *lastKeptFrame, p.dedupeMaxDistance)
+            && sameColor(thumbnail, lastKeptThumbnail, p.dedupeMaxColorDifference))
+        {
+            // skipped frame extends the duration of the previous one: timeframe deltas are computed between written frames
+            TLOG(INFO) << "frame #" << frame->frame2D->frameNumber << " is a duplicate, skip";
+            ++numDuplicates;
+            return;
+        }
+        lastStructureHash = structureHash;
+        lastKeptFrame = frame;
+        lastKeptThumbnail = thumbnail;
+    }
+
     TLOG(INFO) << "timeframe animation, frame #" << frame->frame2D->frameNumber;
 
     batch.emplace_back(frame);
@@ -74,17 +180,42 @@ void AnimationWriter::processFrameBatch()
 
     const bool withColor = !firstFrame->color.empty();
 
+    // only the part of the frame covered by the mesh goes into the atlas, crops are packed into shelves
     const float textureScale = animationParams().textureScale;
     const cv::Mat &firstColor = firstFrame->color;
-    const int texRows = int(firstColor.rows * textureScale), texCols = int(firstColor.cols * textureScale);
-    cv::Mat atlas = cv::Mat::zeros(int(texRows * batch.size()), texCols, firstColor.type());
+    std::vector<cv::Rect> crops(batch.size());
+    std::vector<cv::Size> cropSizes(batch.size());
+    std::vector<cv::Point> cropPositions;
+    int atlasRows = 0, atlasCols = 0;
+    if (withColor)
+    {
+        double totalArea = 0;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            crops[i] = uvBoundingRect(batch[i]->uv, batch[i]->frame2D->color.size());
+            cropSizes[i] = cv::Size(std::max(int(crops[i].width * textureScale), 1), std::max(int(crops[i].height * textureScale), 1));
+            atlasCols = std::max(atlasCols, cropSizes[i].width);
+            totalArea += cropSizes[i].area();
+        }
+
+        // roughly square atlas: little waste with shelf packing and stays within the texture size limits of the viewers
+        atlasCols = std::max(atlasCols, int(std::ceil(std::sqrt(totalArea))));
+        atlasRows = packShelves(cropSizes, atlasCols, cropPositions);
+        TLOG(INFO) << "Texture atlas " << atlasCols << "x" << atlasRows << ", " << int(100 * totalArea / (atlasCols * atlasRows)) << "% used, full frames would take "
+                   << int(firstColor.cols * textureScale) << "x" << int(firstColor.rows * textureScale) * batch.size();
+    }
+
+    cv::Mat atlas = cv::Mat::zeros(atlasRows, atlasCols, firstColor.type());
     const auto atlasName = frameFilename(firstFrame->frameNumber, ".jpg");
 
-    const float uvStep = 1.0f / batch.size();
-    for (size_t batchI = 0; batchI < batch.size(); ++batchI)
+    // previous atlas must be on disk before we start the next one, this also limits the memory usage
+    waitForAtlas();
+
+    // frames are independent: transform points, write meshes and resize textures in parallel,
+    // every frame copies its texture crop into its own region of the atlas
+    threadPool().parallelFor(0, int(batch.size()), [&](int batchI)
     {
         auto &frame = batch[batchI];
-
         const auto meshFilename = frameFilename(frame->frame2D->frameNumber, ".ply");
 
         std::vector<cv::Point3f> points(frame->cloud);
@@ -96,27 +227,42 @@ void AnimationWriter::processFrameBatch()
 
         if (withColor)
         {
+            const cv::Mat &color = frame->frame2D->color;
+            const cv::Rect &crop = crops[batchI];
+            const cv::Rect region(cropPositions[batchI], cropSizes[batchI]);
+
+            // image uv -> pixels of the crop -> pixels of the atlas region -> atlas uv
+            const float scaleU = float(color.cols) * region.width / crop.width, scaleV = float(color.rows) * region.height / crop.height;
+            const float offsetU = region.x - crop.x * float(region.width) / crop.width, offsetV = region.y - crop.y * float(region.height) / crop.height;
             std::vector<cv::Point2f> uv(frame->uv.size());
             for (size_t i = 0; i < uv.size(); ++i)
             {
-                uv[i].x = frame->uv[i].x, uv[i].y = 1.0f - frame->uv[i].y;  // convert to .ply convention
-                uv[i].y = (batch.size() - batchI - 1) * uvStep + uv[i].y / batch.size();  // convert to atlas uv-coordinates
+                uv[i].x = (frame->uv[i].x * scaleU + offsetU) / atlas.cols;
+                uv[i].y = 1.0f - (frame->uv[i].y * scaleV + offsetV) / atlas.rows;  // convert to .ply convention
             }
-            saveBinaryPly(pathJoin(outputPath, meshFilename), &points, &frame->triangles, &uv, &atlasName);
+            std::vector<char> ply;
+            serializeBinaryPly(ply, &points, &frame->triangles, &uv, &atlasName);
+            fileWriter.writeFile(pathJoin(outputPath, meshFilename), std::move(ply));
 
-            cv::Mat resizedTexture;
-            cv::resize(frame->frame2D->color, resizedTexture, cv::Size(), textureScale, textureScale, CV_INTER_CUBIC);
-            assert(resizedTexture.rows == texRows && resizedTexture.cols == texCols);
-            resizedTexture.copyTo(atlas.rowRange(int(batchI * texRows), int((batchI + 1) * texRows)));
+            cv::Mat atlasRegion = atlas(region);
+            cv::resize(color(crop), atlasRegion, region.size(), 0, 0, CV_INTER_CUBIC);
         }
         else
-            saveBinaryPly(pathJoin(outputPath, meshFilename), &points, &frame->triangles);
+        {
+            std::vector<char> ply;
+            serializeBinaryPly(ply, &points, &frame->triangles);
+            fileWriter.writeFile(pathJoin(outputPath, meshFilename), std::move(ply));
+        }
+    });
 
+    // timeframe entries depend only on the frame order, write them here to keep the file deterministic
+    for (const auto &frame : batch)
+    {
+        const auto meshFilename = frameFilename(frame->frame2D->frameNumber, ".ply");
         if (lastWrittenFrame != -1)
         {
             const auto timeDeltaSeconds = float(frame->frame2D->dTimestamp - lastFrameTimestamp) / 1000000;
             timeframe << std::setprecision(3) << timeDeltaSeconds << " " << lastMeshFilename << '\n';
-            totalDelta += timeDeltaSeconds;
         }
 
         lastFrameTimestamp = frame->frame2D->dTimestamp;
@@ -127,6 +273,27 @@ void AnimationWriter::processFrameBatch()
 
     batch.clear();
 
+    // JPEG encoding of the large atlas is the slowest part, overlap it with accumulating the next batch
     if (withColor)
-        cv::imwrite(pathJoin(outputPath, atlasName), atlas);
+    {
+        const std::string atlasPath = pathJoin(outputPath, atlasName);
+        pendingAtlas = threadPool().submit([this, atlas, atlasPath]
+        {
+            std::vector<uchar> jpeg;
+            if (!cv::imencode(".jpg", atlas, jpeg))
+                return false;
+
+            fileWriter.writeFile(atlasPath, std::vector<char>(jpeg.begin(), jpeg.end()));
+            return true;
+        });
+    }
+}
+
+void AnimationWriter::waitForAtlas()
+{
+    if (!pendingAtlas.valid())
+        return;
+
+    const bool ok = pendingAtlas.get();
+    TLOG_IF(ERROR, !ok) << "Could not encode texture atlas";
 }
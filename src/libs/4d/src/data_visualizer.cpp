@@ -98,11 +98,14 @@ void DataVisualizer::process(std::shared_ptr<Frame> &frame)
     else
     {
         cv::Mat projection = cv::Mat::zeros(depthCamera.h, depthCamera.w, CV_16UC1);
-        int iImg, jImg;
-        uint16_t d;
-        for (const auto &p : frame->cloud)
-            if (project3dPointTo2d(p, depthCamera, iImg, jImg, d))
-                projection.at<uint16_t>(iImg, jImg) = d;
+        const size_t numPoints = frame->cloud.size();
+        std::vector<int> iImg(numPoints), jImg(numPoints);
+        std::vector<uint16_t> d(numPoints);
+        std::vector<uint8_t> valid(numPoints);
+        project3dPointsTo2d(frame->cloud.data(), numPoints, depthCamera, iImg.data(), jImg.data(), d.data(), valid.data());
+        for (size_t k = 0; k < numPoints; ++k)
+            if (valid[k])
+                projection.at<uint16_t>(iImg[k], jImg[k]) = d[k];
 
         resizeImg(projection, depth, w, h);
     }
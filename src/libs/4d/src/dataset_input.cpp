@@ -76,6 +76,21 @@ DatasetInput::DatasetInput(const std::string &path, bool readColor)
         return ok;
     };
     fp[Field::CLOUD] = [&](Frame &f) { return bool(in.read((char *)f.cloud.data(), f.cloud.size() * sizeof(cv::Point3f))); };
+    fp[Field::CLOUD_QUANTIZED] = [&](Frame &f)
+    {
+        auto &q = quantizedCloud;
+        uint32_t payloadSize;
+        if (!binRead(q.numPoints, q.origin.x, q.origin.y, q.origin.z, q.step, q.encoding, payloadSize))
+            return false;
+
+        q.payload.resize(payloadSize);
+        if (!in.read((char *)q.payload.data(), payloadSize))
+            return false;
+
+        const bool ok = dequantizeCloud(q, f.cloud);
+        TLOG_IF(ERROR, !ok) << "Could not decode quantized cloud, encoding " << int(q.encoding);
+        return ok;
+    };
 }
 
 DatasetInput::~DatasetInput()
@@ -114,6 +129,13 @@ Status DatasetInput::readHeader()
 
     TLOG(INFO) << "Format version is: " << meta.formatVersion;
 
+    // older versions are a subset of the current one, newer ones may have fields we would misparse
+    if (meta.formatVersion < 1 || meta.formatVersion > FORMAT_VERSION)
+    {
+        TLOG(ERROR) << "Unsupported format version " << meta.formatVersion << ", expected at most " << FORMAT_VERSION;
+        return Status::ERROR;
+    }
+
     return Status::SUCCESS;
 }
 
@@ -1,15 +1,34 @@
+#include <util/tiny_logger.hpp>
+
 #include <4d/format.hpp>
 #include <4d/dataset_output.hpp>
 
 
 DatasetOutput::DatasetOutput(const std::string &path)
-    : out(path, std::ios::binary)
+    : fileWriter(64 << 20)  // ~50 frames
+    , file(fileWriter.open(path))
+{
+}
+
+DatasetOutput::~DatasetOutput()
+{
+    fileWriter.close(file);
+    TLOG_IF(ERROR, !fileWriter.flush()) << "Could not write dataset";
+}
+
+void DatasetOutput::submitBuffer()
 {
+    // the storage goes to the writer with the data, sections are about the same size, so reserve the next one
+    // upfront instead of growing it again by doubling on every frame
+    const size_t sectionSize = buffer.size();
+    fileWriter.append(file, std::move(buffer));
+    buffer = std::vector<char>();
+    buffer.reserve(sectionSize);
 }
 
 Status DatasetOutput::writeHeader(const SensorManager &sensorManager)
 {
-    if (!out.is_open())
+    if (file == AsyncFileWriter::invalidHandle)
         return Status::ERROR;
 
     binWrite(Field::MAGIC);
@@ -51,11 +70,15 @@ Status DatasetOutput::writeHeader(const SensorManager &sensorManager)
     writeField(Field::COLOR_FORMAT, colorFormat);
     writeField(Field::DEPTH_FORMAT, depthFormat);
 
+    submitBuffer();
     return Status::SUCCESS;
 }
 
 Status DatasetOutput::writeFrame(const Frame &frame)
 {
+    if (file == AsyncFileWriter::invalidHandle)
+        return Status::ERROR;
+
     binWrite(Field::FRAME_SECTION);
     writeField(Field::FRAME_NUMBER, frame.frameNumber);
 
@@ -66,10 +89,29 @@ Status DatasetOutput::writeFrame(const Frame &frame)
         writeField(Field::DEPTH, (const char *)frame.depth.data, frame.depth.total() * frame.depth.elemSize());
     if (!frame.cloud.empty())
     {
-        writeField(Field::CLOUD_NUM_POINTS, uint32_t(frame.cloud.size()));
-        writeField(Field::CLOUD, (const char *)frame.cloud.data(), frame.cloud.size() * sizeof(frame.cloud.front()));
+        if (quantizeClouds)
+        {
+            quantizeCloud(frame.cloud, quantizationStep, cloudEncoding, quantizedCloud);
+            const auto &q = quantizedCloud;
+            binWrite(Field::CLOUD_QUANTIZED);
+            binWrite(q.numPoints, q.origin.x, q.origin.y, q.origin.z, q.step, q.encoding, uint32_t(q.payload.size()));
+            write((const char *)q.payload.data(), q.payload.size());
+        }
+        else
+        {
+            writeField(Field::CLOUD_NUM_POINTS, uint32_t(frame.cloud.size()));
+            writeField(Field::CLOUD, (const char *)frame.cloud.data(), frame.cloud.size() * sizeof(frame.cloud.front()));
+        }
     }
     writeField(Field::DEPTH_TIMESTAMP, frame.dTimestamp);
 
+    submitBuffer();
     return Status::SUCCESS;
 }
+
+void DatasetOutput::enableCloudQuantization(CloudEncoding encoding, float step)
+{
+    quantizeClouds = true;
+    cloudEncoding = encoding;
+    quantizationStep = step;
+}
@@ -1,3 +1,5 @@
+#include <thread>
+
 #include <util/tiny_logger.hpp>
 
 #include <4d/app_state.hpp>
@@ -35,17 +37,35 @@ void DatasetReader::init()
     initialized = true;
 }
 
+void DatasetReader::enableRealTimePacing()
+{
+    realTime = true;
+}
+
 void DatasetReader::run()
 {
     if (!initialized)
         return;
 
+    const auto start = std::chrono::steady_clock::now();
+    int64_t firstTimestampUs = -1;
+
     int numFrames = 0;
     while (!cancel && !dataset->finished())
     {
         std::shared_ptr<Frame> frame = std::make_shared<Frame>();
         if (dataset->readFrame(*frame) == Status::SUCCESS)
         {
+            frame->lastFrame = dataset->finished();
+
+            if (realTime)
+            {
+                if (firstTimestampUs < 0)
+                    firstTimestampUs = frame->dTimestamp;
+                std::this_thread::sleep_until(start + std::chrono::microseconds(frame->dTimestamp - firstTimestampUs));
+                frame->creationTime = std::chrono::steady_clock::now();
+            }
+
             produce(frame);
             ++numFrames;
         }
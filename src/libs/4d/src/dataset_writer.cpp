@@ -27,6 +27,11 @@ void DatasetWriter::init()
     dataset.writeHeader(sensorManager);
 }
 
+void DatasetWriter::enableCloudQuantization(CloudEncoding encoding)
+{
+    dataset.enableCloudQuantization(encoding);
+}
+
 void DatasetWriter::process(std::shared_ptr<Frame> &frame)
 {
     if (!appState().isGrabbingStarted())
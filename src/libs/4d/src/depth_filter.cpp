@@ -49,18 +49,25 @@ void DepthFilter::process(std::shared_ptr<Frame> &frame)
     const cv::Point3f *translation = reinterpret_cast<cv::Point3f *>(calibration.tvec.data);
     cv::Mat &depth = frame->depth;
     cv::Mat mask = cv::Mat::zeros(depth.rows, depth.cols, CV_8UC1);
+
+    // pixels not visible in the color camera are removed, projected in batches row by row
+    std::vector<float> cols(depth.cols), x(depth.cols), y(depth.cols), z(depth.cols);
+    std::vector<uint8_t> hasDepth(depth.cols), inColorImage(depth.cols);
+    for (int j = 0; j < depth.cols; ++j)
+        cols[j] = float(j);
+
     for (int i = 0; i < depth.rows; ++i)
+    {
+        uint16_t *row = depth.ptr<uint16_t>(i);
+        project2dPointsTo3d(i, cols.data(), row, depth.cols, depthCam, x.data(), y.data(), z.data(), hasDepth.data());
         for (int j = 0; j < depth.cols; ++j)
-        {
-            uint16_t &d = depth.at<uint16_t>(i, j);
-            if (d < minDepth || d > maxDepth || i < 1 || j < 1 || i >= depth.rows - 1 || j >= depth.cols - 1)
-            {
-                d = 0;
-                continue;
-            }
+            x[j] += translation->x, y[j] += translation->y, z[j] += translation->z;
+        project3dPointsTo2d(x.data(), y.data(), z.data(), depth.cols, colorCam, nullptr, nullptr, nullptr, inColorImage.data());
 
-            const auto pointColorSpace = project2dPointTo3d(i, j, d, depthCam) + *translation;
-            if (!project3dPointTo2d(pointColorSpace, colorCam, Ignore<int>(), Ignore<int>(), Ignore<uint16_t>()))
+        for (int j = 0; j < depth.cols; ++j)
+        {
+            uint16_t &d = row[j];
+            if (d < minDepth || d > maxDepth || i < 1 || j < 1 || i >= depth.rows - 1 || j >= depth.cols - 1 || !inColorImage[j])
             {
                 d = 0;
                 continue;
@@ -81,6 +88,7 @@ void DepthFilter::process(std::shared_ptr<Frame> &frame)
                     }
                 }
         }
+    }
 
     int clusterIdx = 1;
     cv::Mat cluster = cv::Mat::zeros(depth.rows, depth.cols, CV_32SC1);
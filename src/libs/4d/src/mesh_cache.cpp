@@ -0,0 +1,42 @@
+#include <vector>
+#include <fstream>
+
+#include <util/hash.hpp>
+
+#include <4d/format.hpp>
+#include <4d/params.hpp>
+#include <4d/player.hpp>
+#include <4d/mesh_cache.hpp>
+
+
+std::string meshCachePath(const std::string &datasetPath)
+{
+    return datasetPath + ".4dm";
+}
+
+uint64_t meshCacheKey(const std::string &datasetPath)
+{
+    constexpr int64_t chunkSize = 1 << 20;
+
+    Hasher h;
+    h.add(MESH_CACHE_FORMAT_VERSION).add(algoParams().meshingParamsHash()).add(targetScreenWidth);
+
+    std::ifstream in(datasetPath, std::ios::binary);
+    if (!in.is_open())
+        return h.value();
+
+    in.seekg(0, std::ios::end);
+    const int64_t size = in.tellg();
+    h.add(size);
+
+    std::vector<char> buffer(size_t(std::min(size, chunkSize)));
+    in.seekg(0);
+    in.read(buffer.data(), buffer.size());
+    h.add(buffer.data(), buffer.size());
+
+    in.seekg(std::max(size - chunkSize, int64_t(0)));
+    in.read(buffer.data(), buffer.size());
+    h.add(buffer.data(), buffer.size());
+
+    return h.value();
+}
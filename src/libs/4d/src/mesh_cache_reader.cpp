@@ -0,0 +1,181 @@
+#include <util/tiny_logger.hpp>
+
+#include <4d/app_state.hpp>
+#include <4d/mesh_cache.hpp>
+#include <4d/mesh_cache_reader.hpp>
+
+
+MeshCacheReader::MeshCacheReader(const std::string &datasetPath, bool readColor, const CancellationToken &cancellationToken)
+    : MeshFrameProducer(cancellationToken)
+    , withColor(readColor)
+    , datasetPath(datasetPath)
+{
+    TLOG(INFO) << "Mesh cache: " << meshCachePath(datasetPath);
+}
+
+MeshCacheReader::~MeshCacheReader()
+{
+}
+
+bool MeshCacheReader::isValid(const std::string &datasetPath)
+{
+    std::ifstream f(meshCachePath(datasetPath), std::ios::binary);
+    if (!f.is_open())
+        return false;
+
+    Field magic, metadata, versionField, keyField;
+    uint32_t version;
+    uint64_t key;
+    f.read((char *)&magic, sizeof(magic)).read((char *)&metadata, sizeof(metadata));
+    f.read((char *)&versionField, sizeof(versionField)).read((char *)&version, sizeof(version));
+    f.read((char *)&keyField, sizeof(keyField)).read((char *)&key, sizeof(key));
+    if (!f || magic != Field::MAGIC || version != MESH_CACHE_FORMAT_VERSION || keyField != Field::CACHE_KEY)
+        return false;
+
+    const bool valid = key == meshCacheKey(datasetPath);
+    TLOG_IF(INFO, !valid) << "Mesh cache is outdated, dataset or params have changed";
+    return valid;
+}
+
+void MeshCacheReader::init()
+{
+    finished = false;
+    in = std::ifstream(meshCachePath(datasetPath), std::ios::binary);
+    if (!readHeader())
+    {
+        TLOG(ERROR) << "Could not read mesh cache header!";
+        return;
+    }
+
+    // the source dataset provides sensor params and color frames
+    source = std::make_shared<DatasetInput>(datasetPath, withColor);
+    if (source->readHeader() != Status::SUCCESS)
+    {
+        TLOG(ERROR) << "Could not read dataset header!";
+        return;
+    }
+
+    auto metadata = source->getMetadata();
+    auto &sensorManager = appState().getSensorManager();
+    sensorManager.setColorParams(metadata.color, metadata.colorFormat);
+    sensorManager.setDepthParams(metadata.depth, metadata.depthFormat);
+    sensorManager.setCalibration(metadata.calibration);
+    sensorManager.setInitialized();
+    initialized = true;
+}
+
+bool MeshCacheReader::readHeader()
+{
+    Field field;
+    uint32_t version;
+    uint64_t key;
+    return binRead(field) && field == Field::MAGIC
+        && binRead(field) && field == Field::METADATA_SECTION
+        && readField(Field::VERSION, version) && version == MESH_CACHE_FORMAT_VERSION
+        && readField(Field::CACHE_KEY, key);
+}
+
+bool MeshCacheReader::readFrame(MeshFrame &meshFrame)
+{
+    Frame &frame = *meshFrame.frame2D;
+    Field field;
+    uint32_t numLods;
+    const bool ok = binRead(field) && field == Field::FRAME_SECTION
+        && readField(Field::FRAME_NUMBER, frame.frameNumber)
+        && readField(Field::COLOR_TIMESTAMP, frame.cTimestamp)
+        && readField(Field::DEPTH_TIMESTAMP, frame.dTimestamp)
+        && readMesh(meshFrame)
+        && readField(Field::LODS, numLods);
+    if (!ok)
+        return false;
+
+    for (uint32_t level = 0; level < numLods; ++level)
+    {
+        auto lod = std::make_shared<MeshFrame>();
+        lod->frame2D = meshFrame.frame2D;
+        lod->indexedMode = true;
+        if (!readMesh(*lod))
+            return false;
+        meshFrame.lods.push_back(lod);
+    }
+
+    // peek at the next field to find out if this is the last frame
+    if (!binRead(field))
+        return false;
+    if (field == Field::END_OF_SEQUENCE)
+        frame.lastFrame = finished = true;
+    else
+        in.seekg(-std::streamoff(sizeof(field)), std::ios::cur);
+
+    return true;
+}
+
+bool MeshCacheReader::readMesh(MeshFrame &mesh)
+{
+    return readArray(Field::CLOUD, mesh.cloud)
+        && readArray(Field::TRIANGLES, mesh.triangles)
+        && readArray(Field::NORMALS, mesh.normals)
+        && readArray(Field::UV, mesh.uv);
+}
+
+void MeshCacheReader::readColor(Frame &frame)
+{
+    // pipeline does not drop frames, but let's not rely on it and skip source frames until the numbers match
+    Frame sourceFrame;
+    while (!source->finished())
+    {
+        if (source->readFrame(sourceFrame) != Status::SUCCESS)
+            break;
+
+        if (sourceFrame.frameNumber == frame.frameNumber)
+        {
+            frame.color = sourceFrame.color;
+            return;
+        }
+    }
+
+    TLOG(WARNING) << "Could not find color for frame #" << frame.frameNumber;
+}
+
+void MeshCacheReader::run()
+{
+    if (!initialized)
+        return;
+
+    numFrames = 0;
+    while (!cancel && !finished)
+    {
+        auto meshFrame = std::make_shared<MeshFrame>();
+        meshFrame->frame2D = std::make_shared<Frame>();
+        meshFrame->indexedMode = true;
+        if (!readFrame(*meshFrame))
+        {
+            TLOG(ERROR) << "Error while reading mesh cache frame!";
+            break;
+        }
+
+        if (withColor)
+            readColor(*meshFrame->frame2D);
+
+        produce(meshFrame);
+        ++numFrames;
+    }
+
+    TLOG(INFO) << "Read total: " << numFrames << " mesh frames";
+}
+
+void MeshCacheReader::runLoop()
+{
+    if (!initialized)
+        return;
+
+    while (!cancel)
+    {
+        run();
+
+        initialized = false;
+        init();
+        if (!initialized)
+            break;
+    }
+}
@@ -0,0 +1,107 @@
+#include <cstdio>
+
+#include <util/tiny_logger.hpp>
+
+#include <4d/mesh_cache.hpp>
+#include <4d/mesh_cache_writer.hpp>
+
+
+MeshCacheWriter::MeshCacheWriter(const std::string &datasetPath, MeshFrameQueue &q, CancellationToken &cancellationToken)
+    : MeshFrameConsumer(q, cancellationToken)
+    , datasetPath(datasetPath)
+    , cachePath(meshCachePath(datasetPath))
+    , tmpPath(cachePath + ".tmp")
+{
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+    if (!finished && out.is_open())
+    {
+        TLOG(INFO) << "Mesh cache is incomplete (" << numFrames << " frames), discarding";
+        out.close();
+        std::remove(tmpPath.c_str());
+    }
+}
+
+void MeshCacheWriter::init()
+{
+    out.open(tmpPath, std::ios::binary);
+    if (!out.is_open())
+    {
+        TLOG(ERROR) << "Could not open " << tmpPath << " for writing, mesh cache is disabled";
+        finished = true;
+        return;
+    }
+
+    binWrite(Field::MAGIC);
+    binWrite(Field::METADATA_SECTION);
+    binWrite(Field::VERSION, MESH_CACHE_FORMAT_VERSION);
+    binWrite(Field::CACHE_KEY, meshCacheKey(datasetPath));
+}
+
+void MeshCacheWriter::process(std::shared_ptr<MeshFrame> &frame)
+{
+    if (finished)
+        return;
+
+    if (!frame->indexedMode)
+    {
+        TLOG(ERROR) << "Only indexed mode is supported by the mesh cache";
+        finished = true;
+        out.close();
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    frame = withFloatVertices(frame);
+
+    const Frame &frame2D = *frame->frame2D;
+    binWrite(Field::FRAME_SECTION);
+    binWrite(Field::FRAME_NUMBER, frame2D.frameNumber);
+    binWrite(Field::COLOR_TIMESTAMP, frame2D.cTimestamp);
+    binWrite(Field::DEPTH_TIMESTAMP, frame2D.dTimestamp);
+    writeMesh(*frame);
+
+    // levels of detail are stored too, rebuilding them on replay would cost as much as the decimation itself
+    binWrite(Field::LODS, uint32_t(frame->lods.size()));
+    for (const auto &lod : frame->lods)
+        writeMesh(*withFloatVertices(lod));
+    ++numFrames;
+
+    if (frame2D.lastFrame)
+        finalize();
+}
+
+void MeshCacheWriter::writeMesh(const MeshFrame &mesh)
+{
+    writeArray(Field::CLOUD, mesh.cloud);
+    writeArray(Field::TRIANGLES, mesh.triangles);
+    writeArray(Field::NORMALS, mesh.normals);
+    writeArray(Field::UV, mesh.uv);
+}
+
+void MeshCacheWriter::finalize()
+{
+    binWrite(Field::END_OF_SEQUENCE);
+    out.close();
+    finished = true;
+
+    if (!out)
+    {
+        TLOG(ERROR) << "Error while writing mesh cache " << tmpPath;
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    // std::rename does not overwrite existing files on all platforms
+    std::remove(cachePath.c_str());
+    if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+    {
+        TLOG(ERROR) << "Could not rename " << tmpPath << " to " << cachePath;
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    TLOG(INFO) << "Mesh cache with " << numFrames << " frames saved to " << cachePath;
+}
@@ -0,0 +1,103 @@
+#include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
+#include <util/tiny_profiler.hpp>
+#include <util/mesh_optimization.hpp>
+
+#include <4d/params.hpp>
+#include <4d/mesh_decimator.hpp>
+
+
+MeshDecimator::MeshDecimator(MeshFrameQueue &q, MeshFrameProducer &output, CancellationToken &cancellationToken, const SimplificationSettings &settings)
+    : MeshFrameConsumer(q, cancellationToken)
+    , output(output)
+    , settings(settings)
+{
+    TLOG(INFO) << "Decimation to " << settings.targetTriangles << " triangles, max error " << settings.maxError;
+}
+
+void MeshDecimator::run()
+{
+    MeshFrameConsumer::run();
+    produceReady(0);
+
+    if (numFrames)
+        TLOG(INFO) << "Decimated " << numFrames << " frames, avg triangles " << numInputTriangles / numFrames << " -> " << numOutputTriangles / numFrames;
+}
+
+std::shared_ptr<MeshFrame> MeshDecimator::decimate(const std::shared_ptr<MeshFrame> &frame, const SimplificationSettings &settings)
+{
+    // the mesher may have done most of the work already
+    const auto input = selectLod(frame, settings.targetTriangles);
+    if (!input->indexedMode || input->triangles.size() <= settings.targetTriangles)
+        return input;
+
+    tprof().startTimer("decimation");
+
+    // decoding of the compact frame makes a copy anyway
+    auto simplified = input->isCompact() ? withFloatVertices(input) : std::make_shared<MeshFrame>(*input);
+    simplified->lods.clear();
+
+    std::vector<int> remap;
+    const size_t numVertices = simplifyMesh(simplified->cloud, simplified->triangles, settings, remap);
+    remapVertices(simplified->cloud, remap, numVertices);
+    remapVertices(simplified->normals, remap, numVertices);
+    remapVertices(simplified->uv, remap, numVertices);
+
+    if (mesherParams().optimizeVertexOrder)
+        optimizeVertexOrder(*simplified);
+    if (input->isCompact())
+        compactVertices(*simplified);
+
+    tprof().stopTimer("decimation");
+    return simplified;
+}
+
+void MeshDecimator::addLods(const std::shared_ptr<MeshFrame> &frame, int numLods, float maxError)
+{
+    SimplificationSettings settings;
+    settings.maxError = maxError;
+
+    frame->lods.clear();
+    std::shared_ptr<MeshFrame> previous = frame;
+    for (int level = 1; level < numLods; ++level)
+    {
+        const size_t numTriangles = previous->triangles.size();
+        settings.targetTriangles = numTriangles / 2;
+
+        // levels that are not much lighter than the previous one are not worth the memory
+        auto lod = decimate(previous, settings);
+        if (lod == previous || lod->triangles.size() > numTriangles * 3 / 4)
+            break;
+
+        frame->lods.push_back(lod);
+        previous = lod;
+    }
+}
+
+void MeshDecimator::process(std::shared_ptr<MeshFrame> &frame)
+{
+    // bounded, so that the decimator does not buffer the whole dataset if the output is slow
+    produceReady(size_t(2 * threadPool().numThreads()));
+
+    numInputTriangles += frame->triangles.size();
+    std::shared_ptr<MeshFrame> input = frame;
+    const SimplificationSettings s = settings;
+    pending.emplace_back(threadPool().submit([input, s] { return decimate(input, s); }));
+
+    // don't hold frames that are already done, the player needs them as soon as possible
+    while (!pending.empty() && pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        produceReady(pending.size() - 1);
+}
+
+void MeshDecimator::produceReady(size_t maxPending)
+{
+    while (pending.size() > maxPending)
+    {
+        auto frame = pending.front().get();
+        pending.pop_front();
+
+        numOutputTriangles += frame->triangles.size();
+        ++numFrames;
+        output.produce(frame);
+    }
+}
@@ -0,0 +1,65 @@
+#include <util/mesh_optimization.hpp>
+
+#include <4d/mesh_frame.hpp>
+
+
+std::shared_ptr<MeshFrame> selectLod(const std::shared_ptr<MeshFrame> &frame, size_t maxTriangles)
+{
+    if (frame->triangles.size() <= maxTriangles || frame->lods.empty())
+        return frame;
+
+    for (const auto &lod : frame->lods)
+        if (lod->triangles.size() <= maxTriangles)
+            return lod;
+    return frame->lods.back();
+}
+
+void optimizeVertexOrder(MeshFrame &frame)
+{
+    if (!frame.indexedMode || frame.isCompact())
+        return;
+
+    optimizeVertexCache(frame.triangles, frame.cloud.size());
+
+    std::vector<int> remap;
+    const size_t numUsedVertices = optimizeVertexFetch(frame.triangles, frame.cloud.size(), remap);
+    remapVertices(frame.cloud, remap, numUsedVertices);
+    remapVertices(frame.normals, remap, numUsedVertices);
+    remapVertices(frame.uv, remap, numUsedVertices);
+}
+
+void compactVertices(MeshFrame &frame)
+{
+    if (!frame.indexedMode || frame.cloud.empty())
+        return;
+
+    const bool withNormals = frame.frame2D->color.empty();
+    encodeCompactVertices(frame.cloud, withNormals ? frame.normals : std::vector<cv::Point3f>(), frame.uv,
+                          frame.compactVertices, frame.compactOrigin, frame.compactStep);
+
+    std::vector<cv::Point3f>().swap(frame.cloud);
+    std::vector<cv::Point3f>().swap(frame.normals);
+    std::vector<cv::Point2f>().swap(frame.uv);
+}
+
+std::shared_ptr<MeshFrame> withFloatVertices(const std::shared_ptr<MeshFrame> &frame)
+{
+    if (!frame->isCompact())
+        return frame;
+
+    auto decoded = std::make_shared<MeshFrame>();
+    decoded->frame2D = frame->frame2D;
+    decoded->indexedMode = true;
+    decoded->triangles = frame->triangles;
+    decoded->lods = frame->lods;
+
+    const bool withNormals = frame->frame2D->color.empty();
+    decodeCompactVertices(frame->compactVertices, frame->compactOrigin, frame->compactStep,
+                          &decoded->cloud,
+                          withNormals ? &decoded->normals : nullptr,
+                          withNormals ? nullptr : &decoded->uv);
+    if (!withNormals)
+        decoded->normals.resize(decoded->cloud.size());
+
+    return decoded;
+}
@@ -0,0 +1,104 @@
+#include <4d/mesh_frame_cache.hpp>
+
+
+namespace
+{
+
+template<typename T>
+size_t vectorBytes(const std::vector<T> &v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+size_t matBytes(const cv::Mat &m)
+{
+    return m.empty() ? 0 : m.total() * m.elemSize();
+}
+
+/// Mesh data without the 2D frame.
+size_t meshBytes(const MeshFrame &frame)
+{
+    size_t bytes = sizeof(MeshFrame);
+    bytes += vectorBytes(frame.cloud) + vectorBytes(frame.triangles) + vectorBytes(frame.normals) + vectorBytes(frame.uv);
+    bytes += vectorBytes(frame.compactVertices);
+    bytes += vectorBytes(frame.triangles3D) + vectorBytes(frame.trianglesNormals) + vectorBytes(frame.trianglesUv);
+    return bytes;
+}
+
+}
+
+
+MeshFrameCache::MeshFrameCache(size_t maxBytes)
+    : maxBytes(maxBytes)
+{
+}
+
+std::shared_ptr<MeshFrame> MeshFrameCache::get(const std::string &dataset, int frameNumber)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = index.find(Key(dataset, frameNumber));
+    if (it == index.end())
+    {
+        ++stats.numMisses;
+        return nullptr;
+    }
+
+    ++stats.numHits;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->frame;
+}
+
+void MeshFrameCache::put(const std::string &dataset, int frameNumber, const std::shared_ptr<MeshFrame> &frame)
+{
+    const size_t bytes = frameBytes(*frame);
+    if (bytes > maxBytes)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const Key key(dataset, frameNumber);
+    const auto existing = index.find(key);
+    if (existing != index.end())
+    {
+        stats.numBytes -= existing->second->bytes;
+        lru.erase(existing->second);
+        index.erase(existing);
+    }
+
+    while (!lru.empty() && stats.numBytes + bytes > maxBytes)
+    {
+        stats.numBytes -= lru.back().bytes;
+        index.erase(lru.back().key);
+        lru.pop_back();
+        ++stats.numEvicted;
+    }
+
+    lru.push_front({ key, frame, bytes });
+    index[key] = lru.begin();
+    stats.numBytes += bytes;
+}
+
+MeshFrameCache::Stats MeshFrameCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.numFrames = int(lru.size());
+    return result;
+}
+
+size_t MeshFrameCache::frameBytes(const MeshFrame &frame)
+{
+    // levels of detail share frame2D
+    size_t bytes = meshBytes(frame);
+    for (const auto &lod : frame.lods)
+        bytes += meshBytes(*lod);
+
+    if (frame.frame2D)
+    {
+        const Frame &f = *frame.frame2D;
+        bytes += sizeof(Frame) + matBytes(f.color) + matBytes(f.depth) + vectorBytes(f.cloud);
+    }
+
+    return bytes;
+}
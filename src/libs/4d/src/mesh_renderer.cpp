@@ -0,0 +1,373 @@
+#ifdef _MSC_VER
+    #pragma warning(push)
+    #pragma warning(disable: 4310)  // cast truncates constant value
+#endif
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#ifdef _MSC_VER
+    #pragma warning(pop)
+#endif
+
+#include <util/tiny_logger.hpp>
+#include <util/opengl_utils.hpp>
+
+#include <4d/params.hpp>
+#include <4d/mesh_renderer.hpp>
+
+
+namespace
+{
+
+// OpenGL stuff
+
+const char *vertexShader =
+"#version 330 core\n"
+"layout(location = 0) in vec3 vertexPosition_modelspace;"
+"layout(location = 1) in vec3 vertexNormal;"
+"layout(location = 2) in vec2 vertexUV;"
+""
+"uniform mat4 transform;"
+""
+"// compact vertices: positions are 16-bit integers relative to the frame bounding box, normals are octahedral\n"
+"uniform vec3 positionOrigin;"
+"uniform float positionStep;"
+"uniform bool octNormals;"
+"uniform float pointSize;"
+""
+"out vec3 v;"
+"out vec3 normal;"
+"out vec2 uv;"
+""
+"vec3 octDecode(vec2 e)"
+"{"
+"    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));"
+"    if (n.z < 0.0)"
+"        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);"
+"    return normalize(n);"
+"}"
+""
+"void main()"
+"{"
+"    vec3 p = positionOrigin + positionStep * vertexPosition_modelspace;"
+"    gl_Position = transform * vec4(p, 1.0);"
+"    gl_PointSize = pointSize;"
+"    v = p;"
+"    normal = octNormals ? octDecode(vertexNormal.xy) : vertexNormal;"
+"    uv = vertexUV;"
+"}";
+
+const char *fragmentShader =
+"#version 330 core\n"
+"in vec3 v;"
+"in vec3 normal;"
+"in vec2 uv;"
+""
+"uniform sampler2D textureSampler;"
+"uniform bool withColor;"
+""
+"out vec3 color;"
+""
+"void main()"
+"{"
+"    vec3 lightPos = vec3(0, 0, 3);"
+"    vec3 lightDirection = normalize(lightPos - v);"
+"    vec3 finalColor;"
+"    if (withColor)"
+"    {"
+"        finalColor = texture(textureSampler, uv).rgb;"
+"    }"
+"    else"
+"    {"
+"        finalColor = vec3(0.3, 0.3, 0.3) + vec3(0.5, 0.5, 0.5) * max(float(dot(normal, lightDirection)), 0.0);"
+"    }"
+"    color = finalColor;"
+"}";
+
+/// Attributes from the interleaved CompactVertex stream, positions are decoded in the shader.
+void setCompactAttributes(GLuint buffer, size_t offset, bool withColor)
+{
+    constexpr GLsizei stride = sizeof(CompactVertex);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, stride, (void*)(offset + offsetof(CompactVertex, position)));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, stride, (void*)(offset + offsetof(CompactVertex, normal)));
+
+    if (withColor)
+    {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(offset + offsetof(CompactVertex, uv)));
+    }
+}
+
+/// Same as uvBoundingRect, the bounding box of the 16-bit uv is found first.
+cv::Rect compactUvBoundingRect(const std::vector<CompactVertex> &vertices, cv::Size imageSize)
+{
+    if (vertices.empty())
+        return cv::Rect();
+
+    uint16_t minU = 0xffff, minV = 0xffff, maxU = 0, maxV = 0;
+    for (const auto &v : vertices)
+    {
+        minU = std::min(minU, v.uv[0]), maxU = std::max(maxU, v.uv[0]);
+        minV = std::min(minV, v.uv[1]), maxV = std::max(maxV, v.uv[1]);
+    }
+
+    const float scale = 1.0f / 0xffff;
+    const cv::Point2f corners[] = { cv::Point2f(minU * scale, minV * scale), cv::Point2f(maxU * scale, maxV * scale) };
+    return uvBoundingRect(corners, 2, imageSize);
+}
+
+}
+
+
+struct MeshRenderer::MeshRendererImpl
+{
+    ~MeshRendererImpl()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+        if (vertexArrayID)
+            glDeleteVertexArrays(1, &vertexArrayID);
+    }
+
+    std::shared_ptr<ShaderLoader> shaderLoader;
+    GLint program = 0;
+    GLuint vertexArrayID = 0;
+    std::unique_ptr<StreamingBuffer> vertexBuffer, normalBuffer, uvBuffer, indexBuffer;
+    size_t vertexOffset = 0, normalOffset = 0, uvOffset = 0, indexOffset = 0;
+    GLint transformUniformID = 0;
+    GLuint texture = 0;
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    GLint withColorHandle = 0;
+    GLint positionOriginHandle = 0, positionStepHandle = 0, octNormalsHandle = 0, pointSizeHandle = 0;
+
+    bool indexedMode = false;
+    bool withColor = false;
+    bool pointsOnly = false;
+
+    /// Interleaved CompactVertex data in the vertex buffer instead of the separate float arrays.
+    bool compact = false;
+    cv::Point3f positionOrigin;
+    float positionStep = 1;
+
+    /// Attributes from the separate float buffers.
+    void setFloatAttributes()
+    {
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer->getBuffer());
+        glVertexAttribPointer(
+            0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
+            3,                  // size
+            GL_FLOAT,           // type
+            GL_FALSE,           // normalized?
+            0,                  // stride
+            (void*)vertexOffset  // array buffer offset
+        );
+
+        if (pointsOnly)
+        {
+            // points have no normals, constant one facing the light
+            glDisableVertexAttribArray(1);
+            glVertexAttrib3f(1, 0, 0, 1);
+        }
+        else
+        {
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ARRAY_BUFFER, normalBuffer->getBuffer());
+            glVertexAttribPointer(
+                1,
+                3,                  // size
+                GL_FLOAT,           // type
+                GL_FALSE,           // normalized?
+                0,                  // stride
+                (void*)normalOffset  // array buffer offset
+            );
+        }
+
+        if (withColor)
+        {
+            glEnableVertexAttribArray(2);
+            glBindBuffer(GL_ARRAY_BUFFER, uvBuffer->getBuffer());
+            glVertexAttribPointer(
+                2,
+                2,                  // size (2 floats for uv)
+                GL_FLOAT,           // type
+                GL_FALSE,           // normalized?
+                0,                  // stride
+                (void*)uvOffset    // array buffer offset
+            );
+        }
+    }
+    GLsizei numElements = 0;
+};
+
+
+MeshRenderer::MeshRenderer()
+    : data(std::make_unique<MeshRendererImpl>())
+{
+    auto &d = *data;
+
+    d.shaderLoader = std::make_shared<ShaderLoader>(vertexShader, fragmentShader, "4D");
+    d.program = d.shaderLoader->getProgram();
+
+    glGenVertexArrays(1, &d.vertexArrayID);
+    glBindVertexArray(d.vertexArrayID);
+
+    // mesh data changes every frame, stream it through ring buffers instead of reallocating the storage
+    d.vertexBuffer = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER);
+    d.normalBuffer = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER);
+    d.uvBuffer = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER);
+    d.indexBuffer = std::make_unique<StreamingBuffer>(GL_ELEMENT_ARRAY_BUFFER);
+
+    d.transformUniformID = glGetUniformLocation(d.program, "transform");
+    d.withColorHandle = glGetUniformLocation(d.program, "withColor");
+    d.positionOriginHandle = glGetUniformLocation(d.program, "positionOrigin");
+    d.positionStepHandle = glGetUniformLocation(d.program, "positionStep");
+    d.octNormalsHandle = glGetUniformLocation(d.program, "octNormals");
+    d.pointSizeHandle = glGetUniformLocation(d.program, "pointSize");
+
+    if (playerParams().streamTextures)
+        d.textureStreamer = std::make_unique<TextureStreamer>(playerParams().mipmapInterval);
+
+    glGenTextures(1, &d.texture);
+    glBindTexture(GL_TEXTURE_2D, d.texture);
+
+    // should not actually be needed, just in case; default is GL_REPEAT
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // trilinear filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    // point sprites of the preview mode are sized in the vertex shader
+    glEnable(GL_PROGRAM_POINT_SIZE);
+}
+
+MeshRenderer::~MeshRenderer() = default;
+
+void MeshRenderer::setFrame(const MeshFrame &frame)
+{
+    auto &d = *data;
+
+    d.indexedMode = frame.indexedMode && !frame.pointsOnly;
+    d.pointsOnly = frame.pointsOnly;
+    d.compact = frame.isCompact();
+    d.positionOrigin = d.compact ? frame.compactOrigin : cv::Point3f();
+    d.positionStep = d.compact ? frame.compactStep : 1;
+
+    auto &frame2D = frame.frame2D;
+    d.withColor = !frame2D->color.empty();
+    glBindVertexArray(d.vertexArrayID);
+
+    if (d.pointsOnly)
+    {
+        // preview: just the points and the uv, no index buffer
+        d.numElements = GLsizei(frame.cloud.size());
+
+        d.vertexOffset = d.vertexBuffer->upload(frame.cloud.data(), frame.cloud.size() * sizeof(cv::Point3f));
+        if (d.withColor)
+            d.uvOffset = d.uvBuffer->upload(frame.uv.data(), frame.uv.size() * sizeof(cv::Point2f));
+    }
+    else if (d.compact)
+    {
+        // all attributes in one interleaved stream, 12 bytes per vertex
+        d.numElements = GLsizei(frame.triangles.size());
+
+        d.vertexOffset = d.vertexBuffer->upload(frame.compactVertices.data(), frame.compactVertices.size() * sizeof(CompactVertex));
+        d.indexOffset = d.indexBuffer->upload(frame.triangles.data(), frame.triangles.size() * sizeof(Triangle));
+    }
+    else if (d.indexedMode)
+    {
+        d.numElements = GLsizei(frame.triangles.size());
+
+        d.vertexOffset = d.vertexBuffer->upload(frame.cloud.data(), frame.cloud.size() * sizeof(cv::Point3f));
+        d.normalOffset = d.normalBuffer->upload(frame.normals.data(), frame.normals.size() * sizeof(cv::Point3f));
+        d.indexOffset = d.indexBuffer->upload(frame.triangles.data(), frame.triangles.size() * sizeof(Triangle));
+        if (d.withColor)
+            d.uvOffset = d.uvBuffer->upload(frame.uv.data(), frame.uv.size() * sizeof(cv::Point2f));
+    }
+    else
+    {
+        d.numElements = GLsizei(frame.num3DTriangles);
+
+        d.vertexOffset = d.vertexBuffer->upload(frame.triangles3D.data(), d.numElements * sizeof(Triangle3D));
+        d.normalOffset = d.normalBuffer->upload(frame.trianglesNormals.data(), d.numElements * sizeof(Triangle3D));
+        if (d.withColor)
+            d.uvOffset = d.uvBuffer->upload(frame.trianglesUv.data(), d.numElements * sizeof(TriangleUV));
+    }
+
+    if (d.withColor)
+    {
+        // loading texture data to GPU
+        if (d.textureStreamer)
+        {
+            cv::Rect rect;
+            if (playerParams().uploadUvBoundedRect)
+            {
+                if (d.compact)
+                    rect = compactUvBoundingRect(frame.compactVertices, frame2D->color.size());
+                else if (d.indexedMode || d.pointsOnly)
+                    rect = uvBoundingRect(frame.uv, frame2D->color.size());
+                else
+                    rect = uvBoundingRect(reinterpret_cast<const cv::Point2f *>(frame.trianglesUv.data()), 3 * size_t(d.numElements), frame2D->color.size());
+            }
+            d.textureStreamer->upload(frame2D->color, rect);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, d.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame2D->color.cols, frame2D->color.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, frame2D->color.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+}
+
+void MeshRenderer::draw(const float *mvp)
+{
+    auto &d = *data;
+
+    glUseProgram(d.program);
+    glUniform1i(d.withColorHandle, d.withColor);
+    glUniform3f(d.positionOriginHandle, d.positionOrigin.x, d.positionOrigin.y, d.positionOrigin.z);
+    glUniform1f(d.positionStepHandle, d.positionStep);
+    glUniform1i(d.octNormalsHandle, d.compact);
+    glUniform1f(d.pointSizeHandle, float(playerParams().pointSize));
+
+    if (d.compact)
+        setCompactAttributes(d.vertexBuffer->getBuffer(), d.vertexOffset, d.withColor);
+    else
+        d.setFloatAttributes();
+
+    if (d.indexedMode)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.indexBuffer->getBuffer());
+
+    glUniformMatrix4fv(d.transformUniformID, 1, GL_FALSE, mvp);
+
+    if (d.pointsOnly)
+        glDrawArrays(GL_POINTS, 0, d.numElements);
+    else if (d.indexedMode)
+        glDrawElements(GL_TRIANGLES, 3 * d.numElements, GL_UNSIGNED_SHORT, (void*)d.indexOffset);
+    else
+        glDrawArrays(GL_TRIANGLES, 0, 3 * d.numElements);
+
+    // the last uploaded regions are read by this draw call
+    d.vertexBuffer->fence();
+    if (!d.compact)
+    {
+        if (!d.pointsOnly)
+            d.normalBuffer->fence();
+        if (d.withColor)
+            d.uvBuffer->fence();
+    }
+    if (d.indexedMode)
+        d.indexBuffer->fence();
+
+    glDisableVertexAttribArray(0);
+}
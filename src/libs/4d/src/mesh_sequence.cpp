@@ -0,0 +1,276 @@
+#include <cstring>
+#include <algorithm>
+
+#include <util/varint.hpp>
+
+#include <4d/mesh_sequence.hpp>
+
+
+namespace
+{
+
+constexpr float maxQuantizedValue = 65535.0f;
+
+/// Intra frame grid is extended by this number of steps below the bounding box, objects move in all directions.
+constexpr int gridMargin = 1024;
+
+template<typename T>
+void append(std::vector<uint8_t> &out, const T &value)
+{
+    const size_t size = out.size();
+    out.resize(size + sizeof(value));
+    memcpy(out.data() + size, &value, sizeof(value));
+}
+
+/// Bounds-checked sequential reader of the frame payload.
+class PayloadReader
+{
+public:
+    PayloadReader(const uint8_t *data, size_t size)
+        : p(data)
+        , end(data + size)
+    {
+    }
+
+    template<typename T>
+    bool read(T &value)
+    {
+        if (!p || size_t(end - p) < sizeof(value))
+            return false;
+
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return true;
+    }
+
+    bool readDelta(int32_t &value)
+    {
+        uint32_t code;
+        p = p ? varintDecode(p, end, code) : nullptr;
+        if (!p)
+            return false;
+
+        value = zigzagDecode(code);
+        return true;
+    }
+
+    bool atEnd() const { return p == end; }
+
+private:
+    const uint8_t *p, *end;
+};
+
+FORCE_INLINE uint16_t quantizeUv(float v)
+{
+    return uint16_t(std::min(std::max(v, 0.0f), 1.0f) * maxQuantizedValue + 0.5f);
+}
+
+/// Values are interleaved (e.g. x,y,z), every value is coded relative to the same component of the previous item.
+void encodeInterleavedDeltas(const std::vector<uint16_t> &values, int numComponents, std::vector<uint8_t> &out)
+{
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const int32_t prev = i >= size_t(numComponents) ? values[i - numComponents] : 0;
+        varintEncode(zigzagEncode(int32_t(values[i]) - prev), out);
+    }
+}
+
+bool decodeInterleavedDeltas(PayloadReader &reader, int numComponents, std::vector<uint16_t> &values)
+{
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        int32_t delta;
+        if (!reader.readDelta(delta))
+            return false;
+
+        const int32_t prev = i >= size_t(numComponents) ? values[i - numComponents] : 0;
+        values[i] = uint16_t(prev + delta);
+    }
+    return true;
+}
+
+void dequantizeUv(const std::vector<uint16_t> &values, std::vector<cv::Point2f> &uv)
+{
+    uv.resize(values.size() / 2);
+    const float scale = 1.0f / maxQuantizedValue;
+    for (size_t i = 0; i < uv.size(); ++i)
+        uv[i] = cv::Point2f(values[2 * i] * scale, values[2 * i + 1] * scale);
+}
+
+}
+
+
+MeshSequenceEncoder::MeshSequenceEncoder(int keyframeInterval, float step)
+    : keyframeInterval(std::max(keyframeInterval, 1))
+    , step(step)
+{
+}
+
+bool MeshSequenceEncoder::canEncodeDelta(const std::vector<cv::Point3f> &cloud, const std::vector<Triangle> &triangles, bool hasUv)
+{
+    if (prevStep <= 0 || framesSinceIntra + 1 >= keyframeInterval)
+        return false;
+
+    if (hasUv != prevHasUv || cloud.size() * 3 != prevPositions.size() || triangles.size() != prevTriangles.size())
+        return false;
+
+    if (memcmp(triangles.data(), prevTriangles.data(), triangles.size() * sizeof(Triangle)) != 0)
+        return false;
+
+    // the new frame must fit into the quantization grid of the previous one
+    const float invStep = 1.0f / prevStep;
+    positions.resize(cloud.size() * 3);
+    for (size_t i = 0; i < cloud.size(); ++i)
+    {
+        const float q[] = { (cloud[i].x - origin.x) * invStep + 0.5f, (cloud[i].y - origin.y) * invStep + 0.5f, (cloud[i].z - origin.z) * invStep + 0.5f };
+        for (int c = 0; c < 3; ++c)
+        {
+            if (q[c] < 0 || q[c] > maxQuantizedValue)
+                return false;
+            positions[3 * i + c] = uint16_t(q[c]);
+        }
+    }
+
+    return true;
+}
+
+MeshFrameType MeshSequenceEncoder::encode(const std::vector<cv::Point3f> &cloud, const std::vector<Triangle> &triangles, const std::vector<cv::Point2f> &uv,
+                                          std::vector<uint8_t> &out)
+{
+    out.clear();
+    const bool hasUv = !uv.empty() && uv.size() == cloud.size();
+
+    uvs.resize(hasUv ? 2 * uv.size() : 0);
+    for (size_t i = 0; hasUv && i < uv.size(); ++i)
+        uvs[2 * i] = quantizeUv(uv[i].x), uvs[2 * i + 1] = quantizeUv(uv[i].y);
+
+    MeshFrameType type;
+    if (canEncodeDelta(cloud, triangles, hasUv))
+    {
+        type = MeshFrameType::DELTA;
+        ++framesSinceIntra;
+
+        append(out, uint8_t(hasUv));
+        append(out, uint32_t(cloud.size()));
+        for (size_t i = 0; i < positions.size(); ++i)
+            varintEncode(zigzagEncode(int32_t(positions[i]) - prevPositions[i]), out);
+        for (size_t i = 0; i < uvs.size(); ++i)
+            varintEncode(zigzagEncode(int32_t(uvs[i]) - prevUv[i]), out);
+    }
+    else
+    {
+        type = MeshFrameType::INTRA;
+        framesSinceIntra = 0;
+
+        QuantizedCloud q;
+        quantizeCloud(cloud, step, CloudEncoding::RAW, q);
+        positions.resize(cloud.size() * 3);
+        if (!q.payload.empty())
+            memcpy(positions.data(), q.payload.data(), q.payload.size());
+
+        // leave some room below the bounding box, so that the following frames still fit into this grid
+        int margin = gridMargin;
+        for (const uint16_t v : positions)
+            margin = std::min(margin, int(maxQuantizedValue) - v);
+        for (auto &v : positions)
+            v = uint16_t(v + margin);
+        origin = q.origin - cv::Point3f(1, 1, 1) * (margin * q.step), prevStep = q.step;
+        prevTriangles = triangles;
+
+        append(out, uint8_t(hasUv));
+        append(out, uint32_t(cloud.size()));
+        append(out, uint32_t(triangles.size()));
+        append(out, origin.x), append(out, origin.y), append(out, origin.z), append(out, prevStep);
+
+        encodeInterleavedDeltas(positions, 3, out);
+        encodeInterleavedDeltas(uvs, 2, out);
+
+        int32_t prevIdx = 0;
+        for (const auto &t : triangles)
+            for (const uint16_t idx : { t.p1, t.p2, t.p3 })
+            {
+                varintEncode(zigzagEncode(int32_t(idx) - prevIdx), out);
+                prevIdx = idx;
+            }
+    }
+
+    prevHasUv = hasUv;
+    prevPositions.swap(positions);
+    prevUv.swap(uvs);
+    return type;
+}
+
+void MeshSequenceDecoder::reset()
+{
+    hasPrevious = false;
+}
+
+bool MeshSequenceDecoder::decode(MeshFrameType type, const uint8_t *data, size_t size,
+                                 std::vector<cv::Point3f> &cloud, std::vector<Triangle> &triangles, std::vector<cv::Point2f> &uv)
+{
+    PayloadReader reader(data, size);
+    uint8_t frameHasUv;
+    uint32_t numPoints;
+    if (!reader.read(frameHasUv) || !reader.read(numPoints))
+        return false;
+
+    if (type == MeshFrameType::DELTA)
+    {
+        if (!hasPrevious || positions.size() != 3 * size_t(numPoints) || bool(frameHasUv) != hasUv)
+            return false;
+
+        for (auto *values : { &positions, &uvs })
+            for (auto &v : *values)
+            {
+                int32_t delta;
+                if (!reader.readDelta(delta))
+                    return false;
+                v = uint16_t(v + delta);
+            }
+    }
+    else
+    {
+        hasPrevious = false;
+        uint32_t numTriangles;
+        if (!reader.read(numTriangles) || !reader.read(origin.x) || !reader.read(origin.y) || !reader.read(origin.z) || !reader.read(step))
+            return false;
+
+        // every value takes at least one byte, protects from huge allocations on corrupted input
+        if (3 * (size_t(numPoints) + numTriangles) > size)
+            return false;
+
+        hasUv = frameHasUv != 0;
+        positions.resize(3 * size_t(numPoints));
+        uvs.resize(hasUv ? 2 * size_t(numPoints) : 0);
+        if (!decodeInterleavedDeltas(reader, 3, positions) || !decodeInterleavedDeltas(reader, 2, uvs))
+            return false;
+
+        prevTriangles.resize(numTriangles);
+        int32_t idx = 0;
+        for (auto &t : prevTriangles)
+            for (uint16_t *p : { &t.p1, &t.p2, &t.p3 })
+            {
+                int32_t delta;
+                if (!reader.readDelta(delta))
+                    return false;
+                idx += delta;
+                if (idx < 0 || uint32_t(idx) >= numPoints)
+                    return false;
+                *p = uint16_t(idx);
+            }
+    }
+
+    if (!reader.atEnd())
+        return false;
+
+    cloud.resize(numPoints);
+    dequantizePoints(positions.data(), numPoints, origin, step, cloud.data());
+    triangles = prevTriangles;
+    if (hasUv)
+        dequantizeUv(uvs, uv);
+    else
+        uv.clear();
+
+    hasPrevious = true;
+    return true;
+}
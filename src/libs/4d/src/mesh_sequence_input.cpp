@@ -0,0 +1,159 @@
+#include <algorithm>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <util/tiny_logger.hpp>
+
+#include <4d/mesh_sequence_input.hpp>
+
+
+MeshSequenceInput::MeshSequenceInput(const std::string &path, bool readColor)
+    : withColor(readColor)
+    , in(path, std::ios::binary)
+{
+}
+
+Status MeshSequenceInput::open()
+{
+    if (!in.is_open())
+        return Status::ERROR;
+
+    Field magic, metadata;
+    uint32_t version;
+    if (!binRead(magic, metadata) || magic != Field::MAGIC || metadata != Field::METADATA_SECTION || !readField(Field::VERSION, version))
+    {
+        TLOG(ERROR) << "Invalid mesh sequence header";
+        return Status::ERROR;
+    }
+
+    if (version != MESH_SEQUENCE_FORMAT_VERSION)
+    {
+        TLOG(ERROR) << "Unsupported mesh sequence version " << version;
+        return Status::ERROR;
+    }
+
+    const auto framesStart = in.tellg();
+
+    // offset of the seek table is stored in the last 8 bytes
+    in.seekg(-std::streamoff(sizeof(seekTableOffset)), std::ios::end);
+    uint32_t numEntries;
+    if (!binRead(seekTableOffset) || !in.seekg(std::streamoff(seekTableOffset)) || !readField(Field::SEEK_TABLE, numEntries))
+    {
+        TLOG(ERROR) << "Could not find the seek table, sequence is incomplete";
+        return Status::ERROR;
+    }
+
+    seekTable.resize(numEntries);
+    for (auto &entry : seekTable)
+        if (!binRead(entry.first, entry.second))
+            return Status::ERROR;
+
+    in.seekg(framesStart);
+    return Status::SUCCESS;
+}
+
+bool MeshSequenceInput::readBlock(std::vector<uint8_t> &block)
+{
+    uint32_t size;
+    if (!binRead(size) || uint64_t(in.tellg()) + size > seekTableOffset)
+        return false;
+
+    block.resize(size);
+    return bool(in.read((char *)block.data(), size));
+}
+
+Status MeshSequenceInput::decodeNextFrame(MeshFrame &frame)
+{
+    if (uint64_t(in.tellg()) >= seekTableOffset)
+    {
+        isFinished = true;
+        return Status::ERROR;
+    }
+
+    if (!frame.frame2D)
+        frame.frame2D = std::make_shared<Frame>();
+    Frame &frame2D = *frame.frame2D;
+    frame.indexedMode = true;
+
+    Field field, meshField;
+    int32_t frameNumber;
+    if (!binRead(field) || field != Field::FRAME_SECTION
+        || !readField(Field::FRAME_NUMBER, frameNumber) || !readField(Field::DEPTH_TIMESTAMP, frame2D.dTimestamp)
+        || !binRead(meshField) || (meshField != Field::MESH_INTRA && meshField != Field::MESH_DELTA) || !readBlock(payload))
+    {
+        TLOG(ERROR) << "Could not read mesh sequence frame";
+        return Status::ERROR;
+    }
+    frame2D.frameNumber = frameNumber;
+
+    const auto type = meshField == Field::MESH_INTRA ? MeshFrameType::INTRA : MeshFrameType::DELTA;
+    if (!decoder.decode(type, payload.data(), payload.size(), frame.cloud, frame.triangles, frame.uv))
+    {
+        TLOG(ERROR) << "Could not decode mesh of frame #" << frameNumber;
+        decoder.reset();
+        return Status::ERROR;
+    }
+
+    // texture is optional
+    frame2D.color = cv::Mat();
+    const auto pos = in.tellg();
+    if (uint64_t(pos) < seekTableOffset && binRead(field) && field == Field::TEXTURE_JPEG)
+    {
+        if (!readBlock(jpeg))
+            return Status::ERROR;
+        if (withColor)
+            frame2D.color = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+    }
+    else
+        in.seekg(pos);
+
+    frame2D.lastFrame = isFinished = uint64_t(in.tellg()) >= seekTableOffset;
+    return Status::SUCCESS;
+}
+
+Status MeshSequenceInput::readFrame(MeshFrame &frame)
+{
+    if (pendingFrame)
+    {
+        frame = *pendingFrame;
+        pendingFrame.reset();
+        return Status::SUCCESS;
+    }
+
+    return decodeNextFrame(frame);
+}
+
+Status MeshSequenceInput::seek(int frameNumber)
+{
+    if (seekTable.empty())
+        return Status::ERROR;
+
+    // last intra frame at or before the requested one
+    auto it = std::upper_bound(seekTable.begin(), seekTable.end(), frameNumber, [](int number, const std::pair<int32_t, uint64_t> &entry) { return number < entry.first; });
+    if (it != seekTable.begin())
+        --it;
+
+    in.clear();
+    in.seekg(std::streamoff(it->second));
+    decoder.reset();
+    isFinished = false;
+    pendingFrame.reset();
+
+    auto frame = std::make_shared<MeshFrame>();
+    while (true)
+    {
+        if (decodeNextFrame(*frame) != Status::SUCCESS)
+            return Status::ERROR;
+
+        if (frame->frame2D->frameNumber >= frameNumber)
+        {
+            pendingFrame = frame;
+            return Status::SUCCESS;
+        }
+    }
+}
+
+bool MeshSequenceInput::finished() const
+{
+    return isFinished && !pendingFrame;
+}
@@ -0,0 +1,132 @@
+#include <chrono>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <util/io_3d.hpp>
+#include <util/tiny_logger.hpp>
+
+#include <4d/params.hpp>
+#include <4d/mesh_sequence_writer.hpp>
+
+
+namespace
+{
+
+double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+
+MeshSequenceWriter::MeshSequenceWriter(const std::string &path, MeshFrameQueue &q, CancellationToken &cancellationToken)
+    : MeshFrameConsumer(q, cancellationToken)
+    , path(path)
+    , out(path, std::ios::binary)
+{
+    if (!out.is_open())
+    {
+        TLOG(ERROR) << "Could not open " << path << " for writing";
+        finished = true;
+        return;
+    }
+
+    binWrite(Field::MAGIC);
+    binWrite(Field::METADATA_SECTION);
+    binWrite(Field::VERSION, MESH_SEQUENCE_FORMAT_VERSION);
+}
+
+MeshSequenceWriter::~MeshSequenceWriter()
+{
+    TLOG(INFO);
+    finalize();
+}
+
+void MeshSequenceWriter::enablePlyComparison()
+{
+    comparePly = true;
+}
+
+void MeshSequenceWriter::process(std::shared_ptr<MeshFrame> &frame)
+{
+    if (finished)
+        return;
+
+    // same as AnimationWriter, stop when the dataset starts over
+    if (!frame->indexedMode || frame->frame2D->frameNumber < lastWrittenFrame)
+    {
+        finalize();
+        return;
+    }
+
+    frame = withFloatVertices(frame);
+
+    const Frame &frame2D = *frame->frame2D;
+    const uint64_t frameOffset = uint64_t(out.tellp());
+
+    auto start = std::chrono::steady_clock::now();
+    const MeshFrameType type = encoder.encode(frame->cloud, frame->triangles, frame->uv, payload);
+    meshEncodeSeconds += secondsSince(start);
+
+    if (type == MeshFrameType::INTRA)
+    {
+        seekTable.emplace_back(frame2D.frameNumber, frameOffset);
+        ++numIntraFrames;
+    }
+
+    binWrite(Field::FRAME_SECTION);
+    binWrite(Field::FRAME_NUMBER, int32_t(frame2D.frameNumber));
+    binWrite(Field::DEPTH_TIMESTAMP, frame2D.dTimestamp);
+    writeBlock(type == MeshFrameType::INTRA ? Field::MESH_INTRA : Field::MESH_DELTA, payload.data(), payload.size());
+    meshBytes += payload.size();
+
+    if (!frame2D.color.empty())
+    {
+        start = std::chrono::steady_clock::now();
+        const float textureScale = animationParams().textureScale;
+        cv::Mat texture;
+        cv::resize(frame2D.color, texture, cv::Size(), textureScale, textureScale, CV_INTER_CUBIC);
+        cv::imencode(".jpg", texture, jpeg);
+        textureEncodeSeconds += secondsSince(start);
+
+        writeBlock(Field::TEXTURE_JPEG, jpeg.data(), jpeg.size());
+        textureBytes += jpeg.size();
+    }
+
+    if (comparePly)
+    {
+        start = std::chrono::steady_clock::now();
+        serializeBinaryPly(plyBuffer, &frame->cloud, &frame->triangles, frame->uv.empty() ? nullptr : &frame->uv);
+        plySeconds += secondsSince(start);
+        plyBytes += plyBuffer.size();
+    }
+
+    lastWrittenFrame = frame2D.frameNumber;
+    ++numFrames;
+}
+
+void MeshSequenceWriter::finalize()
+{
+    if (finished)
+        return;
+    finished = true;
+
+    const uint64_t seekTableOffset = uint64_t(out.tellp());
+    binWrite(Field::SEEK_TABLE, uint32_t(seekTable.size()));
+    for (const auto &entry : seekTable)
+        binWrite(entry.first, entry.second);
+    binWrite(seekTableOffset);
+    out.close();
+
+    TLOG_IF(ERROR, !out) << "Error while writing " << path;
+    TLOG(INFO) << "Mesh sequence " << path << ": " << numFrames << " frames (" << numIntraFrames << " intra), meshes "
+               << meshBytes / 1024 << " KB in " << meshEncodeSeconds << " s, textures " << textureBytes / 1024 << " KB in " << textureEncodeSeconds << " s";
+
+    if (comparePly && plyBytes > 0 && meshBytes > 0)
+    {
+        TLOG(INFO) << "Compared to PLY: " << plyBytes / 1024 << " KB in " << plySeconds << " s, "
+                   << "meshes are " << double(plyBytes) / meshBytes << "x smaller, encoding took " << meshEncodeSeconds / std::max(plySeconds, 1e-9) << "x of the PLY time";
+    }
+}
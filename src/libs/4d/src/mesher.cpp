@@ -1,12 +1,15 @@
 #include <thread>
 
 #include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
 #include <util/tiny_profiler.hpp>
+#include <util/mesh_optimization.hpp>
 
 #include <4d/mesher.hpp>
 #include <4d/params.hpp>
 #include <4d/player.hpp>
 #include <4d/app_state.hpp>
+#include <4d/mesh_decimator.hpp>
 
 
 using namespace std::chrono_literals;
@@ -66,43 +69,84 @@ void Mesher::init()
     sensorManager.getColorParams(colorCam, colorFormat);
     sensorManager.getDepthParams(depthCam, depthFormat);
     calibration = sensorManager.getCalibration();
+    colorProjection = uvProjection(calibration, colorCam);
 
     scale = float(targetScreenWidth) / depthCam.w;
     TLOG(INFO) << "Scale input depth by a factor of: " << scale;
     depthCam.scale(scale);
 }
 
-void Mesher::fillPoints(const cv::Mat &depth, std::vector<PointIJ> &points, std::vector<cv::Point3f> &cloud) const
+void Mesher::enablePointsOnly()
 {
-    for (int i = 0; i < depth.rows; ++i)
+    pointsOnly = true;
+}
+
+void Mesher::fillPoints(const cv::Mat &depth)
+{
+    cols.resize(depth.cols);
+    valid.resize(depth.cols);
+    for (int j = 0; j < depth.cols; ++j)
+        cols[j] = short(scale * j);
+
+    // every row is projected right after the points kept so far and compacted in place
+    constexpr size_t maxPoints = std::numeric_limits<short>::max() - 10;
+    size_t n = 0;
+    for (int i = 0; i < depth.rows && n < maxPoints; ++i)
     {
         const short scaleI = short(scale * i);
-        for (int j = 0; j < depth.cols; ++j)
+        const size_t rowStart = n;
+        points.resize(rowStart + depth.cols, true);
+        float *x = points.x.data(), *y = points.y.data(), *z = points.z.data();
+        project2dPointsTo3d(scaleI, cols.data(), depth.ptr<uint16_t>(i), depth.cols, depthCam,
+                            x + rowStart, y + rowStart, z + rowStart, valid.data());
+
+        for (int j = 0; j < depth.cols && n < maxPoints; ++j)
         {
-            const uint16_t d = depth.at<uint16_t>(i, j);
-            if (d > 0 && points.size() < std::numeric_limits<short>::max() - 10)
+            if (valid[j])
             {
-                const short scaleJ = short(scale * j);
-                points.emplace_back(scaleI, scaleJ);
-                cloud.emplace_back(project2dPointTo3d(scaleI, scaleJ, d, depthCam));
+                x[n] = x[rowStart + j], y[n] = y[rowStart + j], z[n] = z[rowStart + j];
+                points.pixels[n] = PointIJ(scaleI, short(cols[j]));
+                ++n;
             }
         }
     }
+
+    points.resize(n, true);
 }
 
-void Mesher::fillPoints(const std::vector<cv::Point3f> &frameCloud, std::vector<PointIJ> &points, std::vector<cv::Point3f> &cloud) const
+void Mesher::fillPoints(const std::vector<cv::Point3f> &frameCloud)
 {
-    int iImg, jImg;
-    uint16_t d;
-    for (const auto &p : frameCloud)
-        if (project3dPointTo2d(p, depthCam, iImg, jImg, d))
-        {
-            points.emplace_back(iImg, jImg);
-            cloud.emplace_back(p);
-        }
+    const size_t numPoints = frameCloud.size();
+    iImg.resize(numPoints), jImg.resize(numPoints), valid.resize(numPoints);
+    project3dPointsTo2d(frameCloud.data(), numPoints, depthCam, iImg.data(), jImg.data(), nullptr, valid.data());
+
+    for (size_t k = 0; k < numPoints; ++k)
+        if (valid[k])
+            points.push_back(frameCloud[k], PointIJ(short(iImg[k]), short(jImg[k])));
+}
+
+void Mesher::fillUv(std::vector<cv::Point2f> &uv) const
+{
+    // generate uv coordinates by reprojecting 3D points onto color image plane, large clouds in parallel chunks
+    constexpr size_t chunkSize = 16 * 1024;
+    const size_t numPoints = points.size();
+    uv.resize(numPoints);
+
+    const int numChunks = int((numPoints + chunkSize - 1) / chunkSize);
+    auto projectChunk = [&](int chunk)
+    {
+        const size_t begin = chunk * chunkSize, end = std::min(begin + chunkSize, numPoints);
+        projectPointsToUv(points.x.data() + begin, points.y.data() + begin, points.z.data() + begin, end - begin,
+                          colorProjection, uv.data() + begin);
+    };
+
+    if (numChunks > 1)
+        threadPool().parallelFor(0, numChunks, projectChunk);
+    else if (numChunks == 1)
+        projectChunk(0);
 }
 
-void Mesher::fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &points)
+void Mesher::fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &pixels)
 {
     frame.triangles3D.resize(numTriangles);
     frame.trianglesUv.resize(numTriangles);
@@ -114,7 +158,7 @@ void Mesher::fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTri
     for (int i = 0; i < numTriangles; ++i)
     {
         const Triangle &t = triangles[i];
-        if (!skipFiltering && filterTriangle2D(points[t.p1], points[t.p2], points[t.p3]))
+        if (!skipFiltering && filterTriangle2D(pixels[t.p1], pixels[t.p2], pixels[t.p3]))
             continue;
 
         Triangle3D &t3d = frame.triangles3D[j];
@@ -142,27 +186,36 @@ void Mesher::fillDataArrayMode(MeshFrame &frame, Triangle *triangles, int numTri
     frame.num3DTriangles = j;
 }
 
-void Mesher::fillDataIndexedMode(MeshFrame &frame, Triangle *triangles, int numTriangles, const std::vector<PointIJ> &points)
+void Mesher::fillDataIndexedMode(MeshFrame &frame, Triangle *triangles, int numTriangles)
 {
     const bool needNormals = frame.frame2D->color.empty();
     frame.normals.resize(frame.cloud.size());
 
-    for (int i = 0; i < numTriangles; ++i)
+    keep.resize(numTriangles);
+    if (skipFiltering)
+        std::fill(keep.begin(), keep.end(), uint8_t(1));
+    else
     {
-        const Triangle &t = triangles[i];
-        if (!skipFiltering && filterTriangle2D(points[t.p1], points[t.p2], points[t.p3]))
-            continue;
+        const auto &params = mesherParams();
+        filterTriangles(triangles, numTriangles, points.pixels.data(), points.x.data(), points.y.data(), points.z.data(),
+                        params.triSideLengthThreshold2D, params.triSideLengthThreshold3D, params.zThreshold, keep.data());
+    }
 
-        const auto &p1 = frame.cloud[t.p1];
-        const auto &p2 = frame.cloud[t.p2];
-        const auto &p3 = frame.cloud[t.p3];
-        if (!skipFiltering && filterTriangle3D(p1, p2, p3))
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        if (!keep[i])
             continue;
 
+        const Triangle &t = triangles[i];
         frame.triangles.emplace_back(t);
 
         if (needNormals)
+        {
+            const auto &p1 = frame.cloud[t.p1];
+            const auto &p2 = frame.cloud[t.p2];
+            const auto &p3 = frame.cloud[t.p3];
             frame.normals[t.p1] = frame.normals[t.p2] = frame.normals[t.p3] = triNormal(p1, p2, p3);
+        }
     }
 }
 
@@ -174,59 +227,88 @@ void Mesher::process(std::shared_ptr<Frame> &frame2D)
 
     auto &cloud = meshFrame->cloud;
     auto &uv = meshFrame->uv;
-    std::vector<PointIJ> points;
 
+    points.clear();
     if (!frame2D->depth.empty())
-        fillPoints(frame2D->depth, points, cloud);
+        fillPoints(frame2D->depth);
     else
-        fillPoints(frame2D->cloud, points, cloud);
+        fillPoints(frame2D->cloud);
+
+    if (pointsOnly)
+    {
+        meshFrame->indexedMode = meshFrame->pointsOnly = true;
+        points.toAos(cloud);
+        if (!frame2D->color.empty())
+            fillUv(uv);
+
+        tprof().stopTimer("mesher_frame");
+        ++numProcessedFrames;
+        output.produce(meshFrame);
+        return;
+    }
 
     tprof().startTimer("triangulation");
-    std::vector<short> indexMap(points.size());
-    delaunay(points, indexMap);
+    indexMap.resize(points.size());
+    delaunay(points.pixels, indexMap);
     delaunay.generateTriangles();
 
     Triangle *triangles = nullptr;
     int numTriangles = 0;
     delaunay.getTriangles(triangles, numTriangles);
 
-    std::vector<cv::Point3f> sortedCloud(points.size());
-    for (size_t i = 0; i < sortedCloud.size(); ++i)
-        sortedCloud[i] = cloud[indexMap[i]];
-    cloud.swap(sortedCloud);
+    // pixels are sorted (and deduplicated) by the triangulation, bring the coordinates into the same order
+    points.reorderCoordinates(indexMap.data(), points.pixels.size());
+    points.toAos(cloud);
     tprof().stopTimer("triangulation");
 
-    // generate uv coordinates by reprojecting 3D points onto color image plane
     if (!frame2D->color.empty())
+        fillUv(uv);
+
+    tprof().startTimer("meshing");
+
+    meshFrame->indexedMode = true;
+    if (meshFrame->indexedMode)
     {
-        int iImg, jImg;
-        uint16_t d;
-        const cv::Point3f *translation = reinterpret_cast<cv::Point3f *>(calibration.tvec.data);
-        for (size_t i = 0; i < cloud.size(); ++i)
+        fillDataIndexedMode(*meshFrame, triangles, numTriangles);
+
+        if (mesherParams().optimizeVertexOrder)
         {
-            float u = 0, v = 0;
-            const cv::Point3f pointColorSpace = cloud[i] + *translation;
-            if (project3dPointTo2d(pointColorSpace, colorCam, iImg, jImg, d))
+            tprof().startTimer("vertex_order");
+            const bool logStats = numProcessedFrames % 100 == 0;
+            VertexCacheStats before;
+            if (logStats)
+                before = analyzeVertexCache(meshFrame->triangles, meshFrame->cloud.size());
+
+            optimizeVertexOrder(*meshFrame);
+
+            if (logStats)
             {
-                // u - horizontal texture coordinate, v - vertical
-                u = float(jImg) / colorCam.w;
-                v = float(iImg) / colorCam.h;
+                const VertexCacheStats after = analyzeVertexCache(meshFrame->triangles, meshFrame->cloud.size());
+                TLOG(INFO) << "Vertex cache ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr;
             }
-
-            uv.emplace_back(u, v);
+            tprof().stopTimer("vertex_order");
         }
-    }
 
-    tprof().startTimer("meshing");
+        if (mesherParams().numLods > 1)
+        {
+            tprof().startTimer("lods");
+            MeshDecimator::addLods(meshFrame, mesherParams().numLods, mesherParams().lodMaxError);
+            tprof().stopTimer("lods");
+        }
 
-    meshFrame->indexedMode = true;
-    if (meshFrame->indexedMode)
-        fillDataIndexedMode(*meshFrame, triangles, numTriangles, points);
+        if (mesherParams().compactVertices)
+        {
+            compactVertices(*meshFrame);
+            for (const auto &lod : meshFrame->lods)
+                compactVertices(*lod);
+        }
+    }
     else
-        fillDataArrayMode(*meshFrame, triangles, numTriangles, points);
+        fillDataArrayMode(*meshFrame, triangles, numTriangles, points.pixels);
 
     tprof().stopTimer("meshing");
     tprof().stopTimer("mesher_frame");
 
+    ++numProcessedFrames;
     output.produce(meshFrame);
 }
@@ -0,0 +1,309 @@
+#include <deque>
+#include <iomanip>
+
+#ifdef _MSC_VER
+    #pragma warning(push)
+    #pragma warning(disable: 4310)  // cast truncates constant value
+#endif
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#ifdef _MSC_VER
+    #pragma warning(pop)
+#endif
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
+#include <util/opengl_utils.hpp>
+#include <util/filesystem_utils.hpp>
+#include <util/async_file_writer.hpp>
+
+#include <4d/app_state.hpp>
+#include <4d/mesh_renderer.hpp>
+#include <4d/offscreen_renderer.hpp>
+
+
+using namespace std::chrono_literals;
+
+
+namespace
+{
+
+/// Frames in flight between glReadPixels and the CPU copy, the GPU is at most this many frames ahead.
+constexpr int numPixelBuffers = 3;
+
+constexpr int numSamples = 4;
+
+std::string frameFilename(int frameIdx)
+{
+    std::ostringstream s;
+    s << "frame_" << std::setw(8) << std::setfill('0') << frameIdx << ".png";
+    return s.str();
+}
+
+}
+
+
+struct OffscreenRenderer::OffscreenRendererImpl
+{
+    OffscreenRendererImpl(const std::string &outputPath, const Settings &settings)
+        : outputPath(outputPath)
+        , settings(settings)
+    {
+    }
+
+    ~OffscreenRendererImpl()
+    {
+        finish();
+
+        if (!context)
+            return;
+
+        // GL objects must be released while the context is still alive
+        renderer.reset();
+        glDeleteBuffers(numPixelBuffers, pixelBuffers);
+        glDeleteRenderbuffers(2, msaaRenderbuffers), glDeleteRenderbuffers(1, &resolveRenderbuffer);
+        glDeleteFramebuffers(1, &msaaFramebuffer), glDeleteFramebuffers(1, &resolveFramebuffer);
+        context.reset();
+    }
+
+    void init()
+    {
+        const SensorManager &sensorManager = appState().getSensorManager();
+        DepthDataFormat depthFormat;
+        sensorManager.getDepthParams(camera, depthFormat);
+        camera.scale(float(settings.width) / camera.w);
+        w = camera.w, h = camera.h;
+
+        initContext();
+        initFramebuffers();
+        renderer = std::make_unique<MeshRenderer>();
+
+        if (settings.rawOutput)
+        {
+            rawFile = fileWriter.open(pathJoin(outputPath, "frames.bgra"));
+            TLOG_IF(FATAL, rawFile == AsyncFileWriter::invalidHandle) << "Could not create output file in " << outputPath;
+            TLOG(INFO) << "Encode with: ffmpeg -f rawvideo -pix_fmt bgra -s " << w << "x" << h << " -framerate 30 -i frames.bgra out.mp4";
+        }
+
+        TLOG(INFO) << "Offscreen rendering " << w << "x" << h << " to " << outputPath;
+        started = std::chrono::steady_clock::now();
+    }
+
+    void initContext()
+    {
+        context = std::make_unique<OffscreenContext>();
+        TLOG_IF(FATAL, !context->isValid()) << "Could not create offscreen OpenGL context";
+    }
+
+    void initFramebuffers()
+    {
+        // multisampled framebuffer for rendering, resolved to the single sample one for readback
+        glGenRenderbuffers(2, msaaRenderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaRenderbuffers[0]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, numSamples, GL_RGBA8, w, h);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaRenderbuffers[1]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, numSamples, GL_DEPTH_COMPONENT24, w, h);
+
+        glGenFramebuffers(1, &msaaFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, msaaFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, msaaRenderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, msaaRenderbuffers[1]);
+        TLOG_IF(FATAL, glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) << "Multisampled framebuffer is incomplete";
+
+        glGenRenderbuffers(1, &resolveRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, resolveRenderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+
+        glGenFramebuffers(1, &resolveFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveRenderbuffer);
+        TLOG_IF(FATAL, glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) << "Resolve framebuffer is incomplete";
+
+        const size_t frameBytes = size_t(w) * h * 4;
+        glGenBuffers(numPixelBuffers, pixelBuffers);
+        for (GLuint pixelBuffer : pixelBuffers)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        glViewport(0, 0, w, h);
+    }
+
+    glm::mat4 cameraTransform(int frameIdx) const
+    {
+        const glm::mat4 projectionMatrix = projectionMatrixFromPinholeCamera(camera, 0.1f, 100.0f);
+        const glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+
+        const glm::vec3 center(modelCenter.x, modelCenter.y, modelCenter.z);
+        const glm::mat4 translateToOrigin = glm::translate(glm::mat4(1.0f), -center);
+        const glm::mat4 translateBack = glm::translate(glm::mat4(1.0f), center * glm::vec3(1.0f, 1.0f, settings.distanceScale));
+
+        glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(settings.pitchDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+        rotation = glm::rotate(rotation, glm::radians(settings.yawDegreesPerFrame * frameIdx), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        return projectionMatrix * viewMatrix * translateBack * rotation * translateToOrigin;
+    }
+
+    void render(const MeshFrame &frame)
+    {
+        renderer->setFrame(frame);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, msaaFramebuffer);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const glm::mat4 mvp = cameraTransform(numFrames);
+        renderer->draw(glm::value_ptr(mvp));
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        // readback is only queued here, the pixels are copied numPixelBuffers frames later when they are surely ready
+        const int slot = numFrames % numPixelBuffers;
+        if (numFrames >= numPixelBuffers)
+            finishReadback(numFrames - numPixelBuffers);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        glReadPixels(0, 0, w, h, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        ++numFrames;
+    }
+
+    void finishReadback(int frameIdx)
+    {
+        const int slot = frameIdx % numPixelBuffers;
+        GLenum status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+
+        const size_t rowBytes = size_t(w) * 4;
+        std::vector<char> pixels(rowBytes * h);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        const auto *mapped = static_cast<const char *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels.size(), GL_MAP_READ_BIT));
+        TLOG_IF(FATAL, !mapped) << "Could not map pixel buffer";
+
+        // OpenGL rows go bottom to top
+        for (int i = 0; i < h; ++i)
+            memcpy(pixels.data() + i * rowBytes, mapped + (h - 1 - i) * rowBytes, rowBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (settings.rawOutput)
+            fileWriter.append(rawFile, std::move(pixels));
+        else
+            encode(frameIdx, std::move(pixels));
+    }
+
+    void encode(int frameIdx, std::vector<char> &&pixels)
+    {
+        // don't let the encoding queue grow if the pool can't keep up
+        while (int(encodings.size()) >= 2 * threadPool().numThreads())
+            encodings.front().get(), encodings.pop_front();
+
+        auto sharedPixels = std::make_shared<std::vector<char>>(std::move(pixels));
+        const std::string filename = pathJoin(outputPath, frameFilename(frameIdx));
+        encodings.emplace_back(threadPool().submit([this, sharedPixels, filename]
+        {
+            const cv::Mat bgra(h, w, CV_8UC4, sharedPixels->data());
+            cv::Mat bgr;
+            cv::cvtColor(bgra, bgr, cv::COLOR_BGRA2BGR);
+
+            std::vector<uchar> png;
+            cv::imencode(".png", bgr, png);
+            fileWriter.writeFile(filename, std::vector<char>(png.begin(), png.end()));
+        }));
+    }
+
+    void finish()
+    {
+        if (finished)
+            return;
+        finished = true;
+
+        for (int frameIdx = std::max(numFrames - numPixelBuffers, 0); frameIdx < numFrames; ++frameIdx)
+            finishReadback(frameIdx);
+        for (auto &encoding : encodings)
+            encoding.get();
+        encodings.clear();
+
+        if (rawFile != AsyncFileWriter::invalidHandle)
+            fileWriter.close(rawFile);
+        TLOG_IF(ERROR, !fileWriter.flush()) << "Could not write some of the frames to " << outputPath;
+
+        const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+        TLOG(INFO) << "Rendered " << numFrames << " frames in " << seconds << " s, " << numFrames / seconds << " fps";
+    }
+
+    std::string outputPath;
+    Settings settings;
+
+    CameraParams camera;
+    int w = 0, h = 0;
+
+    bool meanPointCalculated = false;
+    cv::Point3f modelCenter;
+
+    std::unique_ptr<OffscreenContext> context;
+
+    std::unique_ptr<MeshRenderer> renderer;
+    GLuint msaaFramebuffer = 0, resolveFramebuffer = 0;
+    GLuint msaaRenderbuffers[2] = {}, resolveRenderbuffer = 0;
+    GLuint pixelBuffers[numPixelBuffers] = {};
+    GLsync fences[numPixelBuffers] = {};
+
+    int numFrames = 0;
+    bool finished = false;
+    std::chrono::steady_clock::time_point started;
+
+    std::deque<std::future<void>> encodings;
+    AsyncFileWriter::FileHandle rawFile = AsyncFileWriter::invalidHandle;
+    AsyncFileWriter fileWriter;
+};
+
+
+OffscreenRenderer::OffscreenRenderer(const std::string &outputPath, const Settings &settings, MeshFrameQueue &q, CancellationToken &cancellationToken)
+    : MeshFrameConsumer(q, cancellationToken)
+    , data(std::make_unique<OffscreenRendererImpl>(outputPath, settings))
+{
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+}
+
+void OffscreenRenderer::init()
+{
+    TLOG(INFO);
+    const SensorManager &sensorManager = appState().getSensorManager();
+    while (!cancel && !sensorManager.isInitialized())
+        std::this_thread::sleep_for(30ms);
+    data->init();
+}
+
+void OffscreenRenderer::run()
+{
+    MeshFrameConsumer::run();
+    data->finish();
+}
+
+int OffscreenRenderer::numRenderedFrames() const
+{
+    return data->numFrames;
+}
+
+void OffscreenRenderer::process(std::shared_ptr<MeshFrame> &item)
+{
+    if (!data->meanPointCalculated)
+        data->modelCenter = meanPoint(withFloatVertices(item)->cloud), data->meanPointCalculated = true;
+
+    data->render(*item);
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include <util/tiny_logger.hpp>
+
+#include <4d/mesher.hpp>
+#include <4d/depth_filter.hpp>
+#include <4d/parallel_mesher.hpp>
+
+
+namespace
+{
+
+constexpr int workerQueueSize = 4;
+
+/// Cached frame for the current pass: the mesh is shared, frame2D is the frame that just came in, so that
+/// the consumers see the current timestamps (e.g. creationTime for the latency) rather than the first pass.
+std::shared_ptr<MeshFrame> withFrame2D(const std::shared_ptr<MeshFrame> &cached, const std::shared_ptr<Frame> &frame)
+{
+    auto meshFrame = std::make_shared<MeshFrame>(*cached);
+    meshFrame->frame2D = frame;
+    for (auto &lod : meshFrame->lods)
+    {
+        lod = std::make_shared<MeshFrame>(*lod);
+        lod->frame2D = frame;
+    }
+    return meshFrame;
+}
+
+}
+
+
+struct ParallelMesher::Worker
+{
+    Worker()
+        : input(workerQueueSize)
+        , filtered(workerQueueSize)
+        , output(workerQueueSize)
+        , filteredProducer(producerCancel)
+        , meshProducer(producerCancel)
+        , filter(input, filteredProducer, filterCancel)
+        , mesher(filtered, meshProducer, mesherCancel)
+    {
+        filteredProducer.addQueue(&filtered);
+        meshProducer.addQueue(&output);
+    }
+
+    FrameQueue input, filtered;
+    MeshFrameQueue output;
+
+    // stages are stopped one by one, so that each of them can drain its queue; producers never drop frames
+    CancellationToken filterCancel, mesherCancel, producerCancel;
+    FrameProducer filteredProducer;
+    MeshFrameProducer meshProducer;
+
+    DepthFilter filter;
+    Mesher mesher;
+    std::thread filterThread, mesherThread;
+};
+
+
+ParallelMesher::ParallelMesher(FrameQueue &inputQueue, MeshFrameProducer &output, CancellationToken &cancellationToken, int numWorkers)
+    : FrameConsumer(inputQueue, cancellationToken)
+    , output(output)
+    , numDispatched(0)
+    , numCollected(0)
+{
+    if (numWorkers <= 0)
+        numWorkers = std::max(1, int(std::thread::hardware_concurrency()) / 2);
+
+    TLOG(INFO) << "Meshing workers: " << numWorkers;
+    for (int i = 0; i < numWorkers; ++i)
+        workers.emplace_back(new Worker);
+}
+
+ParallelMesher::~ParallelMesher()
+{
+}
+
+void ParallelMesher::init()
+{
+    // init() of the stages waits for the sensor manager, do it on the worker threads
+    for (auto &w : workers)
+    {
+        Worker *worker = w.get();
+        worker->filterThread = std::thread([worker] { worker->filter.init(); worker->filter.run(); });
+        worker->mesherThread = std::thread([worker] { worker->mesher.init(); worker->mesher.run(); });
+    }
+
+    collector = std::thread(&ParallelMesher::collect, this);
+}
+
+void ParallelMesher::run()
+{
+    FrameConsumer::run();
+
+    // input is drained, now stop the workers stage by stage
+    for (auto &w : workers)
+        w->filterCancel.trigger();
+    for (auto &w : workers)
+        w->filterThread.join();
+
+    for (auto &w : workers)
+        w->mesherCancel.trigger();
+    for (auto &w : workers)
+        w->mesherThread.join();
+
+    collectorCancel.trigger();
+    collector.join();
+
+    for (auto &w : workers)
+        w->producerCancel.trigger();
+
+    TLOG(INFO) << "Meshed total: " << numCollected << " frames";
+}
+
+void ParallelMesher::setCache(MeshFrameCache &frameCache, const std::string &dataset)
+{
+    cache = &frameCache;
+    cacheDataset = dataset;
+}
+
+void ParallelMesher::process(std::shared_ptr<Frame> &frame)
+{
+    std::shared_ptr<MeshFrame> cached;
+    if (cache)
+        cached = cache->get(cacheDataset, frame->frameNumber);
+
+    if (cached)
+    {
+        cached = withFrame2D(cached, frame);
+
+        // no worker queue limits the cached frames, don't get too far ahead of the output
+        const int maxInFlight = int(workers.size()) * workerQueueSize * 3;
+        while (!output.isCancelled() && numDispatched - numCollected >= maxInFlight)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    else
+    {
+        // like the producers, give up only when the output is stopped: the own token is triggered while
+        // the input is still being drained, and those frames must not be dropped
+        Worker &worker = *workers[numMeshDispatched % workers.size()];
+        while (!output.isCancelled() && !worker.input.put(frame, timeoutMs));
+        ++numMeshDispatched;
+    }
+
+    // nothing will be collected anymore, don't wait for the frame in the collector
+    if (output.isCancelled())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(dispatchMutex);
+        dispatchOrder.push_back(cached);
+    }
+    ++numDispatched;
+}
+
+void ParallelMesher::collect()
+{
+    // same order as in process(): cached frames, meshed frames from the workers round-robin
+    int numMeshCollected = 0;
+    while ((numCollected < numDispatched || !collectorCancel) && !output.isCancelled())
+    {
+        if (numCollected == numDispatched)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        std::shared_ptr<MeshFrame> meshFrame;
+        {
+            std::lock_guard<std::mutex> lock(dispatchMutex);
+            meshFrame = dispatchOrder.front();
+        }
+
+        if (!meshFrame)
+        {
+            if (!workers[numMeshCollected % workers.size()]->output.pop(meshFrame, timeoutMs))
+                continue;
+            ++numMeshCollected;
+
+            if (cache)
+                cache->put(cacheDataset, meshFrame->frame2D->frameNumber, meshFrame);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(dispatchMutex);
+            dispatchOrder.pop_front();
+        }
+        output.produce(meshFrame);
+        ++numCollected;
+
+        if (cache && meshFrame->frame2D->lastFrame)
+        {
+            const auto stats = cache->getStats();
+            TLOG(INFO) << "Mesh frame cache hit rate: " << int(100 * stats.hitRate()) << "%, " << stats.numFrames << " frames, "
+                       << stats.numBytes / (1 << 20) << " MB, evicted: " << stats.numEvicted;
+        }
+    }
+
+    // the output is stopped, the workers must not wait for the space in the queues nobody reads
+    if (output.isCancelled())
+        for (auto &w : workers)
+            w->producerCancel.trigger();
+}
@@ -1,3 +1,5 @@
+#include <util/hash.hpp>
+
 #include <4d/params.hpp>
 
 
@@ -15,6 +17,10 @@ Params::Params()
         p.triSideLengthThreshold2D = 16;
         p.triSideLengthThreshold3D = 0.08f;
         p.zThreshold = 0.05f;
+        p.optimizeVertexOrder = true;
+        p.numLods = 1;
+        p.lodMaxError = 0.02f;
+        p.compactVertices = false;
     }
 
     // filter params
@@ -32,6 +38,26 @@ Params::Params()
         auto &p = animP;
         p.textureScale = 0.5f;
         p.batchSize = 8;
+        p.dedupeMaxDistance = 0.002f;
+        p.dedupeMaxColorDifference = 8;
+    }
+
+    // player params
+    {
+        auto &p = playerP;
+        p.streamTextures = true;
+        p.uploadUvBoundedRect = true;
+        p.mipmapInterval = 8;
+        p.maxTriangles = 0;
+        p.pointSize = 3;
+    }
+
+    // decimation params
+    {
+        auto &p = decimationP;
+        p.playerTriangleBudget = 0;
+        p.writerTriangleBudget = 0;  // animation_writer_app --decimate
+        p.maxError = 0.005f;
     }
 
     constexpr bool needCustomParams = false;
@@ -39,6 +65,16 @@ Params::Params()
         SetCustomParams();
 }
 
+uint64_t Params::meshingParamsHash() const
+{
+    // hash field by field, structs may contain padding
+    Hasher h;
+    h.add(mesherP.triSideLengthThreshold2D).add(mesherP.triSideLengthThreshold3D).add(mesherP.zThreshold).add(mesherP.optimizeVertexOrder).add(mesherP.compactVertices);
+    h.add(mesherP.numLods).add(mesherP.lodMaxError);
+    h.add(filterP.minDepthMm).add(filterP.maxDepthMm).add(filterP.purgeRadius).add(filterP.curvatureThresholdMm).add(filterP.minDepthClusterAreaCoeff);
+    return h.value();
+}
+
 void Params::SetCustomParams()
 {
 }
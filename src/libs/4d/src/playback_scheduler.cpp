@@ -0,0 +1,129 @@
+#include <algorithm>
+
+#include <4d/playback_scheduler.hpp>
+
+
+constexpr double PlaybackScheduler::minSpeed, PlaybackScheduler::maxSpeed;
+constexpr int PlaybackScheduler::maxPrebufferMs;
+
+
+PlaybackScheduler::PlaybackScheduler(int jitterBufferSize)
+    : jitterBufferSize(std::max(jitterBufferSize, 1))
+{
+}
+
+bool PlaybackScheduler::canPush() const
+{
+    return int(buffer.size()) < jitterBufferSize;
+}
+
+bool PlaybackScheduler::empty() const
+{
+    return buffer.empty();
+}
+
+void PlaybackScheduler::push(const std::shared_ptr<MeshFrame> &frame, Clock::time_point now)
+{
+    if (!clockStarted && buffer.empty())
+        firstPushTime = now;
+
+    const int frameNumber = frame->frame2D->frameNumber;
+    buffer.push_back({ frame, frameNumber < lastPushedFrameNumber });
+    lastPushedFrameNumber = frameNumber;
+}
+
+std::shared_ptr<MeshFrame> PlaybackScheduler::frameToPresent(Clock::time_point now)
+{
+    if (buffer.empty())
+        return nullptr;
+
+    if (!clockStarted)
+    {
+        const bool prebufferTimeout = now - firstPushTime >= std::chrono::milliseconds(maxPrebufferMs);
+        if (int(buffer.size()) < jitterBufferSize && !prebufferTimeout)
+            return nullptr;
+        startClock(buffer.front().frame->frame2D->dTimestamp, now);
+    }
+
+    const int numBuffered = int(buffer.size());
+    std::shared_ptr<MeshFrame> due;
+    while (!buffer.empty())
+    {
+        Entry &entry = buffer.front();
+        if (entry.restart)
+        {
+            // frames of the previous pass go first, then the timeline starts over
+            if (due)
+                break;
+            startClock(entry.frame->frame2D->dTimestamp, now);
+            entry.restart = false;
+        }
+
+        if (entry.frame->frame2D->dTimestamp > playbackTimeUs(now))
+            break;
+
+        // only the newest of the frames due is presented
+        if (due)
+            ++stats.numDropped;
+        due = entry.frame;
+        buffer.pop_front();
+    }
+
+    if (!due)
+        return nullptr;
+
+    if (presentedAny)
+    {
+        const float intervalMs = std::chrono::duration<float, std::milli>(now - lastPresentTime).count();
+        sumIntervalsMs += intervalMs;
+        stats.maxIntervalMs = std::max(stats.maxIntervalMs, intervalMs);
+    }
+    presentedAny = true;
+    lastPresentTime = now;
+
+    sumBufferedFrames += numBuffered;
+    ++stats.numPresented;
+    return due;
+}
+
+void PlaybackScheduler::setSpeed(double newSpeed, Clock::time_point now)
+{
+    if (clockStarted)
+        startClock(playbackTimeUs(now), now);
+    speed = std::min(std::max(newSpeed, minSpeed), maxSpeed);
+}
+
+double PlaybackScheduler::getSpeed() const
+{
+    return speed;
+}
+
+PlaybackScheduler::Stats PlaybackScheduler::getStats() const
+{
+    Stats result = stats;
+    if (stats.numPresented > 1)
+        result.meanIntervalMs = float(sumIntervalsMs / (stats.numPresented - 1));
+    if (stats.numPresented > 0)
+        result.meanBufferedFrames = float(sumBufferedFrames / stats.numPresented);
+    return result;
+}
+
+void PlaybackScheduler::resetStats()
+{
+    stats = Stats();
+    sumIntervalsMs = sumBufferedFrames = 0;
+    presentedAny = false;
+}
+
+int64_t PlaybackScheduler::playbackTimeUs(Clock::time_point now) const
+{
+    const double elapsedUs = std::chrono::duration<double, std::micro>(now - anchorTime).count();
+    return anchorTimestampUs + int64_t(elapsedUs * speed);
+}
+
+void PlaybackScheduler::startClock(int64_t timestampUs, Clock::time_point now)
+{
+    clockStarted = true;
+    anchorTimestampUs = timestampUs;
+    anchorTime = now;
+}
@@ -13,7 +13,10 @@
 
 #include <tri/triangulation.hpp>
 
+#include <4d/params.hpp>
 #include <4d/player.hpp>
+#include <4d/mesh_renderer.hpp>
+#include <4d/playback_scheduler.hpp>
 #include <4d/app_state.hpp>
 
 
@@ -30,55 +33,6 @@ Player::PlayerImpl *activePlayer = nullptr;
 void glfwWindowKeyCallback(GLFWwindow *, int key, int scancode, int, int);
 void glfwScrollCallback(GLFWwindow *, double, double yScroll);
 
-// OpenGL stuff
-
-const char *vertexShader =
-"#version 330 core\n"
-"layout(location = 0) in vec3 vertexPosition_modelspace;"
-"layout(location = 1) in vec3 vertexNormal;"
-"layout(location = 2) in vec2 vertexUV;"
-""
-"uniform mat4 transform;"
-""
-"out vec3 v;"
-"out vec3 normal;"
-"out vec2 uv;"
-""
-"void main()"
-"{"
-"    gl_Position = transform * vec4(vertexPosition_modelspace, 1.0);"
-"    v = vertexPosition_modelspace;"
-"    normal = vertexNormal;"
-"    uv = vertexUV;"
-"}";
-
-const char *fragmentShader =
-"#version 330 core\n"
-"in vec3 v;"
-"in vec3 normal;"
-"in vec2 uv;"
-""
-"uniform sampler2D textureSampler;"
-"uniform bool withColor;"
-""
-"out vec3 color;"
-""
-"void main()"
-"{"
-"    vec3 lightPos = vec3(0, 0, 3);"
-"    vec3 lightDirection = normalize(lightPos - v);"
-"    vec3 finalColor;"
-"    if (withColor)"
-"    {"
-"        finalColor = texture(textureSampler, uv).rgb;"
-"    }"
-"    else"
-"    {"
-"        finalColor = vec3(0.3, 0.3, 0.3) + vec3(0.5, 0.5, 0.5) * max(float(dot(normal, lightDirection)), 0.0);"
-"    }"
-"    color = finalColor;"
-"}";
-
 }
 
 
@@ -94,6 +48,9 @@ public:
 
     ~PlayerImpl()
     {
+        // GL objects must be released while the context is still alive
+        renderer.reset();
+
         if (window)
             glfwDestroyWindow(window);
     }
@@ -134,33 +91,7 @@ public:
     {
         TLOG(INFO);
 
-        shaderLoader = std::make_shared<ShaderLoader>(vertexShader, fragmentShader, "4D");
-        program = shaderLoader->getProgram();
-
-        glGenVertexArrays(1, &vertexArrayID);
-        glBindVertexArray(vertexArrayID);
-
-        glGenBuffers(1, &vertexBuffer);
-        glGenBuffers(1, &normalBuffer);
-        glGenBuffers(1, &uvBuffer);
-        glGenBuffers(1, &indexBuffer);
-
-        transformUniformID = glGetUniformLocation(program, "transform");
-        withColorHandle = glGetUniformLocation(program, "withColor");
-
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        // should not actually be needed, just in case; default is GL_REPEAT
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // trilinear filtering
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-
-        glClearColor(0.0f, 0.0f, 0.0f, 1);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
+        renderer = std::make_unique<MeshRenderer>();
     }
 
     void onScroll(double scroll)
@@ -178,46 +109,71 @@ public:
     {
         auto &queue = parent.q;
 
-        if (!currentFrame)
-            queue.pop(currentFrame, 10);
+        // wait for the pipeline only when there is nothing to present, otherwise just take what's ready
+        std::shared_ptr<MeshFrame> frame;
+        while (scheduler.canPush() && queue.pop(frame, scheduler.empty() ? 10 : 0))
+            scheduler.push(frame, PlaybackScheduler::Clock::now());
 
-        if (currentFrame)
+        if (auto presented = scheduler.frameToPresent(PlaybackScheduler::Clock::now()))
         {
-            if (currentFrame->frame2D->frameNumber < lastPlayedFrame)
-            {
-                // beginning of dataset!
-                playbackStarted = std::chrono::system_clock::now();
-                firstFrameTimestamp = currentFrame->frame2D->dTimestamp;
-            }
+            frameToDraw = presented;
+            pointsOnly = presented->pointsOnly;
 
-            if (canPlayCurrentFrame())
-            {
-                lastPlayedFrame = currentFrame->frame2D->frameNumber;
-                frameToDraw = currentFrame;
-
-                if (!meanPointCalculated)
-                    modelCenter = meanPoint(currentFrame->cloud), meanPointCalculated = true;
+            // from entering the pipeline to the presentation, the swap adds about one more refresh interval
+            const auto latency = std::chrono::steady_clock::now() - presented->frame2D->creationTime;
+            const float latencyMs = std::chrono::duration<float, std::milli>(latency).count();
+            latencySumMs += latencyMs, maxLatencyMs = std::max(maxLatencyMs, latencyMs), ++numLatencySamples;
 
-                currentFrame.reset();
-            }
+            if (!meanPointCalculated)
+                modelCenter = meanPoint(withFloatVertices(frameToDraw)->cloud), meanPointCalculated = true;
         }
 
+        const auto drawStarted = std::chrono::steady_clock::now();
         draw();
+        logFrameTime(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - drawStarted).count());
 
         glfwSwapBuffers(window);
         glfwPollEvents();
         return !glfwWindowShouldClose(window);
     }
 
-    bool canPlayCurrentFrame()
+    /// Render thread time without the swap (which waits for vsync), averaged over a number of frames.
+    void logFrameTime(float ms)
     {
-        if (!currentFrame)
-            return false;
+        frameTimeSumMs += ms, maxFrameTimeMs = std::max(maxFrameTimeMs, ms);
+        if (++numTimedFrames < 300)
+            return;
+
+        TLOG(INFO) << "Render thread frame time avg: " << frameTimeSumMs / numTimedFrames << " ms, max: " << maxFrameTimeMs
+                   << " ms, textures " << (playerParams().streamTextures ? "streamed" : "respecified");
+        frameTimeSumMs = maxFrameTimeMs = 0, numTimedFrames = 0;
+
+        const auto stats = scheduler.getStats();
+        TLOG(INFO) << "Playback " << scheduler.getSpeed() << "x, presented: " << stats.numPresented << ", dropped: " << stats.numDropped
+                   << ", interval avg: " << stats.meanIntervalMs << " ms, max: " << stats.maxIntervalMs << " ms, buffered: " << stats.meanBufferedFrames;
+        scheduler.resetStats();
+
+        if (numLatencySamples)
+            TLOG(INFO) << "End-to-end latency (" << (pointsOnly ? "point preview" : "mesh") << ") avg: " << latencySumMs / numLatencySamples
+                       << " ms, max: " << maxLatencyMs << " ms";
+        latencySumMs = maxLatencyMs = 0, numLatencySamples = 0;
+    }
+
+    void onKey(int key)
+    {
+        // playback speed: +/- double or halve it, 0 goes back to the real time
+        double speed = scheduler.getSpeed();
+        if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD)
+            speed *= 2;
+        else if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT)
+            speed /= 2;
+        else if (key == GLFW_KEY_0 || key == GLFW_KEY_KP_0)
+            speed = 1;
+        else
+            return;
 
-        constexpr double speedup = 1;
-        const auto targetPlaybackTimeUs = double(currentFrame->frame2D->dTimestamp - firstFrameTimestamp) / speedup;
-        const auto passedTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - playbackStarted).count();
-        return passedTimeUs >= targetPlaybackTimeUs;
+        scheduler.setSpeed(speed, PlaybackScheduler::Clock::now());
+        TLOG(INFO) << "Playback speed " << scheduler.getSpeed() << "x";
     }
 
     void computeMatricesFromInputs()
@@ -292,107 +248,15 @@ public:
     {
         if (frameToDraw)
         {
-            indexedMode = frameToDraw->indexedMode;
-
-            auto &frame2D = frameToDraw->frame2D;
-            withColor = !frame2D->color.empty();
-            glBindVertexArray(vertexArrayID);
-
-            if (indexedMode)
-            {
-                numElements = GLsizei(frameToDraw->triangles.size());
-
-                glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-                glBufferData(GL_ARRAY_BUFFER, frameToDraw->cloud.size() * sizeof(cv::Point3f), frameToDraw->cloud.data(), GL_DYNAMIC_DRAW);
-                glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-                glBufferData(GL_ARRAY_BUFFER, frameToDraw->normals.size() * sizeof(cv::Point3f), frameToDraw->normals.data(), GL_DYNAMIC_DRAW);
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-                glBufferData(GL_ELEMENT_ARRAY_BUFFER, frameToDraw->triangles.size() * sizeof(Triangle), frameToDraw->triangles.data(), GL_DYNAMIC_DRAW);
-                if (withColor)
-                {
-                    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-                    glBufferData(GL_ARRAY_BUFFER, frameToDraw->uv.size() * sizeof(cv::Point2f), frameToDraw->uv.data(), GL_DYNAMIC_DRAW);
-                }
-            }
-            else
-            {
-                numElements = GLsizei(frameToDraw->num3DTriangles);
-
-                glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-                glBufferData(GL_ARRAY_BUFFER, numElements * sizeof(Triangle3D), frameToDraw->triangles3D.data(), GL_DYNAMIC_DRAW);
-                glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-                glBufferData(GL_ARRAY_BUFFER, numElements * sizeof(Triangle3D), frameToDraw->trianglesNormals.data(), GL_DYNAMIC_DRAW);
-                if (withColor)
-                {
-                    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-                    glBufferData(GL_ARRAY_BUFFER, numElements * sizeof(TriangleUV), frameToDraw->trianglesUv.data(), GL_DYNAMIC_DRAW);
-                }
-            }
-
-            glUniform1i(withColorHandle, withColor);
-            if (withColor)
-            {
-                // loading texture data to GPU
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame2D->color.cols, frame2D->color.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, frame2D->color.data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-            }
-
+            const int maxTriangles = playerParams().maxTriangles;
+            renderer->setFrame(maxTriangles > 0 ? *selectLod(frameToDraw, size_t(maxTriangles)) : *frameToDraw);
             frameToDraw.reset();
         }
 
         computeMatricesFromInputs();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glUseProgram(program);
-
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-        glVertexAttribPointer(
-            0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-        glVertexAttribPointer(
-            1,
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        if (withColor)
-        {
-            glEnableVertexAttribArray(2);
-            glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-            glVertexAttribPointer(
-                2,
-                2,                  // size (2 floats for uv)
-                GL_FLOAT,           // type
-                GL_FALSE,           // normalized?
-                0,                  // stride
-                (void*)0            // array buffer offset
-            );
-        }
-
-        if (indexedMode)
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-
-        glUniformMatrix4fv(transformUniformID, 1, GL_FALSE, glm::value_ptr(mvp));
-
-        if (indexedMode)
-            glDrawElements(GL_TRIANGLES, 3 * numElements, GL_UNSIGNED_SHORT, 0);
-        else
-            glDrawArrays(GL_TRIANGLES, 0, 3 * numElements);
-
-        glDisableVertexAttribArray(0);
+        renderer->draw(glm::value_ptr(mvp));
     }
 
 private:
@@ -408,13 +272,7 @@ private:
 
     // OpenGL stuff
 
-    std::shared_ptr<ShaderLoader> shaderLoader;
-    GLint program;
-    GLuint vertexArrayID;
-    GLuint vertexBuffer, normalBuffer, uvBuffer, indexBuffer;
-    GLint transformUniformID;
-    GLuint texture;
-    GLint withColorHandle;
+    std::unique_ptr<MeshRenderer> renderer;
 
     glm::mat4 scaleMatrix, rotation, translationMatrix;
     glm::mat4 mvp;
@@ -422,18 +280,17 @@ private:
     bool meanPointCalculated = false;
     cv::Point3f modelCenter;
 
-    bool indexedMode = false;
-    GLsizei numElements = 0;
-
     // player state
 
-    int lastPlayedFrame = std::numeric_limits<int>::max();
-    int64_t firstFrameTimestamp = 0;
-    std::chrono::time_point<std::chrono::system_clock> playbackStarted;
+    PlaybackScheduler scheduler;
+    std::shared_ptr<MeshFrame> frameToDraw;
 
-    std::shared_ptr<MeshFrame> currentFrame, frameToDraw;
+    float frameTimeSumMs = 0, maxFrameTimeMs = 0;
+    int numTimedFrames = 0;
 
-    bool withColor = false;
+    bool pointsOnly = false;
+    float latencySumMs = 0, maxLatencyMs = 0;
+    int numLatencySamples = 0;
 
     // camera and screen
 
@@ -447,9 +304,11 @@ namespace
 
 // GLFW callbacks (implementation)
 
-void glfwWindowKeyCallback(GLFWwindow *, int key, int scancode, int, int)
+void glfwWindowKeyCallback(GLFWwindow *, int key, int scancode, int action, int)
 {
     TLOG(INFO) << "Key " << key << " " << scancode << " pressed";
+    if (activePlayer && action == GLFW_PRESS)
+        activePlayer->onKey(key);
 }
 
 void glfwScrollCallback(GLFWwindow *, double, double yScroll)
@@ -473,6 +332,11 @@ Player::~Player()
     activePlayer = nullptr;
 }
 
+void Player::setJitterBufferSize(int numFrames)
+{
+    data->scheduler = PlaybackScheduler(numFrames);
+}
+
 void Player::init()
 {
     TLOG(INFO);
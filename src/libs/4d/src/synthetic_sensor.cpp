@@ -0,0 +1,182 @@
+#include <thread>
+
+#include <util/tiny_logger.hpp>
+
+#include <4d/app_state.hpp>
+#include <4d/synthetic_sensor.hpp>
+
+
+namespace
+{
+
+enum SceneObject
+{
+    NONE = -1,
+    WALL,
+    SPHERE,
+    BOX,
+};
+
+constexpr float pi = 3.14159265f;
+
+// scene, meters and seconds
+constexpr float wallDepth = 2.2f, wallTilt = 0.15f, checkerSize = 0.2f;
+constexpr float sphereRadius = 0.3f, sphereDepth = 1.5f, sphereOrbitX = 0.35f, sphereOrbitY = 0.2f, spherePeriod = 4;
+constexpr float boxDepth = 1.1f, boxHalfW = 0.15f, boxHalfH = 0.2f, boxY = 0.25f, boxSwing = 0.5f, boxPeriod = 6;
+
+cv::Point3f sphereCenter(float t)
+{
+    const float angle = 2 * pi * t / spherePeriod;
+    return { sphereOrbitX * std::cos(angle), sphereOrbitY * std::sin(angle), sphereDepth };
+}
+
+float boxX(float t)
+{
+    return boxSwing * std::sin(2 * pi * t / boxPeriod);
+}
+
+}
+
+
+SyntheticSensor::SyntheticSensor(const SyntheticSensorSettings &settings, const CancellationToken &cancellationToken)
+    : FrameProducer(cancellationToken)
+    , settings(settings)
+    , cam(0.9f * settings.width, 0.5f * (settings.width - 1), 0.5f * (settings.height - 1), settings.width, settings.height)
+    , rng(settings.seed)
+{
+}
+
+void SyntheticSensor::init()
+{
+    Calibration calibration;
+    calibration.rmat = cv::Mat::eye(3, 3, CV_32F);
+    calibration.tvec = cv::Mat::zeros(3, 1, CV_32F);
+
+    auto &sensorManager = appState().getSensorManager();
+    sensorManager.setColorParams(cam, ColorDataFormat::BGR);
+    sensorManager.setDepthParams(cam, DepthDataFormat::UNSIGNED_16BIT_MM);
+    sensorManager.setCalibration(calibration);
+    sensorManager.setInitialized();
+
+    TLOG(INFO) << "Synthetic sensor " << cam.w << "x" << cam.h << " at " << settings.fps << " fps"
+               << (settings.realTime ? "" : ", not paced");
+}
+
+float SyntheticSensor::castRay(int frameNumber, int i, int j, int &object) const
+{
+    // ray through the pixel with unit z, so the ray parameter is the depth
+    const float t = frameNumber / settings.fps;
+    const cv::Point3f ray((j - cam.cx) / cam.f, (i - cam.cy) / cam.f, 1);
+
+    object = NONE;
+    float depth = std::numeric_limits<float>::max();
+
+    const float wall = wallDepth / (1 - wallTilt * ray.x);
+    if (wall > 0)
+        depth = wall, object = WALL;
+
+    const cv::Point3f c = sphereCenter(t);
+    const float a = ray.dot(ray), b = -2 * ray.dot(c), cc = c.dot(c) - sphereRadius * sphereRadius;
+    const float discriminant = b * b - 4 * a * cc;
+    if (discriminant >= 0)
+    {
+        const float sphere = (-b - std::sqrt(discriminant)) / (2 * a);
+        if (sphere > 0 && sphere < depth)
+            depth = sphere, object = SPHERE;
+    }
+
+    if (boxDepth < depth && std::abs(ray.x * boxDepth - boxX(t)) < boxHalfW && std::abs(ray.y * boxDepth - boxY) < boxHalfH)
+        depth = boxDepth, object = BOX;
+
+    return object == NONE ? 0 : depth;
+}
+
+cv::Mat SyntheticSensor::groundTruthDepth(int frameNumber) const
+{
+    cv::Mat depth(cam.h, cam.w, CV_16UC1);
+    for (int i = 0; i < cam.h; ++i)
+    {
+        uint16_t *row = depth.ptr<uint16_t>(i);
+        for (int j = 0; j < cam.w; ++j)
+        {
+            int object;
+            row[j] = uint16_t(std::lround(castRay(frameNumber, i, j, object) * 1000));
+        }
+    }
+    return depth;
+}
+
+std::shared_ptr<Frame> SyntheticSensor::renderFrame(int frameNumber)
+{
+    auto frame = std::make_shared<Frame>();
+    frame->frameNumber = frameNumber;
+    frame->cTimestamp = frame->dTimestamp = int64_t(frameNumber * 1e6 / settings.fps);
+    frame->depth.create(cam.h, cam.w, CV_16UC1);
+    if (settings.withColor)
+        frame->color.create(cam.h, cam.w, CV_8UC3);
+
+    std::normal_distribution<float> noise(0, 1);
+    std::uniform_real_distribution<float> uniform(0, 1);
+    const cv::Point3f c = sphereCenter(frameNumber / settings.fps);
+
+    for (int i = 0; i < cam.h; ++i)
+    {
+        uint16_t *depthRow = frame->depth.ptr<uint16_t>(i);
+        uint8_t *colorRow = settings.withColor ? frame->color.ptr<uint8_t>(i) : nullptr;
+        for (int j = 0; j < cam.w; ++j)
+        {
+            int object;
+            const float z = castRay(frameNumber, i, j, object);
+
+            const float mm = z * 1000 + noise(rng) * settings.noiseMm * z * z;
+            const bool hole = object == NONE || uniform(rng) < settings.holeFraction;
+            depthRow[j] = hole ? 0 : uint16_t(std::min(std::max(std::lround(mm), 1L), 65535L));
+
+            if (!colorRow)
+                continue;
+
+            // BGR, the sphere is lit from the camera
+            const cv::Point3f p((j - cam.cx) / cam.f * z, (i - cam.cy) / cam.f * z, z);
+            cv::Vec3f bgr(0, 0, 0);
+            if (object == WALL)
+            {
+                const bool light = (int(std::floor(p.x / checkerSize)) + int(std::floor(p.y / checkerSize))) % 2 == 0;
+                bgr = light ? cv::Vec3f(200, 200, 200) : cv::Vec3f(80, 80, 80);
+            }
+            else if (object == SPHERE)
+            {
+                const cv::Point3f normal = (p - c) * (1 / sphereRadius);
+                const float shade = std::max(0.2f, float(-normal.dot(p) / cv::norm(p)));
+                bgr = cv::Vec3f(40, 40, 220) * shade;
+            }
+            else if (object == BOX)
+                bgr = cv::Vec3f(60, 180, 60);
+
+            for (int ch = 0; ch < 3; ++ch)
+                colorRow[3 * j + ch] = uint8_t(bgr[ch]);
+        }
+    }
+
+    return frame;
+}
+
+void SyntheticSensor::run()
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> framePeriod(1.0 / settings.fps);
+
+    for (int n = 0; n < settings.numFrames && !cancel; ++n)
+    {
+        std::shared_ptr<Frame> frame = renderFrame(n);
+        frame->lastFrame = n + 1 == settings.numFrames;
+
+        if (settings.realTime)
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(framePeriod * n));
+        frame->creationTime = std::chrono::steady_clock::now();
+
+        produce(frame);
+        ++numProduced;
+    }
+
+    TLOG(INFO) << "Synthetic sensor produced " << numProduced << " frames";
+}
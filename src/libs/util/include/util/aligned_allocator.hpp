@@ -0,0 +1,83 @@
+#pragma once
+
+#include <new>
+#include <utility>
+#include <vector>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+    #include <malloc.h>
+#endif
+
+
+/// Allocator for SIMD arrays: memory is aligned to the cache line, which is enough for the widest vector loads.
+/// Elements are default-initialized, so resizing an array of floats does not clear it, the kernels overwrite
+/// the data anyway.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+    {
+    }
+
+    T * allocate(size_t n)
+    {
+        void *p = nullptr;
+#if defined(_MSC_VER)
+        p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+        if (posix_memalign(&p, Alignment, n * sizeof(T)))
+            p = nullptr;
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t)
+    {
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    template <typename U>
+    void construct(U *p)
+    {
+        ::new (static_cast<void *>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&... args)
+    {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const
+    {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
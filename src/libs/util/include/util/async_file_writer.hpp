@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+/// Asynchronous file output, writers hand over whole buffers and continue with the next frame while
+/// files are created, written and closed in the background.
+/// On Linux with liburing (WITH_IO_URING) all operations are submitted to io_uring from a single thread,
+/// otherwise they are executed by a small pool of I/O threads with regular blocking calls.
+/// All methods are thread-safe.
+class AsyncFileWriter
+{
+    struct AsyncFileWriterImpl;
+
+public:
+    typedef int FileHandle;
+    static constexpr FileHandle invalidHandle = -1;
+
+    /// Callers are blocked when more than maxQueuedBytes are waiting to be written, this limits the memory usage
+    /// when the disk can't keep up.
+    explicit AsyncFileWriter(size_t maxQueuedBytes = 256 << 20);
+
+    /// Waits for all pending operations.
+    ~AsyncFileWriter();
+
+    /// True if io_uring backend is used.
+    bool usesIoUring() const;
+
+    /// Create (or truncate) the file, write the whole buffer and close it.
+    void writeFile(const std::string &filename, std::vector<char> &&data);
+
+    /// Files written incrementally, e.g. datasets: the file is created immediately, appends are written in order,
+    /// close() happens after all pending appends. Returns invalidHandle if the file could not be created.
+    FileHandle open(const std::string &filename);
+    void append(FileHandle file, std::vector<char> &&data);
+    void close(FileHandle file);
+
+    /// Wait until all queued operations are completed. Returns false if any of them failed since the last flush.
+    bool flush();
+
+    /// Statistics of completed operations, files are counted when closed.
+    uint64_t numBytesWritten() const;
+    int numFilesWritten() const;
+
+private:
+    AsyncFileWriter(const AsyncFileWriter &) = delete;
+    void operator=(const AsyncFileWriter &) = delete;
+
+private:
+    std::unique_ptr<AsyncFileWriterImpl> data;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <utility>
+
+
+/// Instruction set levels of the SIMD kernels, every level includes the lower ones.
+enum class CpuLevel
+{
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512,
+};
+
+constexpr int numCpuLevels = 4;
+
+/// Highest level supported by the CPU and the OS, detected once.
+CpuLevel detectedCpuLevel();
+
+/// Level used by the kernels: the detected one, lowered by the CPU_LEVEL_4DVIDEO environment variable
+/// (scalar, sse42, avx2 or avx512) or by setCpuLevelOverride. Levels above the detected one are ignored.
+CpuLevel cpuLevel();
+
+/// Force a level, e.g. to test all variants of the kernels on one machine. Not meant to be changed while kernels run.
+void setCpuLevelOverride(CpuLevel level);
+void resetCpuLevelOverride();
+
+const char * cpuLevelName(CpuLevel level);
+
+/// Variants of a kernel for the instruction set levels behind one function pointer. Levels without their own variant
+/// use the closest lower one, the scalar variant is required. The pointer is resolved on every call, which is
+/// negligible for kernels that process a batch of data.
+template <typename Function>
+class CpuDispatch
+{
+public:
+    constexpr CpuDispatch(Function scalar, Function sse42 = nullptr, Function avx2 = nullptr, Function avx512 = nullptr)
+        : variants{ scalar, sse42, avx2, avx512 }
+    {
+    }
+
+    Function get(CpuLevel level) const
+    {
+        for (int l = int(level); l > 0; --l)
+            if (variants[l])
+                return variants[l];
+        return variants[0];
+    }
+
+    Function get() const
+    {
+        return get(cpuLevel());
+    }
+
+    template <typename... Args>
+    void operator()(Args &&... args) const
+    {
+        get()(std::forward<Args>(args)...);
+    }
+
+private:
+    Function variants[numCpuLevels];
+};
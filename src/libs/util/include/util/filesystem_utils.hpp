@@ -42,3 +42,9 @@ size_t readAllBytes(std::ifstream &stream, std::vector<char> &buffer);
 
 /// Actually checks if file is accessible.
 bool fileExists(const std::string filename);
+
+/// Create a single directory (not recursive). Returns true if directory was created or already exists.
+bool createDirectory(const std::string &path);
+
+/// Remove an empty directory. Returns true if it was removed.
+bool removeDirectory(const std::string &path);
@@ -108,6 +108,69 @@ inline cv::Point3f project2dPointTo3d(int i, int j, uint16_t d, const CameraPara
     return { (j - cam.cx) * zDivF, (i - cam.cy) * zDivF, z };
 }
 
+/// Batched versions of the projections, results are the same as from the per-point functions above.
+/// Outputs are structure of arrays, valid[k] is 1 if point k projects, 0 otherwise. Other outputs of invalid points
+/// are unspecified. The kernels use the best SIMD variant for the CPU, see util/cpu_features.hpp.
+
+/// Pixels (i, j[k]) of one image row with depths depth[k] to 3D, valid[k] is 0 for zero depth.
+void project2dPointsTo3d(int i,
+                         const float *j,
+                         const uint16_t *depth,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         float *x,
+                         float *y,
+                         float *z,
+                         uint8_t *valid);
+
+/// Points to pixels of the camera image, any of iImg, jImg, depth can be null if not needed.
+void project3dPointsTo2d(const float *x,
+                         const float *y,
+                         const float *z,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         int *iImg,
+                         int *jImg,
+                         uint16_t *depth,
+                         uint8_t *valid);
+
+/// Same for the array of structures layout of the point clouds.
+void project3dPointsTo2d(const cv::Point3f *points,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         int *iImg,
+                         int *jImg,
+                         uint16_t *depth,
+                         uint8_t *valid);
+
+/// Rigid transform from the depth to the color camera and the color camera projection fused into one 3x4 matrix,
+/// rows are pre-divided by the image size, so the result is a texture coordinate.
+struct UvProjection
+{
+    float m[3][4];
+};
+
+/// Missing rotation means the cameras are aligned.
+UvProjection uvProjection(const Calibration &calibration, const CameraParams &colorCam);
+
+/// Sub-pixel texture coordinates in [0, 1] of the points, texel centers are at (j + 0.5) / w.
+/// Points behind the camera or outside of the image get (0, 0).
+void projectPointsToUv(const cv::Point3f *points, size_t numPoints, const UvProjection &projection, cv::Point2f *uv);
+void projectPointsToUv(const float *x, const float *y, const float *z, size_t numPoints, const UvProjection &projection, cv::Point2f *uv);
+
+/// Filter of the triangulated depth: keep[t] is 0 if triangle t has a side longer than maxSide2D in the image (pixels
+/// are the vertex pixels), a side longer than maxSide3D in space or a depth range larger than maxDepthRange.
+void filterTriangles(const Triangle *triangles,
+                     size_t numTriangles,
+                     const PointIJ *pixels,
+                     const float *x,
+                     const float *y,
+                     const float *z,
+                     float maxSide2D,
+                     float maxSide3D,
+                     float maxDepthRange,
+                     uint8_t *keep);
+
 FORCE_INLINE Orientation triOrientation(int x1, int y1, int x2, int y2, int x3, int y3)
 {
     const int val = (y2 - y1) * (x3 - x2) - (x2 - x1) * (y3 - y2);
@@ -189,3 +252,29 @@ inline cv::Point3d meanPoint(const std::vector<cv::Point3f> &points)
         mean += cv::Point3d(p);
     return mean * (1.0 / points.size());
 }
+
+/// Pixel rect of the image covered by texture coordinates in [0, 1], extended by a border for texture filtering.
+/// Returns the whole image if there are no coordinates.
+inline cv::Rect uvBoundingRect(const cv::Point2f *uv, size_t numPoints, const cv::Size &imageSize, int border = 2)
+{
+    const cv::Rect imageRect(cv::Point(0, 0), imageSize);
+    if (!numPoints)
+        return imageRect;
+
+    float minU = 1, minV = 1, maxU = 0, maxV = 0;
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        minU = std::min(minU, uv[i].x), maxU = std::max(maxU, uv[i].x);
+        minV = std::min(minV, uv[i].y), maxV = std::max(maxV, uv[i].y);
+    }
+
+    const cv::Point tl(int(std::floor(minU * imageSize.width)) - border, int(std::floor(minV * imageSize.height)) - border);
+    const cv::Point br(int(std::ceil(maxU * imageSize.width)) + border, int(std::ceil(maxV * imageSize.height)) + border);
+    const cv::Rect rect = cv::Rect(tl, br) & imageRect;
+    return rect.area() > 0 ? rect : imageRect;
+}
+
+inline cv::Rect uvBoundingRect(const std::vector<cv::Point2f> &uv, const cv::Size &imageSize, int border = 2)
+{
+    return uvBoundingRect(uv.data(), uv.size(), imageSize, border);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <type_traits>
+
+
+/// Incremental 64-bit FNV-1a hash. Not cryptographic, but fast and good enough for cache keys and deduplication.
+class Hasher
+{
+public:
+    Hasher & add(const void *data, size_t size)
+    {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (size_t i = 0; i < size; ++i)
+            h = (h ^ bytes[i]) * prime;
+        return *this;
+    }
+
+    template<typename T>
+    Hasher & add(const T &value)
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Only scalars can be hashed by value, padding bytes are undefined");
+        return add(&value, sizeof(value));
+    }
+
+    Hasher & add(const std::string &s)
+    {
+        return add(s.data(), s.size());
+    }
+
+    uint64_t value() const
+    {
+        return h;
+    }
+
+private:
+    static constexpr uint64_t offsetBasis = 0xcbf29ce484222325ULL, prime = 0x100000001b3ULL;
+    uint64_t h = offsetBasis;
+};
@@ -7,14 +7,45 @@
 #include <util/geometry.hpp>
 
 
-/// Read ply file. Return true on success.
+/// Read binary ply file (memory-mapped, any endianness and scalar types). Return true if all requested data was read.
+/// Faces are split into triangles. Texture coordinates are returned per vertex, per-face texcoord lists are converted.
+/// For zero-copy access to large files see PlyReader.
 bool loadBinaryPly(const std::string &filename,
                    std::vector<cv::Point3f> *vertices = nullptr,
-                   std::vector<cv::Vec3b> *vertexColors = nullptr);
+                   std::vector<cv::Vec3b> *vertexColors = nullptr,
+                   std::vector<Triangle> *triangles = nullptr,
+                   std::vector<cv::Point2f> *uv = nullptr);
+
+enum class PlyIndexType
+{
+    INT,
+    USHORT,
+    UINT,
+};
+
+struct PlyOptions
+{
+    /// Type of the face vertex indices. INT is what older tools expect, USHORT is enough for our meshes.
+    PlyIndexType indexType = PlyIndexType::INT;
+
+    /// Write texture coordinates as vertex properties (s, t) instead of per-face lists, 3x less uv data.
+    bool perVertexUv = false;
+};
 
 /// Save ply. Return true on success.
+/// Default options produce the legacy layout: int indices and per-face texcoord lists.
 bool saveBinaryPly(const std::string &filename,
                    const std::vector<cv::Point3f> *vertices = nullptr,
                    const std::vector<Triangle> *triangles = nullptr,
                    const std::vector<cv::Point2f> *uv = nullptr,
-                   const std::string *textureFilename = nullptr);
+                   const std::string *textureFilename = nullptr,
+                   const PlyOptions &options = PlyOptions());
+
+/// Serialize header and all data of the binary ply into the buffer (contents are replaced), see saveBinaryPly.
+/// Large face blocks are filled in parallel.
+void serializeBinaryPly(std::vector<char> &buffer,
+                        const std::vector<cv::Point3f> *vertices = nullptr,
+                        const std::vector<Triangle> *triangles = nullptr,
+                        const std::vector<cv::Point2f> *uv = nullptr,
+                        const std::string *textureFilename = nullptr,
+                        const PlyOptions &options = PlyOptions());
@@ -8,5 +8,25 @@
     #define FORCE_INLINE __forceinline
 #endif
 
+// x86 SIMD kernels are compiled for the instruction set in the function attribute and selected at runtime
+// (see util/cpu_features.hpp), MSVC allows the intrinsics without any flags
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define WITH_X86_SIMD 1
+#endif
+
+#if defined(__clang__)
+    #define TARGET_SSE42 __attribute__((target("sse4.2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+    #define TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__GNUG__)
+    #define TARGET_SSE42 __attribute__((target("sse4.2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+    // GCC enables FMA with AVX-512 and fuses separate multiplies and adds, the kernels must match the scalar code
+    #define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+    #define TARGET_SSE42
+    #define TARGET_AVX2
+    #define TARGET_AVX512
+#endif
 
 #define EPSILON 1e-5f
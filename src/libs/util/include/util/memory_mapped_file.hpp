@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+
+/// Read-only memory mapping of the whole file. Pages are loaded by the OS on demand, so "opening" even a huge file is cheap.
+class MemoryMappedFile
+{
+public:
+    MemoryMappedFile() = default;
+    explicit MemoryMappedFile(const std::string &filename);
+    ~MemoryMappedFile();
+
+    /// Returns false if file does not exist, is empty or cannot be mapped.
+    bool open(const std::string &filename);
+    void close();
+
+    bool isOpen() const { return ptr != nullptr; }
+    const char * data() const { return ptr; }
+    size_t size() const { return fileSize; }
+
+private:
+    MemoryMappedFile(const MemoryMappedFile &) = delete;
+    void operator=(const MemoryMappedFile &) = delete;
+
+private:
+    const char *ptr = nullptr;
+    size_t fileSize = 0;
+
+#if defined(_WIN32)
+    void *fileHandle = nullptr, *mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <util/geometry.hpp>
+
+
+/// Post-transform vertex cache efficiency of an index buffer, simulated on the CPU with a FIFO cache.
+struct VertexCacheStats
+{
+    /// Average cache miss ratio: transformed vertices per triangle, 3 is the worst, ~0.5 is the limit for large regular meshes.
+    float acmr = 0;
+
+    /// Average transformed to vertex ratio: transformed vertices per referenced vertex, 1 is optimal.
+    float atvr = 0;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<Triangle> &triangles, size_t numVertices, int cacheSize = 16);
+
+/// Reorder triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+/// Triangles are greedily emitted by the score of their vertices, which prefers vertices that are in the simulated
+/// LRU cache and vertices with few remaining triangles. Triangle winding is preserved.
+void optimizeVertexCache(std::vector<Triangle> &triangles, size_t numVertices, int cacheSize = 32);
+
+/// Renumber the vertices in the order of the first use by the triangles, so the vertex fetch is mostly sequential.
+/// Returns the number of used vertices, remap[oldIndex] is the new index or -1 for vertices not used by any triangle.
+size_t optimizeVertexFetch(std::vector<Triangle> &triangles, size_t numVertices, std::vector<int> &remap);
+
+/// Apply the remap from optimizeVertexFetch to a vertex attribute array, unused vertices are removed.
+template <typename T>
+void remapVertices(std::vector<T> &vertices, const std::vector<int> &remap, size_t numUsedVertices)
+{
+    if (vertices.empty())
+        return;
+
+    std::vector<T> remapped(numUsedVertices);
+    for (size_t i = 0; i < remap.size(); ++i)
+        if (remap[i] >= 0)
+            remapped[remap[i]] = vertices[i];
+    vertices.swap(remapped);
+}
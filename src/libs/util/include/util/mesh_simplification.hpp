@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include <util/geometry.hpp>
+
+
+struct SimplificationSettings
+{
+    /// Stop when the mesh has this many triangles or fewer.
+    size_t targetTriangles = 0;
+
+    /// Collapses that move the surface further than this distance are not done, even if the target is not reached.
+    /// Same units as the positions.
+    float maxError = 0.005f;
+};
+
+/// Quadric error metric simplification (Garland, Heckbert) with half-edge collapses: a vertex is merged into
+/// its neighbour, so the surviving vertices keep their exact attributes, e.g. uv and normals. Mesh boundaries are
+/// constrained by additional quadrics and boundary vertices only move along the boundary. Collapses that flip
+/// triangles or make the mesh non-manifold are rejected.
+/// Triangles are rewritten, returns the number of remaining vertices, remap[oldIndex] is the new index
+/// or -1 for removed vertices (see remapVertices in util/mesh_optimization.hpp).
+size_t simplifyMesh(const std::vector<cv::Point3f> &cloud,
+                    std::vector<Triangle> &triangles,
+                    const SimplificationSettings &settings,
+                    std::vector<int> &remap);
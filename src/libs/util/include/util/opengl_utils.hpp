@@ -1,14 +1,43 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <GL/glew.h>
 
 #include <GLFW/glfw3.h>
 
+#include <opencv2/core.hpp>
+
 #include <util/camera.hpp>
 
 
+/// Load the OpenGL entry points, the context must be current. Needed before the first GL call, ShaderLoader does it too.
+void initGlew();
+
+
+/// OpenGL 3.3 core context without a window, for rendering on servers and in tests (EGL, preferably the surfaceless
+/// Mesa platform which needs neither X nor a GPU). The context is current in the creating thread while the object
+/// lives, GL entry points are loaded. Rendering goes to the framebuffers of the caller.
+class OffscreenContext
+{
+public:
+    OffscreenContext();
+    ~OffscreenContext();
+
+    /// False if the context could not be created or the library is built without WITH_EGL, the error is logged.
+    bool isValid() const;
+
+private:
+    OffscreenContext(const OffscreenContext &) = delete;
+    void operator=(const OffscreenContext &) = delete;
+
+private:
+    // EGLDisplay and EGLContext, EGL headers are not needed by the users
+    void *display = nullptr, *context = nullptr;
+};
+
+
 class ShaderLoader
 {
 public:
@@ -25,4 +54,80 @@ private:
 };
 
 
+/// Buffer for data that changes every frame, e.g. meshes in the player.
+/// The buffer is split into a ring of regions (triple buffering by default), each upload goes to the next region,
+/// so the CPU writes new data while the GPU still reads the previous frames. Regions are protected by fences and
+/// reused only when the GPU is done with them.
+/// With GL 4.4 / ARB_buffer_storage the storage is mapped once (persistent coherent mapping) and uploads are plain
+/// memcpy. Otherwise (or with allowPersistent = false) the buffer is orphaned and filled with glBufferSubData.
+/// Capacity is fixed, it only grows when an upload does not fit into a region.
+class StreamingBuffer
+{
+public:
+    StreamingBuffer(GLenum target, size_t regionCapacity = 1 << 20, int numRegions = 3, bool allowPersistent = true);
+    ~StreamingBuffer();
+
+    /// Copy the data to the next region and return its offset in bytes, the buffer stays bound to the target.
+    size_t upload(const void *data, size_t size);
+
+    /// Call after the draw calls that read the last upload, the region is not overwritten until they complete.
+    void fence();
+
+    GLuint getBuffer() const;
+    bool isPersistent() const;
+
+private:
+    StreamingBuffer(const StreamingBuffer &) = delete;
+    void operator=(const StreamingBuffer &) = delete;
+
+    void allocate(size_t capacity);
+    void release();
+    void waitForRegion(int region);
+
+private:
+    GLenum target;
+    GLuint buffer = 0;
+    bool persistent = false;
+
+    size_t regionCapacity;
+    int numRegions, currentRegion = 0;
+    std::vector<GLsync> fences;
+    char *mapped = nullptr;
+};
+
+
+/// Texture updated every frame from BGR images, e.g. color frames in the player.
+/// Storage is allocated once (immutable with GL 4.2 / ARB_texture_storage) and reallocated only when the image size
+/// changes, pixels go through a ring of pixel buffer objects, so glTexSubImage2D does not stall on the client memory.
+/// Only the rect that is actually referenced by the mesh can be updated. Mipmaps are optional: with mipmapInterval > 0
+/// they are regenerated every mipmapInterval uploads, in between the lower levels show a slightly older frame.
+class TextureStreamer
+{
+public:
+    explicit TextureStreamer(int mipmapInterval = 0);
+    ~TextureStreamer();
+
+    /// Update the texture from 8-bit BGR image, empty rect means the whole image.
+    /// Leaves the texture bound to GL_TEXTURE_2D.
+    void upload(const cv::Mat &image, cv::Rect rect = cv::Rect());
+
+    GLuint getTexture() const;
+
+private:
+    TextureStreamer(const TextureStreamer &) = delete;
+    void operator=(const TextureStreamer &) = delete;
+
+    void allocate(const cv::Size &size);
+
+private:
+    GLuint texture = 0;
+    cv::Size size;
+
+    int mipmapInterval, numLevels = 1;
+    int64_t numUploads = 0;
+
+    StreamingBuffer pixelBuffer;
+};
+
+
 glm::mat4 projectionMatrixFromPinholeCamera(const CameraParams &camera, float near, float far);
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <util/memory_mapped_file.hpp>
+
+
+enum class PlyType : uint8_t
+{
+    INVALID,
+    CHAR,
+    UCHAR,
+    SHORT,
+    USHORT,
+    INT,
+    UINT,
+    FLOAT,
+    DOUBLE,
+};
+
+/// Accepts both the original names (char, uchar, ...) and the sized ones (int8, uint8, ..., float32, float64).
+PlyType plyTypeFromString(const std::string &type);
+size_t plyTypeSize(PlyType type);
+
+template<typename T> struct PlyTypeOf { static constexpr PlyType value = PlyType::INVALID; };
+template<> struct PlyTypeOf<int8_t> { static constexpr PlyType value = PlyType::CHAR; };
+template<> struct PlyTypeOf<uint8_t> { static constexpr PlyType value = PlyType::UCHAR; };
+template<> struct PlyTypeOf<int16_t> { static constexpr PlyType value = PlyType::SHORT; };
+template<> struct PlyTypeOf<uint16_t> { static constexpr PlyType value = PlyType::USHORT; };
+template<> struct PlyTypeOf<int32_t> { static constexpr PlyType value = PlyType::INT; };
+template<> struct PlyTypeOf<uint32_t> { static constexpr PlyType value = PlyType::UINT; };
+template<> struct PlyTypeOf<float> { static constexpr PlyType value = PlyType::FLOAT; };
+template<> struct PlyTypeOf<double> { static constexpr PlyType value = PlyType::DOUBLE; };
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type = PlyType::INVALID;
+
+    /// For list properties "type" is the type of the items.
+    bool isList = false;
+    PlyType countType = PlyType::INVALID;
+};
+
+struct PlyElement
+{
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    /// Byte offset of the element data from the beginning of the file.
+    size_t dataOffset = 0;
+
+    /// Elements without list properties, or where all lists have the same length, have records of the same size.
+    bool fixedSize = true;
+    size_t recordSize = 0;
+    std::vector<size_t> propertyOffsets;  // valid only for fixed size records
+
+    /// Offsets of the records from dataOffset, only for variable size records.
+    std::vector<size_t> recordOffsets;
+
+    int propertyIndex(const std::string &propertyName) const;
+};
+
+/// Read-only view of count items located stride bytes apart, either in the mapped file or in a separate buffer.
+template<typename T>
+class PlyView
+{
+public:
+    PlyView() = default;
+    PlyView(const char *data, size_t count, size_t stride)
+        : ptr(data)
+        , n(count)
+        , step(stride)
+    {
+    }
+
+    const T & operator[](size_t i) const { return *(const T *)(ptr + i * step); }
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    /// True if items are tightly packed, i.e. view can be used as a regular array.
+    bool contiguous() const { return step == sizeof(T); }
+    const T * data() const { return (const T *)ptr; }
+
+private:
+    const char *ptr = nullptr;
+    size_t n = 0, step = 0;
+};
+
+/// Binary ply reader (both little and big endian) on top of the memory-mapped file.
+/// Header is parsed and the element layout is determined on open(), the data itself is read lazily.
+class PlyReader
+{
+public:
+    bool open(const std::string &filename);
+
+    const std::vector<PlyElement> & elements() const { return elementList; }
+    const PlyElement * element(const std::string &name) const;
+
+    /// Text of "comment" lines of the header, e.g. "TextureFile 0000.jpg".
+    const std::vector<std::string> & comments() const { return commentList; }
+
+    /// Read consecutive scalar properties of an element (e.g. x,y,z) as items of type T, where T consists of
+    /// names.size() values of type ScalarT (e.g. T = cv::Point3f, ScalarT = float).
+    /// If property types match ScalarT, file is native-endian and data is aligned, the view points directly into
+    /// the mapped file (zero-copy). Otherwise values are converted into the storage and the view points there.
+    /// View is valid while both the reader and the storage are alive and unchanged.
+    template<typename T, typename ScalarT>
+    bool readProperties(const std::string &elementName, const std::vector<std::string> &names, PlyView<T> &view, std::vector<T> &storage)
+    {
+        static_assert(PlyTypeOf<ScalarT>::value != PlyType::INVALID, "Unsupported scalar type");
+        const char *src = nullptr;
+        size_t stride = 0;
+        if (!findProperties(elementName, names, sizeof(T), sizeof(ScalarT), PlyTypeOf<ScalarT>::value, src, stride))
+            return false;
+
+        const PlyElement &e = *element(elementName);
+        if (src)
+        {
+            view = PlyView<T>(src, e.count, stride);
+            return true;
+        }
+
+        storage.resize(e.count);
+        convertProperties(e, names, PlyTypeOf<ScalarT>::value, (char *)storage.data());
+        view = PlyView<T>((const char *)storage.data(), storage.size(), sizeof(T));
+        return true;
+    }
+
+    /// Read a list property of every record, items are converted to ScalarT and concatenated.
+    /// If lengths is not null it receives the length of every list.
+    template<typename ScalarT>
+    bool readList(const std::string &elementName, const std::string &propertyName, std::vector<ScalarT> &items, std::vector<uint32_t> *lengths = nullptr)
+    {
+        static_assert(PlyTypeOf<ScalarT>::value != PlyType::INVALID, "Unsupported scalar type");
+        size_t totalItems;
+        if (!countListItems(elementName, propertyName, totalItems))
+            return false;
+
+        items.resize(totalItems);
+        readListItems(elementName, propertyName, PlyTypeOf<ScalarT>::value, (char *)items.data(), lengths);
+        return true;
+    }
+
+private:
+    bool parseHeader();
+    bool computeLayout();
+
+    const char * recordPtr(const PlyElement &e, size_t i) const;
+
+    bool findProperties(const std::string &elementName, const std::vector<std::string> &names, size_t itemSize, size_t scalarSize, PlyType scalarType,
+                        const char *&zeroCopyPtr, size_t &stride) const;
+    void convertProperties(const PlyElement &e, const std::vector<std::string> &names, PlyType dstType, char *dst) const;
+
+    bool countListItems(const std::string &elementName, const std::string &propertyName, size_t &totalItems) const;
+    void readListItems(const std::string &elementName, const std::string &propertyName, PlyType dstType, char *dst, std::vector<uint32_t> *lengths) const;
+
+private:
+    MemoryMappedFile file;
+    bool bigEndian = false;
+    size_t headerSize = 0;
+    std::vector<PlyElement> elementList;
+    std::vector<std::string> commentList;
+};
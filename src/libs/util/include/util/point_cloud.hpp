@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <util/geometry.hpp>
+#include <util/aligned_allocator.hpp>
+
+
+/// Point cloud in the structure of arrays layout of the batched kernels (see util/geometry.hpp): coordinates in
+/// separate aligned arrays, optional pixel coordinates of the points in the depth image. Clearing and shrinking keep
+/// the capacity, a cloud reused across frames does not allocate once it has grown to the frame size.
+/// Frames passed between the pipeline stages keep std::vector<cv::Point3f>, use fromAos/toAos at the boundaries.
+class PointCloudSoA
+{
+public:
+    size_t size() const
+    {
+        return x.size();
+    }
+
+    bool empty() const
+    {
+        return x.empty();
+    }
+
+    /// Pixels are either missing or there is one per point.
+    bool hasPixels() const
+    {
+        return !pixels.empty();
+    }
+
+    void clear();
+
+    void reserve(size_t numPoints);
+
+    /// New coordinates are not initialized.
+    void resize(size_t numPoints, bool withPixels);
+
+    void push_back(const cv::Point3f &p);
+    void push_back(const cv::Point3f &p, const PointIJ &pixel);
+
+    cv::Point3f point(size_t k) const
+    {
+        return { x[k], y[k], z[k] };
+    }
+
+    /// Conversions from and to the array of structures, pixels are dropped.
+    void fromAos(const cv::Point3f *points, size_t numPoints);
+    void fromAos(const std::vector<cv::Point3f> &points);
+    void toAos(std::vector<cv::Point3f> &points) const;
+
+    /// Keeps numPoints coordinates, the new point k is the old point order[k]. Pixels are not touched: the triangulation
+    /// sorts them in place and returns the order (the index map), this brings the coordinates into the same order.
+    void reorderCoordinates(const short *order, size_t numPoints);
+
+public:
+    AlignedVector<float> x, y, z;
+    std::vector<PointIJ> pixels;
+
+private:
+    AlignedVector<float> scratch;
+};
@@ -31,6 +31,12 @@ public:
             while (!cancel && !queue->put(item, 100));
     }
 
+    /// Consumers downstream are stopped, the items put to the queues won't be read anymore.
+    bool isCancelled() const
+    {
+        return cancel;
+    }
+
 protected:
     /// Multiple queues used to pass frames to different consumers.
     std::vector<QueueType *> queues;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+
+/// Default quantization step, roughly the precision of the depth sensors we use (1 mm).
+constexpr float defaultQuantizationStep = 0.001f;
+
+enum class CloudEncoding : uint8_t
+{
+    /// Interleaved 16-bit x,y,z triplets in the original point order.
+    RAW = 0x00,
+
+    /// Points sorted in Morton order, per-coordinate deltas stored as zigzag varints.
+    MORTON_DELTA = 0x01,
+};
+
+/// Point cloud with 16-bit fixed-point coordinates relative to the per-frame origin:
+/// p = origin + step * q, where q is in [0, 65535].
+struct QuantizedCloud
+{
+    cv::Point3f origin;
+    float step = defaultQuantizationStep;
+    uint32_t numPoints = 0;
+    CloudEncoding encoding = CloudEncoding::RAW;
+    std::vector<uint8_t> payload;
+};
+
+
+/// Origin is the min corner of the bounding box. Step is increased if needed to fit the cloud extent into 16 bits.
+void quantizeCloud(const std::vector<cv::Point3f> &cloud, float step, CloudEncoding encoding, QuantizedCloud &q);
+
+/// Returns false if the payload is malformed.
+bool dequantizeCloud(const QuantizedCloud &q, std::vector<cv::Point3f> &cloud);
+
+/// Vectorized kernel: out[k] = origin + step * q[3k..3k+2], q points to interleaved x,y,z values.
+void dequantizePoints(const uint16_t *q, size_t numPoints, const cv::Point3f &origin, float step, cv::Point3f *out);
+
+/// Interleave bits of three 16-bit coordinates into a 48-bit Morton code.
+uint64_t mortonCode(uint16_t x, uint16_t y, uint16_t z);
+
+
+/// GPU-friendly vertex for the mesh frames, 12 bytes instead of 32 for float position, normal and uv.
+/// Position is quantized like the clouds above (p = origin + step * position), normal is octahedral-encoded
+/// into two signed bytes, uv is 16-bit normalized.
+struct CompactVertex
+{
+    uint16_t position[3];
+    int8_t normal[2];
+    uint16_t uv[2];
+};
+
+static_assert(sizeof(CompactVertex) == 12, "CompactVertex is uploaded to the GPU as is");
+
+/// Octahedral mapping of a unit vector to [-1, 1]^2 stored as signed bytes. Zero vector maps to (0, 0).
+void octEncode(const cv::Point3f &n, int8_t out[2]);
+cv::Point3f octDecode(const int8_t e[2]);
+
+/// Normals and uv can be empty (zero normal and uv are stored then), otherwise they have the size of the cloud.
+/// Origin and step are chosen like in quantizeCloud, but the step is not limited from below by a fixed precision:
+/// the whole 16-bit range spans the largest extent of the bounding box.
+void encodeCompactVertices(const std::vector<cv::Point3f> &cloud,
+                           const std::vector<cv::Point3f> &normals,
+                           const std::vector<cv::Point2f> &uv,
+                           std::vector<CompactVertex> &vertices,
+                           cv::Point3f &origin,
+                           float &step);
+
+/// Pointers can be null if the corresponding attribute is not needed.
+void decodeCompactVertices(const std::vector<CompactVertex> &vertices,
+                           const cv::Point3f &origin,
+                           float step,
+                           std::vector<cv::Point3f> *cloud,
+                           std::vector<cv::Point3f> *normals,
+                           std::vector<cv::Point2f> *uv);
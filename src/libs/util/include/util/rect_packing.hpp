@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+
+/// Shelf packing of rectangles into a strip of the given width: rectangles are placed left to right
+/// in the order of decreasing height, a new shelf is started when the current one is full.
+/// Simple and fast, wastes little space when the rectangles have similar heights (like crops of consecutive frames).
+/// Returns the height of the strip, positions[i] is the top-left corner of the i-th rectangle.
+/// Rectangles wider than the strip are not allowed.
+int packShelves(const std::vector<cv::Size> &sizes, int width, std::vector<cv::Point> &positions);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+
+/// Fixed-size pool of worker threads for short CPU-bound or I/O tasks.
+class ThreadPool
+{
+public:
+    /// By default use all hardware threads.
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    int numThreads() const { return int(workers.size()); }
+
+    /// Schedule task for execution, returned future can be used to wait for the result.
+    template<typename F>
+    auto submit(F &&f) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        newTaskCV.notify_one();
+        return result;
+    }
+
+    /// Call body(i) for every i in [begin, end) and block until done. Calling thread takes part in the work,
+    /// so it is safe to call this from within another pool task.
+    void parallelFor(int begin, int end, const std::function<void(int)> &body);
+
+private:
+    ThreadPool(const ThreadPool &) = delete;
+    void operator=(const ThreadPool &) = delete;
+
+    void workerLoop();
+
+private:
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable newTaskCV;
+    std::queue<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+};
+
+/// Shared pool for the library code, created on first use.
+ThreadPool & threadPool();
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <memory>
+#include <string>
 
 
+/// Timers are per thread, so the same key can be used by the same stage running on multiple threads.
 class TinyProfiler
 {
     /// Private implementation to hide some stl headers.
@@ -29,8 +30,7 @@ private:
     TinyProfiler(const TinyProfiler &) = delete;
     void operator=(const TinyProfiler &) = delete;
 
-private:
-    std::unique_ptr<TinyProfilerImpl> data;
+    static TinyProfilerImpl & threadData();
 };
 
 TinyProfiler & tprof();
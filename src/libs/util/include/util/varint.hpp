@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <util/macro.hpp>
+
+
+/// Map signed integers to unsigned so that values with small magnitude get small codes (0,-1,1,-2,... -> 0,1,2,3,...).
+FORCE_INLINE uint32_t zigzagEncode(int32_t v)
+{
+    return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+}
+
+FORCE_INLINE int32_t zigzagDecode(uint32_t v)
+{
+    return int32_t(v >> 1) ^ -int32_t(v & 1);
+}
+
+/// LEB128-style variable length encoding, 7 bits per byte.
+inline void varintEncode(uint32_t v, std::vector<uint8_t> &out)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+/// Returns pointer past the decoded value, or nullptr if the input ends prematurely.
+inline const uint8_t * varintDecode(const uint8_t *p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7)
+    {
+        const uint8_t byte = *p++;
+        v |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return p;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,573 @@
+#include <map>
+#include <deque>
+#include <mutex>
+#include <fstream>
+#include <functional>
+#include <condition_variable>
+
+#if defined(WITH_IO_URING)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <liburing.h>
+#endif
+
+#include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
+#include <util/async_file_writer.hpp>
+
+
+namespace
+{
+
+typedef AsyncFileWriter::FileHandle FileHandle;
+
+/// Called by the backend for every finished operation.
+typedef std::function<void(size_t bytes, bool ok, bool fileClosed)> CompletionCallback;
+
+constexpr int numIoThreads = 4;
+
+#if defined(WITH_IO_URING)
+
+constexpr unsigned ringSize = 256;
+
+/// All ring operations are done on a single thread, callers pass requests through the queue and wake it up
+/// via eventfd, which is read through the ring as well. Whole files go through openat -> write -> close,
+/// appends to the stream files are written at precomputed offsets and can complete in any order.
+class IoUringBackend
+{
+    struct Op
+    {
+        enum Type { WRITE_FILE, REGISTER_STREAM, APPEND, CLOSE_STREAM, WAKEUP } type;
+        enum Stage { OPENING, WRITING, CLOSING } stage = OPENING;
+
+        std::string filename;
+        std::vector<char> data;
+        size_t written = 0;
+        uint64_t offset = 0;
+        int fd = -1;
+        FileHandle handle = AsyncFileWriter::invalidHandle;
+        bool ok = true;
+    };
+
+    struct Stream
+    {
+        int fd = -1;
+        uint64_t offset = 0;
+        int numAppends = 0;  // in flight
+        Op *closeOp = nullptr;  // close requested while appends were in flight
+    };
+
+public:
+    explicit IoUringBackend(const CompletionCallback &onComplete)
+        : onComplete(onComplete)
+    {
+        wakeupOp.type = Op::WAKEUP;
+    }
+
+    ~IoUringBackend()
+    {
+        if (!initialized)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wakeup();
+        thread.join();
+
+        io_uring_queue_exit(&ring);
+        ::close(eventFd);
+    }
+
+    /// False if io_uring or the required operations are not supported by the kernel.
+    bool init()
+    {
+        if (io_uring_queue_init(ringSize, &ring, 0) < 0)
+            return false;
+
+        io_uring_probe *probe = io_uring_get_probe_ring(&ring);
+        const bool supported = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) && io_uring_opcode_supported(probe, IORING_OP_WRITE)
+                            && io_uring_opcode_supported(probe, IORING_OP_CLOSE) && io_uring_opcode_supported(probe, IORING_OP_READ);
+        if (probe)
+            io_uring_free_probe(probe);
+
+        eventFd = supported ? eventfd(0, EFD_CLOEXEC) : -1;
+        if (eventFd < 0)
+        {
+            io_uring_queue_exit(&ring);
+            return false;
+        }
+
+        initialized = true;
+        thread = std::thread(&IoUringBackend::loop, this);
+        return true;
+    }
+
+    void writeFile(const std::string &filename, std::vector<char> &&data)
+    {
+        std::unique_ptr<Op> op(new Op);
+        op->type = Op::WRITE_FILE;
+        op->filename = filename;
+        op->data = std::move(data);
+        enqueue(std::move(op));
+    }
+
+    FileHandle open(const std::string &filename, FileHandle handle)
+    {
+        // creating a single file synchronously is fine, streams are opened once per dataset
+        const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return AsyncFileWriter::invalidHandle;
+
+        std::unique_ptr<Op> op(new Op);
+        op->type = Op::REGISTER_STREAM;
+        op->fd = fd;
+        op->handle = handle;
+        enqueue(std::move(op));
+        return handle;
+    }
+
+    void append(FileHandle handle, std::vector<char> &&data)
+    {
+        std::unique_ptr<Op> op(new Op);
+        op->type = Op::APPEND;
+        op->handle = handle;
+        op->data = std::move(data);
+        enqueue(std::move(op));
+    }
+
+    void close(FileHandle handle)
+    {
+        std::unique_ptr<Op> op(new Op);
+        op->type = Op::CLOSE_STREAM;
+        op->handle = handle;
+        enqueue(std::move(op));
+    }
+
+private:
+    void enqueue(std::unique_ptr<Op> op)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.emplace_back(std::move(op));
+        }
+        wakeup();
+    }
+
+    void wakeup()
+    {
+        const uint64_t one = 1;
+        const ssize_t res = ::write(eventFd, &one, sizeof(one));
+        (void)res;  // can only fail if the counter overflows, then the ring thread is awake anyway
+    }
+
+    io_uring_sqe * getSqe()
+    {
+        io_uring_sqe *sqe;
+        while (!(sqe = io_uring_get_sqe(&ring)))
+            io_uring_submit(&ring);
+        return sqe;
+    }
+
+    void prepWakeupRead()
+    {
+        io_uring_sqe *sqe = getSqe();
+        io_uring_prep_read(sqe, eventFd, &eventValue, sizeof(eventValue), 0);
+        io_uring_sqe_set_data(sqe, &wakeupOp);
+    }
+
+    void prepOpen(Op *op)
+    {
+        op->stage = Op::OPENING;
+        io_uring_sqe *sqe = getSqe();
+        io_uring_prep_openat(sqe, AT_FDCWD, op->filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        io_uring_sqe_set_data(sqe, op);
+        ++numInFlight;
+    }
+
+    void prepWrite(Op *op)
+    {
+        op->stage = Op::WRITING;
+        io_uring_sqe *sqe = getSqe();
+        io_uring_prep_write(sqe, op->fd, op->data.data() + op->written, unsigned(op->data.size() - op->written), op->offset + op->written);
+        io_uring_sqe_set_data(sqe, op);
+        ++numInFlight;
+    }
+
+    void prepClose(Op *op)
+    {
+        op->stage = Op::CLOSING;
+        io_uring_sqe *sqe = getSqe();
+        io_uring_prep_close(sqe, op->fd);
+        io_uring_sqe_set_data(sqe, op);
+        ++numInFlight;
+    }
+
+    void start(Op *op)
+    {
+        switch (op->type)
+        {
+        case Op::WRITE_FILE:
+            prepOpen(op);
+            break;
+        case Op::REGISTER_STREAM:
+            streams[op->handle].fd = op->fd;
+            delete op;
+            break;
+        case Op::APPEND:
+        {
+            Stream &s = streams[op->handle];
+            op->fd = s.fd;
+            op->offset = s.offset;
+            s.offset += op->data.size();
+            ++s.numAppends;
+            prepWrite(op);
+            break;
+        }
+        case Op::CLOSE_STREAM:
+        {
+            Stream &s = streams[op->handle];
+            op->fd = s.fd;
+            if (s.numAppends > 0)
+                s.closeOp = op;
+            else
+                prepClose(op);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void complete(Op *op, int res)
+    {
+        --numInFlight;
+        switch (op->stage)
+        {
+        case Op::OPENING:
+            if (res < 0)
+            {
+                TLOG(ERROR) << "Could not create " << op->filename << ", error " << -res;
+                onComplete(op->data.size(), false, false);
+                delete op;
+                return;
+            }
+            op->fd = res;
+            prepWrite(op);
+            return;
+
+        case Op::WRITING:
+            if (res > 0 && op->written + res < op->data.size())
+            {
+                op->written += res;
+                prepWrite(op);  // short write, continue with the rest
+                return;
+            }
+
+            op->ok = res >= 0 && op->written + res == op->data.size();
+            TLOG_IF(ERROR, !op->ok) << "Could not write " << (op->type == Op::APPEND ? "stream" : op->filename) << ", result " << res;
+            if (op->type == Op::WRITE_FILE)
+            {
+                prepClose(op);
+                return;
+            }
+
+            {
+                Stream &s = streams[op->handle];
+                --s.numAppends;
+                onComplete(op->data.size(), op->ok, false);
+                if (s.numAppends == 0 && s.closeOp)
+                {
+                    prepClose(s.closeOp);
+                    s.closeOp = nullptr;
+                }
+            }
+            delete op;
+            return;
+
+        case Op::CLOSING:
+            op->ok = op->ok && res >= 0;
+            if (op->type == Op::CLOSE_STREAM)
+                streams.erase(op->handle);
+            onComplete(op->type == Op::WRITE_FILE ? op->data.size() : 0, op->ok, true);
+            delete op;
+            return;
+        }
+    }
+
+    void loop()
+    {
+        prepWakeupRead();
+        io_uring_submit(&ring);
+
+        bool stopping = false;
+        while (!stopping || numInFlight > 0)
+        {
+            io_uring_cqe *cqe;
+            const int res = io_uring_wait_cqe(&ring, &cqe);
+            if (res < 0)
+            {
+                TLOG_IF(ERROR, res != -EINTR) << "io_uring_wait_cqe failed, error " << -res;
+                continue;
+            }
+
+            Op *op = (Op *)io_uring_cqe_get_data(cqe);
+            const int opResult = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+
+            if (op == &wakeupOp)
+            {
+                std::deque<std::unique_ptr<Op>> requests;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    requests.swap(incoming);
+                    stopping = stop;
+                }
+
+                for (auto &request : requests)
+                    start(request.release());
+
+                if (!stopping)
+                    prepWakeupRead();
+            }
+            else
+                complete(op, opResult);
+
+            io_uring_submit(&ring);
+        }
+    }
+
+private:
+    CompletionCallback onComplete;
+
+    bool initialized = false;
+    io_uring ring;
+    int eventFd = -1;
+    uint64_t eventValue = 0;
+    Op wakeupOp;
+
+    std::mutex mutex;
+    std::deque<std::unique_ptr<Op>> incoming;
+    bool stop = false;
+
+    // accessed only by the ring thread
+    std::map<FileHandle, Stream> streams;
+    int numInFlight = 0;
+
+    std::thread thread;
+};
+
+#else
+
+/// Not compiled in, the thread pool backend is used.
+class IoUringBackend
+{
+public:
+    explicit IoUringBackend(const CompletionCallback &) {}
+    bool init() { return false; }
+    void writeFile(const std::string &, std::vector<char> &&) {}
+    FileHandle open(const std::string &, FileHandle) { return AsyncFileWriter::invalidHandle; }
+    void append(FileHandle, std::vector<char> &&) {}
+    void close(FileHandle) {}
+};
+
+#endif
+
+}
+
+
+struct AsyncFileWriter::AsyncFileWriterImpl
+{
+    explicit AsyncFileWriterImpl(size_t maxQueuedBytes)
+        : maxQueuedBytes(maxQueuedBytes)
+    {
+        ioUring.reset(new IoUringBackend([this](size_t bytes, bool ok, bool fileClosed) { endOperation(bytes, ok, fileClosed); }));
+        if (!ioUring->init())
+        {
+            ioUring.reset();
+            filePool.reset(new ThreadPool(numIoThreads));
+            streamPool.reset(new ThreadPool(1));
+        }
+    }
+
+    /// Blocks while too much data is queued.
+    void beginOperation(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return queuedBytes == 0 || queuedBytes + bytes <= maxQueuedBytes; });
+        queuedBytes += bytes;
+        ++numPending;
+    }
+
+    void endOperation(size_t bytes, bool ok, bool fileClosed)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedBytes -= bytes;
+        --numPending;
+        failed = failed || !ok;
+        if (ok)
+            bytesWritten += bytes, filesWritten += fileClosed ? 1 : 0;
+        cv.notify_all();
+    }
+
+    size_t maxQueuedBytes;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t queuedBytes = 0;
+    int numPending = 0;
+    bool failed = false;
+    uint64_t bytesWritten = 0;
+    int filesWritten = 0;
+    FileHandle nextHandle = 0;
+
+    std::unique_ptr<IoUringBackend> ioUring;
+
+    // thread pool backend: single thread for the streams keeps appends in order
+    std::unique_ptr<ThreadPool> filePool, streamPool;
+    std::map<FileHandle, std::shared_ptr<std::ofstream>> streams;  // guarded by mutex
+};
+
+
+constexpr AsyncFileWriter::FileHandle AsyncFileWriter::invalidHandle;
+
+AsyncFileWriter::AsyncFileWriter(size_t maxQueuedBytes)
+    : data(new AsyncFileWriterImpl(maxQueuedBytes))
+{
+    TLOG(INFO) << "Async file output: " << (usesIoUring() ? "io_uring" : "I/O threads");
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    flush();
+}
+
+bool AsyncFileWriter::usesIoUring() const
+{
+    return bool(data->ioUring);
+}
+
+void AsyncFileWriter::writeFile(const std::string &filename, std::vector<char> &&buffer)
+{
+    const size_t size = buffer.size();
+    data->beginOperation(size);
+
+    if (data->ioUring)
+    {
+        data->ioUring->writeFile(filename, std::move(buffer));
+        return;
+    }
+
+    auto d = data.get();
+    auto sharedBuffer = std::make_shared<std::vector<char>>(std::move(buffer));
+    d->filePool->submit([d, filename, sharedBuffer, size]
+    {
+        std::ofstream out(filename, std::ios::binary);
+        out.write(sharedBuffer->data(), size);
+        out.close();
+        const bool ok = bool(out);
+        TLOG_IF(ERROR, !ok) << "Could not write " << filename;
+        d->endOperation(size, ok, true);
+    });
+}
+
+AsyncFileWriter::FileHandle AsyncFileWriter::open(const std::string &filename)
+{
+    FileHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        handle = data->nextHandle++;
+    }
+
+    if (data->ioUring)
+        return data->ioUring->open(filename, handle);
+
+    auto stream = std::make_shared<std::ofstream>(filename, std::ios::binary);
+    if (!stream->is_open())
+        return invalidHandle;
+
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->streams[handle] = stream;
+    return handle;
+}
+
+void AsyncFileWriter::append(FileHandle file, std::vector<char> &&buffer)
+{
+    if (file == invalidHandle)
+        return;
+
+    const size_t size = buffer.size();
+    data->beginOperation(size);
+
+    if (data->ioUring)
+    {
+        data->ioUring->append(file, std::move(buffer));
+        return;
+    }
+
+    auto d = data.get();
+    std::shared_ptr<std::ofstream> stream;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        stream = d->streams[file];
+    }
+
+    auto sharedBuffer = std::make_shared<std::vector<char>>(std::move(buffer));
+    d->streamPool->submit([d, stream, sharedBuffer, size]
+    {
+        stream->write(sharedBuffer->data(), size);
+        d->endOperation(size, bool(*stream), false);
+    });
+}
+
+void AsyncFileWriter::close(FileHandle file)
+{
+    if (file == invalidHandle)
+        return;
+
+    data->beginOperation(0);
+
+    if (data->ioUring)
+    {
+        data->ioUring->close(file);
+        return;
+    }
+
+    auto d = data.get();
+    std::shared_ptr<std::ofstream> stream;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        stream = d->streams[file];
+        d->streams.erase(file);
+    }
+
+    d->streamPool->submit([d, stream]
+    {
+        stream->close();
+        d->endOperation(0, bool(*stream), true);
+    });
+}
+
+bool AsyncFileWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(data->mutex);
+    data->cv.wait(lock, [&] { return data->numPending == 0; });
+
+    const bool ok = !data->failed;
+    data->failed = false;
+    return ok;
+}
+
+uint64_t AsyncFileWriter::numBytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(data->mutex);
+    return data->bytesWritten;
+}
+
+int AsyncFileWriter::numFilesWritten() const
+{
+    std::lock_guard<std::mutex> lock(data->mutex);
+    return data->filesWritten;
+}
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <util/macro.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/cpu_features.hpp>
+
+#if WITH_X86_SIMD && defined(_MSC_VER)
+    #include <intrin.h>
+    #include <immintrin.h>
+#endif
+
+
+namespace
+{
+
+const char *cpuLevelEnvVar = "CPU_LEVEL_4DVIDEO";
+
+constexpr int noOverride = -1;
+std::atomic<int> levelOverride(noOverride);
+
+CpuLevel detect()
+{
+#if WITH_X86_SIMD
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse42 = (info[2] & (1 << 20)) != 0;
+
+    // the OS must save the AVX registers (XMM, YMM) and for AVX-512 also the opmask and ZMM registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool osAvx = (info[2] & (1 << 28)) && (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = osAvx && (xcr0 & 0xe0) == 0xe0;
+
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = osAvx && (info[1] & (1 << 5));
+        avx512 = osAvx512 && (info[1] & (1 << 16));
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse42 = __builtin_cpu_supports("sse4.2");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+    const bool avx512 = __builtin_cpu_supports("avx512f");
+#endif
+
+    // kernels of the higher levels also use the lower instruction sets
+    if (avx512 && avx2 && sse42)
+        return CpuLevel::AVX512;
+    if (avx2 && sse42)
+        return CpuLevel::AVX2;
+    if (sse42)
+        return CpuLevel::SSE42;
+#endif
+
+    return CpuLevel::SCALAR;
+}
+
+/// Detected level, lowered by the environment variable.
+CpuLevel defaultLevel()
+{
+    const CpuLevel detected = detectedCpuLevel();
+    CpuLevel level = detected;
+
+    const char *fromEnv = getenv(cpuLevelEnvVar);
+    if (fromEnv)
+    {
+        bool found = false;
+        for (int l = 0; l < numCpuLevels; ++l)
+            if (strcmp(fromEnv, cpuLevelName(CpuLevel(l))) == 0)
+                level = CpuLevel(std::min(l, int(detected))), found = true;
+
+        TLOG_IF(ERROR, !found) << "Unknown " << cpuLevelEnvVar << " value: " << fromEnv;
+    }
+
+    TLOG(INFO) << "CPU level: " << cpuLevelName(level) << " (detected " << cpuLevelName(detected) << ")";
+    return level;
+}
+
+}
+
+
+CpuLevel detectedCpuLevel()
+{
+    static const CpuLevel level = detect();
+    return level;
+}
+
+CpuLevel cpuLevel()
+{
+    static const CpuLevel level = defaultLevel();
+    const int forced = levelOverride.load(std::memory_order_relaxed);
+    return forced == noOverride ? level : CpuLevel(forced);
+}
+
+void setCpuLevelOverride(CpuLevel level)
+{
+    levelOverride = std::min(int(level), int(detectedCpuLevel()));
+}
+
+void resetCpuLevelOverride()
+{
+    levelOverride = noOverride;
+}
+
+const char * cpuLevelName(CpuLevel level)
+{
+    switch (level)
+    {
+    case CpuLevel::SSE42:
+        return "sse42";
+    case CpuLevel::AVX2:
+        return "avx2";
+    case CpuLevel::AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
@@ -1,3 +1,12 @@
+#include <cerrno>
+
+#if defined(_WIN32)
+    #include <direct.h>
+#else
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
 #include <util/filesystem_utils.hpp>
 
 
@@ -23,4 +32,23 @@ bool fileExists(const std::string filename)
 {
     std::ifstream f(filename);
     return f.good();
-}
\ No newline at end of file
+}
+
+bool createDirectory(const std::string &path)
+{
+#if defined(_WIN32)
+    const int status = _mkdir(path.c_str());
+#else
+    const int status = mkdir(path.c_str(), 0755);
+#endif
+    return status == 0 || errno == EEXIST;
+}
+
+bool removeDirectory(const std::string &path)
+{
+#if defined(_WIN32)
+    return _rmdir(path.c_str()) == 0;
+#else
+    return rmdir(path.c_str()) == 0;
+#endif
+}
@@ -0,0 +1,595 @@
+#include <cstring>
+#include <algorithm>
+
+#include <util/geometry.hpp>
+#include <util/cpu_features.hpp>
+
+#if WITH_X86_SIMD
+    #include <immintrin.h>
+#endif
+
+
+namespace
+{
+
+/// The kernels are exact: same IEEE operations in the same order as the scalar functions, no FMA.
+/// Scalar loops also process the tails of the SIMD variants, starting from the index "first".
+
+void project2dPointsTo3dTail(int i, const float *j, const uint16_t *depth, size_t first, size_t numPoints,
+                             const CameraParams &cam, float *x, float *y, float *z, uint8_t *valid)
+{
+    for (size_t k = first; k < numPoints; ++k)
+    {
+        const uint16_t d = depth[k];
+        const float zk = float(d) / 1000;
+        const float zDivF = zk / cam.f;
+        x[k] = (j[k] - cam.cx) * zDivF;
+        y[k] = (i - cam.cy) * zDivF;
+        z[k] = zk;
+        valid[k] = d != 0;
+    }
+}
+
+void project3dPointsTo2dTail(const float *x, const float *y, const float *z, size_t first, size_t numPoints,
+                             const CameraParams &cam, int *iImg, int *jImg, uint16_t *depth, uint8_t *valid)
+{
+    for (size_t k = first; k < numPoints; ++k)
+    {
+        int i = 0, j = 0;
+        uint16_t d = 0;
+        valid[k] = project3dPointTo2d(cv::Point3f(x[k], y[k], z[k]), cam, i, j, d);
+        if (iImg) iImg[k] = i;
+        if (jImg) jImg[k] = j;
+        if (depth) depth[k] = d;
+    }
+}
+
+void projectPointsToUvTail(const float *x, const float *y, const float *z, size_t first, size_t numPoints,
+                           const UvProjection &projection, float *u, float *v)
+{
+    const auto &m = projection.m;
+    for (size_t k = first; k < numPoints; ++k)
+    {
+        const float zc = m[2][0] * x[k] + m[2][1] * y[k] + m[2][2] * z[k] + m[2][3];
+        const float invZ = 1.0f / zc;
+        const float uk = (m[0][0] * x[k] + m[0][1] * y[k] + m[0][2] * z[k] + m[0][3]) * invZ;
+        const float vk = (m[1][0] * x[k] + m[1][1] * y[k] + m[1][2] * z[k] + m[1][3]) * invZ;
+        const bool inside = zc > 0 && uk >= 0 && uk <= 1 && vk >= 0 && vk <= 1;
+        u[k] = inside ? uk : 0;
+        v[k] = inside ? vk : 0;
+    }
+}
+
+void filterTrianglesTail(const Triangle *triangles, size_t first, size_t numTriangles, const PointIJ *pixels,
+                         const float *x, const float *y, const float *z, float maxSide2DSq, float maxSide3DSq,
+                         float maxDepthRange, uint8_t *keep)
+{
+    for (size_t t = first; t < numTriangles; ++t)
+    {
+        const uint16_t v[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+        const float minZ = std::min(std::min(z[v[0]], z[v[1]]), z[v[2]]);
+        const float maxZ = std::max(std::max(z[v[0]], z[v[1]]), z[v[2]]);
+        bool reject = maxZ - minZ > maxDepthRange;
+
+        for (int e = 0; e < 3; ++e)
+        {
+            const uint16_t a = v[e], b = v[(e + 1) % 3];
+            const int di = pixels[b].i - pixels[a].i, dj = pixels[b].j - pixels[a].j;
+            const float dx = x[b] - x[a], dy = y[b] - y[a], dz = z[b] - z[a];
+            reject = reject || float(di * di + dj * dj) > maxSide2DSq || dx * dx + dy * dy + dz * dz > maxSide3DSq;
+        }
+
+        keep[t] = !reject;
+    }
+}
+
+void project2dPointsTo3dScalar(int i, const float *j, const uint16_t *depth, size_t numPoints,
+                               const CameraParams &cam, float *x, float *y, float *z, uint8_t *valid)
+{
+    project2dPointsTo3dTail(i, j, depth, 0, numPoints, cam, x, y, z, valid);
+}
+
+void project3dPointsTo2dScalar(const float *x, const float *y, const float *z, size_t numPoints,
+                               const CameraParams &cam, int *iImg, int *jImg, uint16_t *depth, uint8_t *valid)
+{
+    project3dPointsTo2dTail(x, y, z, 0, numPoints, cam, iImg, jImg, depth, valid);
+}
+
+void projectPointsToUvScalar(const float *x, const float *y, const float *z, size_t numPoints,
+                             const UvProjection &projection, float *u, float *v)
+{
+    projectPointsToUvTail(x, y, z, 0, numPoints, projection, u, v);
+}
+
+void filterTrianglesScalar(const Triangle *triangles, size_t numTriangles, const PointIJ *pixels,
+                           const float *x, const float *y, const float *z, float maxSide2DSq, float maxSide3DSq,
+                           float maxDepthRange, uint8_t *keep)
+{
+    filterTrianglesTail(triangles, 0, numTriangles, pixels, x, y, z, maxSide2DSq, maxSide3DSq, maxDepthRange, keep);
+}
+
+#if WITH_X86_SIMD
+
+/// 0/-1 32-bit lanes to 0/1 bytes.
+TARGET_SSE42 FORCE_INLINE void storeMask(__m128i mask, uint8_t *valid)
+{
+    const __m128i bytes = _mm_and_si128(_mm_packs_epi16(_mm_packs_epi32(mask, mask), mask), _mm_set1_epi8(1));
+    const int packed = _mm_cvtsi128_si32(bytes);
+    memcpy(valid, &packed, 4);
+}
+
+/// Low 16 bits of the 32-bit lanes, same as the truncating cast.
+TARGET_SSE42 FORCE_INLINE __m128i packDepth(__m128i lo, __m128i hi)
+{
+    const __m128i low16 = _mm_set1_epi32(0xffff);
+    return _mm_packus_epi32(_mm_and_si128(lo, low16), _mm_and_si128(hi, low16));
+}
+
+TARGET_SSE42 void project2dPointsTo3dSse42(int i, const float *j, const uint16_t *depth, size_t numPoints,
+                                           const CameraParams &cam, float *x, float *y, float *z, uint8_t *valid)
+{
+    const __m128 thousand = _mm_set1_ps(1000), f = _mm_set1_ps(cam.f), cx = _mm_set1_ps(cam.cx);
+    const __m128 rowY = _mm_set1_ps(i - cam.cy);
+
+    size_t k = 0;
+    for (; k + 4 <= numPoints; k += 4)
+    {
+        const __m128i d = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth + k)));
+        const __m128 zk = _mm_div_ps(_mm_cvtepi32_ps(d), thousand);
+        const __m128 zDivF = _mm_div_ps(zk, f);
+        _mm_storeu_ps(x + k, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(j + k), cx), zDivF));
+        _mm_storeu_ps(y + k, _mm_mul_ps(rowY, zDivF));
+        _mm_storeu_ps(z + k, zk);
+        storeMask(_mm_xor_si128(_mm_cmpeq_epi32(d, _mm_setzero_si128()), _mm_set1_epi32(-1)), valid + k);
+    }
+
+    project2dPointsTo3dTail(i, j, depth, k, numPoints, cam, x, y, z, valid);
+}
+
+TARGET_SSE42 void project3dPointsTo2dSse42(const float *x, const float *y, const float *z, size_t numPoints,
+                                           const CameraParams &cam, int *iImg, int *jImg, uint16_t *depth, uint8_t *valid)
+{
+    const __m128 f = _mm_set1_ps(cam.f), cx = _mm_set1_ps(cam.cx), cy = _mm_set1_ps(cam.cy), thousand = _mm_set1_ps(1000);
+    const __m128i minusOne = _mm_set1_epi32(-1), w = _mm_set1_epi32(cam.w), h = _mm_set1_epi32(cam.h);
+
+    size_t k = 0;
+    for (; k + 4 <= numPoints; k += 4)
+    {
+        const __m128 zk = _mm_loadu_ps(z + k);
+        const __m128 fDivZ = _mm_div_ps(f, zk);
+        const __m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(fDivZ, _mm_loadu_ps(y + k)), cy));
+        const __m128i j = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(fDivZ, _mm_loadu_ps(x + k)), cx));
+
+        // out of range and NaN (converted to INT_MIN) are invalid
+        const __m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(i, minusOne), _mm_cmpgt_epi32(h, i)),
+                                             _mm_and_si128(_mm_cmpgt_epi32(j, minusOne), _mm_cmpgt_epi32(w, j)));
+        storeMask(inside, valid + k);
+
+        if (iImg) _mm_storeu_si128(reinterpret_cast<__m128i *>(iImg + k), i);
+        if (jImg) _mm_storeu_si128(reinterpret_cast<__m128i *>(jImg + k), j);
+        if (depth)
+        {
+            const __m128i d = _mm_cvttps_epi32(_mm_mul_ps(zk, thousand));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(depth + k), packDepth(d, d));
+        }
+    }
+
+    project3dPointsTo2dTail(x, y, z, k, numPoints, cam, iImg, jImg, depth, valid);
+}
+
+TARGET_SSE42 void projectPointsToUvSse42(const float *x, const float *y, const float *z, size_t numPoints,
+                                         const UvProjection &projection, float *u, float *v)
+{
+    __m128 m[3][4];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 4; ++c)
+            m[r][c] = _mm_set1_ps(projection.m[r][c]);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+
+    size_t k = 0;
+    for (; k + 4 <= numPoints; k += 4)
+    {
+        const __m128 xk = _mm_loadu_ps(x + k), yk = _mm_loadu_ps(y + k), zk = _mm_loadu_ps(z + k);
+        __m128 row[3];
+        for (int r = 0; r < 3; ++r)
+            row[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], xk), _mm_mul_ps(m[r][1], yk)), _mm_mul_ps(m[r][2], zk)), m[r][3]);
+
+        const __m128 invZ = _mm_div_ps(one, row[2]);
+        const __m128 uk = _mm_mul_ps(row[0], invZ), vk = _mm_mul_ps(row[1], invZ);
+
+        // comparisons with NaN are false, so these points are outside too
+        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(row[2], zero), _mm_and_ps(_mm_cmpge_ps(uk, zero), _mm_cmple_ps(uk, one))),
+                                         _mm_and_ps(_mm_cmpge_ps(vk, zero), _mm_cmple_ps(vk, one)));
+        _mm_storeu_ps(u + k, _mm_and_ps(uk, inside));
+        _mm_storeu_ps(v + k, _mm_and_ps(vk, inside));
+    }
+
+    projectPointsToUvTail(x, y, z, k, numPoints, projection, u, v);
+}
+
+TARGET_AVX2 void project2dPointsTo3dAvx2(int i, const float *j, const uint16_t *depth, size_t numPoints,
+                                         const CameraParams &cam, float *x, float *y, float *z, uint8_t *valid)
+{
+    const __m256 thousand = _mm256_set1_ps(1000), f = _mm256_set1_ps(cam.f), cx = _mm256_set1_ps(cam.cx);
+    const __m256 rowY = _mm256_set1_ps(i - cam.cy);
+
+    size_t k = 0;
+    for (; k + 8 <= numPoints; k += 8)
+    {
+        const __m128i d16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth + k));
+        const __m256 zk = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(d16)), thousand);
+        const __m256 zDivF = _mm256_div_ps(zk, f);
+        _mm256_storeu_ps(x + k, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(j + k), cx), zDivF));
+        _mm256_storeu_ps(y + k, _mm256_mul_ps(rowY, zDivF));
+        _mm256_storeu_ps(z + k, zk);
+
+        const __m128i zero = _mm_cmpeq_epi16(d16, _mm_setzero_si128());
+        const __m128i bytes = _mm_andnot_si128(_mm_packs_epi16(zero, zero), _mm_set1_epi8(1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(valid + k), bytes);
+    }
+
+    project2dPointsTo3dTail(i, j, depth, k, numPoints, cam, x, y, z, valid);
+}
+
+TARGET_AVX2 void project3dPointsTo2dAvx2(const float *x, const float *y, const float *z, size_t numPoints,
+                                         const CameraParams &cam, int *iImg, int *jImg, uint16_t *depth, uint8_t *valid)
+{
+    const __m256 f = _mm256_set1_ps(cam.f), cx = _mm256_set1_ps(cam.cx), cy = _mm256_set1_ps(cam.cy);
+    const __m256 thousand = _mm256_set1_ps(1000);
+    const __m256i minusOne = _mm256_set1_epi32(-1), w = _mm256_set1_epi32(cam.w), h = _mm256_set1_epi32(cam.h);
+
+    size_t k = 0;
+    for (; k + 8 <= numPoints; k += 8)
+    {
+        const __m256 zk = _mm256_loadu_ps(z + k);
+        const __m256 fDivZ = _mm256_div_ps(f, zk);
+        const __m256i i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(fDivZ, _mm256_loadu_ps(y + k)), cy));
+        const __m256i j = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(fDivZ, _mm256_loadu_ps(x + k)), cx));
+
+        const __m256i inside = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(i, minusOne), _mm256_cmpgt_epi32(h, i)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(j, minusOne), _mm256_cmpgt_epi32(w, j)));
+        const __m128i mask16 = _mm_packs_epi32(_mm256_castsi256_si128(inside), _mm256_extracti128_si256(inside, 1));
+        const __m128i bytes = _mm_and_si128(_mm_packs_epi16(mask16, mask16), _mm_set1_epi8(1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(valid + k), bytes);
+
+        if (iImg) _mm256_storeu_si256(reinterpret_cast<__m256i *>(iImg + k), i);
+        if (jImg) _mm256_storeu_si256(reinterpret_cast<__m256i *>(jImg + k), j);
+        if (depth)
+        {
+            const __m256i d = _mm256_cvttps_epi32(_mm256_mul_ps(zk, thousand));
+            const __m128i packed = packDepth(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(depth + k), packed);
+        }
+    }
+
+    project3dPointsTo2dTail(x, y, z, k, numPoints, cam, iImg, jImg, depth, valid);
+}
+
+TARGET_AVX2 void projectPointsToUvAvx2(const float *x, const float *y, const float *z, size_t numPoints,
+                                       const UvProjection &projection, float *u, float *v)
+{
+    __m256 m[3][4];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 4; ++c)
+            m[r][c] = _mm256_set1_ps(projection.m[r][c]);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+
+    size_t k = 0;
+    for (; k + 8 <= numPoints; k += 8)
+    {
+        const __m256 xk = _mm256_loadu_ps(x + k), yk = _mm256_loadu_ps(y + k), zk = _mm256_loadu_ps(z + k);
+        __m256 row[3];
+        for (int r = 0; r < 3; ++r)
+            row[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r][0], xk), _mm256_mul_ps(m[r][1], yk)),
+                                                 _mm256_mul_ps(m[r][2], zk)), m[r][3]);
+
+        const __m256 invZ = _mm256_div_ps(one, row[2]);
+        const __m256 uk = _mm256_mul_ps(row[0], invZ), vk = _mm256_mul_ps(row[1], invZ);
+
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(row[2], zero, _CMP_GT_OQ),
+                          _mm256_and_ps(_mm256_cmp_ps(uk, zero, _CMP_GE_OQ), _mm256_cmp_ps(uk, one, _CMP_LE_OQ))),
+            _mm256_and_ps(_mm256_cmp_ps(vk, zero, _CMP_GE_OQ), _mm256_cmp_ps(vk, one, _CMP_LE_OQ)));
+        _mm256_storeu_ps(u + k, _mm256_and_ps(uk, inside));
+        _mm256_storeu_ps(v + k, _mm256_and_ps(vk, inside));
+    }
+
+    projectPointsToUvTail(x, y, z, k, numPoints, projection, u, v);
+}
+
+/// Vertices are gathered, there is no SSE variant: without gathers it is not faster than the scalar loop.
+TARGET_AVX2 void filterTrianglesAvx2(const Triangle *triangles, size_t numTriangles, const PointIJ *pixels,
+                                     const float *x, const float *y, const float *z, float maxSide2DSq, float maxSide3DSq,
+                                     float maxDepthRange, uint8_t *keep)
+{
+    static_assert(sizeof(PointIJ) == sizeof(int), "pixels are gathered as 32-bit values");
+    const int *packedPixels = reinterpret_cast<const int *>(pixels);
+    const __m256 max2D = _mm256_set1_ps(maxSide2DSq), max3D = _mm256_set1_ps(maxSide3DSq);
+    const __m256 maxRange = _mm256_set1_ps(maxDepthRange);
+
+    size_t t = 0;
+    for (; t + 8 <= numTriangles; t += 8)
+    {
+        alignas(32) int indices[3][8];
+        for (int k = 0; k < 8; ++k)
+        {
+            indices[0][k] = triangles[t + k].p1;
+            indices[1][k] = triangles[t + k].p2;
+            indices[2][k] = triangles[t + k].p3;
+        }
+
+        __m256 px[3], py[3], pz[3];
+        __m256i pi[3], pj[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(indices[c]));
+            px[c] = _mm256_i32gather_ps(x, v, 4);
+            py[c] = _mm256_i32gather_ps(y, v, 4);
+            pz[c] = _mm256_i32gather_ps(z, v, 4);
+
+            // i is the low half of the packed pixel, both are signed
+            const __m256i ij = _mm256_i32gather_epi32(packedPixels, v, 4);
+            pi[c] = _mm256_srai_epi32(_mm256_slli_epi32(ij, 16), 16);
+            pj[c] = _mm256_srai_epi32(ij, 16);
+        }
+
+        const __m256 minZ = _mm256_min_ps(_mm256_min_ps(pz[0], pz[1]), pz[2]);
+        const __m256 maxZ = _mm256_max_ps(_mm256_max_ps(pz[0], pz[1]), pz[2]);
+        __m256 reject = _mm256_cmp_ps(_mm256_sub_ps(maxZ, minZ), maxRange, _CMP_GT_OQ);
+
+        for (int e = 0; e < 3; ++e)
+        {
+            const int a = e, b = (e + 1) % 3;
+            const __m256i di = _mm256_sub_epi32(pi[b], pi[a]), dj = _mm256_sub_epi32(pj[b], pj[a]);
+            const __m256 side2D = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_mullo_epi32(di, di), _mm256_mullo_epi32(dj, dj)));
+            reject = _mm256_or_ps(reject, _mm256_cmp_ps(side2D, max2D, _CMP_GT_OQ));
+
+            const __m256 dx = _mm256_sub_ps(px[b], px[a]), dy = _mm256_sub_ps(py[b], py[a]), dz = _mm256_sub_ps(pz[b], pz[a]);
+            const __m256 side3D = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            reject = _mm256_or_ps(reject, _mm256_cmp_ps(side3D, max3D, _CMP_GT_OQ));
+        }
+
+        const int rejectMask = _mm256_movemask_ps(reject);
+        for (int k = 0; k < 8; ++k)
+            keep[t + k] = uint8_t(((rejectMask >> k) & 1) ^ 1);
+    }
+
+    filterTrianglesTail(triangles, t, numTriangles, pixels, x, y, z, maxSide2DSq, maxSide3DSq, maxDepthRange, keep);
+}
+
+TARGET_AVX512 FORCE_INLINE void storeMask(__mmask16 mask, uint8_t *valid)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(valid), _mm512_cvtepi32_epi8(_mm512_maskz_set1_epi32(mask, 1)));
+}
+
+TARGET_AVX512 void project2dPointsTo3dAvx512(int i, const float *j, const uint16_t *depth, size_t numPoints,
+                                             const CameraParams &cam, float *x, float *y, float *z, uint8_t *valid)
+{
+    const __m512 thousand = _mm512_set1_ps(1000), f = _mm512_set1_ps(cam.f), cx = _mm512_set1_ps(cam.cx);
+    const __m512 rowY = _mm512_set1_ps(i - cam.cy);
+
+    size_t k = 0;
+    for (; k + 16 <= numPoints; k += 16)
+    {
+        const __m512i d = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(depth + k)));
+        const __m512 zk = _mm512_div_ps(_mm512_cvtepi32_ps(d), thousand);
+        const __m512 zDivF = _mm512_div_ps(zk, f);
+        _mm512_storeu_ps(x + k, _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(j + k), cx), zDivF));
+        _mm512_storeu_ps(y + k, _mm512_mul_ps(rowY, zDivF));
+        _mm512_storeu_ps(z + k, zk);
+        storeMask(_mm512_test_epi32_mask(d, d), valid + k);
+    }
+
+    project2dPointsTo3dTail(i, j, depth, k, numPoints, cam, x, y, z, valid);
+}
+
+TARGET_AVX512 void project3dPointsTo2dAvx512(const float *x, const float *y, const float *z, size_t numPoints,
+                                             const CameraParams &cam, int *iImg, int *jImg, uint16_t *depth, uint8_t *valid)
+{
+    const __m512 f = _mm512_set1_ps(cam.f), cx = _mm512_set1_ps(cam.cx), cy = _mm512_set1_ps(cam.cy);
+    const __m512 thousand = _mm512_set1_ps(1000);
+    const __m512i minusOne = _mm512_set1_epi32(-1), w = _mm512_set1_epi32(cam.w), h = _mm512_set1_epi32(cam.h);
+
+    size_t k = 0;
+    for (; k + 16 <= numPoints; k += 16)
+    {
+        const __m512 zk = _mm512_loadu_ps(z + k);
+        const __m512 fDivZ = _mm512_div_ps(f, zk);
+        const __m512i i = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(fDivZ, _mm512_loadu_ps(y + k)), cy));
+        const __m512i j = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(fDivZ, _mm512_loadu_ps(x + k)), cx));
+
+        __mmask16 inside = _mm512_cmpgt_epi32_mask(i, minusOne);
+        inside = _mm512_mask_cmpgt_epi32_mask(inside, h, i);
+        inside = _mm512_mask_cmpgt_epi32_mask(inside, j, minusOne);
+        inside = _mm512_mask_cmpgt_epi32_mask(inside, w, j);
+        storeMask(inside, valid + k);
+
+        if (iImg) _mm512_storeu_si512(iImg + k, i);
+        if (jImg) _mm512_storeu_si512(jImg + k, j);
+        if (depth)
+        {
+            // truncating conversion keeps the low 16 bits, same as the cast
+            const __m512i d = _mm512_cvttps_epi32(_mm512_mul_ps(zk, thousand));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(depth + k), _mm512_cvtepi32_epi16(d));
+        }
+    }
+
+    project3dPointsTo2dTail(x, y, z, k, numPoints, cam, iImg, jImg, depth, valid);
+}
+
+TARGET_AVX512 void projectPointsToUvAvx512(const float *x, const float *y, const float *z, size_t numPoints,
+                                           const UvProjection &projection, float *u, float *v)
+{
+    __m512 m[3][4];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 4; ++c)
+            m[r][c] = _mm512_set1_ps(projection.m[r][c]);
+    const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1);
+
+    size_t k = 0;
+    for (; k + 16 <= numPoints; k += 16)
+    {
+        const __m512 xk = _mm512_loadu_ps(x + k), yk = _mm512_loadu_ps(y + k), zk = _mm512_loadu_ps(z + k);
+        __m512 row[3];
+        for (int r = 0; r < 3; ++r)
+            row[r] = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m[r][0], xk), _mm512_mul_ps(m[r][1], yk)),
+                                                 _mm512_mul_ps(m[r][2], zk)), m[r][3]);
+
+        const __m512 invZ = _mm512_div_ps(one, row[2]);
+        const __m512 uk = _mm512_mul_ps(row[0], invZ), vk = _mm512_mul_ps(row[1], invZ);
+
+        __mmask16 inside = _mm512_cmp_ps_mask(row[2], zero, _CMP_GT_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, uk, zero, _CMP_GE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, uk, one, _CMP_LE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, vk, zero, _CMP_GE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, vk, one, _CMP_LE_OQ);
+        _mm512_storeu_ps(u + k, _mm512_maskz_mov_ps(inside, uk));
+        _mm512_storeu_ps(v + k, _mm512_maskz_mov_ps(inside, vk));
+    }
+
+    projectPointsToUvTail(x, y, z, k, numPoints, projection, u, v);
+}
+
+#endif
+
+#if WITH_X86_SIMD
+    #define SIMD_VARIANTS(kernel) , kernel##Sse42, kernel##Avx2, kernel##Avx512
+#else
+    #define SIMD_VARIANTS(kernel)
+#endif
+
+const CpuDispatch<decltype(&project2dPointsTo3dScalar)> project2dPointsTo3dKernel(project2dPointsTo3dScalar SIMD_VARIANTS(project2dPointsTo3d));
+const CpuDispatch<decltype(&project3dPointsTo2dScalar)> project3dPointsTo2dKernel(project3dPointsTo2dScalar SIMD_VARIANTS(project3dPointsTo2d));
+const CpuDispatch<decltype(&projectPointsToUvScalar)> projectPointsToUvKernel(projectPointsToUvScalar SIMD_VARIANTS(projectPointsToUv));
+
+#if WITH_X86_SIMD
+const CpuDispatch<decltype(&filterTrianglesScalar)> filterTrianglesKernel(filterTrianglesScalar, nullptr, filterTrianglesAvx2);
+#else
+const CpuDispatch<decltype(&filterTrianglesScalar)> filterTrianglesKernel(filterTrianglesScalar);
+#endif
+
+}
+
+
+void project2dPointsTo3d(int i,
+                         const float *j,
+                         const uint16_t *depth,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         float *x,
+                         float *y,
+                         float *z,
+                         uint8_t *valid)
+{
+    project2dPointsTo3dKernel(i, j, depth, numPoints, cam, x, y, z, valid);
+}
+
+void project3dPointsTo2d(const float *x,
+                         const float *y,
+                         const float *z,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         int *iImg,
+                         int *jImg,
+                         uint16_t *depth,
+                         uint8_t *valid)
+{
+    project3dPointsTo2dKernel(x, y, z, numPoints, cam, iImg, jImg, depth, valid);
+}
+
+void project3dPointsTo2d(const cv::Point3f *points,
+                         size_t numPoints,
+                         const CameraParams &cam,
+                         int *iImg,
+                         int *jImg,
+                         uint16_t *depth,
+                         uint8_t *valid)
+{
+    // transpose in blocks that stay in L1
+    constexpr size_t blockSize = 256;
+    float x[blockSize], y[blockSize], z[blockSize];
+
+    for (size_t first = 0; first < numPoints; first += blockSize)
+    {
+        const size_t n = std::min(blockSize, numPoints - first);
+        for (size_t k = 0; k < n; ++k)
+            x[k] = points[first + k].x, y[k] = points[first + k].y, z[k] = points[first + k].z;
+
+        project3dPointsTo2d(x, y, z, n, cam,
+                            iImg ? iImg + first : nullptr,
+                            jImg ? jImg + first : nullptr,
+                            depth ? depth + first : nullptr,
+                            valid + first);
+    }
+}
+
+UvProjection uvProjection(const Calibration &calibration, const CameraParams &colorCam)
+{
+    float r[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } }, t[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!calibration.rmat.empty())
+            for (int j = 0; j < 3; ++j)
+                r[i][j] = calibration.rmat.type() == CV_64F ? float(calibration.rmat.at<double>(i, j)) : calibration.rmat.at<float>(i, j);
+        if (!calibration.tvec.empty())
+            t[i] = calibration.tvec.type() == CV_64F ? float(calibration.tvec.at<double>(i)) : calibration.tvec.at<float>(i);
+    }
+
+    // intrinsics with the half texel shift, divided by the image size
+    const float k[2][3] = { { colorCam.f / colorCam.w, 0, (colorCam.cx + 0.5f) / colorCam.w },
+                            { 0, colorCam.f / colorCam.h, (colorCam.cy + 0.5f) / colorCam.h } };
+
+    UvProjection projection;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 4; ++j)
+        {
+            const auto extrinsics = [&](int row) { return j < 3 ? r[row][j] : t[row]; };
+            projection.m[i][j] = i < 2 ? k[i][0] * extrinsics(0) + k[i][1] * extrinsics(1) + k[i][2] * extrinsics(2) : extrinsics(2);
+        }
+    return projection;
+}
+
+void projectPointsToUv(const cv::Point3f *points, size_t numPoints, const UvProjection &projection, cv::Point2f *uv)
+{
+    constexpr size_t blockSize = 256;
+    float x[blockSize], y[blockSize], z[blockSize];
+
+    for (size_t first = 0; first < numPoints; first += blockSize)
+    {
+        const size_t n = std::min(blockSize, numPoints - first);
+        for (size_t k = 0; k < n; ++k)
+            x[k] = points[first + k].x, y[k] = points[first + k].y, z[k] = points[first + k].z;
+
+        projectPointsToUv(x, y, z, n, projection, uv + first);
+    }
+}
+
+void projectPointsToUv(const float *x, const float *y, const float *z, size_t numPoints, const UvProjection &projection, cv::Point2f *uv)
+{
+    constexpr size_t blockSize = 256;
+    float u[blockSize], v[blockSize];
+
+    for (size_t first = 0; first < numPoints; first += blockSize)
+    {
+        const size_t n = std::min(blockSize, numPoints - first);
+        projectPointsToUvKernel(x + first, y + first, z + first, n, projection, u, v);
+
+        for (size_t k = 0; k < n; ++k)
+            uv[first + k] = cv::Point2f(u[k], v[k]);
+    }
+}
+
+void filterTriangles(const Triangle *triangles,
+                     size_t numTriangles,
+                     const PointIJ *pixels,
+                     const float *x,
+                     const float *y,
+                     const float *z,
+                     float maxSide2D,
+                     float maxSide3D,
+                     float maxDepthRange,
+                     uint8_t *keep)
+{
+    filterTrianglesKernel(triangles, numTriangles, pixels, x, y, z, maxSide2D * maxSide2D, maxSide3D * maxSide3D, maxDepthRange, keep);
+}
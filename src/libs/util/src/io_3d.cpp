@@ -1,55 +1,54 @@
-#include <map>
-#include <queue>
+#include <limits>
+#include <cstring>
 #include <vector>
 #include <fstream>
 
 #include <util/util.hpp>
 #include <util/io_3d.hpp>
+#include <util/ply_reader.hpp>
 #include <util/geometry.hpp>
 #include <util/tiny_logger.hpp>
+#include <util/thread_pool.hpp>
 #include <util/string_utils.hpp>
 
 
 namespace
 {
 
-// local data structures
-
-struct PropertyGroup
+/// Copy data from the view, unless it already points to the destination vector.
+template<typename T>
+void assignFromView(const PlyView<T> &view, std::vector<T> &dst)
 {
-    PropertyGroup(const std::vector<std::string> &propertyNames, const std::string &type, char *dataPtr)
-        : propertyNames(propertyNames)
-        , type(type)
-        , dataPtr(dataPtr)
+    if (!view.empty() && view.data() == dst.data())
+        return;
+
+    if (view.contiguous())
+        dst.assign(view.data(), view.data() + view.size());
+    else
     {
+        dst.resize(view.size());
+        for (size_t i = 0; i < view.size(); ++i)
+            dst[i] = view[i];
     }
+}
 
-    std::vector<std::string> propertyNames;
-    std::string type;
-    char *dataPtr = nullptr;
-    int offset = 0;
-    bool found = false;
-};
-
-struct Element
-{
-    int count;
-    std::vector<std::string> propertyNames;
-    std::vector<std::string> propertyTypes;
-    std::vector<PropertyGroup> propertiesToRead;
-};
-
-// local helper functions
-int typeToSize(const std::string &type)
+template<typename T, typename ScalarT>
+bool readAnyOf(PlyReader &ply, const std::string &element, const std::vector<std::vector<std::string>> &namings, std::vector<T> &dst)
 {
-    if (type == "float")
-        return 4;
-    else if (type == "uchar")
-        return 1;
-    else
-        TLOG(ERROR) << "type " << type << " is unknown";
+    PlyView<T> view;
+    for (const auto &names : namings)
+        if (ply.readProperties<T, ScalarT>(element, names, view, dst))
+        {
+            assignFromView(view, dst);
+            return true;
+        }
+
+    return false;
+}
 
-    return 0;
+bool readFaces(PlyReader &ply, std::vector<uint32_t> &indices, std::vector<uint32_t> &lengths)
+{
+    return ply.readList("face", "vertex_indices", indices, &lengths) || ply.readList("face", "vertex_index", indices, &lengths);
 }
 
 }
@@ -57,165 +56,111 @@ int typeToSize(const std::string &type)
 
 bool loadBinaryPly(const std::string &filename,
                    std::vector<cv::Point3f> *vertices,
-                   std::vector<cv::Vec3b> *vertexColors)
+                   std::vector<cv::Vec3b> *vertexColors,
+                   std::vector<Triangle> *triangles,
+                   std::vector<cv::Point2f> *uv)
 {
-    // It's very convenient to open file as binary, but read header as text using getline.
-    // This may break one day, e.g. on a file with \r\n line endings.
-    std::ifstream ply{ filename, std::ios::binary };
-    std::string line;
-    bool isOk;
-
-    if (!std::getline(ply, line) || line != "ply")
-    {
-        TLOG(ERROR) << "expected 'ply' header line, format not supported";
+    PlyReader ply;
+    if (!ply.open(filename))
         return false;
-    }
 
-    std::vector<std::string> tokens;
-    if (!std::getline(ply, line) || (tokens = splitString(line, " ")).size() != 3)
-    {
-        TLOG(ERROR) << "ply format " << line << " cannot be interpreted (expected 3 tokens)";
-        return false;
-    }
-    if (tokens.front() != "format")
+    if (vertices && !readAnyOf<cv::Point3f, float>(ply, "vertex", { { "x", "y", "z" } }, *vertices))
     {
-        TLOG(ERROR) << "ply format string should start with 'format' keyword, found: " << line;
+        TLOG(ERROR) << "could not read vertex positions from " << filename;
         return false;
     }
 
-    const std::string format{ tokens[1] }, version{ tokens[2] };
-    if (format == "ascii" || format == "binary_big_endian")
+    if (vertexColors && !readAnyOf<cv::Vec3b, uint8_t>(ply, "vertex", { { "red", "green", "blue" }, { "r", "g", "b" } }, *vertexColors))
     {
-        TLOG(ERROR) << "format " << format << " " << version << " not supported. Only binary_little_endian is currently supported.";
+        TLOG(ERROR) << "could not read vertex colors from " << filename;
         return false;
     }
 
-    std::map<std::string, Element> elements;
-    std::queue<std::string> elementOrder;
+    std::vector<uint32_t> indices, lengths;
+    const bool needFaces = triangles || uv;
+    const bool hasFaces = needFaces && readFaces(ply, indices, lengths);
 
-    while (std::getline(ply, line) && line != "end_header")
+    if (triangles)
     {
-        tokens = splitString(line, " ");
-
-        if (tokens.size() == 3 && tokens.front() == "element")
+        if (!hasFaces)
         {
-            Element element;
-            const std::string elementName = tokens[1];
-            element.count = stringTo<int>(tokens[2], isOk);
-            if (!isOk)
-            {
-                TLOG(ERROR) << "could not parse the element count, token is: " << tokens[2];
-                return false;
-            }
+            TLOG(ERROR) << "could not read faces from " << filename;
+            return false;
+        }
 
-            while (std::getline(ply, line) && startsWith(line, "property"))
+        // polygons are split into triangle fans
+        triangles->clear();
+        const uint32_t *face = indices.data();
+        for (uint32_t length : lengths)
+        {
+            for (uint32_t k = 2; k < length; ++k)
             {
-                tokens = splitString(line, " ");
-                if (tokens.size() != 3)
+                if (face[0] > std::numeric_limits<uint16_t>::max() || face[k - 1] > std::numeric_limits<uint16_t>::max() || face[k] > std::numeric_limits<uint16_t>::max())
                 {
-                    TLOG(ERROR) << "only parameters described by three tokens are supported, line is: " << line;
+                    TLOG(ERROR) << "vertex index does not fit into 16 bits in " << filename;
                     return false;
                 }
-
-                element.propertyTypes.emplace_back(tokens[1]);
-                element.propertyNames.emplace_back(tokens[2]);
+                triangles->push_back({ uint16_t(face[0]), uint16_t(face[k - 1]), uint16_t(face[k]) });
             }
-
-            elements[elementName] = element;
-            elementOrder.push(elementName);
-
-            if (line == "end_header")
-                break;
-        }
-        else if (!tokens.empty() && tokens.front() == "comment")
-        {
-            continue;
-        }
-        else
-        {
-            TLOG(WARNING) << "unknown header token: " << line;
-            continue;
+            face += length;
         }
-    };
-
-    // determine what data we actually need to read (and allocate buffers)
-    const bool canReadVertices = elements.count("vertex") > 0,
-               needVertices = vertices || vertexColors;
+    }
 
-    if (needVertices && !canReadVertices)
-        TLOG(ERROR) << "vertex element not found in .ply file";
-    else
+    if (uv)
     {
-        Element &vertexElem = elements["vertex"];
-        if (vertices)
-        {
-            vertices->resize(vertexElem.count);
-            vertexElem.propertiesToRead.push_back(PropertyGroup({"x", "y", "z"}, "float", (char *)vertices->data()));
-        }
-        if (vertexColors)
+        const std::vector<std::vector<std::string>> uvNames{ { "s", "t" }, { "u", "v" }, { "texture_u", "texture_v" } };
+        if (readAnyOf<cv::Point2f, float>(ply, "vertex", uvNames, *uv))
+            return true;
+
+        // per-face texcoords, scatter them to vertices (saveBinaryPly derives them from per-vertex uv, so this is lossless)
+        std::vector<float> texcoord;
+        std::vector<uint32_t> texcoordLengths;
+        const PlyElement *vertexElem = ply.element("vertex");
+        if (!hasFaces || !vertexElem || !ply.readList("face", "texcoord", texcoord, &texcoordLengths))
         {
-            vertexColors->resize(vertexElem.count);
-            vertexElem.propertiesToRead.push_back(PropertyGroup({ "red", "green", "blue" }, "uchar", (char *)vertexColors->data()));
+            TLOG(ERROR) << "could not read texture coordinates from " << filename;
+            return false;
         }
-    }
-
-    std::vector<char> elementData;
 
-    while (!elementOrder.empty())
-    {
-        const std::string elementName{ elementOrder.front() };
-        elementOrder.pop();
-        Element &element = elements[elementName];
-        int elementSize = 0;
-
-        // learn which properties are actually in the data, also learn offset of each property group and total size of element
-        assert(element.propertyNames.size() == element.propertyTypes.size());
-        for (size_t i = 0; i < element.propertyNames.size(); ++i)
+        uv->assign(vertexElem->count, cv::Point2f());
+        size_t faceOfs = 0, uvOfs = 0;
+        for (size_t i = 0; i < lengths.size(); ++i)
         {
-            const std::string &type = element.propertyTypes[i];
-            for (auto &group : element.propertiesToRead)
-            {
-                // check following sequence of properties matches property group that we want to read (e.g. x,y,z)
-                if (group.found)
-                    continue;
-                if (group.type != type)
-                    continue;
-                if (element.propertyNames.size() - i < group.propertyNames.size())
-                    continue;
-                if (std::equal(group.propertyNames.begin(), group.propertyNames.end(), element.propertyNames.begin() + i))
-                {
-                    group.found = true;
-                    group.offset = elementSize;
-                    break;
-                }
-            }
+            if (texcoordLengths[i] == 2 * lengths[i])
+                for (uint32_t k = 0; k < lengths[i]; ++k)
+                    if (indices[faceOfs + k] < uv->size())
+                        (*uv)[indices[faceOfs + k]] = cv::Point2f(texcoord[uvOfs + 2 * k], texcoord[uvOfs + 2 * k + 1]);
 
-            elementSize += typeToSize(type);
+            faceOfs += lengths[i], uvOfs += texcoordLengths[i];
         }
+    }
 
-        elementData.resize(element.count * elementSize);
-        ply.read((char *)elementData.data(), elementData.size());
+    return true;
+}
 
-        for (const auto &group : element.propertiesToRead)
-        {
-            if (!group.found)
-            {
-                TLOG(ERROR) << "could not read property " << elementName << group.propertyNames;
-                continue;
-            }
+namespace
+{
 
-            const size_t groupSize = group.propertyNames.size() * typeToSize(group.type);
-            memcpyStride(group.dataPtr, (char *)elementData.data(), int(groupSize), element.count, group.offset, elementSize);
-        }
+const char * plyIndexTypeName(PlyIndexType type)
+{
+    switch (type)
+    {
+    case PlyIndexType::USHORT: return "ushort";
+    case PlyIndexType::UINT: return "uint";
+    default: return "int";
     }
+}
 
-    return true;
+size_t plyIndexSize(PlyIndexType type)
+{
+    return type == PlyIndexType::USHORT ? sizeof(uint16_t) : sizeof(uint32_t);
 }
 
 std::string plyHeader(const std::vector<cv::Point3f> *vertices,
                       const std::vector<Triangle> *triangles,
                       const std::vector<cv::Point2f> *uv,
-                      const std::string *textureFilename)
+                      const std::string *textureFilename,
+                      const PlyOptions &options)
 {
     std::ostringstream header;
     header << "ply\n";
@@ -230,13 +175,15 @@ std::string plyHeader(const std::vector<cv::Point3f> *vertices,
         header << "element vertex " << vertices->size() << "\n";
         for (char c = 'x'; c <= 'z'; ++c)
             header << "property float " << c << "\n";
+        if (uv && options.perVertexUv)
+            header << "property float s\n" << "property float t\n";
     }
 
     if (triangles)
     {
         header << "element face " << triangles->size() << "\n";
-        header << "property list uchar int vertex_indices\n";
-        if (uv)
+        header << "property list uchar " << plyIndexTypeName(options.indexType) << " vertex_indices\n";
+        if (uv && !options.perVertexUv)
             header << "property list uchar float texcoord\n";
     }
 
@@ -244,46 +191,107 @@ std::string plyHeader(const std::vector<cv::Point3f> *vertices,
     return header.str();
 }
 
-/// Disclaimer: this is a very limited version of binary writer, made just for debugging.
-bool saveBinaryPly(const std::string &filename,
-                   const std::vector<cv::Point3f> *vertices,
-                   const std::vector<Triangle> *triangles,
-                   const std::vector<cv::Point2f> *uv,
-                   const std::string *textureFilename)
+template<typename IndexType>
+FORCE_INLINE char * writeFace(char *dst, const Triangle &t, const cv::Point2f *uv)
 {
-    std::ofstream ply{ filename, std::ios::binary };
-    const auto header = plyHeader(vertices, triangles, uv, textureFilename);
-    ply.write(header.c_str(), header.length());
+    constexpr uint8_t numSides = 3, numUv = numSides * 2;
+    *dst++ = char(numSides);
 
-    if (ply && vertices)
-        ply.write((const char *)vertices->data(), vertices->size() * sizeof(cv::Point3f));
+    const IndexType idx[numSides] = { IndexType(t.p1), IndexType(t.p2), IndexType(t.p3) };
+    memcpy(dst, idx, sizeof(idx));
+    dst += sizeof(idx);
 
-    if (ply && triangles)
+    if (uv)
     {
-        constexpr char numSides = 3, numUv = numSides * 2;
-        std::vector<cv::Point2f> faceUv(numSides);
-        for (size_t i = 0; i < triangles->size(); ++i)
-        {
-            ply.write(&numSides, sizeof(numSides));
-            const Triangle &t = (*triangles)[i];
+        *dst++ = char(numUv);
+        const cv::Point2f faceUv[numSides] = { uv[t.p1], uv[t.p2], uv[t.p3] };
+        memcpy(dst, faceUv, sizeof(faceUv));
+        dst += sizeof(faceUv);
+    }
 
-            for (size_t j = 0; j < numSides; ++j)
-            {
-                const uint16_t *p = &t.p1 + j;
-                const int idx = *p;
-                ply.write((char *)&idx, sizeof(idx));
+    return dst;
+}
 
-                if (uv)
-                    faceUv[j] = (*uv)[idx];
-            }
+template<typename IndexType>
+void writeFaces(char *dst, const Triangle *triangles, size_t numTriangles, const cv::Point2f *uv, size_t faceSize)
+{
+    // face records have fixed size, so the block can be split into independent chunks
+    constexpr size_t chunkSize = 16 * 1024;
+    const int numChunks = int((numTriangles + chunkSize - 1) / chunkSize);
+    auto writeChunk = [&](int chunk)
+    {
+        const size_t begin = chunk * chunkSize, end = std::min(begin + chunkSize, numTriangles);
+        char *p = dst + begin * faceSize;
+        for (size_t i = begin; i < end; ++i)
+            p = writeFace<IndexType>(p, triangles[i], uv);
+    };
 
-            if (uv)
-            {
-                ply.write(&numUv, sizeof(numUv));
-                ply.write((const char *)faceUv.data(), faceUv.size() * sizeof(cv::Point2f));
-            }
+    if (numChunks > 1)
+        threadPool().parallelFor(0, numChunks, writeChunk);
+    else if (numChunks == 1)
+        writeChunk(0);
+}
+
+}
+
+
+void serializeBinaryPly(std::vector<char> &buffer,
+                        const std::vector<cv::Point3f> *vertices,
+                        const std::vector<Triangle> *triangles,
+                        const std::vector<cv::Point2f> *uv,
+                        const std::string *textureFilename,
+                        const PlyOptions &options)
+{
+    const auto header = plyHeader(vertices, triangles, uv, textureFilename, options);
+
+    const bool vertexUv = vertices && uv && options.perVertexUv, faceUv = triangles && uv && !options.perVertexUv;
+    const size_t numVertices = vertices ? vertices->size() : 0, numTriangles = triangles ? triangles->size() : 0;
+    const size_t vertexSize = sizeof(cv::Point3f) + (vertexUv ? sizeof(cv::Point2f) : 0);
+    const size_t faceSize = 1 + 3 * plyIndexSize(options.indexType) + (faceUv ? 1 + 3 * sizeof(cv::Point2f) : 0);
+
+    buffer.resize(header.size() + numVertices * vertexSize + numTriangles * faceSize);
+    char *dst = buffer.data();
+    memcpy(dst, header.data(), header.size());
+    dst += header.size();
+
+    if (vertexUv)
+    {
+        for (size_t i = 0; i < numVertices; ++i, dst += vertexSize)
+        {
+            memcpy(dst, &(*vertices)[i], sizeof(cv::Point3f));
+            memcpy(dst + sizeof(cv::Point3f), &(*uv)[i], sizeof(cv::Point2f));
         }
     }
+    else if (numVertices)
+    {
+        memcpy(dst, vertices->data(), numVertices * vertexSize);
+        dst += numVertices * vertexSize;
+    }
 
+    if (numTriangles)
+    {
+        const cv::Point2f *faceUvPtr = faceUv ? uv->data() : nullptr;
+        if (options.indexType == PlyIndexType::USHORT)
+            writeFaces<uint16_t>(dst, triangles->data(), numTriangles, faceUvPtr, faceSize);
+        else if (options.indexType == PlyIndexType::UINT)
+            writeFaces<uint32_t>(dst, triangles->data(), numTriangles, faceUvPtr, faceSize);
+        else
+            writeFaces<int32_t>(dst, triangles->data(), numTriangles, faceUvPtr, faceSize);
+    }
+}
+
+bool saveBinaryPly(const std::string &filename,
+                   const std::vector<cv::Point3f> *vertices,
+                   const std::vector<Triangle> *triangles,
+                   const std::vector<cv::Point2f> *uv,
+                   const std::string *textureFilename,
+                   const PlyOptions &options)
+{
+    // reuse the buffer between calls on the same thread to avoid page faults on every frame
+    thread_local std::vector<char> buffer;
+    serializeBinaryPly(buffer, vertices, triangles, uv, textureFilename, options);
+
+    std::ofstream ply{ filename, std::ios::binary };
+    ply.write(buffer.data(), buffer.size());
     return bool(ply);
 }
@@ -0,0 +1,118 @@
+#if defined(_WIN32)
+    #define NOMINMAX
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include <util/tiny_logger.hpp>
+#include <util/memory_mapped_file.hpp>
+
+
+MemoryMappedFile::MemoryMappedFile(const std::string &filename)
+{
+    open(filename);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MemoryMappedFile::open(const std::string &filename)
+{
+    close();
+
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle)
+        ptr = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if (!ptr)
+    {
+        TLOG(ERROR) << "Could not map file " << filename << ", error " << GetLastError();
+        close();
+        return false;
+    }
+
+    fileSize = size_t(size.QuadPart);
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+
+    ptr = nullptr, mappingHandle = fileHandle = nullptr;
+    fileSize = 0;
+}
+
+#else
+
+bool MemoryMappedFile::open(const std::string &filename)
+{
+    close();
+
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        TLOG(ERROR) << "Could not map file " << filename;
+        close();
+        return false;
+    }
+
+    // most users parse the file front to back
+    madvise(mapped, size_t(st.st_size), MADV_SEQUENTIAL);
+
+    ptr = (const char *)mapped;
+    fileSize = size_t(st.st_size);
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (ptr)
+        munmap((void *)ptr, fileSize);
+    if (fd >= 0)
+        ::close(fd);
+
+    ptr = nullptr, fd = -1;
+    fileSize = 0;
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include <cmath>
+#include <algorithm>
+
+#include <util/mesh_optimization.hpp>
+
+
+namespace
+{
+
+constexpr int maxCacheSize = 64;
+
+/// Score of the vertex from Forsyth's article, higher means the vertex should be used sooner.
+float vertexScore(int cachePosition, int numRemainingTriangles, int cacheSize)
+{
+    if (numRemainingTriangles == 0)
+        return -1;
+
+    float score = 0;
+    if (cachePosition >= 0)
+    {
+        // vertices of the last triangle get a fixed score, otherwise the strip direction would be too rigid
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / (cacheSize - 3), 1.5f);
+    }
+
+    // vertices with few triangles left are prioritized, so no lonely triangles are left behind
+    score += 2.0f / std::sqrt(float(numRemainingTriangles));
+    return score;
+}
+
+FORCE_INLINE const uint16_t * indices(const Triangle &t)
+{
+    return &t.p1;
+}
+
+}
+
+
+VertexCacheStats analyzeVertexCache(const std::vector<Triangle> &triangles, size_t numVertices, int cacheSize)
+{
+    VertexCacheStats stats;
+    if (triangles.empty())
+        return stats;
+
+    // FIFO cache: a vertex is in the cache if it was transformed within the last cacheSize misses
+    std::vector<int64_t> missTime(numVertices, -int64_t(cacheSize) - 1);
+    std::vector<bool> used(numVertices, false);
+    int64_t numMisses = 0;
+    size_t numUsed = 0;
+
+    for (const auto &t : triangles)
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint16_t v = indices(t)[k];
+            if (numMisses - missTime[v] > cacheSize)
+                missTime[v] = numMisses++;
+
+            if (!used[v])
+                used[v] = true, ++numUsed;
+        }
+
+    stats.acmr = float(numMisses) / triangles.size();
+    stats.atvr = float(numMisses) / numUsed;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<Triangle> &triangles, size_t numVertices, int cacheSize)
+{
+    const size_t numTriangles = triangles.size();
+    if (numTriangles < 2)
+        return;
+
+    cacheSize = std::min(std::max(cacheSize, 4), maxCacheSize);
+
+    // vertex -> triangles adjacency in one array, the first numRemaining[v] entries are the triangles not emitted yet
+    std::vector<int> numRemaining(numVertices, 0);
+    for (const auto &t : triangles)
+        ++numRemaining[t.p1], ++numRemaining[t.p2], ++numRemaining[t.p3];
+
+    std::vector<int> adjacencyOffset(numVertices + 1, 0);
+    for (size_t v = 0; v < numVertices; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + numRemaining[v];
+
+    std::vector<int> adjacency(adjacencyOffset.back());
+    {
+        std::vector<int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < numTriangles; ++i)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[indices(triangles[i])[k]]++] = int(i);
+    }
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> score(numVertices);
+    for (size_t v = 0; v < numVertices; ++v)
+        score[v] = vertexScore(-1, numRemaining[v], cacheSize);
+
+    std::vector<float> triangleScore(numTriangles);
+    std::vector<bool> emitted(numTriangles, false);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        const Triangle &t = triangles[i];
+        triangleScore[i] = score[t.p1] + score[t.p2] + score[t.p3];
+    }
+
+    // the three vertices of the new triangle are pushed in front, entries that fall out are in the tail
+    int cache[maxCacheSize + 3], newCache[maxCacheSize + 3];
+    int cacheUsed = 0;
+
+    std::vector<Triangle> result;
+    result.reserve(numTriangles);
+
+    int best = int(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+    size_t nextCandidate = 0;
+
+    while (result.size() < numTriangles)
+    {
+        if (best < 0)
+        {
+            // nothing adjacent to the cache, continue with the first triangle left in the input order
+            while (emitted[nextCandidate])
+                ++nextCandidate;
+            best = int(nextCandidate);
+        }
+
+        const Triangle &t = triangles[best];
+        result.push_back(t);
+        emitted[best] = true;
+
+        int newCacheUsed = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const int v = indices(t)[k];
+
+            // remove the triangle from the active part of the adjacency list
+            int *begin = &adjacency[adjacencyOffset[v]], *end = begin + numRemaining[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            --numRemaining[v];
+
+            if (std::find(newCache, newCache + newCacheUsed, v) == newCache + newCacheUsed)
+                newCache[newCacheUsed++] = v;
+        }
+
+        const int numFront = newCacheUsed;
+        for (int i = 0; i < cacheUsed; ++i)
+            if (std::find(newCache, newCache + numFront, cache[i]) == newCache + numFront)
+                newCache[newCacheUsed++] = cache[i];
+
+        for (int i = 0; i < newCacheUsed; ++i)
+        {
+            const int v = newCache[i];
+            cachePosition[v] = i < cacheSize ? i : -1;
+            score[v] = vertexScore(cachePosition[v], numRemaining[v], cacheSize);
+        }
+
+        // only the triangles around the touched vertices change the score, the best one is among them
+        best = -1;
+        float bestScore = -1;
+        for (int i = 0; i < newCacheUsed; ++i)
+        {
+            const int v = newCache[i];
+            for (int j = adjacencyOffset[v]; j < adjacencyOffset[v] + numRemaining[v]; ++j)
+            {
+                const int tri = adjacency[j];
+                const Triangle &candidate = triangles[tri];
+                triangleScore[tri] = score[candidate.p1] + score[candidate.p2] + score[candidate.p3];
+                if (triangleScore[tri] > bestScore)
+                    best = tri, bestScore = triangleScore[tri];
+            }
+        }
+
+        cacheUsed = std::min(newCacheUsed, cacheSize);
+        std::copy(newCache, newCache + cacheUsed, cache);
+    }
+
+    triangles.swap(result);
+}
+
+size_t optimizeVertexFetch(std::vector<Triangle> &triangles, size_t numVertices, std::vector<int> &remap)
+{
+    remap.assign(numVertices, -1);
+    int numUsed = 0;
+    for (auto &t : triangles)
+    {
+        uint16_t *idx = &t.p1;  // Triangle is three uint16_t, no padding
+        for (int k = 0; k < 3; ++k)
+        {
+            int &newIndex = remap[idx[k]];
+            if (newIndex < 0)
+                newIndex = numUsed++;
+            idx[k] = uint16_t(newIndex);
+        }
+    }
+
+    return size_t(numUsed);
+}
@@ -0,0 +1,306 @@
+#include <cmath>
+#include <algorithm>
+#include <unordered_set>
+
+#include <util/mesh_optimization.hpp>
+#include <util/mesh_simplification.hpp>
+
+
+namespace
+{
+
+/// Boundary constraint planes are weighted stronger than the surface, otherwise holes and silhouettes shrink.
+constexpr double boundaryWeight = 10;
+
+/// Collapses are done in passes, every pass collapses independent edges in the order of the cost.
+constexpr int maxPasses = 32;
+
+/// Sum of squared distances to a set of planes, weighted by the triangle area.
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double weight = 0;
+
+    /// Plane n * p + d = 0, n is a unit vector.
+    void addPlane(const cv::Point3d &n, double d, double w)
+    {
+        a00 += w * n.x * n.x, a01 += w * n.x * n.y, a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y, a12 += w * n.y * n.z, a22 += w * n.z * n.z;
+        b0 += w * n.x * d, b1 += w * n.y * d, b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    Quadric & operator+=(const Quadric &q)
+    {
+        a00 += q.a00, a01 += q.a01, a02 += q.a02, a11 += q.a11, a12 += q.a12, a22 += q.a22;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2, c += q.c;
+        weight += q.weight;
+        return *this;
+    }
+
+    /// Weighted mean of the squared distances.
+    double error(const cv::Point3f &p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                       + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0 ? std::max(e, 0.0) / weight : 0;
+    }
+};
+
+struct Collapse
+{
+    int from, to;
+    double cost;
+
+    bool operator<(const Collapse &other) const { return cost < other.cost; }
+};
+
+FORCE_INLINE uint32_t edgeKey(int a, int b)
+{
+    return (uint32_t(a) << 16) | uint32_t(b);
+}
+
+FORCE_INLINE cv::Point3d toDouble(const cv::Point3f &p)
+{
+    return cv::Point3d(p.x, p.y, p.z);
+}
+
+FORCE_INLINE cv::Point3d triangleNormal(const cv::Point3f &p1, const cv::Point3f &p2, const cv::Point3f &p3)
+{
+    return (toDouble(p2) - toDouble(p1)).cross(toDouble(p3) - toDouble(p1));
+}
+
+/// Vertex -> triangles adjacency of the current mesh.
+struct Adjacency
+{
+    std::vector<int> offsets, triangles;
+
+    Adjacency(const std::vector<Triangle> &mesh, size_t numVertices)
+        : offsets(numVertices + 1, 0)
+        , triangles(3 * mesh.size())
+    {
+        for (const auto &t : mesh)
+            ++offsets[t.p1 + 1], ++offsets[t.p2 + 1], ++offsets[t.p3 + 1];
+        for (size_t v = 0; v < numVertices; ++v)
+            offsets[v + 1] += offsets[v];
+
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < mesh.size(); ++i)
+        {
+            const Triangle &t = mesh[i];
+            triangles[fill[t.p1]++] = triangles[fill[t.p2]++] = triangles[fill[t.p3]++] = int(i);
+        }
+    }
+
+    const int * begin(int v) const { return triangles.data() + offsets[v]; }
+    const int * end(int v) const { return triangles.data() + offsets[v + 1]; }
+};
+
+FORCE_INLINE bool contains(const Triangle &t, int v)
+{
+    return t.p1 == v || t.p2 == v || t.p3 == v;
+}
+
+void neighbours(const std::vector<Triangle> &mesh, const Adjacency &adjacency, int v, std::vector<int> &result)
+{
+    result.clear();
+    for (const int *tri = adjacency.begin(v); tri != adjacency.end(v); ++tri)
+    {
+        const Triangle &t = mesh[*tri];
+        for (int u : { int(t.p1), int(t.p2), int(t.p3) })
+            if (u != v && std::find(result.begin(), result.end(), u) == result.end())
+                result.push_back(u);
+    }
+}
+
+/// Moving vertex "from" into "to" must not flip the remaining triangles around it, otherwise the surface folds.
+bool flipsTriangles(const std::vector<cv::Point3f> &cloud, const std::vector<Triangle> &mesh, const Adjacency &adjacency, int from, int to)
+{
+    for (const int *tri = adjacency.begin(from); tri != adjacency.end(from); ++tri)
+    {
+        const Triangle &t = mesh[*tri];
+        if (contains(t, to))
+            continue;  // this triangle collapses
+
+        const cv::Point3f &p1 = t.p1 == from ? cloud[to] : cloud[t.p1];
+        const cv::Point3f &p2 = t.p2 == from ? cloud[to] : cloud[t.p2];
+        const cv::Point3f &p3 = t.p3 == from ? cloud[to] : cloud[t.p3];
+        const cv::Point3d before = triangleNormal(cloud[t.p1], cloud[t.p2], cloud[t.p3]), after = triangleNormal(p1, p2, p3);
+
+        // also reject nearly degenerate results, they produce shading artifacts
+        if (before.dot(after) <= 0.25 * cv::norm(before) * cv::norm(after))
+            return true;
+    }
+    return false;
+}
+
+}
+
+
+size_t simplifyMesh(const std::vector<cv::Point3f> &cloud,
+                    std::vector<Triangle> &triangles,
+                    const SimplificationSettings &settings,
+                    std::vector<int> &remap)
+{
+    const size_t numVertices = cloud.size();
+    const double maxCost = double(settings.maxError) * settings.maxError;
+
+    // surface quadrics never change, the quadric of the surviving vertex accumulates the collapsed ones
+    std::vector<Quadric> quadrics(numVertices);
+    for (const auto &t : triangles)
+    {
+        cv::Point3d n = triangleNormal(cloud[t.p1], cloud[t.p2], cloud[t.p3]);
+        const double doubleArea = cv::norm(n);
+        if (doubleArea <= 0)
+            continue;
+
+        n *= 1.0 / doubleArea;
+        const double d = -n.dot(toDouble(cloud[t.p1]));
+        for (int v : { int(t.p1), int(t.p2), int(t.p3) })
+            quadrics[v].addPlane(n, d, 0.5 * doubleArea);
+    }
+
+    std::vector<bool> isBoundary(numVertices), locked(numVertices);
+    std::vector<int> collapseTo(numVertices);
+    std::vector<Collapse> candidates;
+    std::vector<int> neighboursFrom, neighboursTo;
+    std::unordered_set<uint32_t> directedEdges;
+
+    for (int pass = 0; pass < maxPasses && triangles.size() > settings.targetTriangles; ++pass)
+    {
+        // an edge is on the boundary if there is no triangle with the opposite edge direction
+        directedEdges.clear();
+        for (const auto &t : triangles)
+            directedEdges.insert(edgeKey(t.p1, t.p2)), directedEdges.insert(edgeKey(t.p2, t.p3)), directedEdges.insert(edgeKey(t.p3, t.p1));
+
+        const auto isBoundaryEdge = [&](int a, int b)
+        {
+            return !directedEdges.count(edgeKey(b, a)) || !directedEdges.count(edgeKey(a, b));
+        };
+
+        std::fill(isBoundary.begin(), isBoundary.end(), false);
+        for (const auto &t : triangles)
+        {
+            const int v[3] = { t.p1, t.p2, t.p3 };
+            for (int k = 0; k < 3; ++k)
+            {
+                const int a = v[k], b = v[(k + 1) % 3];
+                if (directedEdges.count(edgeKey(b, a)))
+                    continue;
+
+                isBoundary[a] = isBoundary[b] = true;
+
+                // first pass only: constraint plane through the boundary edge, perpendicular to the triangle
+                if (pass == 0)
+                {
+                    const cv::Point3d edge = toDouble(cloud[b]) - toDouble(cloud[a]);
+                    cv::Point3d n = edge.cross(triangleNormal(cloud[t.p1], cloud[t.p2], cloud[t.p3]));
+                    const double norm = cv::norm(n);
+                    if (norm <= 0)
+                        continue;
+
+                    n *= 1.0 / norm;
+                    const double d = -n.dot(toDouble(cloud[a]));
+                    const double w = boundaryWeight * edge.dot(edge);
+                    quadrics[a].addPlane(n, d, w), quadrics[b].addPlane(n, d, w);
+                }
+            }
+        }
+
+        // every edge once, the cheaper allowed direction
+        candidates.clear();
+        for (const auto &t : triangles)
+        {
+            const int v[3] = { t.p1, t.p2, t.p3 };
+            for (int k = 0; k < 3; ++k)
+            {
+                const int a = v[k], b = v[(k + 1) % 3];
+                const bool boundaryEdge = isBoundaryEdge(a, b);
+                if (a > b && !boundaryEdge)
+                    continue;  // interior edges are seen twice
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+
+                Collapse best{ -1, -1, maxCost };
+                if (!isBoundary[a] || boundaryEdge)
+                {
+                    const double cost = q.error(cloud[b]);
+                    if (cost <= best.cost)
+                        best = Collapse{ a, b, cost };
+                }
+                if (!isBoundary[b] || boundaryEdge)
+                {
+                    const double cost = q.error(cloud[a]);
+                    if (cost <= best.cost)
+                        best = Collapse{ b, a, cost };
+                }
+
+                if (best.from >= 0)
+                    candidates.push_back(best);
+            }
+        }
+
+        if (candidates.empty())
+            break;
+
+        std::sort(candidates.begin(), candidates.end());
+
+        const Adjacency adjacency(triangles, numVertices);
+        std::fill(locked.begin(), locked.end(), false);
+        for (size_t v = 0; v < numVertices; ++v)
+            collapseTo[v] = int(v);
+
+        // interior collapse removes two triangles, don't overshoot the target by much
+        const size_t maxCollapses = (triangles.size() - settings.targetTriangles + 1) / 2;
+        size_t numCollapses = 0;
+
+        for (const auto &c : candidates)
+        {
+            if (numCollapses >= maxCollapses)
+                break;
+            if (locked[c.from] || locked[c.to])
+                continue;
+
+            // link condition: the endpoints may share only the vertices opposite to the edge
+            neighbours(triangles, adjacency, c.from, neighboursFrom);
+            neighbours(triangles, adjacency, c.to, neighboursTo);
+            int numShared = 0;
+            for (int u : neighboursFrom)
+                numShared += std::find(neighboursTo.begin(), neighboursTo.end(), u) != neighboursTo.end();
+            if (numShared > (isBoundaryEdge(c.from, c.to) ? 1 : 2))
+                continue;
+
+            if (flipsTriangles(cloud, triangles, adjacency, c.from, c.to))
+                continue;
+
+            collapseTo[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+
+            // the neighbourhood is stale now, it can't take part in other collapses of this pass
+            locked[c.from] = locked[c.to] = true;
+            for (int u : neighboursFrom)
+                locked[u] = true;
+
+            ++numCollapses;
+        }
+
+        if (!numCollapses)
+            break;
+
+        // targets are locked, so one step of the remap is enough
+        size_t numKept = 0;
+        for (const auto &t : triangles)
+        {
+            const Triangle collapsed{ uint16_t(collapseTo[t.p1]), uint16_t(collapseTo[t.p2]), uint16_t(collapseTo[t.p3]) };
+            if (collapsed.p1 != collapsed.p2 && collapsed.p2 != collapsed.p3 && collapsed.p3 != collapsed.p1)
+                triangles[numKept++] = collapsed;
+        }
+        triangles.resize(numKept);
+    }
+
+    return optimizeVertexFetch(triangles, numVertices, remap);
+}
@@ -1,3 +1,10 @@
+#include <cstring>
+
+#ifdef WITH_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
 #include <glm/glm.hpp>
 
 #include <util/tiny_logger.hpp>
@@ -39,11 +46,101 @@ GLuint loadShader(int kind, const std::string &code, const std::string &shaderNa
 }
 
 
+void initGlew()
+{
+    glewExperimental = GL_TRUE;  // core profile contexts (e.g. Mesa) don't report all the entry points otherwise
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX complains in EGL contexts (offscreen rendering), GL entry points are loaded anyway
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewStatus = GLEW_OK;
+#endif
+    TLOG_IF(FATAL, glewStatus != GLEW_OK) << "could not initialize GLEW";
+}
+
+OffscreenContext::OffscreenContext()
+{
+#ifdef WITH_EGL
+    // surfaceless platform does not need X or a GPU device, otherwise take whatever is the default
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+    {
+        TLOG(ERROR) << "Could not initialize EGL display";
+        return;
+    }
+    display = eglDisplay;
+    TLOG(INFO) << "EGL " << major << "." << minor << ", vendor: " << eglQueryString(eglDisplay, EGL_VENDOR);
+
+    // no window configs on the surfaceless platform, pbuffer ones exist everywhere
+    const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs < 1)
+    {
+        TLOG(ERROR) << "No EGL config for desktop OpenGL";
+        return;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE,
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT)
+    {
+        TLOG(ERROR) << "Could not create OpenGL 3.3 context, EGL error " << eglGetError();
+        return;
+    }
+
+    // no surface, the caller renders to its own framebuffers
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+    {
+        TLOG(ERROR) << "Could not make context current, EGL error " << eglGetError();
+        eglDestroyContext(eglDisplay, eglContext);
+        return;
+    }
+    context = eglContext;
+
+    // framebuffers and buffers may be created before the first shader, load the entry points right away
+    initGlew();
+#else
+    TLOG(ERROR) << "Offscreen OpenGL context requires EGL, rebuild with WITH_EGL";
+#endif
+}
+
+OffscreenContext::~OffscreenContext()
+{
+#ifdef WITH_EGL
+    if (context)
+    {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+    if (display)
+        eglTerminate(display);
+#endif
+}
+
+bool OffscreenContext::isValid() const
+{
+    return context != nullptr;
+}
+
 ShaderLoader::ShaderLoader(const std::string &vShaderCode, const std::string &fShaderCode, const std::string &name)
     : program(0)
     , name(name)
 {
-    TLOG_IF(FATAL, glewInit() != GLEW_OK) << "could not initialize GLEW";
+    initGlew();
 
     vShader = loadShader(GL_VERTEX_SHADER, vShaderCode, name);
     fShader = loadShader(GL_FRAGMENT_SHADER, fShaderCode, name);
@@ -87,6 +184,212 @@ GLint ShaderLoader::getProgram() const
     return program;
 }
 
+StreamingBuffer::StreamingBuffer(GLenum target, size_t regionCapacity, int numRegions, bool allowPersistent)
+    : target(target)
+    , regionCapacity(0)
+    , numRegions(numRegions)
+    , fences(size_t(numRegions), nullptr)
+{
+    persistent = allowPersistent && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+    TLOG(INFO) << "Streaming buffer, persistent mapping: " << persistent;
+    allocate(regionCapacity);
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    release();
+}
+
+size_t StreamingBuffer::upload(const void *data, size_t size)
+{
+    if (size > regionCapacity)
+    {
+        // glDeleteBuffers is deferred by the driver until the pending draw calls are done
+        release();
+        allocate(size + size / 2);
+    }
+
+    glBindBuffer(target, buffer);
+
+    if (!persistent)
+    {
+        // orphaning: the driver hands out fresh storage while the GPU still reads the old one
+        glBufferData(target, regionCapacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, size, data);
+        return 0;
+    }
+
+    currentRegion = (currentRegion + 1) % numRegions;
+    waitForRegion(currentRegion);
+
+    const size_t offset = currentRegion * regionCapacity;
+    memcpy(mapped + offset, data, size);
+    return offset;
+}
+
+void StreamingBuffer::fence()
+{
+    if (!persistent)
+        return;
+
+    GLsync &regionFence = fences[currentRegion];
+    if (regionFence)
+        glDeleteSync(regionFence);
+    regionFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint StreamingBuffer::getBuffer() const
+{
+    return buffer;
+}
+
+bool StreamingBuffer::isPersistent() const
+{
+    return persistent;
+}
+
+void StreamingBuffer::allocate(size_t capacity)
+{
+    // attribute offsets must be aligned, use the common GPU alignment
+    constexpr size_t alignment = 256;
+    regionCapacity = (capacity + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    if (!persistent)
+    {
+        glBufferData(target, regionCapacity, nullptr, GL_STREAM_DRAW);
+        return;
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const size_t totalSize = regionCapacity * numRegions;
+    glBufferStorage(target, totalSize, nullptr, flags);
+    mapped = static_cast<char *>(glMapBufferRange(target, 0, totalSize, flags));
+    TLOG_IF(FATAL, !mapped) << "could not map streaming buffer of size " << totalSize;
+}
+
+void StreamingBuffer::release()
+{
+    for (GLsync &regionFence : fences)
+    {
+        if (regionFence)
+            glDeleteSync(regionFence);
+        regionFence = nullptr;
+    }
+
+    if (!buffer)
+        return;
+
+    if (mapped)
+    {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void StreamingBuffer::waitForRegion(int region)
+{
+    GLsync &regionFence = fences[region];
+    if (!regionFence)
+        return;
+
+    constexpr GLuint64 timeoutNs = 1000000;
+    GLenum status = glClientWaitSync(regionFence, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(regionFence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+    TLOG_IF(ERROR, status == GL_WAIT_FAILED) << "glClientWaitSync failed";
+
+    glDeleteSync(regionFence);
+    regionFence = nullptr;
+}
+
+TextureStreamer::TextureStreamer(int mipmapInterval)
+    : mipmapInterval(mipmapInterval)
+    , pixelBuffer(GL_PIXEL_UNPACK_BUFFER, 4 << 20)
+{
+    // leave the pixel buffer unbound, regular texture uploads read from it otherwise
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    if (texture)
+        glDeleteTextures(1, &texture);
+}
+
+void TextureStreamer::upload(const cv::Mat &image, cv::Rect rect)
+{
+    assert(image.type() == CV_8UC3);
+
+    if (image.size() != size)
+        allocate(image.size());
+    if (rect.area() <= 0)
+        rect = cv::Rect(cv::Point(0, 0), size);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // whole rows of the rect are contiguous in memory, the horizontal part is selected by the pixel store params
+    const size_t rowBytes = image.cols * image.elemSize();
+    const size_t offset = pixelBuffer.upload(image.ptr(rect.y), (rect.height - 1) * image.step + rowBytes);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(image.step / image.elemSize()));
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_BGR, GL_UNSIGNED_BYTE, (void *)offset);
+    pixelBuffer.fence();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (numLevels > 1 && numUploads % mipmapInterval == 0)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    ++numUploads;
+}
+
+GLuint TextureStreamer::getTexture() const
+{
+    return texture;
+}
+
+void TextureStreamer::allocate(const cv::Size &newSize)
+{
+    // immutable storage can't be resized, just start over with the new texture
+    if (texture)
+        glDeleteTextures(1, &texture);
+
+    size = newSize;
+    numLevels = 1;
+    if (mipmapInterval > 0)
+        while ((std::max(size.width, size.height) >> numLevels) > 0)
+            ++numLevels;
+    numUploads = 0;
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+        glTexStorage2D(GL_TEXTURE_2D, numLevels, GL_RGB8, size.width, size.height);
+    else
+    {
+        for (int level = 0; level < numLevels; ++level)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGB8, std::max(size.width >> level, 1), std::max(size.height >> level, 1), 0, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    TLOG(INFO) << "Texture " << size.width << "x" << size.height << ", " << numLevels << " levels";
+}
+
 // http://www.songho.ca/opengl/gl_projectionmatrix.html
 glm::mat4 projectionMatrixFromPinholeCamera(const CameraParams &c, float near, float far)
 {
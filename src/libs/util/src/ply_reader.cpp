@@ -0,0 +1,475 @@
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+
+#include <util/util.hpp>
+#include <util/ply_reader.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/string_utils.hpp>
+
+
+namespace
+{
+
+bool isLittleEndianHost()
+{
+    const uint16_t x = 1;
+    return *(const uint8_t *)&x == 1;
+}
+
+template<typename T>
+FORCE_INLINE T load(const char *p, bool swap)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));
+    if (swap)
+        endianSwap(&value);
+    return value;
+}
+
+template<typename Dst>
+FORCE_INLINE Dst loadAs(const char *p, PlyType type, bool swap)
+{
+    switch (type)
+    {
+    case PlyType::CHAR: return Dst(load<int8_t>(p, swap));
+    case PlyType::UCHAR: return Dst(load<uint8_t>(p, swap));
+    case PlyType::SHORT: return Dst(load<int16_t>(p, swap));
+    case PlyType::USHORT: return Dst(load<uint16_t>(p, swap));
+    case PlyType::INT: return Dst(load<int32_t>(p, swap));
+    case PlyType::UINT: return Dst(load<uint32_t>(p, swap));
+    case PlyType::FLOAT: return Dst(load<float>(p, swap));
+    case PlyType::DOUBLE: return Dst(load<double>(p, swap));
+    default: return Dst();
+    }
+}
+
+template<typename Dst>
+FORCE_INLINE void storeAs(char *dst, const char *src, PlyType srcType, bool swap)
+{
+    const Dst value = loadAs<Dst>(src, srcType, swap);
+    memcpy(dst, &value, sizeof(value));
+}
+
+/// Convert a single value of srcType into dstType, dst is not necessarily aligned.
+void convertScalar(char *dst, PlyType dstType, const char *src, PlyType srcType, bool swap)
+{
+    switch (dstType)
+    {
+    case PlyType::CHAR: storeAs<int8_t>(dst, src, srcType, swap); break;
+    case PlyType::UCHAR: storeAs<uint8_t>(dst, src, srcType, swap); break;
+    case PlyType::SHORT: storeAs<int16_t>(dst, src, srcType, swap); break;
+    case PlyType::USHORT: storeAs<uint16_t>(dst, src, srcType, swap); break;
+    case PlyType::INT: storeAs<int32_t>(dst, src, srcType, swap); break;
+    case PlyType::UINT: storeAs<uint32_t>(dst, src, srcType, swap); break;
+    case PlyType::FLOAT: storeAs<float>(dst, src, srcType, swap); break;
+    case PlyType::DOUBLE: storeAs<double>(dst, src, srcType, swap); break;
+    default: break;
+    }
+}
+
+std::vector<std::string> tokenize(const std::string &line)
+{
+    std::istringstream stream(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (stream >> token)
+        tokens.emplace_back(token);
+    return tokens;
+}
+
+}
+
+
+PlyType plyTypeFromString(const std::string &type)
+{
+    if (type == "char" || type == "int8") return PlyType::CHAR;
+    if (type == "uchar" || type == "uint8") return PlyType::UCHAR;
+    if (type == "short" || type == "int16") return PlyType::SHORT;
+    if (type == "ushort" || type == "uint16") return PlyType::USHORT;
+    if (type == "int" || type == "int32") return PlyType::INT;
+    if (type == "uint" || type == "uint32") return PlyType::UINT;
+    if (type == "float" || type == "float32") return PlyType::FLOAT;
+    if (type == "double" || type == "float64") return PlyType::DOUBLE;
+    return PlyType::INVALID;
+}
+
+size_t plyTypeSize(PlyType type)
+{
+    switch (type)
+    {
+    case PlyType::CHAR: case PlyType::UCHAR: return 1;
+    case PlyType::SHORT: case PlyType::USHORT: return 2;
+    case PlyType::INT: case PlyType::UINT: case PlyType::FLOAT: return 4;
+    case PlyType::DOUBLE: return 8;
+    default: return 0;
+    }
+}
+
+int PlyElement::propertyIndex(const std::string &propertyName) const
+{
+    for (size_t i = 0; i < properties.size(); ++i)
+        if (properties[i].name == propertyName)
+            return int(i);
+    return -1;
+}
+
+bool PlyReader::open(const std::string &filename)
+{
+    elementList.clear(), commentList.clear();
+    if (!file.open(filename))
+    {
+        TLOG(ERROR) << "could not open " << filename;
+        return false;
+    }
+
+    return parseHeader() && computeLayout();
+}
+
+const PlyElement * PlyReader::element(const std::string &name) const
+{
+    for (const auto &e : elementList)
+        if (e.name == name)
+            return &e;
+    return nullptr;
+}
+
+bool PlyReader::parseHeader()
+{
+    const char *data = file.data(), *end = data + file.size();
+    const char *p = data;
+    bool isOk, formatFound = false;
+    int lineNumber = 0;
+
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+        {
+            TLOG(ERROR) << "unexpected end of ply header";
+            return false;
+        }
+
+        std::string line(p, eol);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        p = eol + 1;
+
+        if (lineNumber++ == 0)
+        {
+            if (line != "ply")
+            {
+                TLOG(ERROR) << "expected 'ply' header line, format not supported";
+                return false;
+            }
+            continue;
+        }
+
+        const auto tokens = tokenize(line);
+        if (tokens.empty())
+            continue;
+
+        const std::string &keyword = tokens.front();
+        if (keyword == "end_header")
+        {
+            headerSize = size_t(p - data);
+            break;
+        }
+        else if (keyword == "format")
+        {
+            if (tokens.size() != 3 || (tokens[1] != "binary_little_endian" && tokens[1] != "binary_big_endian"))
+            {
+                TLOG(ERROR) << "format " << line << " not supported, only binary ply files can be read";
+                return false;
+            }
+            bigEndian = tokens[1] == "binary_big_endian";
+            formatFound = true;
+        }
+        else if (keyword == "comment")
+        {
+            commentList.emplace_back(line.size() > keyword.size() + 1 ? line.substr(keyword.size() + 1) : std::string());
+        }
+        else if (keyword == "element" && tokens.size() == 3)
+        {
+            PlyElement element;
+            element.name = tokens[1];
+            element.count = stringTo<size_t>(tokens[2], isOk);
+            if (!isOk)
+            {
+                TLOG(ERROR) << "could not parse the element count, token is: " << tokens[2];
+                return false;
+            }
+            elementList.emplace_back(element);
+        }
+        else if (keyword == "property" && !elementList.empty())
+        {
+            PlyProperty property;
+            if (tokens.size() == 3)
+            {
+                property.type = plyTypeFromString(tokens[1]);
+                property.name = tokens[2];
+            }
+            else if (tokens.size() == 5 && tokens[1] == "list")
+            {
+                property.isList = true;
+                property.countType = plyTypeFromString(tokens[2]);
+                property.type = plyTypeFromString(tokens[3]);
+                property.name = tokens[4];
+            }
+
+            if (property.type == PlyType::INVALID || (property.isList && (property.countType == PlyType::INVALID || property.countType >= PlyType::FLOAT)))
+            {
+                TLOG(ERROR) << "could not parse property: " << line;
+                return false;
+            }
+            elementList.back().properties.emplace_back(property);
+        }
+        else if (keyword != "obj_info")
+        {
+            TLOG(WARNING) << "unknown header token: " << line;
+        }
+    }
+
+    if (!headerSize || !formatFound)
+    {
+        TLOG(ERROR) << "invalid ply header";
+        return false;
+    }
+
+    return true;
+}
+
+bool PlyReader::computeLayout()
+{
+    const char *data = file.data();
+    const size_t fileSize = file.size();
+    const bool swap = bigEndian == isLittleEndianHost();
+    size_t offset = headerSize;
+
+    for (auto &e : elementList)
+    {
+        e.dataOffset = offset;
+        e.propertyOffsets.clear(), e.recordOffsets.clear();
+
+        const bool hasLists = std::any_of(e.properties.begin(), e.properties.end(), [](const PlyProperty &p) { return p.isList; });
+        if (!hasLists)
+        {
+            e.fixedSize = true;
+            e.recordSize = 0;
+            for (const auto &p : e.properties)
+                e.propertyOffsets.push_back(e.recordSize), e.recordSize += plyTypeSize(p.type);
+
+            offset += e.count * e.recordSize;
+            if (offset > fileSize)
+            {
+                TLOG(ERROR) << "ply file is truncated, element " << e.name;
+                return false;
+            }
+            continue;
+        }
+
+        // records with lists have to be scanned to find where they start, but very often (e.g. triangle meshes)
+        // all lists have the same length, then the element is treated as fixed size
+        e.fixedSize = true;
+        e.recordOffsets.resize(e.count);
+        std::vector<size_t> firstLengths;
+        for (size_t i = 0; i < e.count; ++i)
+        {
+            e.recordOffsets[i] = offset - e.dataOffset;
+            size_t listIdx = 0;
+            for (const auto &p : e.properties)
+            {
+                size_t size = plyTypeSize(p.type);
+                if (p.isList)
+                {
+                    const size_t countSize = plyTypeSize(p.countType);
+                    const size_t length = offset + countSize <= fileSize ? loadAs<size_t>(data + offset, p.countType, swap) : fileSize;
+                    if (length >= fileSize)
+                    {
+                        TLOG(ERROR) << "ply file is truncated or corrupted, element " << e.name;
+                        return false;
+                    }
+
+                    if (i == 0)
+                        firstLengths.push_back(length);
+                    else if (firstLengths[listIdx] != length)
+                        e.fixedSize = false;
+                    ++listIdx;
+
+                    size = countSize + length * size;
+                }
+                offset += size;
+            }
+
+            if (offset > fileSize)
+            {
+                TLOG(ERROR) << "ply file is truncated, element " << e.name;
+                return false;
+            }
+        }
+
+        if (e.fixedSize && e.count > 0)
+        {
+            // offsets in the first record are valid for all records
+            e.recordSize = e.count > 1 ? e.recordOffsets[1] : offset - e.dataOffset;
+            const char *record = data + e.dataOffset;
+            size_t propertyOffset = 0;
+            for (const auto &p : e.properties)
+            {
+                e.propertyOffsets.push_back(propertyOffset);
+                if (p.isList)
+                    propertyOffset += plyTypeSize(p.countType) + loadAs<size_t>(record + propertyOffset, p.countType, swap) * plyTypeSize(p.type);
+                else
+                    propertyOffset += plyTypeSize(p.type);
+            }
+            e.recordOffsets.clear();
+            e.recordOffsets.shrink_to_fit();
+        }
+    }
+
+    return true;
+}
+
+const char * PlyReader::recordPtr(const PlyElement &e, size_t i) const
+{
+    const char *begin = file.data() + e.dataOffset;
+    return e.fixedSize ? begin + i * e.recordSize : begin + e.recordOffsets[i];
+}
+
+bool PlyReader::findProperties(const std::string &elementName, const std::vector<std::string> &names, size_t itemSize, size_t scalarSize, PlyType scalarType,
+                               const char *&zeroCopyPtr, size_t &stride) const
+{
+    zeroCopyPtr = nullptr, stride = 0;
+
+    const PlyElement *e = element(elementName);
+    if (!e || itemSize != names.size() * scalarSize)
+        return false;
+
+    int first = -1;
+    bool sameType = true, consecutive = true;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        const int idx = e->propertyIndex(names[i]);
+        if (idx < 0 || e->properties[idx].isList)
+            return false;
+
+        if (i == 0)
+            first = idx;
+        consecutive = consecutive && idx == first + int(i);
+        sameType = sameType && e->properties[idx].type == scalarType;
+    }
+
+    const bool nativeEndian = bigEndian != isLittleEndianHost();
+    if (!nativeEndian || !sameType || !consecutive || !e->fixedSize || e->count == 0)
+        return true;
+
+    // mapping is page-aligned, so alignment of the absolute offset is what matters
+    const size_t offset = e->dataOffset + e->propertyOffsets[first];
+    if (offset % scalarSize || e->recordSize % scalarSize)
+        return true;
+
+    zeroCopyPtr = file.data() + offset;
+    stride = e->recordSize;
+    return true;
+}
+
+void PlyReader::convertProperties(const PlyElement &e, const std::vector<std::string> &names, PlyType dstType, char *dst) const
+{
+    const bool swap = bigEndian == isLittleEndianHost();
+    const size_t dstSize = plyTypeSize(dstType);
+
+    std::vector<int> indices;
+    for (const auto &name : names)
+        indices.push_back(e.propertyIndex(name));
+
+    for (size_t i = 0; i < e.count; ++i)
+    {
+        const char *record = recordPtr(e, i);
+        for (size_t k = 0; k < indices.size(); ++k, dst += dstSize)
+        {
+            const PlyProperty &p = e.properties[indices[k]];
+            if (e.fixedSize)
+                convertScalar(dst, dstType, record + e.propertyOffsets[indices[k]], p.type, swap);
+            else
+            {
+                // variable size record, walk over the preceding properties
+                const char *src = record;
+                for (int j = 0; j < indices[k]; ++j)
+                {
+                    const PlyProperty &prev = e.properties[j];
+                    src += prev.isList ? plyTypeSize(prev.countType) + loadAs<size_t>(src, prev.countType, swap) * plyTypeSize(prev.type) : plyTypeSize(prev.type);
+                }
+                convertScalar(dst, dstType, src, p.type, swap);
+            }
+        }
+    }
+}
+
+bool PlyReader::countListItems(const std::string &elementName, const std::string &propertyName, size_t &totalItems) const
+{
+    const PlyElement *e = element(elementName);
+    const int idx = e ? e->propertyIndex(propertyName) : -1;
+    if (idx < 0 || !e->properties[idx].isList)
+        return false;
+
+    const bool swap = bigEndian == isLittleEndianHost();
+    const PlyProperty &p = e->properties[idx];
+    totalItems = 0;
+    if (e->fixedSize)
+    {
+        if (e->count)
+            totalItems = e->count * loadAs<size_t>(recordPtr(*e, 0) + e->propertyOffsets[idx], p.countType, swap);
+        return true;
+    }
+
+    for (size_t i = 0; i < e->count; ++i)
+    {
+        const char *src = recordPtr(*e, i);
+        for (int j = 0; j < idx; ++j)
+        {
+            const PlyProperty &prev = e->properties[j];
+            src += prev.isList ? plyTypeSize(prev.countType) + loadAs<size_t>(src, prev.countType, swap) * plyTypeSize(prev.type) : plyTypeSize(prev.type);
+        }
+        totalItems += loadAs<size_t>(src, p.countType, swap);
+    }
+    return true;
+}
+
+void PlyReader::readListItems(const std::string &elementName, const std::string &propertyName, PlyType dstType, char *dst, std::vector<uint32_t> *lengths) const
+{
+    const PlyElement &e = *element(elementName);
+    const int idx = e.propertyIndex(propertyName);
+    const PlyProperty &p = e.properties[idx];
+    const bool swap = bigEndian == isLittleEndianHost();
+    const size_t countSize = plyTypeSize(p.countType), srcSize = plyTypeSize(p.type), dstSize = plyTypeSize(dstType);
+    const bool plainCopy = p.type == dstType && !swap;
+
+    if (lengths)
+        lengths->resize(e.count);
+
+    for (size_t i = 0; i < e.count; ++i)
+    {
+        const char *src = recordPtr(e, i);
+        if (e.fixedSize)
+            src += e.propertyOffsets[idx];
+        else
+        {
+            for (int j = 0; j < idx; ++j)
+            {
+                const PlyProperty &prev = e.properties[j];
+                src += prev.isList ? plyTypeSize(prev.countType) + loadAs<size_t>(src, prev.countType, swap) * plyTypeSize(prev.type) : plyTypeSize(prev.type);
+            }
+        }
+
+        const size_t n = loadAs<size_t>(src, p.countType, swap);
+        src += countSize;
+        if (lengths)
+            (*lengths)[i] = uint32_t(n);
+
+        if (plainCopy)
+            memcpy(dst, src, n * srcSize), dst += n * dstSize;
+        else
+            for (size_t k = 0; k < n; ++k, src += srcSize, dst += dstSize)
+                convertScalar(dst, dstType, src, p.type, swap);
+    }
+}
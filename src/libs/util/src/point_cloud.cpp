@@ -0,0 +1,70 @@
+#include <cassert>
+
+#include <util/point_cloud.hpp>
+
+
+void PointCloudSoA::clear()
+{
+    x.clear(), y.clear(), z.clear();
+    pixels.clear();
+}
+
+void PointCloudSoA::reserve(size_t numPoints)
+{
+    x.reserve(numPoints), y.reserve(numPoints), z.reserve(numPoints);
+}
+
+void PointCloudSoA::resize(size_t numPoints, bool withPixels)
+{
+    x.resize(numPoints), y.resize(numPoints), z.resize(numPoints);
+    pixels.resize(withPixels ? numPoints : 0);
+}
+
+void PointCloudSoA::push_back(const cv::Point3f &p)
+{
+    assert(!hasPixels());
+    x.push_back(p.x), y.push_back(p.y), z.push_back(p.z);
+}
+
+void PointCloudSoA::push_back(const cv::Point3f &p, const PointIJ &pixel)
+{
+    assert(pixels.size() == x.size());
+    x.push_back(p.x), y.push_back(p.y), z.push_back(p.z);
+    pixels.push_back(pixel);
+}
+
+void PointCloudSoA::fromAos(const cv::Point3f *points, size_t numPoints)
+{
+    resize(numPoints, false);
+    for (size_t k = 0; k < numPoints; ++k)
+        x[k] = points[k].x, y[k] = points[k].y, z[k] = points[k].z;
+}
+
+void PointCloudSoA::fromAos(const std::vector<cv::Point3f> &points)
+{
+    fromAos(points.data(), points.size());
+}
+
+void PointCloudSoA::toAos(std::vector<cv::Point3f> &points) const
+{
+    const size_t numPoints = size();
+    points.resize(numPoints);
+    for (size_t k = 0; k < numPoints; ++k)
+        points[k] = cv::Point3f(x[k], y[k], z[k]);
+}
+
+void PointCloudSoA::reorderCoordinates(const short *order, size_t numPoints)
+{
+    // scratch takes the old array after each swap, so this allocates only while the cloud grows
+    for (AlignedVector<float> *coord : { &x, &y, &z })
+    {
+        scratch.resize(numPoints);
+        const float *src = coord->data();
+        for (size_t k = 0; k < numPoints; ++k)
+        {
+            assert(size_t(order[k]) < coord->size());
+            scratch[k] = src[order[k]];
+        }
+        coord->swap(scratch);
+    }
+}
@@ -0,0 +1,306 @@
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define QUANTIZATION_SSE2 1
+#else
+    #define QUANTIZATION_SSE2 0
+#endif
+
+#include <util/varint.hpp>
+#include <util/quantization.hpp>
+
+
+namespace
+{
+
+constexpr float maxQuantizedValue = float(std::numeric_limits<uint16_t>::max());
+
+/// Spread lower 16 bits of x so that there are two zero bits between each of the original bits.
+FORCE_INLINE uint64_t spreadBits(uint64_t x)
+{
+    x &= 0xffff;
+    x = (x | (x << 16)) & 0x0000ff0000ff;
+    x = (x | (x << 8)) & 0x00f00f00f00f;
+    x = (x | (x << 4)) & 0x0c30c30c30c3;
+    x = (x | (x << 2)) & 0x249249249249;
+    return x;
+}
+
+FORCE_INLINE uint16_t quantize(float v, float origin, float invStep)
+{
+    const float q = (v - origin) * invStep + 0.5f;
+    return uint16_t(std::min(std::max(q, 0.0f), maxQuantizedValue));
+}
+
+void boundingBox(const std::vector<cv::Point3f> &cloud, cv::Point3f &minP, cv::Point3f &maxP)
+{
+    minP = maxP = cloud.front();
+    for (const auto &p : cloud)
+    {
+        minP.x = std::min(minP.x, p.x), minP.y = std::min(minP.y, p.y), minP.z = std::min(minP.z, p.z);
+        maxP.x = std::max(maxP.x, p.x), maxP.y = std::max(maxP.y, p.y), maxP.z = std::max(maxP.z, p.z);
+    }
+}
+
+FORCE_INLINE float signNotZero(float v)
+{
+    return v >= 0 ? 1.0f : -1.0f;
+}
+
+FORCE_INLINE int8_t snorm8(float v)
+{
+    return int8_t(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 127.0f));
+}
+
+FORCE_INLINE uint16_t unorm16(float v)
+{
+    return uint16_t(std::min(std::max(v, 0.0f), 1.0f) * maxQuantizedValue + 0.5f);
+}
+
+}
+
+
+uint64_t mortonCode(uint16_t x, uint16_t y, uint16_t z)
+{
+    return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
+void quantizeCloud(const std::vector<cv::Point3f> &cloud, float step, CloudEncoding encoding, QuantizedCloud &q)
+{
+    q.numPoints = uint32_t(cloud.size());
+    q.encoding = encoding;
+    q.payload.clear();
+    if (cloud.empty())
+    {
+        q.origin = cv::Point3f(), q.step = step;
+        return;
+    }
+
+    cv::Point3f minP, maxP;
+    boundingBox(cloud, minP, maxP);
+
+    const float extent = std::max(std::max(maxP.x - minP.x, maxP.y - minP.y), maxP.z - minP.z);
+    q.origin = minP;
+    q.step = std::max(step, extent / maxQuantizedValue);
+
+    const float invStep = 1.0f / q.step;
+    std::vector<uint16_t> values(3 * cloud.size());
+    for (size_t i = 0; i < cloud.size(); ++i)
+    {
+        values[3 * i + 0] = quantize(cloud[i].x, minP.x, invStep);
+        values[3 * i + 1] = quantize(cloud[i].y, minP.y, invStep);
+        values[3 * i + 2] = quantize(cloud[i].z, minP.z, invStep);
+    }
+
+    if (encoding == CloudEncoding::RAW)
+    {
+        q.payload.resize(values.size() * sizeof(uint16_t));
+        memcpy(q.payload.data(), values.data(), q.payload.size());
+        return;
+    }
+
+    // sort points along the Z-order curve, so neighbours in the array are also close in space and deltas are small
+    std::vector<std::pair<uint64_t, uint32_t>> order(cloud.size());
+    for (size_t i = 0; i < cloud.size(); ++i)
+        order[i] = std::make_pair(mortonCode(values[3 * i], values[3 * i + 1], values[3 * i + 2]), uint32_t(i));
+    std::sort(order.begin(), order.end());
+
+    q.payload.reserve(values.size() * 2);
+    int32_t prev[3] = { 0, 0, 0 };
+    for (const auto &item : order)
+    {
+        const uint16_t *v = &values[3 * item.second];
+        for (int c = 0; c < 3; ++c)
+        {
+            varintEncode(zigzagEncode(int32_t(v[c]) - prev[c]), q.payload);
+            prev[c] = v[c];
+        }
+    }
+}
+
+bool dequantizeCloud(const QuantizedCloud &q, std::vector<cv::Point3f> &cloud)
+{
+    cloud.resize(q.numPoints);
+    if (!q.numPoints)
+        return true;
+
+    if (q.encoding == CloudEncoding::RAW)
+    {
+        if (q.payload.size() != 3 * sizeof(uint16_t) * q.numPoints)
+            return false;
+
+        // payload buffer comes from std::vector<uint8_t> allocation, so it is aligned well enough for uint16_t
+        dequantizePoints((const uint16_t *)q.payload.data(), q.numPoints, q.origin, q.step, cloud.data());
+        return true;
+    }
+
+    if (q.encoding != CloudEncoding::MORTON_DELTA)
+        return false;
+
+    // reconstruct the absolute values first, delta decoding is inherently serial
+    std::vector<uint16_t> values(3 * q.numPoints);
+    const uint8_t *p = q.payload.data(), *end = p + q.payload.size();
+    int32_t prev[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        uint32_t code;
+        p = varintDecode(p, end, code);
+        if (!p)
+            return false;
+
+        int32_t &c = prev[i % 3];
+        c += zigzagDecode(code);
+        values[i] = uint16_t(c);
+    }
+
+    dequantizePoints(values.data(), q.numPoints, q.origin, q.step, cloud.data());
+    return true;
+}
+
+void dequantizePoints(const uint16_t *q, size_t numPoints, const cv::Point3f &origin, float step, cv::Point3f *out)
+{
+    float *dst = &out->x;
+    const size_t numValues = 3 * numPoints;
+    size_t k = 0;
+
+#if QUANTIZATION_SSE2
+    // 4 points (12 values) per iteration, origin pattern repeats every 3 lanes
+    const __m128 s = _mm_set1_ps(step);
+    const __m128 o0 = _mm_setr_ps(origin.x, origin.y, origin.z, origin.x);
+    const __m128 o1 = _mm_setr_ps(origin.y, origin.z, origin.x, origin.y);
+    const __m128 o2 = _mm_setr_ps(origin.z, origin.x, origin.y, origin.z);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; k + 12 <= numValues; k += 12)
+    {
+        const __m128i v01 = _mm_loadu_si128((const __m128i *)(q + k));  // values 0..7
+        const __m128i v2 = _mm_loadl_epi64((const __m128i *)(q + k + 8));  // values 8..11
+
+        const __m128 f0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v01, zero));
+        const __m128 f1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v01, zero));
+        const __m128 f2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v2, zero));
+
+        _mm_storeu_ps(dst + k, _mm_add_ps(o0, _mm_mul_ps(f0, s)));
+        _mm_storeu_ps(dst + k + 4, _mm_add_ps(o1, _mm_mul_ps(f1, s)));
+        _mm_storeu_ps(dst + k + 8, _mm_add_ps(o2, _mm_mul_ps(f2, s)));
+    }
+#endif
+
+    const float o[3] = { origin.x, origin.y, origin.z };
+    for (; k < numValues; ++k)
+        dst[k] = o[k % 3] + step * q[k];
+}
+
+void octEncode(const cv::Point3f &n, int8_t out[2])
+{
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 <= 0)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    // project onto the octahedron |x| + |y| + |z| = 1, the lower hemisphere is folded over the diagonals
+    float x = n.x / l1, y = n.y / l1;
+    if (n.z < 0)
+    {
+        const float fx = (1 - std::abs(y)) * signNotZero(x);
+        const float fy = (1 - std::abs(x)) * signNotZero(y);
+        x = fx, y = fy;
+    }
+
+    out[0] = snorm8(x);
+    out[1] = snorm8(y);
+}
+
+cv::Point3f octDecode(const int8_t e[2])
+{
+    if (!e[0] && !e[1])
+        return cv::Point3f(0, 0, 1);
+
+    float x = std::max(e[0] / 127.0f, -1.0f), y = std::max(e[1] / 127.0f, -1.0f);
+    const float z = 1 - std::abs(x) - std::abs(y);
+    if (z < 0)
+    {
+        const float fx = (1 - std::abs(y)) * signNotZero(x);
+        const float fy = (1 - std::abs(x)) * signNotZero(y);
+        x = fx, y = fy;
+    }
+
+    const cv::Point3f n(x, y, z);
+    return n * (1.0f / float(cv::norm(n)));
+}
+
+void encodeCompactVertices(const std::vector<cv::Point3f> &cloud,
+                           const std::vector<cv::Point3f> &normals,
+                           const std::vector<cv::Point2f> &uv,
+                           std::vector<CompactVertex> &vertices,
+                           cv::Point3f &origin,
+                           float &step)
+{
+    vertices.resize(cloud.size());
+    origin = cv::Point3f(), step = 0;
+    if (cloud.empty())
+        return;
+
+    cv::Point3f minP, maxP;
+    boundingBox(cloud, minP, maxP);
+    const float extent = std::max(std::max(maxP.x - minP.x, maxP.y - minP.y), maxP.z - minP.z);
+    origin = minP;
+    step = std::max(extent / maxQuantizedValue, 1e-6f);
+
+    const float invStep = 1.0f / step;
+    for (size_t i = 0; i < cloud.size(); ++i)
+    {
+        CompactVertex &v = vertices[i];
+        v.position[0] = quantize(cloud[i].x, minP.x, invStep);
+        v.position[1] = quantize(cloud[i].y, minP.y, invStep);
+        v.position[2] = quantize(cloud[i].z, minP.z, invStep);
+
+        if (normals.empty())
+            v.normal[0] = v.normal[1] = 0;
+        else
+            octEncode(normals[i], v.normal);
+
+        if (uv.empty())
+            v.uv[0] = v.uv[1] = 0;
+        else
+            v.uv[0] = unorm16(uv[i].x), v.uv[1] = unorm16(uv[i].y);
+    }
+}
+
+void decodeCompactVertices(const std::vector<CompactVertex> &vertices,
+                           const cv::Point3f &origin,
+                           float step,
+                           std::vector<cv::Point3f> *cloud,
+                           std::vector<cv::Point3f> *normals,
+                           std::vector<cv::Point2f> *uv)
+{
+    if (cloud)
+    {
+        cloud->resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const uint16_t *q = vertices[i].position;
+            (*cloud)[i] = cv::Point3f(origin.x + step * q[0], origin.y + step * q[1], origin.z + step * q[2]);
+        }
+    }
+
+    if (normals)
+    {
+        normals->resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+            (*normals)[i] = octDecode(vertices[i].normal);
+    }
+
+    if (uv)
+    {
+        uv->resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+            (*uv)[i] = cv::Point2f(vertices[i].uv[0] / maxQuantizedValue, vertices[i].uv[1] / maxQuantizedValue);
+    }
+}
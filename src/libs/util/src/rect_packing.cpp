@@ -0,0 +1,31 @@
+#include <numeric>
+#include <cassert>
+#include <algorithm>
+
+#include <util/rect_packing.hpp>
+
+
+int packShelves(const std::vector<cv::Size> &sizes, int width, std::vector<cv::Point> &positions)
+{
+    std::vector<int> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a].height > sizes[b].height; });
+
+    positions.resize(sizes.size());
+    int shelfY = 0, shelfHeight = 0, x = 0;
+    for (int i : order)
+    {
+        assert(sizes[i].width <= width);
+        if (x + sizes[i].width > width)
+        {
+            shelfY += shelfHeight;
+            x = shelfHeight = 0;
+        }
+
+        positions[i] = cv::Point(x, shelfY);
+        x += sizes[i].width;
+        shelfHeight = std::max(shelfHeight, sizes[i].height);
+    }
+
+    return shelfY + shelfHeight;
+}
@@ -0,0 +1,103 @@
+#include <atomic>
+#include <algorithm>
+
+#include <util/thread_pool.hpp>
+
+
+namespace
+{
+
+struct ParallelForState
+{
+    std::atomic<int> next, done;
+    int begin, end;
+    std::function<void(int)> body;
+
+    std::mutex mutex;
+    std::condition_variable doneCV;
+
+    /// Process iterations until there's nothing left, last finished iteration wakes up the caller.
+    void work()
+    {
+        const int total = end - begin;
+        for (int i = next++; i < end; i = next++)
+        {
+            body(i);
+            if (++done == total)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                doneCV.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+
+ThreadPool::ThreadPool(int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+
+    for (int i = 0; i < numThreads; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    newTaskCV.notify_all();
+
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            newTaskCV.wait(lock, [this] { return stop || !tasks.empty(); });
+            if (tasks.empty())
+                return;  // stop requested and all remaining tasks are done
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int)> &body)
+{
+    if (end <= begin)
+        return;
+
+    // state is shared with the helper tasks, they may start after this call has returned and should find no work
+    auto state = std::make_shared<ParallelForState>();
+    state->next = begin, state->done = 0;
+    state->begin = begin, state->end = end;
+    state->body = body;
+
+    const int numHelpers = std::min(numThreads(), end - begin - 1);
+    for (int i = 0; i < numHelpers; ++i)
+        submit([state] { state->work(); });
+
+    state->work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->doneCV.wait(lock, [&] { return state->done == end - begin; });
+}
+
+ThreadPool & threadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
@@ -50,43 +50,52 @@ TinyProfiler & tprof()
 
 TinyProfiler::TinyProfiler()
 {
-    data.reset(new TinyProfilerImpl);
+}
+
+TinyProfiler::TinyProfilerImpl & TinyProfiler::threadData()
+{
+    thread_local TinyProfilerImpl data;
+    return data;
 }
 
 void TinyProfiler::startTimer(const std::string &key)
 {
-    data->timestamps[key] = high_resolution_clock::now();
+    auto &data = threadData();
+    data.timestamps[key] = high_resolution_clock::now();
 }
 
 void TinyProfiler::pauseTimer(const std::string &key)
 {
-    if (!data->timestamps.count(key))
+    auto &data = threadData();
+    if (!data.timestamps.count(key))
     {
         TLOG(ERROR) << "No such timer: " << key;
         return;
     }
 
-    const auto passedUsec = passedSince(data->timestamps[key]);
-    data->totalTime[key] += passedUsec;
+    const auto passedUsec = passedSince(data.timestamps[key]);
+    data.totalTime[key] += passedUsec;
 }
 
 float TinyProfiler::readTimer(const std::string &key, bool log)
 {
-    if (!data->timestamps.count(key))
+    auto &data = threadData();
+    if (!data.timestamps.count(key))
     {
         TLOG(ERROR) << "No such timer: " << key;
         return 0.0f;
     }
     
-    const auto passedUsec = passedSince(data->timestamps[key]) + data->totalTime[key];
+    const auto passedUsec = passedSince(data.timestamps[key]) + data.totalTime[key];
     TLOG_IF(INFO, log) << passedUsec << " us passed for " << key;
     return float(passedUsec);
 }
 
 float TinyProfiler::stopTimer(const std::string &key)
 {
+    auto &data = threadData();
     const auto passedUsec = readTimer(key, true);
-    data->timestamps.erase(key);
-    data->totalTime.erase(key);
+    data.timestamps.erase(key);
+    data.totalTime.erase(key);
     return passedUsec;
 }
@@ -0,0 +1,258 @@
+#include <thread>
+#include <cstdio>
+#include <iomanip>
+
+#include <gtest/gtest.h>
+
+#include <util/util.hpp>
+#include <util/test_utils.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/tiny_profiler.hpp>
+#include <util/filesystem_utils.hpp>
+
+#include <4d/params.hpp>
+#include <4d/animation_writer.hpp>
+
+
+namespace
+{
+
+/// Regular grid with two triangles per cell, roughly the size of a typical frame after the filter.
+std::shared_ptr<MeshFrame> syntheticMeshFrame(int frameNumber)
+{
+    constexpr int gridW = 160, gridH = 90;
+
+    auto meshFrame = std::make_shared<MeshFrame>();
+    meshFrame->indexedMode = true;
+    meshFrame->frame2D = std::make_shared<Frame>();
+    meshFrame->frame2D->frameNumber = frameNumber;
+    meshFrame->frame2D->dTimestamp = int64_t(frameNumber) * 33333;
+    meshFrame->frame2D->color = cv::Mat(480, 640, CV_8UC3);
+    cv::randu(meshFrame->frame2D->color, 0, 255);
+
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+        {
+            meshFrame->cloud.emplace_back(j * 0.01f, i * 0.01f, 1.0f + randRange(0, 100) * 0.0001f);
+            meshFrame->uv.emplace_back(0.25f + 0.5f * j / gridW, 0.2f + 0.6f * i / gridH);  // object covers a part of the frame
+        }
+
+    for (int i = 0; i + 1 < gridH; ++i)
+        for (int j = 0; j + 1 < gridW; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridW + j);
+            meshFrame->triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridW) });
+            meshFrame->triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridW + 1), uint16_t(p + gridW) });
+        }
+
+    return meshFrame;
+}
+
+/// Timeframe listing, meshes and atlases written by the AnimationWriter, then the directory itself.
+void removeExportedAnimation(const std::string &outputPath, int numFrames)
+{
+    std::remove(pathJoin(outputPath, "sketchfab.timeframe").c_str());
+    for (int i = 0; i < numFrames; ++i)
+    {
+        std::ostringstream filename;
+        filename << std::setw(4) << std::setfill('0') << i;
+        std::remove(pathJoin(outputPath, filename.str() + ".ply").c_str());
+        std::remove(pathJoin(outputPath, filename.str() + ".jpg").c_str());
+    }
+    EXPECT_TRUE(removeDirectory(outputPath));
+}
+
+}
+
+
+TEST(animationWriter, exportBenchmark)
+{
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_animation") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    const int numFrames = 5 * animationParams().batchSize + 3;  // last batch is incomplete
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    for (int i = 0; i < numFrames; ++i)
+        frames.emplace_back(syntheticMeshFrame(i));
+
+    CancellationToken cancellationToken;
+    MeshFrameQueue queue;
+    for (auto &frame : frames)
+        queue.put(frame);
+
+    tprof().startTimer("animation_export");
+    std::thread writerThread([&]
+    {
+        AnimationWriter writer(outputPath, queue, cancellationToken);
+        writer.init();
+        writer.run();
+    });
+
+    while (!queue.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();  // consumer finishes the current frame before it checks the token
+    writerThread.join();  // destructor of the writer flushes the last batch
+    const float usec = tprof().stopTimer("animation_export");
+    TLOG(INFO) << "Export throughput: " << numFrames / (usec / 1e6f) << " fps";
+
+    // entries should follow the frame order regardless of the order in which the tasks finished
+    std::ifstream timeframe(pathJoin(outputPath, "sketchfab.timeframe"));
+    std::string line;
+    int numEntries = 0;
+    while (std::getline(timeframe, line))
+    {
+        std::ostringstream expectedFilename;
+        expectedFilename << std::setw(4) << std::setfill('0') << numEntries << ".ply";
+        EXPECT_NE(line.find(expectedFilename.str()), std::string::npos) << line;
+        ++numEntries;
+    }
+    EXPECT_EQ(numEntries, numFrames);
+
+    for (int i = 0; i < numFrames; i += animationParams().batchSize)
+    {
+        std::ostringstream atlasFilename;
+        atlasFilename << std::setw(4) << std::setfill('0') << i << ".jpg";
+        EXPECT_TRUE(fileExists(pathJoin(outputPath, atlasFilename.str())));
+    }
+
+    timeframe.close();
+    removeExportedAnimation(outputPath, numFrames);
+}
+
+TEST(animationWriter, deduplication)
+{
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_animation_dedupe") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    // frames 3..5 repeat the content of frame 2
+    constexpr int numFrames = 10;
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        if (i >= 3 && i <= 5)
+        {
+            auto duplicate = std::make_shared<MeshFrame>(*frames[2]);
+            duplicate->frame2D = std::make_shared<Frame>(*frames[2]->frame2D);
+            duplicate->frame2D->frameNumber = i;
+            duplicate->frame2D->dTimestamp = int64_t(i) * 33333;
+            frames.emplace_back(duplicate);
+        }
+        else
+            frames.emplace_back(syntheticMeshFrame(i));
+    }
+
+    CancellationToken cancellationToken;
+    MeshFrameQueue queue;
+    for (auto &frame : frames)
+        queue.put(frame);
+
+    std::thread writerThread([&]
+    {
+        AnimationWriter writer(outputPath, queue, cancellationToken);
+        writer.enableDeduplication();
+        writer.init();
+        writer.run();
+    });
+
+    while (!queue.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();
+    writerThread.join();
+
+    std::ifstream timeframe(pathJoin(outputPath, "sketchfab.timeframe"));
+    std::vector<std::pair<float, std::string>> entries;
+    float duration;
+    std::string filename;
+    while (timeframe >> duration >> filename)
+        entries.emplace_back(duration, filename);
+
+    ASSERT_EQ(entries.size(), numFrames - 3);
+    EXPECT_EQ(entries[2].second, "0002.ply");
+    EXPECT_NEAR(entries[2].first, 4 * 0.0333f, 0.001f);  // frame 2 stays on screen until frame 6
+    EXPECT_EQ(entries[3].second, "0006.ply");
+    EXPECT_NEAR(entries[3].first, 0.0333f, 0.001f);
+    EXPECT_FALSE(fileExists(pathJoin(outputPath, "0003.ply")));
+
+    timeframe.close();
+    removeExportedAnimation(outputPath, numFrames);
+}
+
+TEST(animationWriter, deduplicationTolerance)
+{
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_animation_jitter") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    const float maxDistance = animationParams().dedupeMaxDistance;
+    const auto copyFrame = [](const MeshFrame &source, int frameNumber)
+    {
+        auto copy = std::make_shared<MeshFrame>(source);
+        copy->frame2D = std::make_shared<Frame>(*source.frame2D);
+        copy->frame2D->color = source.frame2D->color.clone();
+        copy->frame2D->frameNumber = frameNumber;
+        copy->frame2D->dTimestamp = int64_t(frameNumber) * 33333;
+        return copy;
+    };
+
+    // sensor noise below the tolerance: every vertex moves a bit, colors are slightly brighter
+    const auto jitteredFrame = [&](const MeshFrame &source, int frameNumber)
+    {
+        auto copy = copyFrame(source, frameNumber);
+        for (auto &p : copy->cloud)
+            p += cv::Point3f(randRange(-100, 100), randRange(-100, 100), randRange(-100, 100)) * (maxDistance / 200);
+        cv::Mat &color = copy->frame2D->color;
+        for (int i = 0; i < color.rows; ++i)
+        {
+            uint8_t *row = color.ptr<uint8_t>(i);
+            for (int j = 0; j < color.cols * color.channels(); ++j)
+                row[j] = uint8_t(std::min(row[j] + 3, 255));
+        }
+        return copy;
+    };
+
+    // frames 3, 4 are noisy copies of frame 2, frame 5 moves one vertex past the tolerance,
+    // trailing frames 6..8 are noisy copies of frame 5
+    constexpr int numFrames = 9;
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    for (int i = 0; i < 3; ++i)
+        frames.emplace_back(syntheticMeshFrame(i));
+    for (int i = 3; i < 5; ++i)
+        frames.emplace_back(jitteredFrame(*frames[2], i));
+    frames.emplace_back(copyFrame(*frames[2], 5));
+    frames.back()->cloud[1000].z += 2 * maxDistance;
+    for (int i = 6; i < numFrames; ++i)
+        frames.emplace_back(jitteredFrame(*frames[5], i));
+
+    CancellationToken cancellationToken;
+    MeshFrameQueue queue;
+    for (auto &frame : frames)
+        queue.put(frame);
+
+    std::thread writerThread([&]
+    {
+        AnimationWriter writer(outputPath, queue, cancellationToken);
+        writer.enableDeduplication();
+        writer.init();
+        writer.run();
+    });
+
+    while (!queue.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();
+    writerThread.join();
+
+    std::ifstream timeframe(pathJoin(outputPath, "sketchfab.timeframe"));
+    std::vector<std::pair<float, std::string>> entries;
+    float duration;
+    std::string filename;
+    while (timeframe >> duration >> filename)
+        entries.emplace_back(duration, filename);
+
+    ASSERT_EQ(entries.size(), 4u);
+    EXPECT_EQ(entries[2].second, "0002.ply");
+    EXPECT_NEAR(entries[2].first, 3 * 0.0333f, 0.001f);
+    EXPECT_EQ(entries[3].second, "0005.ply");
+    EXPECT_NEAR(entries[3].first, 4 * 0.0333f, 0.001f);  // trailing duplicates extend the last frame
+
+    timeframe.close();
+    removeExportedAnimation(outputPath, numFrames);
+}
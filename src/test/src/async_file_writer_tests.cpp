@@ -0,0 +1,127 @@
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include <util/util.hpp>
+#include <util/io_3d.hpp>
+#include <util/test_utils.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/tiny_profiler.hpp>
+#include <util/filesystem_utils.hpp>
+#include <util/async_file_writer.hpp>
+
+
+namespace
+{
+
+std::vector<char> readFile(const std::string &filename)
+{
+    std::vector<char> buffer;
+    readAllBytes(filename, buffer);
+    return buffer;
+}
+
+/// Small mesh, like a single frame of a sparse scan after filtering.
+std::vector<char> smallPly()
+{
+    constexpr int gridW = 80, gridH = 60;
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+            vertices.emplace_back(j * 0.01f, i * 0.01f, 1.0f + randRange(0, 100) * 0.0001f);
+    for (int i = 0; i + 1 < gridH; ++i)
+        for (int j = 0; j + 1 < gridW; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridW + j);
+            triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridW) });
+            triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridW + 1), uint16_t(p + gridW) });
+        }
+
+    std::vector<char> buffer;
+    serializeBinaryPly(buffer, &vertices, &triangles);
+    return buffer;
+}
+
+}
+
+
+TEST(asyncFileWriter, filesAndStreams)
+{
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_async") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    AsyncFileWriter writer;
+    TLOG(INFO) << "io_uring: " << writer.usesIoUring();
+
+    constexpr int numFiles = 50;
+    for (int i = 0; i < numFiles; ++i)
+        writer.writeFile(pathJoin(outputPath, std::to_string(i) + ".bin"), std::vector<char>(1000 + i, char(i)));
+
+    // appends of different sizes must end up in order
+    const std::string streamFilename{ pathJoin(outputPath, "stream.bin") };
+    const auto stream = writer.open(streamFilename);
+    ASSERT_NE(stream, AsyncFileWriter::invalidHandle);
+    std::vector<char> expectedStream;
+    for (int i = 0; i < 100; ++i)
+    {
+        std::vector<char> chunk(size_t(1 + (i * 7919) % 5000), char(i));
+        expectedStream.insert(expectedStream.end(), chunk.begin(), chunk.end());
+        writer.append(stream, std::move(chunk));
+    }
+    writer.close(stream);
+
+    EXPECT_TRUE(writer.flush());
+    EXPECT_EQ(writer.numFilesWritten(), numFiles + 1);
+
+    for (int i = 0; i < numFiles; ++i)
+        EXPECT_EQ(readFile(pathJoin(outputPath, std::to_string(i) + ".bin")), std::vector<char>(1000 + i, char(i)));
+    EXPECT_EQ(readFile(streamFilename), expectedStream);
+
+    // failures are reported by flush()
+    writer.writeFile(pathJoin(outputPath, "no_such_dir", "file.bin"), std::vector<char>(10));
+    EXPECT_FALSE(writer.flush());
+    EXPECT_EQ(writer.open(pathJoin(outputPath, "no_such_dir", "stream.bin")), AsyncFileWriter::invalidHandle);
+
+    for (int i = 0; i < numFiles; ++i)
+        EXPECT_EQ(std::remove(pathJoin(outputPath, std::to_string(i) + ".bin").c_str()), 0);
+    EXPECT_EQ(std::remove(streamFilename.c_str()), 0);
+    EXPECT_TRUE(removeDirectory(outputPath));
+}
+
+TEST(asyncFileWriter, smallPlyBenchmark)
+{
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_async_ply") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    const std::vector<char> ply = smallPly();
+    constexpr int numFiles = 500;
+    const float totalMb = float(ply.size()) * numFiles / (1 << 20);
+
+    tprof().startTimer("blocking_ofstream");
+    for (int i = 0; i < numFiles; ++i)
+    {
+        std::ofstream out(pathJoin(outputPath, std::to_string(i) + ".ply"), std::ios::binary);
+        out.write(ply.data(), ply.size());
+    }
+    const float blockingSec = tprof().stopTimer("blocking_ofstream") / 1e6f;
+
+    // in the writers buffers are produced by the serialization anyway, don't measure the copies
+    std::vector<std::vector<char>> buffers(numFiles, ply);
+    AsyncFileWriter writer;
+    tprof().startTimer("async_file_writer");
+    for (int i = 0; i < numFiles; ++i)
+        writer.writeFile(pathJoin(outputPath, std::to_string(i) + ".ply"), std::move(buffers[i]));
+    const float submitSec = tprof().readTimer("async_file_writer") / 1e6f;
+    EXPECT_TRUE(writer.flush());
+    const float asyncSec = tprof().stopTimer("async_file_writer") / 1e6f;
+
+    TLOG(INFO) << numFiles << " files of " << ply.size() / 1024 << " KB, " << (writer.usesIoUring() ? "io_uring" : "I/O threads");
+    TLOG(INFO) << "Blocking ofstream: " << numFiles / blockingSec << " files/s, " << totalMb / blockingSec << " MB/s";
+    TLOG(INFO) << "AsyncFileWriter: " << numFiles / asyncSec << " files/s, " << totalMb / asyncSec << " MB/s, caller blocked for "
+               << submitSec * 1000 << " ms";
+
+    for (int i = 0; i < numFiles; ++i)
+        EXPECT_EQ(std::remove(pathJoin(outputPath, std::to_string(i) + ".ply").c_str()), 0);
+    EXPECT_TRUE(removeDirectory(outputPath));
+}
@@ -1,11 +1,22 @@
+#include <cstdio>
+
 #include <gtest/gtest.h>
 
 #include <util/test_utils.hpp>
 #include <util/filesystem_utils.hpp>
 
+#include <4d/mesher.hpp>
 #include <4d/app_state.hpp>
+#include <4d/mesh_cache.hpp>
+#include <4d/depth_filter.hpp>
+#include <4d/dataset_input.hpp>
+#include <4d/mesh_decimator.hpp>
+#include <4d/dataset_output.hpp>
 #include <4d/dataset_writer.hpp>
 #include <4d/dataset_reader.hpp>
+#include <4d/mesh_cache_reader.hpp>
+#include <4d/mesh_cache_writer.hpp>
+#include <4d/synthetic_sensor.hpp>
 
 
 class binaryDataset : public ::testing::Test
@@ -49,3 +60,215 @@ TEST_F(binaryDataset, readWrite)
     EXPECT_EQ(origBytes, copyBytes);
     EXPECT_TRUE(std::equal(original.begin(), original.end(), copy.begin()));
 }
+
+TEST_F(binaryDataset, meshCache)
+{
+    const std::string testDataset{ pathJoin(getTestDataFolder(), "test_binary_dataset.4dv") };
+    std::remove(meshCachePath(testDataset).c_str());
+    EXPECT_FALSE(MeshCacheReader::isValid(testDataset));
+
+    // mesh the dataset, cache writer should finalize the cache after the last frame
+    std::vector<std::shared_ptr<MeshFrame>> meshed;
+    {
+        CancellationToken cancellationToken;
+        FrameQueue frameQueue, filteredQueue;
+        MeshFrameQueue cacheQueue, resultQueue;
+
+        std::thread filterThread([&]
+        {
+            FrameProducer producer(cancellationToken);
+            producer.addQueue(&filteredQueue);
+            DepthFilter filter(frameQueue, producer, cancellationToken);
+            filter.init();
+            filter.run();
+        });
+
+        std::thread mesherThread([&]
+        {
+            MeshFrameProducer producer(cancellationToken);
+            producer.addQueue(&cacheQueue);
+            producer.addQueue(&resultQueue);
+            Mesher mesher(filteredQueue, producer, cancellationToken);
+            mesher.init();
+            mesher.run();
+        });
+
+        std::thread cacheWriterThread([&]
+        {
+            MeshCacheWriter writer(testDataset, cacheQueue, cancellationToken);
+            writer.init();
+            writer.run();
+        });
+
+        DatasetReader reader(testDataset, false, cancellationToken);
+        reader.addQueue(&frameQueue);
+        reader.init();
+        reader.run();
+
+        std::shared_ptr<MeshFrame> meshFrame;
+        while (meshed.empty() || !meshed.back()->frame2D->lastFrame)
+            if (resultQueue.pop(meshFrame, 100))
+                meshed.emplace_back(meshFrame);
+
+        cancellationToken.trigger();
+        filterThread.join(), mesherThread.join(), cacheWriterThread.join();
+    }
+
+    ASSERT_TRUE(MeshCacheReader::isValid(testDataset));
+    appState().reset();
+
+    CancellationToken cancellationToken;
+    MeshFrameQueue queue;
+    MeshCacheReader cacheReader(testDataset, false, cancellationToken);
+    cacheReader.addQueue(&queue);
+    cacheReader.init();
+    EXPECT_TRUE(appState().getSensorManager().isInitialized());
+    cacheReader.run();
+
+    std::vector<std::shared_ptr<MeshFrame>> cached;
+    std::shared_ptr<MeshFrame> meshFrame;
+    while (queue.pop(meshFrame, 0))
+        cached.emplace_back(meshFrame);
+
+    ASSERT_EQ(cached.size(), meshed.size());
+    for (size_t i = 0; i < meshed.size(); ++i)
+    {
+        // the cache stores the decoded float arrays of compact frames
+        const auto decoded = withFloatVertices(meshed[i]);
+        const auto &c = *cached[i], &m = *decoded;
+        EXPECT_EQ(c.frame2D->frameNumber, m.frame2D->frameNumber);
+        EXPECT_EQ(c.frame2D->lastFrame, m.frame2D->lastFrame);
+        EXPECT_TRUE(c.cloud == m.cloud);
+        EXPECT_TRUE(c.uv == m.uv);
+        ASSERT_EQ(c.triangles.size(), m.triangles.size());
+        EXPECT_EQ(0, memcmp(c.triangles.data(), m.triangles.data(), c.triangles.size() * sizeof(Triangle)));
+    }
+
+    std::remove(meshCachePath(testDataset).c_str());
+}
+
+TEST_F(binaryDataset, meshCacheLods)
+{
+    // the cache reader only needs the sensor params from the source dataset, a single frame is enough
+    const std::string testDataset{ pathJoin(getTestDataFolder(), "tmp_lods.4dv") };
+    {
+        CancellationToken cancellationToken;
+        SyntheticSensor sensor(SyntheticSensorSettings(), cancellationToken);
+        sensor.init();
+        DatasetOutput output(testDataset);
+        ASSERT_EQ(output.writeHeader(appState().getSensorManager()), Status::SUCCESS);
+        ASSERT_EQ(output.writeFrame(*sensor.renderFrame(0)), Status::SUCCESS);
+    }
+
+    constexpr int numFrames = 3, gridSize = 60;
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    {
+        CancellationToken cancellationToken;
+        MeshFrameQueue queue;
+        for (int frameNumber = 0; frameNumber < numFrames; ++frameNumber)
+        {
+            auto frame = std::make_shared<MeshFrame>();
+            frame->frame2D = std::make_shared<Frame>();
+            frame->frame2D->frameNumber = frameNumber;
+            frame->frame2D->lastFrame = frameNumber + 1 == numFrames;
+            frame->indexedMode = true;
+            for (int i = 0; i < gridSize; ++i)
+                for (int j = 0; j < gridSize; ++j)
+                {
+                    frame->cloud.emplace_back(j * 0.01f, i * 0.01f, 1.0f + 0.02f * std::sin(j * 0.2f + frameNumber));
+                    frame->normals.emplace_back(0.0f, 0.0f, -1.0f);
+                    frame->uv.emplace_back(float(j) / gridSize, float(i) / gridSize);
+                }
+            for (int i = 0; i + 1 < gridSize; ++i)
+                for (int j = 0; j + 1 < gridSize; ++j)
+                {
+                    const uint16_t p = uint16_t(i * gridSize + j);
+                    frame->triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridSize) });
+                    frame->triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridSize + 1), uint16_t(p + gridSize) });
+                }
+            MeshDecimator::addLods(frame, 3, 0.02f);
+            ASSERT_FALSE(frame->lods.empty());
+
+            frames.push_back(frame);
+            queue.put(frame, 0);
+        }
+
+        std::thread writerThread([&]
+        {
+            MeshCacheWriter writer(testDataset, queue, cancellationToken);
+            writer.init();
+            writer.run();
+        });
+        while (!queue.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cancellationToken.trigger();
+        writerThread.join();
+    }
+
+    ASSERT_TRUE(MeshCacheReader::isValid(testDataset));
+    appState().reset();
+
+    CancellationToken cancellationToken;
+    MeshFrameQueue queue;
+    MeshCacheReader cacheReader(testDataset, false, cancellationToken);
+    cacheReader.addQueue(&queue);
+    cacheReader.init();
+    cacheReader.run();
+
+    // every level comes back with the same mesh and the frame of its parent
+    std::shared_ptr<MeshFrame> cached;
+    for (const auto &frame : frames)
+    {
+        ASSERT_TRUE(queue.pop(cached, 0));
+        EXPECT_EQ(cached->frame2D->frameNumber, frame->frame2D->frameNumber);
+        ASSERT_EQ(cached->lods.size(), frame->lods.size());
+        for (size_t level = 0; level < frame->lods.size(); ++level)
+        {
+            const auto &c = *cached->lods[level], &m = *frame->lods[level];
+            EXPECT_EQ(c.frame2D, cached->frame2D);
+            EXPECT_TRUE(c.indexedMode);
+            EXPECT_TRUE(c.cloud == m.cloud);
+            EXPECT_TRUE(c.uv == m.uv);
+            ASSERT_EQ(c.triangles.size(), m.triangles.size());
+            EXPECT_EQ(0, memcmp(c.triangles.data(), m.triangles.data(), c.triangles.size() * sizeof(Triangle)));
+        }
+    }
+    EXPECT_FALSE(queue.pop(cached, 0));
+
+    std::remove(meshCachePath(testDataset).c_str());
+    std::remove(testDataset.c_str());
+}
+
+TEST_F(binaryDataset, formatVersion)
+{
+    const std::string testDataset{ pathJoin(getTestDataFolder(), "tmp_version.4dv") };
+    {
+        CancellationToken cancellationToken;
+        SyntheticSensor sensor(SyntheticSensorSettings(), cancellationToken);
+        sensor.init();
+        DatasetOutput output(testDataset);
+        ASSERT_EQ(output.writeHeader(appState().getSensorManager()), Status::SUCCESS);
+        ASSERT_EQ(output.writeFrame(*sensor.renderFrame(0)), Status::SUCCESS);
+    }
+
+    {
+        DatasetInput input(testDataset, false);
+        ASSERT_EQ(input.readHeader(), Status::SUCCESS);
+        EXPECT_EQ(input.getMetadata().formatVersion, FORMAT_VERSION);
+    }
+
+    // file from a newer writer may have fields this reader would misparse
+    {
+        std::fstream f(testDataset, std::ios::in | std::ios::out | std::ios::binary);
+        const Field header[] = { Field::MAGIC, Field::METADATA_SECTION, Field::VERSION };
+        const uint32_t newerVersion = FORMAT_VERSION + 1;
+        f.seekp(sizeof(header)).write((const char *)&newerVersion, sizeof(newerVersion));
+    }
+
+    {
+        DatasetInput input(testDataset, false);
+        EXPECT_EQ(input.readHeader(), Status::ERROR);
+    }
+
+    EXPECT_EQ(std::remove(testDataset.c_str()), 0);
+}
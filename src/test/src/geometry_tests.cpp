@@ -1,9 +1,67 @@
+#include <chrono>
+#include <random>
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 #include <opencv2/core.hpp>
 
 #include <util/util.hpp>
 #include <util/geometry.hpp>
+#include <util/point_cloud.hpp>
+#include <util/cpu_features.hpp>
+#include <util/rect_packing.hpp>
+#include <util/tiny_logger.hpp>
+
+
+namespace
+{
+
+/// Depth image 640x480 with holes and a few far points.
+cv::Mat testDepth()
+{
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> depth(300, 6000), hole(0, 9);
+    cv::Mat d(480, 640, CV_16UC1);
+    for (int i = 0; i < d.rows; ++i)
+        for (int j = 0; j < d.cols; ++j)
+            d.at<uint16_t>(i, j) = hole(rng) ? uint16_t(depth(rng)) : uint16_t(0);
+    d.at<uint16_t>(0, 0) = std::numeric_limits<uint16_t>::max();
+    return d;
+}
+
+/// Run the check with every kernel variant the CPU supports.
+template <typename F>
+void forEachCpuLevel(F f)
+{
+    for (int level = 0; level <= int(detectedCpuLevel()); ++level)
+    {
+        SCOPED_TRACE(cpuLevelName(CpuLevel(level)));
+        setCpuLevelOverride(CpuLevel(level));
+        f();
+    }
+    resetCpuLevelOverride();
+}
+
+/// Average time of one run in microseconds.
+template <typename F>
+double benchmarkUs(F f)
+{
+#if defined(NDEBUG)
+    const int numRuns = 200;
+#else
+    const int numRuns = 5;
+#endif
+
+    f();  // warm up the caches
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int run = 0; run < numRuns; ++run)
+        f();
+    const std::chrono::duration<double, std::micro> passed = std::chrono::high_resolution_clock::now() - start;
+    return passed.count() / numRuns;
+}
+
+}
 
 
 TEST(geom, inCircle)
@@ -64,3 +122,337 @@ TEST(geom, triangleArea3D)
     area = triangleArea3DHeron(0, 1, 1);
     EXPECT_NEAR(area, 0.0f, EPSILON);
 }
+
+TEST(geom, packShelves)
+{
+    const int width = 100;
+    std::vector<cv::Size> sizes;
+    for (int i = 0; i < 40; ++i)
+        sizes.emplace_back(10 + (i * 37) % 60, 10 + (i * 13) % 30);
+
+    std::vector<cv::Point> positions;
+    const int height = packShelves(sizes, width, positions);
+    ASSERT_EQ(positions.size(), sizes.size());
+
+    int area = 0;
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        const cv::Rect r(positions[i], sizes[i]);
+        EXPECT_TRUE(r.x >= 0 && r.y >= 0 && r.br().x <= width && r.br().y <= height);
+        for (size_t j = 0; j < i; ++j)
+            EXPECT_EQ((r & cv::Rect(positions[j], sizes[j])).area(), 0) << i << " " << j;
+        area += r.area();
+    }
+
+    EXPECT_GE(area, int(0.6f * width * height));  // shelves should not waste too much space
+    EXPECT_EQ(packShelves({}, width, positions), 0);
+}
+
+TEST(geom, batchedProjection)
+{
+    const CameraParams cam(520.965f, 319.223f, 175.641f, 640, 360);
+    const cv::Mat depth = testDepth();
+
+    std::vector<float> cols(depth.cols);
+    for (int j = 0; j < depth.cols; ++j)
+        cols[j] = float(j);
+
+    std::vector<float> x(depth.cols), y(depth.cols), z(depth.cols);
+    std::vector<uint8_t> valid(depth.cols), valid2D(depth.cols);
+    std::vector<int> iImg(depth.cols), jImg(depth.cols);
+    std::vector<uint16_t> d2D(depth.cols);
+    std::vector<cv::Point3f> points(depth.cols);
+
+    forEachCpuLevel([&]
+    {
+        for (int i = 0; i < depth.rows; ++i)
+        {
+            // odd lengths to cover the scalar tails
+            const size_t n = size_t(depth.cols - i % 9);
+            const uint16_t *row = depth.ptr<uint16_t>(i);
+            project2dPointsTo3d(i, cols.data(), row, n, cam, x.data(), y.data(), z.data(), valid.data());
+
+            for (size_t k = 0; k < n; ++k)
+            {
+                ASSERT_EQ(valid[k], row[k] != 0);
+                const cv::Point3f expected = project2dPointTo3d(i, int(k), row[k], cam);
+                ASSERT_EQ(x[k], expected.x);
+                ASSERT_EQ(y[k], expected.y);
+                ASSERT_EQ(z[k], expected.z);
+
+                // shift the points, so some fall outside of the image
+                points[k] = cv::Point3f(x[k] + 0.1f * (i % 7) - 0.3f, y[k] - 0.05f * (i % 11), z[k]);
+            }
+
+            project3dPointsTo2d(points.data(), n, cam, iImg.data(), jImg.data(), d2D.data(), valid2D.data());
+            for (size_t k = 0; k < n; ++k)
+            {
+                int expectedI, expectedJ;
+                uint16_t expectedD;
+                const bool expectedValid = project3dPointTo2d(points[k], cam, expectedI, expectedJ, expectedD);
+                ASSERT_EQ(bool(valid2D[k]), expectedValid) << i << " " << k;
+                if (expectedValid)
+                {
+                    EXPECT_EQ(iImg[k], expectedI);
+                    EXPECT_EQ(jImg[k], expectedJ);
+                    EXPECT_EQ(d2D[k], expectedD);
+                }
+            }
+        }
+    });
+
+    // only the mask
+    project3dPointsTo2d(points.data(), points.size(), cam, nullptr, nullptr, nullptr, valid2D.data());
+    project3dPointsTo2d(nullptr, 0, cam, nullptr, nullptr, nullptr, nullptr);
+}
+
+TEST(geom, uvProjection)
+{
+    const CameraParams colorCam(600.0f, 330.5f, 242.25f, 640, 480);
+
+    // rotation by 0.1 radians around y, translation by few centimeters
+    const float c = std::cos(0.1f), s = std::sin(0.1f);
+    const float rotation[9] = { c, 0, s, 0, 1, 0, -s, 0, c }, translation[3] = { 0.025f, -0.01f, 0.004f };
+    Calibration calibration;
+    calibration.rmat = cv::Mat(3, 3, CV_32F, const_cast<float *>(rotation));
+    calibration.tvec = cv::Mat(3, 1, CV_32F, const_cast<float *>(translation));
+    const UvProjection projection = uvProjection(calibration, colorCam);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> lateral(-1.5f, 1.5f), depth(0.3f, 4.0f);
+    std::vector<cv::Point3f> points(1001);
+    for (auto &p : points)
+        p = cv::Point3f(lateral(rng), lateral(rng), depth(rng));
+    points[7].z = -1;  // behind the camera
+    points[8].z = 0;
+
+    // all variants give the same result as the scalar one
+    std::vector<cv::Point2f> uv(points.size()), scalarUv(points.size());
+    setCpuLevelOverride(CpuLevel::SCALAR);
+    projectPointsToUv(points.data(), points.size(), projection, scalarUv.data());
+    resetCpuLevelOverride();
+
+    forEachCpuLevel([&]
+    {
+        projectPointsToUv(points.data(), points.size(), projection, uv.data());
+        EXPECT_EQ(uv, scalarUv);
+
+        int numInside = 0;
+        for (size_t k = 0; k < points.size(); ++k)
+        {
+            const cv::Point3f &p = points[k];
+            const double x = c * p.x + s * p.z + translation[0], y = p.y + translation[1], z = -s * p.x + c * p.z + translation[2];
+            const double u = (colorCam.f * x / z + colorCam.cx + 0.5) / colorCam.w, v = (colorCam.f * y / z + colorCam.cy + 0.5) / colorCam.h;
+            if (z > 0 && u > 1e-4 && u < 1 - 1e-4 && v > 1e-4 && v < 1 - 1e-4)
+            {
+                EXPECT_NEAR(uv[k].x, u, 1e-5) << k;
+                EXPECT_NEAR(uv[k].y, v, 1e-5) << k;
+                ++numInside;
+            }
+            else if (z <= 0 || u < -1e-4 || u > 1 + 1e-4 || v < -1e-4 || v > 1 + 1e-4)
+            {
+                EXPECT_EQ(uv[k], cv::Point2f(0, 0)) << k;
+            }
+        }
+        EXPECT_GT(numInside, 100);
+    });
+
+    // no calibration: aligned cameras, same projection as project3dPointTo2d, which truncates to the pixel index
+    const UvProjection aligned = uvProjection(Calibration(), colorCam);
+    projectPointsToUv(points.data(), points.size(), aligned, uv.data());
+    for (size_t k = 0; k < points.size(); ++k)
+    {
+        int i, j;
+        uint16_t d;
+        if (project3dPointTo2d(points[k], colorCam, i, j, d) && uv[k] != cv::Point2f(0, 0))
+        {
+            EXPECT_NEAR(uv[k].x * colorCam.w - 0.5f, j + 0.5f, 0.5f + 1e-3f);
+            EXPECT_NEAR(uv[k].y * colorCam.h - 0.5f, i + 0.5f, 0.5f + 1e-3f);
+        }
+    }
+}
+
+TEST(geom, pointCloudSoA)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coord(-2.0f, 2.0f);
+    std::vector<cv::Point3f> aos(1000);
+    for (auto &p : aos)
+        p = cv::Point3f(coord(rng), coord(rng), coord(rng) + 3.0f);
+
+    PointCloudSoA soa;
+    soa.fromAos(aos);
+    ASSERT_EQ(soa.size(), aos.size());
+    EXPECT_FALSE(soa.hasPixels());
+    for (float *data : { soa.x.data(), soa.y.data(), soa.z.data() })
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % 64, 0u);
+
+    std::vector<cv::Point3f> back;
+    soa.toAos(back);
+    EXPECT_EQ(back, aos);
+
+    // same uv from both layouts
+    const UvProjection projection = uvProjection(Calibration(), CameraParams(600.0f, 320.0f, 240.0f, 640, 480));
+    std::vector<cv::Point2f> uvAos(aos.size()), uvSoa(aos.size());
+    projectPointsToUv(aos.data(), aos.size(), projection, uvAos.data());
+    projectPointsToUv(soa.x.data(), soa.y.data(), soa.z.data(), soa.size(), projection, uvSoa.data());
+    EXPECT_EQ(uvSoa, uvAos);
+
+    // capacity survives clearing, so the next frame does not allocate
+    const float *data = soa.x.data();
+    soa.clear();
+    EXPECT_TRUE(soa.empty());
+    for (int k = 0; k < 500; ++k)
+        soa.push_back(aos[k], PointIJ(short(k / 20), short(k % 20)));
+    EXPECT_EQ(soa.x.data(), data);
+    EXPECT_TRUE(soa.hasPixels());
+    EXPECT_EQ(soa.point(42), aos[42]);
+
+    // the order from the triangulation: reversed, last few points dropped as duplicates
+    std::vector<short> order(490);
+    for (size_t k = 0; k < order.size(); ++k)
+        order[k] = short(499 - k);
+    soa.reorderCoordinates(order.data(), order.size());
+    ASSERT_EQ(soa.size(), order.size());
+    EXPECT_EQ(soa.pixels.size(), 500u);
+    for (size_t k = 0; k < order.size(); ++k)
+        EXPECT_EQ(soa.point(k), aos[order[k]]);
+}
+
+TEST(geom, filterTriangles)
+{
+    constexpr float maxSide2D = 6, maxSide3D = 0.05f, maxDepthRange = 0.03f;
+
+    // noisy surface with a depth discontinuity, triangles between random nearby pixels
+    constexpr int gridSize = 100;
+    std::mt19937 rng(9);
+    std::uniform_int_distribution<int> pixel(0, gridSize - 1), offset(-6, 6);
+    std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+    PointCloudSoA cloud;
+    for (short i = 0; i < gridSize; ++i)
+        for (short j = 0; j < gridSize; ++j)
+        {
+            const float z = (j < gridSize / 2 ? 1.0f : 1.1f) + noise(rng);
+            cloud.push_back(cv::Point3f(j * 0.002f * z, i * 0.002f * z, z), PointIJ(i, j));
+        }
+
+    std::vector<Triangle> triangles(10001);
+    const auto nearby = [&](int i, int j)
+    {
+        i = std::min(std::max(i + offset(rng), 0), gridSize - 1), j = std::min(std::max(j + offset(rng), 0), gridSize - 1);
+        return uint16_t(i * gridSize + j);
+    };
+    for (auto &t : triangles)
+    {
+        const int i = pixel(rng), j = pixel(rng);
+        t.p1 = uint16_t(i * gridSize + j);
+        t.p2 = nearby(i, j);
+        t.p3 = nearby(i, j);
+    }
+
+    // reference: the per-triangle checks of the mesher
+    std::vector<uint8_t> expected(triangles.size());
+    for (size_t k = 0; k < triangles.size(); ++k)
+    {
+        const uint16_t v[3] = { triangles[k].p1, triangles[k].p2, triangles[k].p3 };
+        bool keep = true;
+        float minZ = cloud.z[v[0]], maxZ = minZ;
+        for (int e = 0; e < 3; ++e)
+        {
+            const uint16_t a = v[e], b = v[(e + 1) % 3];
+            const PointIJ &pa = cloud.pixels[a], &pb = cloud.pixels[b];
+            keep = keep && cv::norm(cv::Point2f(pb.j - pa.j, pb.i - pa.i)) <= maxSide2D;
+            keep = keep && cv::norm(cloud.point(b) - cloud.point(a)) <= maxSide3D;
+            minZ = std::min(minZ, cloud.z[a]), maxZ = std::max(maxZ, cloud.z[a]);
+        }
+        expected[k] = keep && maxZ - minZ <= maxDepthRange;
+    }
+
+    std::vector<uint8_t> keep(triangles.size());
+    forEachCpuLevel([&]
+    {
+        filterTriangles(triangles.data(), triangles.size(), cloud.pixels.data(), cloud.x.data(), cloud.y.data(), cloud.z.data(),
+                        maxSide2D, maxSide3D, maxDepthRange, keep.data());
+        EXPECT_EQ(keep, expected);
+
+        const auto us = benchmarkUs([&]
+        {
+            filterTriangles(triangles.data(), triangles.size(), cloud.pixels.data(), cloud.x.data(), cloud.y.data(), cloud.z.data(),
+                            maxSide2D, maxSide3D, maxDepthRange, keep.data());
+        });
+        TLOG(INFO) << triangles.size() << " triangles, filter " << cpuLevelName(cpuLevel()) << ": " << us << " us";
+    });
+
+    const auto numKept = std::count(expected.begin(), expected.end(), 1);
+    EXPECT_GT(numKept, 0);
+    EXPECT_LT(numKept, std::ptrdiff_t(triangles.size()));
+}
+
+TEST(geom, batchedProjectionBenchmark)
+{
+    const CameraParams cam(520.965f, 319.223f, 175.641f, 640, 480);
+    const cv::Mat depth = testDepth();
+    const size_t numPixels = depth.total();
+
+    std::vector<float> cols(depth.cols);
+    for (int j = 0; j < depth.cols; ++j)
+        cols[j] = float(j);
+
+    std::vector<float> x(numPixels), y(numPixels), z(numPixels);
+    std::vector<uint8_t> valid(numPixels);
+    std::vector<cv::Point3f> cloud(numPixels);
+    std::vector<int> iImg(numPixels), jImg(numPixels);
+    std::vector<uint16_t> d(numPixels);
+    int numValid = 0;
+
+    const auto scalar2dTo3d = benchmarkUs([&]
+    {
+        for (int i = 0; i < depth.rows; ++i)
+            for (int j = 0; j < depth.cols; ++j)
+                cloud[i * depth.cols + j] = project2dPointTo3d(i, j, depth.at<uint16_t>(i, j), cam);
+    });
+    const auto scalar3dTo2d = benchmarkUs([&]
+    {
+        for (size_t k = 0; k < numPixels; ++k)
+            numValid += project3dPointTo2d(cloud[k], cam, iImg[k], jImg[k], d[k]);
+    });
+    TLOG(INFO) << numPixels << " points, per point functions: 2D->3D " << scalar2dTo3d << " us, 3D->2D " << scalar3dTo2d << " us";
+
+    const UvProjection projection = uvProjection(Calibration(), cam);
+    std::vector<cv::Point2f> uv(numPixels);
+
+    forEachCpuLevel([&]
+    {
+        const auto batched2dTo3d = benchmarkUs([&]
+        {
+            for (int i = 0; i < depth.rows; ++i)
+            {
+                const size_t offset = size_t(i) * depth.cols;
+                project2dPointsTo3d(i, cols.data(), depth.ptr<uint16_t>(i), depth.cols, cam,
+                                    x.data() + offset, y.data() + offset, z.data() + offset, valid.data() + offset);
+            }
+        });
+        const auto batchedSoa3dTo2d = benchmarkUs([&]
+        {
+            project3dPointsTo2d(x.data(), y.data(), z.data(), numPixels, cam, iImg.data(), jImg.data(), d.data(), valid.data());
+        });
+        const auto batchedAos3dTo2d = benchmarkUs([&]
+        {
+            project3dPointsTo2d(cloud.data(), numPixels, cam, iImg.data(), jImg.data(), d.data(), valid.data());
+        });
+        const auto batchedUv = benchmarkUs([&]
+        {
+            projectPointsToUv(cloud.data(), numPixels, projection, uv.data());
+        });
+        const auto batchedSoaUv = benchmarkUs([&]
+        {
+            projectPointsToUv(x.data(), y.data(), z.data(), numPixels, projection, uv.data());
+        });
+
+        TLOG(INFO) << numPixels << " points, batched " << cpuLevelName(cpuLevel()) << ": 2D->3D " << batched2dTo3d
+                   << " us, 3D->2D " << batchedSoa3dTo2d << " us, 3D->2D from array of structures " << batchedAos3dTo2d
+                   << " us, uv " << batchedUv << " us, uv from structure of arrays " << batchedSoaUv << " us";
+    });
+
+    EXPECT_GT(numValid, 0);
+}
@@ -1,7 +1,13 @@
+#include <cstdio>
+
 #include <gtest/gtest.h>
 
+#include <util/util.hpp>
 #include <util/io_3d.hpp>
+#include <util/ply_reader.hpp>
 #include <util/test_utils.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/tiny_profiler.hpp>
 #include <util/filesystem_utils.hpp>
 
 
@@ -23,3 +29,272 @@ TEST(io3d, binaryPly)
     EXPECT_TRUE(isOk);
     EXPECT_EQ(cloud.size(), 11973);
 }
+
+namespace
+{
+
+void randomMesh(int numVertices, int numTriangles, std::vector<cv::Point3f> &vertices, std::vector<Triangle> &triangles, std::vector<cv::Point2f> &uv)
+{
+    vertices.clear(), triangles.clear(), uv.clear();
+    for (int i = 0; i < numVertices; ++i)
+    {
+        vertices.emplace_back(randRange(-1000, 1000) / 1000.0f, randRange(-1000, 1000) / 1000.0f, randRange(0, 3000) / 1000.0f);
+        uv.emplace_back(randRange(0, 1000) / 1000.0f, randRange(0, 1000) / 1000.0f);
+    }
+    for (int i = 0; i < numTriangles; ++i)
+        triangles.push_back({ uint16_t(randRange(0, numVertices - 1)), uint16_t(randRange(0, numVertices - 1)), uint16_t(randRange(0, numVertices - 1)) });
+}
+
+/// Straightforward per-field writer, reference for the legacy layout.
+std::string legacyPlyBody(const std::vector<cv::Point3f> &vertices, const std::vector<Triangle> &triangles, const std::vector<cv::Point2f> &uv)
+{
+    std::ostringstream ply;
+    ply.write((const char *)vertices.data(), vertices.size() * sizeof(cv::Point3f));
+
+    constexpr char numSides = 3, numUv = numSides * 2;
+    for (const auto &t : triangles)
+    {
+        ply.write(&numSides, sizeof(numSides));
+        const int idx[] = { t.p1, t.p2, t.p3 };
+        ply.write((const char *)idx, sizeof(idx));
+        ply.write(&numUv, sizeof(numUv));
+        for (int j = 0; j < numSides; ++j)
+            ply.write((const char *)&uv[idx[j]], sizeof(cv::Point2f));
+    }
+
+    return ply.str();
+}
+
+}
+
+
+TEST(io3d, plyLegacyLayout)
+{
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+    randomMesh(5000, 40000, vertices, triangles, uv);  // more than one parallel chunk
+
+    std::vector<char> buffer;
+    const std::string texture{ "0000.jpg" };
+    serializeBinaryPly(buffer, &vertices, &triangles, &uv, &texture);
+
+    const std::string body = legacyPlyBody(vertices, triangles, uv);
+    ASSERT_GT(buffer.size(), body.size());
+    const std::string header(buffer.begin(), buffer.end() - body.size());
+    EXPECT_NE(header.find("property list uchar int vertex_indices\n"), std::string::npos);
+    EXPECT_NE(header.find("property list uchar float texcoord\nend_header\n"), std::string::npos);
+    EXPECT_TRUE(std::equal(body.begin(), body.end(), buffer.end() - body.size()));
+}
+
+TEST(io3d, plyCompactLayout)
+{
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+    randomMesh(100, 200, vertices, triangles, uv);
+
+    PlyOptions options;
+    options.indexType = PlyIndexType::USHORT;
+    options.perVertexUv = true;
+    std::vector<char> buffer;
+    serializeBinaryPly(buffer, &vertices, &triangles, &uv, nullptr, options);
+
+    const std::string endHeader{ "end_header\n" };
+    const std::string bufferStr(buffer.begin(), buffer.end());
+    const size_t headerSize = bufferStr.find(endHeader) + endHeader.size();
+    EXPECT_NE(bufferStr.find("property float s\nproperty float t\n"), std::string::npos);
+    EXPECT_NE(bufferStr.find("property list uchar ushort vertex_indices\n"), std::string::npos);
+    EXPECT_EQ(buffer.size() - headerSize, vertices.size() * 5 * sizeof(float) + triangles.size() * (1 + 3 * sizeof(uint16_t)));
+
+    // spot-check the last vertex and the last face
+    const char *lastVertex = buffer.data() + headerSize + (vertices.size() - 1) * 5 * sizeof(float);
+    EXPECT_EQ(0, memcmp(lastVertex, &vertices.back(), sizeof(cv::Point3f)));
+    EXPECT_EQ(0, memcmp(lastVertex + sizeof(cv::Point3f), &uv.back(), sizeof(cv::Point2f)));
+    const char *lastFace = buffer.data() + buffer.size() - 3 * sizeof(uint16_t);
+    EXPECT_EQ(3, lastFace[-1]);
+    EXPECT_EQ(0, memcmp(lastFace, &triangles.back(), sizeof(Triangle)));
+}
+
+TEST(io3d, plyWriterBenchmark)
+{
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+    randomMesh(30000, 60000, vertices, triangles, uv);  // typical frame size
+
+    const std::string tmpMeshFilename{ pathJoin(getTestDataFolder(), "tmp_mesh.ply") };
+    constexpr int numIterations = 20;
+
+    tprof().startTimer("ply_reference_writer");
+    for (int i = 0; i < numIterations; ++i)
+    {
+        std::ofstream ply{ tmpMeshFilename, std::ios::binary };
+        const auto body = legacyPlyBody(vertices, triangles, uv);
+        ply.write(body.data(), body.size());
+    }
+    const float referenceUsec = tprof().stopTimer("ply_reference_writer");
+
+    tprof().startTimer("ply_legacy_layout");
+    for (int i = 0; i < numIterations; ++i)
+        EXPECT_TRUE(saveBinaryPly(tmpMeshFilename, &vertices, &triangles, &uv));
+    const float legacyUsec = tprof().stopTimer("ply_legacy_layout");
+
+    PlyOptions options;
+    options.indexType = PlyIndexType::USHORT;
+    options.perVertexUv = true;
+    tprof().startTimer("ply_compact_layout");
+    for (int i = 0; i < numIterations; ++i)
+        EXPECT_TRUE(saveBinaryPly(tmpMeshFilename, &vertices, &triangles, &uv, nullptr, options));
+    const float compactUsec = tprof().stopTimer("ply_compact_layout");
+
+    TLOG(INFO) << "Per mesh, reference: " << referenceUsec / numIterations << " us, legacy layout: " << legacyUsec / numIterations
+               << " us, compact layout: " << compactUsec / numIterations << " us";
+
+    std::remove(tmpMeshFilename.c_str());
+}
+
+TEST(io3d, plyRoundTrip)
+{
+    std::vector<cv::Point3f> vertices, loadedVertices;
+    std::vector<Triangle> triangles, loadedTriangles;
+    std::vector<cv::Point2f> uv, loadedUv;
+    randomMesh(1000, 3000, vertices, triangles, uv);
+    for (const auto &t : triangles)  // vertices not referenced by faces don't get texture coordinates from per-face lists
+        for (uint16_t idx : { t.p1, t.p2, t.p3 })
+            uv[idx] = cv::Point2f(idx / 1000.0f, 1 - idx / 1000.0f);
+
+    const std::string tmpMeshFilename{ pathJoin(getTestDataFolder(), "tmp_mesh.ply") };
+
+    PlyOptions compact;
+    compact.indexType = PlyIndexType::USHORT;
+    compact.perVertexUv = true;
+
+    for (const auto &options : { PlyOptions(), compact })
+    {
+        ASSERT_TRUE(saveBinaryPly(tmpMeshFilename, &vertices, &triangles, &uv, nullptr, options));
+        ASSERT_TRUE(loadBinaryPly(tmpMeshFilename, &loadedVertices, nullptr, &loadedTriangles, &loadedUv));
+
+        EXPECT_TRUE(loadedVertices == vertices);
+        ASSERT_EQ(loadedTriangles.size(), triangles.size());
+        EXPECT_EQ(0, memcmp(loadedTriangles.data(), triangles.data(), triangles.size() * sizeof(Triangle)));
+
+        ASSERT_EQ(loadedUv.size(), uv.size());
+        for (const auto &t : triangles)
+            EXPECT_EQ(loadedUv[t.p1], uv[t.p1]);
+    }
+
+    std::vector<cv::Vec3b> colors;
+    EXPECT_FALSE(loadBinaryPly(tmpMeshFilename, &loadedVertices, &colors));  // no colors in the file
+
+    std::remove(tmpMeshFilename.c_str());
+}
+
+TEST(io3d, plyBigEndianAndConversion)
+{
+    // hand-made file: double positions, big endian, int8 list counts, int16 indices, quad face
+    std::ostringstream ply;
+    ply << "ply\r\nformat binary_big_endian 1.0\r\ncomment TextureFile tex.jpg\r\n"
+        << "element vertex 4\r\nproperty float64 x\r\nproperty float64 y\r\nproperty float64 z\r\nproperty uint16 confidence\r\n"
+        << "element face 1\r\nproperty list int8 int16 vertex_indices\r\nend_header\r\n";
+
+    auto writeBigEndian = [&](auto value)
+    {
+        endianSwap(&value);
+        ply.write((const char *)&value, sizeof(value));
+    };
+
+    const std::vector<cv::Point3f> expected{ { 0, 0, 1 }, { 1, 0, 1.5f }, { 1, 1, 2 }, { 0, 1, -1 } };
+    for (const auto &p : expected)
+        writeBigEndian(double(p.x)), writeBigEndian(double(p.y)), writeBigEndian(double(p.z)), writeBigEndian(uint16_t(7));
+    writeBigEndian(int8_t(4));
+    for (int16_t idx : { 0, 1, 2, 3 })
+        writeBigEndian(idx);
+
+    const std::string filename{ pathJoin(getTestDataFolder(), "tmp_big_endian.ply") };
+    {
+        std::ofstream f(filename, std::ios::binary);
+        const auto data = ply.str();
+        f.write(data.data(), data.size());
+    }
+
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    ASSERT_TRUE(loadBinaryPly(filename, &vertices, nullptr, &triangles));
+    EXPECT_TRUE(vertices == expected);
+    ASSERT_EQ(triangles.size(), 2);
+    EXPECT_EQ(triangles[1].p1, 0);
+    EXPECT_EQ(triangles[1].p2, 2);
+    EXPECT_EQ(triangles[1].p3, 3);
+
+    PlyReader reader;
+    ASSERT_TRUE(reader.open(filename));
+    ASSERT_EQ(reader.comments().size(), 1);
+    EXPECT_EQ(reader.comments().front(), "TextureFile tex.jpg");
+
+    PlyView<uint16_t> confidence;
+    std::vector<uint16_t> storage;
+    ASSERT_TRUE((reader.readProperties<uint16_t, uint16_t>("vertex", { "confidence" }, confidence, storage)));
+    EXPECT_EQ(confidence.data(), storage.data());  // big endian data can't be used directly
+    EXPECT_EQ(confidence[3], 7);
+
+    std::remove(filename.c_str());
+}
+
+TEST(io3d, plyZeroCopy)
+{
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+    randomMesh(1000, 10, vertices, triangles, uv);
+
+    PlyOptions options;
+    options.perVertexUv = true;
+    const std::string tmpMeshFilename{ pathJoin(getTestDataFolder(), "tmp_mesh.ply") };
+    ASSERT_TRUE(saveBinaryPly(tmpMeshFilename, &vertices, &triangles, &uv, nullptr, options));
+
+    PlyReader reader;
+    ASSERT_TRUE(reader.open(tmpMeshFilename));
+
+    PlyView<cv::Point3f> positions;
+    PlyView<cv::Point2f> texcoords;
+    std::vector<cv::Point3f> positionStorage;
+    std::vector<cv::Point2f> uvStorage;
+    ASSERT_TRUE((reader.readProperties<cv::Point3f, float>("vertex", { "x", "y", "z" }, positions, positionStorage)));
+    ASSERT_TRUE((reader.readProperties<cv::Point2f, float>("vertex", { "s", "t" }, texcoords, uvStorage)));
+
+    // header length is not necessarily a multiple of 4, then the data has to be copied
+    const bool aligned = (reader.element("vertex")->dataOffset % sizeof(float)) == 0;
+    EXPECT_EQ(positionStorage.empty(), aligned);
+    EXPECT_EQ(positions.contiguous(), !aligned);  // in the file positions are interleaved with uv
+
+    ASSERT_EQ(positions.size(), vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        EXPECT_EQ(positions[i], vertices[i]);
+        EXPECT_EQ(texcoords[i], uv[i]);
+    }
+
+    std::remove(tmpMeshFilename.c_str());
+}
+
+TEST(io3d, plyLoaderBenchmark)
+{
+    std::vector<cv::Point3f> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+    randomMesh(30000, 60000, vertices, triangles, uv);
+
+    const std::string tmpMeshFilename{ pathJoin(getTestDataFolder(), "tmp_mesh.ply") };
+    ASSERT_TRUE(saveBinaryPly(tmpMeshFilename, &vertices, &triangles, &uv));
+
+    constexpr int numIterations = 20;
+    tprof().startTimer("ply_load");
+    for (int i = 0; i < numIterations; ++i)
+        EXPECT_TRUE(loadBinaryPly(tmpMeshFilename, &vertices, nullptr, &triangles, &uv));
+    const float usec = tprof().stopTimer("ply_load");
+
+    TLOG(INFO) << "Load mesh with per-face uv: " << usec / numIterations << " us";
+
+    std::remove(tmpMeshFilename.c_str());
+}
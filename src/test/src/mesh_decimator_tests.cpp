@@ -0,0 +1,118 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <4d/mesh_decimator.hpp>
+
+
+namespace
+{
+
+std::shared_ptr<MeshFrame> gridFrame(int frameNumber, int gridW, int gridH)
+{
+    auto frame = std::make_shared<MeshFrame>();
+    frame->frame2D = std::make_shared<Frame>();
+    frame->frame2D->frameNumber = frameNumber;
+    frame->frame2D->color = cv::Mat(480, 640, CV_8UC3);
+    frame->indexedMode = true;
+
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+        {
+            frame->cloud.emplace_back(j * 0.01f, i * 0.01f, 1.0f + 0.01f * std::sin(j * 0.2f + frameNumber));
+            frame->uv.emplace_back(float(j) / gridW, float(i) / gridH);
+        }
+    frame->normals.resize(frame->cloud.size());
+
+    for (int i = 0; i + 1 < gridH; ++i)
+        for (int j = 0; j + 1 < gridW; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridW + j);
+            frame->triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridW) });
+            frame->triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridW + 1), uint16_t(p + gridW) });
+        }
+
+    return frame;
+}
+
+}
+
+
+TEST(meshDecimator, budget)
+{
+    SimplificationSettings settings;
+    settings.targetTriangles = 1000;
+    settings.maxError = 0.01f;
+
+    constexpr int numFrames = 20;
+    // the producer is never cancelled, so the frames simplified after cancellation are not dropped
+    CancellationToken cancel, outputCancel;
+    MeshFrameQueue input(numFrames), output(numFrames);
+    MeshFrameProducer producer(outputCancel);
+    producer.addQueue(&output);
+
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        frames.emplace_back(gridFrame(i, 80, 60));
+        input.put(frames.back(), 0);
+    }
+    const size_t numInputTriangles = frames.front()->triangles.size();
+
+    MeshDecimator decimator(input, producer, cancel, settings);
+    std::thread thread([&] { decimator.init(); decimator.run(); });
+    while (!input.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancel.trigger();
+    thread.join();
+
+    // all frames in the original order, within the budget, input frames are not modified
+    std::shared_ptr<MeshFrame> frame;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        ASSERT_TRUE(output.pop(frame, 0));
+        EXPECT_EQ(frame->frame2D->frameNumber, i);
+        EXPECT_NE(frame, frames[i]);
+        EXPECT_LE(frame->triangles.size(), settings.targetTriangles * 3 / 2);
+        EXPECT_GT(frame->triangles.size(), 0u);
+        EXPECT_EQ(frame->uv.size(), frame->cloud.size());
+        EXPECT_EQ(frames[i]->triangles.size(), numInputTriangles);
+    }
+    EXPECT_FALSE(output.pop(frame, 0));
+
+    // frames within the budget are passed as is
+    const auto small = gridFrame(0, 10, 10);
+    EXPECT_EQ(MeshDecimator::decimate(small, settings), small);
+}
+
+TEST(meshDecimator, lods)
+{
+    auto frame = gridFrame(0, 80, 60);
+    const size_t numTriangles = frame->triangles.size();
+
+    MeshDecimator::addLods(frame, 3, 0.01f);
+    ASSERT_EQ(frame->lods.size(), 2u);
+    EXPECT_LE(frame->lods[0]->triangles.size(), numTriangles / 2 + 1);
+    EXPECT_LE(frame->lods[1]->triangles.size(), frame->lods[0]->triangles.size() / 2 + 1);
+    for (const auto &lod : frame->lods)
+    {
+        EXPECT_EQ(lod->frame2D, frame->frame2D);
+        EXPECT_TRUE(lod->lods.empty());
+        EXPECT_EQ(lod->uv.size(), lod->cloud.size());
+    }
+
+    // consumers pick the most detailed level within their budget
+    EXPECT_EQ(selectLod(frame, numTriangles), frame);
+    EXPECT_EQ(selectLod(frame, numTriangles - 1), frame->lods[0]);
+    EXPECT_EQ(selectLod(frame, frame->lods[1]->triangles.size()), frame->lods[1]);
+    EXPECT_EQ(selectLod(frame, 1), frame->lods[1]);
+
+    // decimation starts from the closest level
+    SimplificationSettings settings;
+    settings.targetTriangles = frame->lods[0]->triangles.size();
+    EXPECT_EQ(MeshDecimator::decimate(frame, settings), frame->lods[0]);
+    settings.targetTriangles = frame->lods[1]->triangles.size() / 2;
+    const auto decimated = MeshDecimator::decimate(frame, settings);
+    EXPECT_LE(decimated->triangles.size(), settings.targetTriangles * 3 / 2);
+    EXPECT_TRUE(decimated->lods.empty());
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <4d/mesh_frame_cache.hpp>
+
+
+namespace
+{
+
+std::shared_ptr<MeshFrame> meshFrame(int frameNumber, int numPoints)
+{
+    auto frame = std::make_shared<MeshFrame>();
+    frame->frame2D = std::make_shared<Frame>();
+    frame->frame2D->frameNumber = frameNumber;
+    frame->cloud.resize(size_t(numPoints));
+    return frame;
+}
+
+}
+
+
+TEST(meshFrameCache, lru)
+{
+    const size_t frameBytes = MeshFrameCache::frameBytes(*meshFrame(0, 1000));
+    MeshFrameCache cache(3 * frameBytes);
+
+    for (int i = 0; i < 3; ++i)
+        cache.put("a", i, meshFrame(i, 1000));
+    EXPECT_EQ(cache.getStats().numFrames, 3);
+    EXPECT_EQ(cache.getStats().numBytes, 3 * frameBytes);
+
+    // datasets don't share frames
+    EXPECT_EQ(cache.get("b", 0), nullptr);
+
+    // frame 0 is used recently, so frame 1 is evicted first
+    ASSERT_NE(cache.get("a", 0), nullptr);
+    EXPECT_EQ(cache.get("a", 0)->frame2D->frameNumber, 0);
+    cache.put("a", 3, meshFrame(3, 1000));
+    EXPECT_EQ(cache.get("a", 1), nullptr);
+    EXPECT_NE(cache.get("a", 0), nullptr);
+    EXPECT_NE(cache.get("a", 2), nullptr);
+    EXPECT_NE(cache.get("a", 3), nullptr);
+
+    // replacing the same frame does not leak memory
+    cache.put("a", 3, meshFrame(3, 1000));
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.numFrames, 3);
+    EXPECT_EQ(stats.numBytes, 3 * frameBytes);
+    EXPECT_EQ(stats.numEvicted, 1u);
+    EXPECT_EQ(stats.numHits, 5u);
+    EXPECT_EQ(stats.numMisses, 2u);
+
+    // a big frame evicts several small ones, too big frames are not cached at all
+    cache.put("a", 4, meshFrame(4, 2000));
+    EXPECT_LE(cache.getStats().numBytes, 3 * frameBytes);
+    EXPECT_EQ(cache.getStats().numFrames, 2);
+    cache.put("a", 5, meshFrame(5, 10000));
+    EXPECT_EQ(cache.get("a", 5), nullptr);
+    EXPECT_NE(cache.get("a", 4), nullptr);
+}
@@ -0,0 +1,168 @@
+#include <array>
+#include <random>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <util/mesh_optimization.hpp>
+#include <util/mesh_simplification.hpp>
+
+
+namespace
+{
+
+std::vector<Triangle> gridTriangles(int gridW, int gridH)
+{
+    std::vector<Triangle> triangles;
+    for (int i = 0; i + 1 < gridH; ++i)
+        for (int j = 0; j + 1 < gridW; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridW + j);
+            triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridW) });
+            triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridW + 1), uint16_t(p + gridW) });
+        }
+    return triangles;
+}
+
+/// Triangles as sets of vertices, rotations of the same triangle are equal.
+std::vector<std::array<uint16_t, 3>> canonical(const std::vector<Triangle> &triangles, const std::vector<int> *remap = nullptr)
+{
+    std::vector<std::array<uint16_t, 3>> result;
+    for (const auto &t : triangles)
+    {
+        std::array<uint16_t, 3> v = { t.p1, t.p2, t.p3 };
+        if (remap)
+            for (auto &idx : v)
+                idx = uint16_t((*remap)[idx]);
+
+        // rotate so the smallest index is the first, the winding stays the same
+        std::rotate(v.begin(), std::min_element(v.begin(), v.end()), v.end());
+        result.push_back(v);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+}
+
+
+TEST(meshOptimization, vertexCache)
+{
+    constexpr int gridW = 120, gridH = 90, numVertices = gridW * gridH;
+    auto triangles = gridTriangles(gridW, gridH);
+
+    // row-by-row order is already decent, random order is the worst case
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+    const auto shuffled = analyzeVertexCache(triangles, numVertices);
+    EXPECT_GT(shuffled.acmr, 2.0f);
+
+    const auto expected = canonical(triangles);
+    optimizeVertexCache(triangles, numVertices);
+    EXPECT_EQ(canonical(triangles), expected);
+
+    const auto optimized = analyzeVertexCache(triangles, numVertices);
+    EXPECT_LT(optimized.acmr, 0.8f);
+    EXPECT_LT(optimized.atvr, 1.5f);
+    EXPECT_GE(optimized.atvr, 1.0f);
+
+    const auto rowByRow = analyzeVertexCache(gridTriangles(gridW, gridH), numVertices);
+    EXPECT_LT(optimized.acmr, rowByRow.acmr);
+
+    // degenerate inputs
+    std::vector<Triangle> empty;
+    optimizeVertexCache(empty, 0);
+    EXPECT_EQ(analyzeVertexCache(empty, 0).acmr, 0);
+}
+
+TEST(meshOptimization, vertexFetch)
+{
+    constexpr int gridW = 40, gridH = 30, numVertices = gridW * gridH + 10;  // few unused vertices
+    auto triangles = gridTriangles(gridW, gridH);
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+    const auto original = triangles;
+
+    std::vector<int> remap;
+    const size_t numUsed = optimizeVertexFetch(triangles, numVertices, remap);
+    EXPECT_EQ(numUsed, size_t(gridW * gridH));
+    EXPECT_EQ(canonical(triangles), canonical(original, &remap));
+
+    // vertices are numbered in the order of the first use
+    int maxIndex = -1;
+    for (const auto &t : triangles)
+        for (uint16_t v : { t.p1, t.p2, t.p3 })
+        {
+            EXPECT_LE(int(v), maxIndex + 1);
+            maxIndex = std::max(maxIndex, int(v));
+        }
+
+    std::vector<int> values(numVertices);
+    for (int i = 0; i < numVertices; ++i)
+        values[i] = i;
+    remapVertices(values, remap, numUsed);
+    ASSERT_EQ(values.size(), numUsed);
+    for (int i = 0; i < numVertices; ++i)
+        if (remap[i] >= 0)
+            EXPECT_EQ(values[remap[i]], i);
+}
+
+TEST(meshOptimization, simplifyFlat)
+{
+    // planar grid: every interior collapse is free, the boundary must stay in place
+    constexpr int gridW = 60, gridH = 40;
+    std::vector<cv::Point3f> cloud;
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+            cloud.emplace_back(j * 0.01f, i * 0.01f, 1.0f);
+
+    const auto area = [&](const std::vector<cv::Point3f> &points, const std::vector<Triangle> &triangles)
+    {
+        double sum = 0;
+        for (const auto &t : triangles)
+            sum += 0.5 * cv::norm((points[t.p2] - points[t.p1]).cross(points[t.p3] - points[t.p1]));
+        return sum;
+    };
+
+    auto triangles = gridTriangles(gridW, gridH);
+    const double originalArea = area(cloud, triangles);
+
+    SimplificationSettings settings;
+    settings.targetTriangles = triangles.size() / 10;
+    std::vector<int> remap;
+    const size_t numVertices = simplifyMesh(cloud, triangles, settings, remap);
+    remapVertices(cloud, remap, numVertices);
+
+    EXPECT_LE(triangles.size(), settings.targetTriangles * 3 / 2);
+    EXPECT_GT(triangles.size(), 0u);
+    EXPECT_EQ(cloud.size(), numVertices);
+    EXPECT_NEAR(area(cloud, triangles), originalArea, originalArea * 1e-4);
+
+    // all four corners survive
+    for (const cv::Point3f corner : { cv::Point3f(0, 0, 1), cv::Point3f((gridW - 1) * 0.01f, 0, 1),
+                                      cv::Point3f(0, (gridH - 1) * 0.01f, 1), cv::Point3f((gridW - 1) * 0.01f, (gridH - 1) * 0.01f, 1) })
+        EXPECT_TRUE(std::any_of(cloud.begin(), cloud.end(), [&](const cv::Point3f &p) { return cv::norm(p - corner) < 1e-6; }));
+}
+
+TEST(meshOptimization, simplifyErrorBound)
+{
+    // strongly curved surface, tiny error bound: only few collapses are allowed
+    constexpr int gridW = 40, gridH = 40;
+    std::vector<cv::Point3f> cloud;
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+            cloud.emplace_back(j * 0.01f, i * 0.01f, 1.0f + 0.05f * std::sin(j * 0.5f) * std::cos(i * 0.5f));
+
+    auto triangles = gridTriangles(gridW, gridH);
+    const size_t originalTriangles = triangles.size();
+
+    SimplificationSettings settings;
+    settings.maxError = 1e-5f;
+    std::vector<int> remap;
+    simplifyMesh(cloud, triangles, settings, remap);
+    EXPECT_GT(triangles.size(), originalTriangles * 3 / 4);
+
+    // looser bound gives a coarser mesh
+    triangles = gridTriangles(gridW, gridH);
+    settings.maxError = 0.01f;
+    simplifyMesh(cloud, triangles, settings, remap);
+    EXPECT_LT(triangles.size(), originalTriangles / 2);
+}
@@ -0,0 +1,181 @@
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <util/util.hpp>
+#include <util/io_3d.hpp>
+#include <util/test_utils.hpp>
+#include <util/tiny_logger.hpp>
+#include <util/filesystem_utils.hpp>
+
+#include <4d/mesh_sequence.hpp>
+#include <4d/mesh_sequence_input.hpp>
+#include <4d/mesh_sequence_writer.hpp>
+
+
+namespace
+{
+
+/// Wavy grid surface with two triangles per cell, z changes with time.
+void gridMesh(int gridW, int gridH, float time, std::vector<cv::Point3f> &cloud, std::vector<Triangle> &triangles, std::vector<cv::Point2f> &uv)
+{
+    cloud.clear(), triangles.clear(), uv.clear();
+    for (int i = 0; i < gridH; ++i)
+        for (int j = 0; j < gridW; ++j)
+        {
+            cloud.emplace_back(j * 0.01f - 0.5f, i * 0.01f - 0.3f, 1.5f + 0.05f * std::sin(j * 0.1f + time) * std::cos(i * 0.1f));
+            uv.emplace_back(float(j) / gridW, float(i) / gridH);
+        }
+
+    for (int i = 0; i + 1 < gridH; ++i)
+        for (int j = 0; j + 1 < gridW; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridW + j);
+            triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridW) });
+            triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridW + 1), uint16_t(p + gridW) });
+        }
+}
+
+void expectNear(const std::vector<cv::Point3f> &a, const std::vector<cv::Point3f> &b, float tolerance)
+{
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i)
+        EXPECT_LE(cv::norm(a[i] - b[i]), tolerance);
+}
+
+}
+
+
+TEST(meshSequence, codecRoundTrip)
+{
+    std::vector<cv::Point3f> cloud, decodedCloud;
+    std::vector<Triangle> triangles, decodedTriangles;
+    std::vector<cv::Point2f> uv, decodedUv;
+
+    MeshSequenceEncoder encoder(4);
+    MeshSequenceDecoder decoder;
+    std::vector<uint8_t> payload;
+
+    const float tolerance = defaultQuantizationStep;  // half a step per coordinate
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        gridMesh(100, 60, frame * 0.1f, cloud, triangles, uv);
+        if (frame == 6)
+            triangles.pop_back();  // topology change
+
+        const MeshFrameType type = encoder.encode(cloud, triangles, uv, payload);
+        const bool expectIntra = frame == 0 || frame == 4 || frame == 6 || frame == 7;  // keyframe interval, topology changes
+        EXPECT_EQ(type == MeshFrameType::INTRA, expectIntra) << frame;
+
+        ASSERT_TRUE(decoder.decode(type, payload.data(), payload.size(), decodedCloud, decodedTriangles, decodedUv));
+        expectNear(decodedCloud, cloud, tolerance);
+        ASSERT_EQ(decodedTriangles.size(), triangles.size());
+        EXPECT_EQ(0, memcmp(decodedTriangles.data(), triangles.data(), triangles.size() * sizeof(Triangle)));
+        ASSERT_EQ(decodedUv.size(), uv.size());
+        for (size_t i = 0; i < uv.size(); ++i)
+            EXPECT_LE(cv::norm(decodedUv[i] - uv[i]), 1e-4);
+    }
+
+    // corrupted payload is rejected, delta frame requires the previous frame
+    payload.pop_back();
+    MeshSequenceDecoder freshDecoder;
+    EXPECT_FALSE(freshDecoder.decode(MeshFrameType::INTRA, payload.data(), payload.size(), decodedCloud, decodedTriangles, decodedUv));
+    EXPECT_FALSE(freshDecoder.decode(MeshFrameType::DELTA, payload.data(), payload.size(), decodedCloud, decodedTriangles, decodedUv));
+}
+
+TEST(meshSequence, containerSeek)
+{
+    const std::string path{ pathJoin(getTestDataFolder(), "tmp_sequence.4ds") };
+    constexpr int numFrames = 70;
+
+    std::vector<std::shared_ptr<MeshFrame>> frames;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        auto frame = std::make_shared<MeshFrame>();
+        frame->indexedMode = true;
+        frame->frame2D = std::make_shared<Frame>();
+        frame->frame2D->frameNumber = i;
+        frame->frame2D->dTimestamp = int64_t(i) * 33333;
+        frame->frame2D->color = cv::Mat(120, 160, CV_8UC3, cv::Scalar(i, 255 - i, 128));
+        gridMesh(40, 30, i * 0.1f, frame->cloud, frame->triangles, frame->uv);
+        frames.emplace_back(frame);
+    }
+
+    {
+        CancellationToken cancellationToken;
+        MeshFrameQueue queue;
+        for (auto &frame : frames)
+            queue.put(frame);
+
+        std::thread writerThread([&]
+        {
+            MeshSequenceWriter writer(path, queue, cancellationToken);
+            writer.run();
+        });
+
+        while (!queue.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cancellationToken.trigger();  // consumer finishes the current frame before it checks the token
+        writerThread.join();
+    }
+
+    MeshSequenceInput input(path, true);
+    ASSERT_EQ(input.open(), Status::SUCCESS);
+    ASSERT_EQ(input.getSeekTable().size(), 3);  // default keyframe interval is 30
+
+    MeshFrame frame;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        ASSERT_EQ(input.readFrame(frame), Status::SUCCESS);
+        EXPECT_EQ(frame.frame2D->frameNumber, i);
+        EXPECT_EQ(frame.frame2D->dTimestamp, frames[i]->frame2D->dTimestamp);
+        EXPECT_FALSE(frame.frame2D->color.empty());
+        expectNear(frame.cloud, frames[i]->cloud, defaultQuantizationStep);
+    }
+    EXPECT_TRUE(input.finished());
+    EXPECT_TRUE(frame.frame2D->lastFrame);
+
+    for (int target : { 45, 0, 69, 30 })
+    {
+        ASSERT_EQ(input.seek(target), Status::SUCCESS);
+        ASSERT_EQ(input.readFrame(frame), Status::SUCCESS);
+        EXPECT_EQ(frame.frame2D->frameNumber, target);
+        expectNear(frame.cloud, frames[target]->cloud, defaultQuantizationStep);
+    }
+}
+
+TEST(meshSequence, compressionBenchmark)
+{
+    constexpr int numFrames = 60;
+    std::vector<cv::Point3f> cloud;
+    std::vector<Triangle> triangles;
+    std::vector<cv::Point2f> uv;
+
+    MeshSequenceEncoder encoder;
+    std::vector<uint8_t> payload;
+    std::vector<char> ply;
+    size_t sequenceBytes = 0, plyBytes = 0;
+    std::chrono::duration<float, std::micro> sequenceUsec(0), plyUsec(0);
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        // re-triangulated frames are intra-coded (in real captures that's almost every frame), here it's 2 out of 3
+        gridMesh(160, i % 3 == 0 ? 119 : 120, i * 0.1f, cloud, triangles, uv);
+
+        auto start = std::chrono::steady_clock::now();
+        encoder.encode(cloud, triangles, uv, payload);
+        sequenceUsec += std::chrono::steady_clock::now() - start;
+        sequenceBytes += payload.size();
+
+        start = std::chrono::steady_clock::now();
+        serializeBinaryPly(ply, &cloud, &triangles, &uv);
+        plyUsec += std::chrono::steady_clock::now() - start;
+        plyBytes += ply.size();
+    }
+
+    TLOG(INFO) << "PLY: " << plyBytes / 1024 << " KB, " << plyUsec.count() / numFrames << " us per frame; sequence: "
+               << sequenceBytes / 1024 << " KB, " << sequenceUsec.count() / numFrames << " us per frame, "
+               << float(plyBytes) / sequenceBytes << "x smaller";
+    EXPECT_LT(sequenceBytes * 3, plyBytes);
+}
@@ -0,0 +1,114 @@
+#ifdef WITH_EGL
+
+#include <cstdio>
+#include <thread>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <util/test_utils.hpp>
+#include <util/filesystem_utils.hpp>
+
+#include <4d/app_state.hpp>
+#include <4d/offscreen_renderer.hpp>
+
+
+namespace
+{
+
+/// Red square 1 m in front of the camera, covers the middle of the image.
+std::shared_ptr<MeshFrame> squareFrame(int frameNumber)
+{
+    constexpr int gridSize = 10;
+    auto frame = std::make_shared<MeshFrame>();
+    frame->frame2D = std::make_shared<Frame>();
+    frame->frame2D->frameNumber = frameNumber;
+    frame->frame2D->color = cv::Mat(120, 160, CV_8UC3, cv::Scalar(0, 0, 255));
+    frame->indexedMode = true;
+
+    for (int i = 0; i < gridSize; ++i)
+        for (int j = 0; j < gridSize; ++j)
+        {
+            frame->cloud.emplace_back(-0.3f + 0.6f * j / (gridSize - 1), -0.3f + 0.6f * i / (gridSize - 1), 1.0f);
+            frame->normals.emplace_back(0.0f, 0.0f, -1.0f);
+            frame->uv.emplace_back(float(j) / (gridSize - 1), float(i) / (gridSize - 1));
+        }
+
+    for (int i = 0; i + 1 < gridSize; ++i)
+        for (int j = 0; j + 1 < gridSize; ++j)
+        {
+            const uint16_t p = uint16_t(i * gridSize + j);
+            frame->triangles.push_back({ p, uint16_t(p + 1), uint16_t(p + gridSize) });
+            frame->triangles.push_back({ uint16_t(p + 1), uint16_t(p + gridSize + 1), uint16_t(p + gridSize) });
+        }
+
+    return frame;
+}
+
+}
+
+
+TEST(offscreenRenderer, smoke)
+{
+    appState().reset();
+    const CameraParams camera(200, 160, 120, 320, 240);
+    Calibration calibration;
+    calibration.rmat = cv::Mat::eye(3, 3, CV_32F);
+    calibration.tvec = cv::Mat::zeros(3, 1, CV_32F);
+    auto &sensorManager = appState().getSensorManager();
+    sensorManager.setColorParams(camera, ColorDataFormat::BGR);
+    sensorManager.setDepthParams(camera, DepthDataFormat::UNSIGNED_16BIT_MM);
+    sensorManager.setCalibration(calibration);
+    sensorManager.setInitialized();
+
+    const std::string outputPath{ pathJoin(getTestDataFolder(), "tmp_offscreen") };
+    ASSERT_TRUE(createDirectory(outputPath));
+
+    // more frames than the pixel buffers in flight, so the readback wraps around
+    constexpr int numFrames = 5;
+    CancellationToken cancel;
+    MeshFrameQueue queue(numFrames);
+    for (int i = 0; i < numFrames; ++i)
+        queue.put(squareFrame(i), 0);
+
+    OffscreenRenderer::Settings settings;
+    settings.width = 160;
+    settings.rawOutput = true;
+    std::thread thread([&]
+    {
+        // the context is current in the rendering thread only
+        OffscreenRenderer renderer(outputPath, settings, queue, cancel);
+        renderer.init();
+        renderer.run();
+        EXPECT_EQ(renderer.numRenderedFrames(), numFrames);
+    });
+    while (!queue.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancel.trigger();
+    thread.join();
+
+    const int w = 160, h = 120;
+    const std::string rawPath = pathJoin(outputPath, "frames.bgra");
+    std::vector<char> pixels(size_t(w) * h * 4 * numFrames);
+    {
+        std::ifstream raw(rawPath, std::ios::binary);
+        ASSERT_TRUE(raw.read(pixels.data(), pixels.size()));
+        EXPECT_EQ(raw.peek(), std::ifstream::traits_type::eof());
+    }
+
+    // red square in the middle of every frame, black background in the corner
+    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+    {
+        const auto *frame = reinterpret_cast<const uint8_t *>(pixels.data()) + size_t(frameIdx) * w * h * 4;
+        const uint8_t *center = frame + (size_t(h / 2) * w + w / 2) * 4;
+        EXPECT_GT(center[2], 200);
+        EXPECT_LT(center[0], 50);
+        EXPECT_LT(center[1], 50);
+        EXPECT_EQ(frame[2], 0);
+    }
+
+    EXPECT_EQ(remove(rawPath.c_str()), 0);
+    EXPECT_TRUE(removeDirectory(outputPath));
+}
+
+#endif
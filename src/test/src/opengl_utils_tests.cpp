@@ -0,0 +1,323 @@
+#ifdef WITH_EGL
+
+#include <chrono>
+#include <numeric>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+#include <gtest/gtest.h>
+
+#include <util/tiny_logger.hpp>
+#include <util/opengl_utils.hpp>
+
+
+namespace
+{
+
+/// Bytes of the GPU copy of the buffer, goes through a separate buffer like a draw call would read the data.
+std::vector<uint8_t> readBack(GLuint buffer, size_t offset, size_t size)
+{
+    GLuint copy;
+    glGenBuffers(1, &copy);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, copy);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_READ);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+
+    std::vector<uint8_t> data(size);
+    glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, data.data());
+    glDeleteBuffers(1, &copy);
+    return data;
+}
+
+std::vector<uint8_t> pattern(size_t size, uint8_t first)
+{
+    std::vector<uint8_t> data(size);
+    std::iota(data.begin(), data.end(), first);
+    return data;
+}
+
+/// BGR image where the pixel values depend on the position and the seed.
+cv::Mat patternImage(int w, int h, int seed)
+{
+    cv::Mat image(h, w, CV_8UC3);
+    for (int i = 0; i < h; ++i)
+    {
+        uint8_t *row = image.ptr<uint8_t>(i);
+        for (int j = 0; j < w; ++j)
+            row[3 * j] = uint8_t(seed), row[3 * j + 1] = uint8_t(i), row[3 * j + 2] = uint8_t(j);
+    }
+    return image;
+}
+
+/// BGR pixels of the texture level, tightly packed.
+std::vector<uint8_t> textureLevel(GLuint texture, int level, int w, int h)
+{
+    std::vector<uint8_t> pixels(size_t(w) * h * 3);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_BGR, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+}
+
+
+TEST(streamingBuffer, ringReuse)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    constexpr int numRegions = 3;
+    StreamingBuffer buffer(GL_ARRAY_BUFFER, 1000, numRegions);
+    if (!buffer.isPersistent())
+        return;  // no ARB_buffer_storage, covered by the orphaning test
+
+    const GLuint bufferId = buffer.getBuffer();
+    std::vector<size_t> offsets;
+    for (int i = 0; i < 2 * numRegions; ++i)
+    {
+        const auto data = pattern(1000, uint8_t(i));
+        offsets.push_back(buffer.upload(data.data(), data.size()));
+        EXPECT_EQ(readBack(buffer.getBuffer(), offsets.back(), data.size()), data);
+        buffer.fence();
+    }
+
+    // regions are aligned, used in turn and the storage is never reallocated
+    const size_t regionSize = offsets[1] - offsets[0];
+    EXPECT_GE(regionSize, 1000u);
+    EXPECT_EQ(regionSize % 256, 0u);
+    for (int i = 0; i < 2 * numRegions; ++i)
+    {
+        EXPECT_EQ(offsets[i], ((i + 1) % numRegions) * regionSize);
+        EXPECT_EQ(offsets[i], offsets[(i + numRegions) % offsets.size()]);
+    }
+    EXPECT_EQ(buffer.getBuffer(), bufferId);
+}
+
+TEST(streamingBuffer, fencing)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    // fragments read the buffer through a buffer texture, rasterization runs after the draw call returns
+    // (also in llvmpipe with rasterizer threads), the shader is slow on purpose so the GPU is still busy
+    // when the ring wraps around
+    const char *vertexShader =
+        "#version 330 core\n"
+        "void main()"
+        "{"
+        "    gl_Position = vec4(float(gl_VertexID & 1) * 4.0 - 1.0, float(gl_VertexID >> 1) * 4.0 - 1.0, 0.0, 1.0);"
+        "}";
+    const char *fragmentShader =
+        "#version 330 core\n"
+        "uniform usamplerBuffer data;"
+        "uniform int offset;"
+        "out vec4 color;"
+        "void main()"
+        "{"
+        "    uint value = 0u;"
+        "    for (int i = 0; i < 256; ++i)"
+        "        value = max(value, texelFetch(data, offset + int(gl_FragCoord.x)).r);"
+        "    color = vec4(float(value) / 255.0);"
+        "}";
+    ShaderLoader shader(vertexShader, fragmentShader, "fencing");
+
+    constexpr int w = 256, h = 1024, numRegions = 3;
+    GLuint vertexArray, renderbuffer, framebuffer, texture;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+    ASSERT_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GLenum(GL_FRAMEBUFFER_COMPLETE));
+    glViewport(0, 0, w, h);
+
+    StreamingBuffer buffer(GL_TEXTURE_BUFFER, w, numRegions);
+    const auto first = pattern(w, 1);
+    const size_t offset = buffer.upload(first.data(), first.size());
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, buffer.getBuffer());
+
+    glUseProgram(shader.getProgram());
+    glUniform1i(glGetUniformLocation(shader.getProgram(), "data"), 0);
+    glUniform1i(glGetUniformLocation(shader.getProgram(), "offset"), GLint(offset));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    buffer.fence();
+
+    // the last upload goes to the region of the first one, it must wait until the draw call is done
+    for (int i = 0; i < numRegions; ++i)
+    {
+        const auto next = pattern(w, uint8_t(100 + i));
+        buffer.upload(next.data(), next.size());
+        buffer.fence();
+    }
+
+    std::vector<uint8_t> drawn(w);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, h / 2, w, 1, GL_RED, GL_UNSIGNED_BYTE, drawn.data());
+    EXPECT_EQ(drawn, first);
+
+    glDeleteTextures(1, &texture);
+    glDeleteFramebuffers(1, &framebuffer), glDeleteRenderbuffers(1, &renderbuffer);
+    glDeleteVertexArrays(1, &vertexArray);
+}
+
+TEST(streamingBuffer, growth)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    StreamingBuffer buffer(GL_ELEMENT_ARRAY_BUFFER, 256);
+    const auto small = pattern(200, 0);
+    buffer.upload(small.data(), small.size());
+    buffer.fence();
+
+    // does not fit into a region: the storage grows and the data is complete
+    const auto big = pattern(10000, 7);
+    const size_t offset = buffer.upload(big.data(), big.size());
+    EXPECT_EQ(readBack(buffer.getBuffer(), offset, big.size()), big);
+    buffer.fence();
+
+    const size_t nextOffset = buffer.upload(big.data(), big.size());
+    EXPECT_EQ(readBack(buffer.getBuffer(), nextOffset, big.size()), big);
+    buffer.fence();
+    if (buffer.isPersistent())
+        EXPECT_GE(std::max(offset, nextOffset) - std::min(offset, nextOffset), big.size());
+
+    // smaller uploads keep using the grown regions
+    const size_t smallOffset = buffer.upload(small.data(), small.size());
+    EXPECT_EQ(readBack(buffer.getBuffer(), smallOffset, small.size()), small);
+}
+
+TEST(streamingBuffer, orphaning)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    StreamingBuffer buffer(GL_ARRAY_BUFFER, 1000, 3, false);
+    EXPECT_FALSE(buffer.isPersistent());
+
+    // every upload replaces the whole storage, the data is always at the start
+    for (int i = 0; i < 5; ++i)
+    {
+        const auto data = pattern(i < 3 ? 1000 : 5000, uint8_t(i));
+        EXPECT_EQ(buffer.upload(data.data(), data.size()), 0u);
+        EXPECT_EQ(readBack(buffer.getBuffer(), 0, data.size()), data);
+        buffer.fence();
+    }
+}
+
+TEST(textureStreamer, subRect)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    // odd width, so the rows are not 4-byte aligned
+    constexpr int w = 37, h = 23;
+    const cv::Mat first = patternImage(w, h, 1), second = patternImage(w, h, 2);
+    const cv::Rect rect(5, 3, 20, 11);
+
+    TextureStreamer streamer;
+    streamer.upload(first);
+    streamer.upload(second, rect);
+
+    // the rect comes from the second image at the same position, the rest is left from the first one
+    const auto pixels = textureLevel(streamer.getTexture(), 0, w, h);
+    for (int i = 0; i < h; ++i)
+        for (int j = 0; j < w; ++j)
+        {
+            const uint8_t *p = &pixels[(size_t(i) * w + j) * 3];
+            const bool inside = rect.x <= j && j < rect.x + rect.width && rect.y <= i && i < rect.y + rect.height;
+            ASSERT_EQ(p[0], inside ? 2 : 1) << i << " " << j;
+            ASSERT_EQ(p[1], i);
+            ASSERT_EQ(p[2], j);
+        }
+}
+
+TEST(textureStreamer, mipmapInterval)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    // 16x16 image has 5 levels, the last one is a single pixel
+    constexpr int size = 16, lastLevel = 4, mipmapInterval = 3;
+    TextureStreamer streamer(mipmapInterval);
+    for (int upload = 0; upload < 8; ++upload)
+    {
+        streamer.upload(cv::Mat(size, size, CV_8UC3, cv::Scalar(10 * upload, 0, 0)));
+
+        // the lower levels are regenerated only on every mipmapInterval-th upload
+        const int mipmapped = upload / mipmapInterval * mipmapInterval;
+        EXPECT_EQ(textureLevel(streamer.getTexture(), 0, size, size)[0], 10 * upload);
+        EXPECT_EQ(textureLevel(streamer.getTexture(), lastLevel, 1, 1)[0], 10 * mipmapped) << upload;
+    }
+
+    // without the interval there are no mipmaps at all
+    TextureStreamer noMipmaps;
+    noMipmaps.upload(cv::Mat(size, size, CV_8UC3, cv::Scalar(1, 2, 3)));
+    GLint maxLevel = -1;
+    glBindTexture(GL_TEXTURE_2D, noMipmaps.getTexture());
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    EXPECT_EQ(maxLevel, 0);
+}
+
+TEST(textureStreamer, benchmark)
+{
+    OffscreenContext context;
+    ASSERT_TRUE(context.isValid());
+
+    constexpr int w = 1280, h = 720;
+#if defined(NDEBUG)
+    constexpr int numFrames = 100;
+#else
+    constexpr int numFrames = 10;
+#endif
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < 4; ++i)
+        frames.push_back(patternImage(w, h, i));
+
+    // time of the calls on the render thread and the total time including the GPU (CPU threads with llvmpipe)
+    const auto benchmark = [&](const char *name, const std::function<void(const cv::Mat &)> &upload)
+    {
+        upload(frames.back());
+        glFinish();
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> renderThread(0);
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const auto frameStart = std::chrono::high_resolution_clock::now();
+            upload(frames[i % frames.size()]);
+            renderThread += std::chrono::high_resolution_clock::now() - frameStart;
+            glFlush();
+        }
+        glFinish();
+        const std::chrono::duration<double, std::milli> total = std::chrono::high_resolution_clock::now() - start;
+        TLOG(INFO) << w << "x" << h << " " << name << ": render thread " << renderThread.count() / numFrames
+                   << " ms, total " << total.count() / numFrames << " ms per frame";
+    };
+
+    // what the player did before the streamer
+    GLuint texture;
+    glGenTextures(1, &texture);
+    benchmark("glTexImage2D + mipmaps", [&](const cv::Mat &image)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.cols, image.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    });
+    glDeleteTextures(1, &texture);
+
+    TextureStreamer streamer, mipmapStreamer(4);
+    benchmark("streamer", [&](const cv::Mat &image) { streamer.upload(image); });
+    benchmark("streamer, half the rect", [&](const cv::Mat &image) { streamer.upload(image, cv::Rect(w / 4, 0, w / 2, h)); });
+    benchmark("streamer, mipmaps every 4th frame", [&](const cv::Mat &image) { mipmapStreamer.upload(image); });
+}
+
+#endif
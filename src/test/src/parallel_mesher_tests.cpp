@@ -0,0 +1,224 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <4d/app_state.hpp>
+#include <4d/parallel_mesher.hpp>
+#include <4d/mesh_frame_cache.hpp>
+
+
+namespace
+{
+
+void setupSensor(const CameraParams &cam)
+{
+    Calibration calibration;
+    calibration.rmat = cv::Mat::eye(3, 3, CV_32F);
+    calibration.tvec = cv::Mat::zeros(3, 1, CV_32F);
+
+    auto &sensorManager = appState().getSensorManager();
+    sensorManager.setColorParams(cam, ColorDataFormat::BGR);
+    sensorManager.setDepthParams(cam, DepthDataFormat::UNSIGNED_16BIT_MM);
+    sensorManager.setCalibration(calibration);
+    sensorManager.setInitialized();
+}
+
+/// Smooth surface in front of the camera, slightly different for every frame.
+std::shared_ptr<Frame> syntheticDepthFrame(int frameNumber, const CameraParams &cam)
+{
+    auto frame = std::make_shared<Frame>();
+    frame->frameNumber = frameNumber;
+    frame->depth = cv::Mat::zeros(cam.h, cam.w, CV_16UC1);
+    for (int i = cam.h / 4; i < 3 * cam.h / 4; ++i)
+        for (int j = cam.w / 4; j < 3 * cam.w / 4; ++j)
+            frame->depth.at<uint16_t>(i, j) = uint16_t(1000 + frameNumber + (i + j) / 8);
+    return frame;
+}
+
+}
+
+
+TEST(parallelMesher, frameOrder)
+{
+    const CameraParams cam(300, 160, 120, 320, 240);
+    setupSensor(cam);
+
+    constexpr int numFrames = 40;
+    CancellationToken cancellationToken, outputCancel;
+    FrameQueue input;
+    MeshFrameQueue output;
+    for (int i = 0; i < numFrames; ++i)
+        input.put(syntheticDepthFrame(i, cam));
+
+    MeshFrameProducer producer(outputCancel);
+    producer.addQueue(&output);
+    ParallelMesher mesher(input, producer, cancellationToken, 4);
+    std::thread mesherThread([&]
+    {
+        mesher.init();
+        mesher.run();
+    });
+
+    while (!input.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();  // run() returns only when all the frames are meshed
+    mesherThread.join();
+
+    EXPECT_EQ(mesher.numProcessedFrames(), numFrames);
+    for (int i = 0; i < numFrames; ++i)
+    {
+        std::shared_ptr<MeshFrame> meshFrame;
+        ASSERT_TRUE(output.pop(meshFrame, 0));
+        EXPECT_EQ(meshFrame->frame2D->frameNumber, i);
+        EXPECT_FALSE(meshFrame->triangles.empty());
+    }
+    EXPECT_TRUE(output.empty());
+}
+
+TEST(parallelMesher, frameCache)
+{
+    const CameraParams cam(300, 160, 120, 320, 240);
+    setupSensor(cam);
+
+    // dataset played in a loop: the second pass comes from the cache
+    constexpr int numFrames = 20, numPasses = 2;
+    MeshFrameCache cache;
+    CancellationToken cancellationToken, outputCancel;
+    FrameQueue input;
+    MeshFrameQueue output;
+    for (int i = 0; i < numFrames; ++i)
+        input.put(syntheticDepthFrame(i, cam));
+
+    MeshFrameProducer producer(outputCancel);
+    producer.addQueue(&output);
+    ParallelMesher mesher(input, producer, cancellationToken, 2);
+    mesher.setCache(cache, "synthetic");
+    std::thread mesherThread([&]
+    {
+        mesher.init();
+        mesher.run();
+    });
+
+    // the next pass starts after the first one is meshed, otherwise some frames are not in the cache yet
+    while (mesher.numProcessedFrames() < numFrames)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    for (int i = 0; i < numFrames; ++i)
+        input.put(syntheticDepthFrame(i, cam));
+
+    while (!input.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();
+    mesherThread.join();
+
+    EXPECT_EQ(mesher.numProcessedFrames(), numPasses * numFrames);
+    std::vector<std::shared_ptr<MeshFrame>> firstPass;
+    for (int pass = 0; pass < numPasses; ++pass)
+        for (int i = 0; i < numFrames; ++i)
+        {
+            std::shared_ptr<MeshFrame> meshFrame;
+            ASSERT_TRUE(output.pop(meshFrame, 0));
+            EXPECT_EQ(meshFrame->frame2D->frameNumber, i);
+            if (pass == 0)
+                firstPass.push_back(meshFrame);
+            else
+                EXPECT_EQ(meshFrame->cloud, firstPass[i]->cloud);
+        }
+
+    const auto stats = cache.getStats();
+    EXPECT_EQ(stats.numFrames, numFrames);
+    EXPECT_EQ(stats.numHits, uint64_t(numFrames));
+    EXPECT_GT(stats.numBytes, 0u);
+}
+
+TEST(parallelMesher, cachedFrameLatency)
+{
+    const CameraParams cam(300, 160, 120, 320, 240);
+    setupSensor(cam);
+
+    // looped playback: the frames of the second pass come from the cache, but the latency is measured
+    // from the creation of the second pass frames, not from the first pass
+    constexpr int numFrames = 10;
+    MeshFrameCache cache;
+    CancellationToken cancellationToken, outputCancel;
+    FrameQueue input;
+    MeshFrameQueue output(2 * numFrames);
+    for (int i = 0; i < numFrames; ++i)
+        input.put(syntheticDepthFrame(i, cam));
+
+    MeshFrameProducer producer(outputCancel);
+    producer.addQueue(&output);
+    ParallelMesher mesher(input, producer, cancellationToken, 2);
+    mesher.setCache(cache, "synthetic");
+    std::thread mesherThread([&]
+    {
+        mesher.init();
+        mesher.run();
+    });
+
+    while (mesher.numProcessedFrames() < numFrames)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    for (int i = 0; i < numFrames; ++i)
+    {
+        std::shared_ptr<MeshFrame> meshFrame;
+        ASSERT_TRUE(output.pop(meshFrame, 0));
+    }
+
+    // the whole first pass is older than the second pass
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const auto secondPassStart = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<Frame>> secondPass;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        secondPass.push_back(syntheticDepthFrame(i, cam));
+        input.put(secondPass.back());
+    }
+
+    while (!input.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cancellationToken.trigger();
+    mesherThread.join();
+
+    const auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < numFrames; ++i)
+    {
+        std::shared_ptr<MeshFrame> meshFrame;
+        ASSERT_TRUE(output.pop(meshFrame, 0));
+        EXPECT_EQ(meshFrame->frame2D, secondPass[i]);
+        EXPECT_FALSE(meshFrame->triangles.empty());
+        for (const auto &lod : meshFrame->lods)
+            EXPECT_EQ(lod->frame2D, secondPass[i]);
+        EXPECT_LE(now - meshFrame->frame2D->creationTime, now - secondPassStart);
+    }
+    EXPECT_EQ(cache.getStats().numHits, uint64_t(numFrames));
+}
+
+TEST(parallelMesher, outputCancelled)
+{
+    const CameraParams cam(300, 160, 120, 320, 240);
+    setupSensor(cam);
+
+    // the output is stopped: the mesher returns without meshing the rest of the input
+    constexpr int numFrames = 20;
+    CancellationToken cancellationToken, outputCancel;
+    FrameQueue input;
+    MeshFrameQueue output(1);
+    for (int i = 0; i < numFrames; ++i)
+        input.put(syntheticDepthFrame(i, cam));
+
+    MeshFrameProducer producer(outputCancel);
+    producer.addQueue(&output);
+    ParallelMesher mesher(input, producer, cancellationToken, 2);
+    std::thread mesherThread([&]
+    {
+        mesher.init();
+        mesher.run();
+    });
+
+    while (mesher.numProcessedFrames() < 1)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    outputCancel.trigger();
+    cancellationToken.trigger();
+    mesherThread.join();
+
+    EXPECT_LT(mesher.numProcessedFrames(), numFrames);
+}
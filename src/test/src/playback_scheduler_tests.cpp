@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <4d/playback_scheduler.hpp>
+
+
+namespace
+{
+
+typedef PlaybackScheduler::Clock Clock;
+
+constexpr int64_t frameIntervalUs = 33333;  // 30 fps dataset
+
+std::shared_ptr<MeshFrame> meshFrame(int frameNumber)
+{
+    auto frame = std::make_shared<MeshFrame>();
+    frame->frame2D = std::make_shared<Frame>();
+    frame->frame2D->frameNumber = frameNumber;
+    frame->frame2D->dTimestamp = 1000000 + frameNumber * frameIntervalUs;
+    return frame;
+}
+
+/// Simulated render loop at 60 Hz, frames arrive from the pipeline at the given times (relative to the start).
+/// Returns the numbers of the presented frames.
+std::vector<int> simulate(PlaybackScheduler &scheduler, const std::vector<int64_t> &arrivalUs, int64_t durationUs)
+{
+    const Clock::time_point start;
+    std::vector<int> presented;
+    size_t nextFrame = 0;
+    for (int64_t t = 0; t < durationUs; t += 16667)
+    {
+        const auto now = start + std::chrono::microseconds(t);
+        while (nextFrame < arrivalUs.size() && arrivalUs[nextFrame] <= t && scheduler.canPush())
+            scheduler.push(meshFrame(int(nextFrame)), now), ++nextFrame;
+
+        if (auto frame = scheduler.frameToPresent(now))
+            presented.push_back(frame->frame2D->frameNumber);
+    }
+    return presented;
+}
+
+}
+
+
+TEST(playbackScheduler, steadyPipeline)
+{
+    constexpr int numFrames = 60;
+    std::vector<int64_t> arrivalUs;
+    for (int i = 0; i < numFrames; ++i)
+        arrivalUs.push_back(i * frameIntervalUs);
+
+    PlaybackScheduler scheduler;
+    const auto presented = simulate(scheduler, arrivalUs, 3000000);
+
+    ASSERT_EQ(int(presented.size()), numFrames);
+    for (int i = 0; i < numFrames; ++i)
+        EXPECT_EQ(presented[i], i);
+    EXPECT_EQ(scheduler.getStats().numDropped, 0);
+    EXPECT_NEAR(scheduler.getStats().meanIntervalMs, 33.3f, 1.0f);
+}
+
+TEST(playbackScheduler, jitterAndStalls)
+{
+    // mesher time varies, on average still real time: the jitter buffer absorbs it
+    constexpr int numFrames = 90;
+    std::vector<int64_t> arrivalUs;
+    for (int i = 0; i < numFrames; ++i)
+        arrivalUs.push_back(i * frameIntervalUs + (i % 3) * 25000);
+
+    PlaybackScheduler scheduler;
+    auto presented = simulate(scheduler, arrivalUs, 4000000);
+    EXPECT_EQ(int(presented.size()), numFrames);
+    EXPECT_EQ(scheduler.getStats().numDropped, 0);
+    EXPECT_TRUE(std::is_sorted(presented.begin(), presented.end()));
+
+    // long stall: frames that arrive too late are dropped, the playback does not fall behind the timeline
+    arrivalUs.clear();
+    for (int i = 0; i < numFrames; ++i)
+        arrivalUs.push_back(i < 30 ? i * frameIntervalUs : 1500000 + (i - 30) * frameIntervalUs / 4);
+
+    PlaybackScheduler stalled;
+    presented = simulate(stalled, arrivalUs, 4000000);
+    const auto stats = stalled.getStats();
+    EXPECT_GT(stats.numDropped, 0);
+    EXPECT_EQ(stats.numPresented + stats.numDropped, numFrames);
+    EXPECT_EQ(presented.back(), numFrames - 1);
+    EXPECT_TRUE(std::is_sorted(presented.begin(), presented.end()));
+}
+
+TEST(playbackScheduler, speed)
+{
+    constexpr int numFrames = 60;
+    std::vector<int64_t> arrivalUs(numFrames, 0);  // everything is ready, e.g. mesh cache
+
+    for (double speed : { 0.25, 1.0, 2.0, 8.0 })
+    {
+        PlaybackScheduler scheduler;
+        scheduler.setSpeed(speed, Clock::time_point());
+        EXPECT_EQ(scheduler.getSpeed(), speed);
+
+        // run for half of the dataset duration in the playback time
+        const int64_t durationUs = int64_t(numFrames * frameIntervalUs / 2 / speed);
+        const auto presented = simulate(scheduler, arrivalUs, durationUs);
+        ASSERT_FALSE(presented.empty());
+        EXPECT_NEAR(presented.back(), numFrames / 2, 1 + speed / 2) << speed;
+    }
+
+    PlaybackScheduler scheduler;
+    scheduler.setSpeed(100, Clock::time_point());
+    EXPECT_EQ(scheduler.getSpeed(), PlaybackScheduler::maxSpeed);
+}
+
+TEST(playbackScheduler, restart)
+{
+    PlaybackScheduler scheduler(2);
+    Clock::time_point now;
+    for (int frameNumber : { 10, 11, 0, 1 })
+    {
+        while (!scheduler.canPush())
+        {
+            scheduler.frameToPresent(now);
+            now += std::chrono::milliseconds(10);
+        }
+        scheduler.push(meshFrame(frameNumber), now);
+    }
+
+    // the timeline starts over with frame 0, it does not wait for the timestamps to catch up
+    std::vector<int> presented;
+    for (int i = 0; i < 20; ++i, now += std::chrono::milliseconds(10))
+        if (auto frame = scheduler.frameToPresent(now))
+            presented.push_back(frame->frame2D->frameNumber);
+    EXPECT_EQ(presented, std::vector<int>({ 0, 1 }));
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <util/util.hpp>
+#include <util/varint.hpp>
+#include <util/quantization.hpp>
+
+
+namespace
+{
+
+std::vector<cv::Point3f> randomCloud(int numPoints)
+{
+    std::vector<cv::Point3f> cloud;
+    for (int i = 0; i < numPoints; ++i)
+        cloud.emplace_back(randRange(-1000, 1000) / 997.0f, randRange(-1000, 1000) / 991.0f, randRange(500, 4000) / 1003.0f);
+    return cloud;
+}
+
+bool lessXYZ(const cv::Point3f &a, const cv::Point3f &b)
+{
+    if (a.x != b.x) return a.x < b.x;
+    if (a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
+}
+
+
+TEST(quantization, varint)
+{
+    std::vector<uint8_t> buffer;
+    const int32_t values[] = { 0, -1, 1, 63, -64, 64, 65535, -65535, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() };
+    for (auto v : values)
+        varintEncode(zigzagEncode(v), buffer);
+
+    const uint8_t *p = buffer.data(), *end = p + buffer.size();
+    for (auto v : values)
+    {
+        uint32_t code;
+        p = varintDecode(p, end, code);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(zigzagDecode(code), v);
+    }
+    EXPECT_EQ(p, end);
+}
+
+TEST(quantization, rawRoundTrip)
+{
+    for (int numPoints : { 0, 1, 3, 4, 5, 1001 })
+    {
+        const auto cloud = randomCloud(numPoints);
+        QuantizedCloud q;
+        quantizeCloud(cloud, defaultQuantizationStep, CloudEncoding::RAW, q);
+        EXPECT_EQ(q.payload.size(), 3 * sizeof(uint16_t) * cloud.size());
+
+        std::vector<cv::Point3f> restored;
+        EXPECT_TRUE(dequantizeCloud(q, restored));
+        ASSERT_EQ(restored.size(), cloud.size());
+
+        const float tolerance = 0.5f * q.step + EPSILON;
+        for (size_t i = 0; i < cloud.size(); ++i)
+        {
+            EXPECT_NEAR(restored[i].x, cloud[i].x, tolerance);
+            EXPECT_NEAR(restored[i].y, cloud[i].y, tolerance);
+            EXPECT_NEAR(restored[i].z, cloud[i].z, tolerance);
+        }
+    }
+}
+
+TEST(quantization, mortonDeltaRoundTrip)
+{
+    const auto cloud = randomCloud(5000);
+    QuantizedCloud raw, morton;
+    quantizeCloud(cloud, defaultQuantizationStep, CloudEncoding::RAW, raw);
+    quantizeCloud(cloud, defaultQuantizationStep, CloudEncoding::MORTON_DELTA, morton);
+    EXPECT_LT(morton.payload.size(), raw.payload.size());
+
+    // Morton encoding reorders the points, but the set of quantized points must be exactly the same
+    std::vector<cv::Point3f> fromRaw, fromMorton;
+    EXPECT_TRUE(dequantizeCloud(raw, fromRaw));
+    EXPECT_TRUE(dequantizeCloud(morton, fromMorton));
+    std::sort(fromRaw.begin(), fromRaw.end(), lessXYZ);
+    std::sort(fromMorton.begin(), fromMorton.end(), lessXYZ);
+    EXPECT_TRUE(fromRaw == fromMorton);
+
+    morton.payload.pop_back();
+    EXPECT_FALSE(dequantizeCloud(morton, fromMorton));
+}
+
+TEST(quantization, largeExtent)
+{
+    // 100 meters does not fit into 16 bits with 1mm precision, step should be adjusted automatically
+    const std::vector<cv::Point3f> cloud{ { 0, 0, 0 }, { 100, 0, 1 }, { 50, 25, 2 } };
+    QuantizedCloud q;
+    quantizeCloud(cloud, defaultQuantizationStep, CloudEncoding::RAW, q);
+    EXPECT_GT(q.step, defaultQuantizationStep);
+
+    std::vector<cv::Point3f> restored;
+    EXPECT_TRUE(dequantizeCloud(q, restored));
+    EXPECT_NEAR(restored[1].x, 100, q.step);
+}
+
+TEST(quantization, mortonCode)
+{
+    EXPECT_EQ(mortonCode(0, 0, 0), 0);
+    EXPECT_EQ(mortonCode(1, 0, 0), 1);
+    EXPECT_EQ(mortonCode(0, 1, 0), 2);
+    EXPECT_EQ(mortonCode(0, 0, 1), 4);
+    EXPECT_EQ(mortonCode(0xffff, 0xffff, 0xffff), (uint64_t(1) << 48) - 1);
+}
+
+TEST(quantization, octahedralNormals)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        cv::Point3f n(randRange(-1000, 1000), randRange(-1000, 1000), randRange(-1000, 1000));
+        if (cv::norm(n) < 1)
+            continue;
+        n *= 1.0f / float(cv::norm(n));
+
+        int8_t e[2];
+        octEncode(n, e);
+        const cv::Point3f decoded = octDecode(e);
+        EXPECT_NEAR(cv::norm(decoded), 1, 1e-5);
+        EXPECT_GT(decoded.dot(n), 0.999f);  // within 2.5 degrees
+    }
+
+    for (const cv::Point3f n : { cv::Point3f(0, 0, 1), cv::Point3f(0, 0, -1), cv::Point3f(1, 0, 0), cv::Point3f(0, -1, 0) })
+    {
+        int8_t e[2];
+        octEncode(n, e);
+        EXPECT_LT(cv::norm(octDecode(e) - n), 1e-5);
+    }
+}
+
+TEST(quantization, compactVertices)
+{
+    const auto cloud = randomCloud(1001);
+    std::vector<cv::Point3f> normals;
+    std::vector<cv::Point2f> uv;
+    for (const auto &p : cloud)
+    {
+        normals.push_back(p * (1.0f / float(cv::norm(p))));
+        uv.emplace_back(randRange(0, 1000) / 1000.0f, randRange(0, 1000) / 1000.0f);
+    }
+
+    std::vector<CompactVertex> vertices;
+    cv::Point3f origin;
+    float step;
+    encodeCompactVertices(cloud, normals, uv, vertices, origin, step);
+    ASSERT_EQ(vertices.size(), cloud.size());
+    EXPECT_LT(vertices.size() * sizeof(CompactVertex) * 2, cloud.size() * (2 * sizeof(cv::Point3f) + sizeof(cv::Point2f)));
+
+    std::vector<cv::Point3f> restoredCloud, restoredNormals;
+    std::vector<cv::Point2f> restoredUv;
+    decodeCompactVertices(vertices, origin, step, &restoredCloud, &restoredNormals, &restoredUv);
+    ASSERT_EQ(restoredCloud.size(), cloud.size());
+
+    const float tolerance = 0.5f * step + EPSILON;
+    for (size_t i = 0; i < cloud.size(); ++i)
+    {
+        EXPECT_NEAR(restoredCloud[i].x, cloud[i].x, tolerance);
+        EXPECT_NEAR(restoredCloud[i].y, cloud[i].y, tolerance);
+        EXPECT_NEAR(restoredCloud[i].z, cloud[i].z, tolerance);
+        EXPECT_GT(restoredNormals[i].dot(normals[i]), 0.999f);
+        EXPECT_NEAR(restoredUv[i].x, uv[i].x, 1e-4);
+        EXPECT_NEAR(restoredUv[i].y, uv[i].y, 1e-4);
+    }
+
+    // attributes are optional
+    encodeCompactVertices(cloud, {}, {}, vertices, origin, step);
+    decodeCompactVertices(vertices, origin, step, nullptr, &restoredNormals, &restoredUv);
+    EXPECT_EQ(restoredNormals.front(), cv::Point3f(0, 0, 1));
+    EXPECT_EQ(restoredUv.front(), cv::Point2f(0, 0));
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <4d/app_state.hpp>
+#include <4d/synthetic_sensor.hpp>
+
+
+TEST(syntheticSensor, groundTruth)
+{
+    SyntheticSensorSettings settings;
+    CancellationToken cancellationToken;
+    SyntheticSensor sensor(settings, cancellationToken);
+    const CameraParams &cam = sensor.camera();
+
+    const cv::Mat depth = sensor.groundTruthDepth(0);
+    ASSERT_EQ(depth.cols, settings.width);
+    ASSERT_EQ(depth.rows, settings.height);
+
+    // the wall in the middle, the sphere on the right at the start
+    const int centerI = cam.h / 2, centerJ = cam.w / 2;
+    EXPECT_NEAR(depth.at<uint16_t>(centerI, centerJ), 2200, 1);
+    // the ray towards the sphere center at (0.35, 0, 1.5) with radius 0.3 hits at z = 1.5 * (1 - r / |c|)
+    const int sphereJ = int(cam.cx + cam.f * 0.35f / 1.5f);
+    const double sphereZ = 1500 * (1 - 0.3 / std::sqrt(0.35 * 0.35 + 1.5 * 1.5));
+    EXPECT_NEAR(depth.at<uint16_t>(centerI, sphereJ), sphereZ, 2);
+
+    // objects move
+    const cv::Mat later = sensor.groundTruthDepth(15);
+    EXPECT_NE(later.at<uint16_t>(centerI, sphereJ), depth.at<uint16_t>(centerI, sphereJ));
+
+    // noise and holes around the ground truth, red sphere
+    const auto frame = sensor.renderFrame(0);
+    ASSERT_FALSE(frame->color.empty());
+    int numHoles = 0;
+    double sumError = 0;
+    for (int i = 0; i < depth.rows; ++i)
+        for (int j = 0; j < depth.cols; ++j)
+        {
+            const uint16_t d = frame->depth.at<uint16_t>(i, j);
+            if (d)
+                sumError += std::abs(int(d) - int(depth.at<uint16_t>(i, j)));
+            else
+                ++numHoles;
+        }
+    const int numPixels = int(depth.total());
+    EXPECT_GT(numHoles, numPixels / 200);
+    EXPECT_LT(numHoles, numPixels / 50);
+    EXPECT_GT(sumError / (numPixels - numHoles), 0.5);
+    EXPECT_LT(sumError / (numPixels - numHoles), 10.0);
+
+    const uint8_t *bgr = frame->color.ptr<uint8_t>(centerI) + 3 * sphereJ;
+    EXPECT_GT(bgr[2], 2 * bgr[0]);
+    EXPECT_GT(bgr[2], 2 * bgr[1]);
+}
+
+TEST(syntheticSensor, run)
+{
+    appState().reset();
+
+    SyntheticSensorSettings settings;
+    settings.width = 160, settings.height = 120, settings.numFrames = 10, settings.realTime = false;
+    CancellationToken cancellationToken;
+    FrameQueue queue;
+    SyntheticSensor sensor(settings, cancellationToken);
+    sensor.addQueue(&queue);
+    sensor.init();
+    sensor.run();
+
+    EXPECT_TRUE(appState().getSensorManager().isInitialized());
+    EXPECT_EQ(sensor.numFramesProduced(), settings.numFrames);
+    for (int i = 0; i < settings.numFrames; ++i)
+    {
+        std::shared_ptr<Frame> frame;
+        ASSERT_TRUE(queue.pop(frame, 0));
+        EXPECT_EQ(frame->frameNumber, i);
+        EXPECT_EQ(frame->lastFrame, i + 1 == settings.numFrames);
+        EXPECT_EQ(frame->depth.size(), cv::Size(settings.width, settings.height));
+    }
+    EXPECT_TRUE(queue.empty());
+}
@@ -3,6 +3,16 @@
 #include <gtest/gtest.h>
 
 #include <util/util.hpp>
+#include <util/cpu_features.hpp>
+
+
+namespace
+{
+
+int scalarVariant() { return 0; }
+int avx2Variant() { return 2; }
+
+}
 
 
 TEST(util, memcpyStride)
@@ -18,3 +28,25 @@ TEST(util, memcpyStride)
     range = std::equal_range(std::begin(ones), std::end(ones), 1);
     EXPECT_TRUE(range.first == std::begin(ones) && range.second == std::end(ones));
 }
+
+TEST(util, cpuDispatch)
+{
+    // missing variants fall back to the closest lower level
+    const CpuDispatch<int (*)()> kernel(scalarVariant, nullptr, avx2Variant);
+    EXPECT_EQ(kernel.get(CpuLevel::SCALAR)(), 0);
+    EXPECT_EQ(kernel.get(CpuLevel::SSE42)(), 0);
+    EXPECT_EQ(kernel.get(CpuLevel::AVX2)(), 2);
+    EXPECT_EQ(kernel.get(CpuLevel::AVX512)(), 2);
+
+    // the override can only lower the level
+    setCpuLevelOverride(CpuLevel::SCALAR);
+    EXPECT_EQ(cpuLevel(), CpuLevel::SCALAR);
+    EXPECT_EQ(kernel.get()(), 0);
+
+    setCpuLevelOverride(CpuLevel::AVX512);
+    EXPECT_EQ(cpuLevel(), detectedCpuLevel());
+
+    resetCpuLevelOverride();
+    EXPECT_LE(int(cpuLevel()), int(detectedCpuLevel()));
+    EXPECT_STREQ(cpuLevelName(CpuLevel::SSE42), "sse42");
+}